@@ -0,0 +1,190 @@
+/* Physically contiguous memory from the CMA DMA heap
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+#include <config.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#ifdef HAVE_DMA_HEAP
+#include <linux/dma-buf.h>
+#include <linux/dma-heap.h>
+#endif
+#include "dmabuf_heap.h"
+#include "dmabuf_import.h"
+
+
+GST_DEBUG_CATEGORY_STATIC(imx_dmabuf_heap_debug);
+#define GST_CAT_DEFAULT imx_dmabuf_heap_debug
+
+
+#define DMA_HEAP_DEVICE "/dev/dma_heap/linux,cma"
+
+
+static int heap_fd = -1;
+
+
+static void setup_debug_category(void)
+{
+	static gsize initialized = 0;
+
+	if (g_once_init_enter(&initialized))
+	{
+		GST_DEBUG_CATEGORY_INIT(imx_dmabuf_heap_debug, "imxdmabufheap", 0, "Physically contiguous memory from the CMA DMA heap");
+		g_once_init_leave(&initialized, 1);
+	}
+}
+
+
+#ifdef HAVE_DMA_HEAP
+
+static void gst_imx_dmabuf_heap_sync(int fd, __u64 flags)
+{
+	struct dma_buf_sync sync;
+
+	sync.flags = flags;
+	if (ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync) < 0)
+		GST_ERROR("could not sync DMABUF with fd %d: %s", fd, strerror(errno));
+}
+
+#endif
+
+
+gboolean gst_imx_dmabuf_heap_is_available(void)
+{
+	static gsize checked = 0;
+
+	setup_debug_category();
+
+	if (g_once_init_enter(&checked))
+	{
+#ifdef HAVE_DMA_HEAP
+		int fd;
+		guintptr phys_addr;
+
+		heap_fd = open(DMA_HEAP_DEVICE, O_RDWR | O_CLOEXEC);
+		if (heap_fd < 0)
+			GST_INFO("could not open %s: %s - exportable blocks cannot be allocated", DMA_HEAP_DEVICE, strerror(errno));
+		else
+		{
+			/* Mainline kernels have the heap, but no way to get the physical
+			 * address; test this with a small block */
+			fd = gst_imx_dmabuf_heap_alloc(4096, &phys_addr);
+			if (fd < 0)
+			{
+				GST_INFO("physical address of DMA heap blocks cannot be retrieved - exportable blocks cannot be allocated");
+				close(heap_fd);
+				heap_fd = -1;
+			}
+			else
+				close(fd);
+		}
+#else
+		GST_INFO("built without DMA heap support - exportable blocks cannot be allocated");
+#endif
+
+		g_once_init_leave(&checked, 1);
+	}
+
+	return (heap_fd >= 0);
+}
+
+
+int gst_imx_dmabuf_heap_alloc(gsize size, guintptr *phys_addr)
+{
+#ifdef HAVE_DMA_HEAP
+	struct dma_heap_allocation_data alloc_data;
+
+	setup_debug_category();
+
+	memset(&alloc_data, 0, sizeof(alloc_data));
+	alloc_data.len = size;
+	alloc_data.fd_flags = O_RDWR | O_CLOEXEC;
+
+	if (ioctl(heap_fd, DMA_HEAP_IOCTL_ALLOC, &alloc_data) < 0)
+	{
+		GST_ERROR("could not allocate %" G_GSIZE_FORMAT " bytes from the DMA heap: %s", size, strerror(errno));
+		return -1;
+	}
+
+	*phys_addr = gst_imx_dmabuf_get_phys_addr(alloc_data.fd);
+	if (*phys_addr == 0)
+	{
+		close(alloc_data.fd);
+		return -1;
+	}
+
+	GST_DEBUG("allocated %" G_GSIZE_FORMAT " bytes from the DMA heap at phys addr %p, fd %d", size, (gpointer)(*phys_addr), (int)(alloc_data.fd));
+
+	return alloc_data.fd;
+#else
+	(void)size;
+	(void)phys_addr;
+	return -1;
+#endif
+}
+
+
+gpointer gst_imx_dmabuf_heap_map(int fd, gsize size, GstMapFlags flags)
+{
+	int prot = 0;
+	gpointer virt_addr;
+
+	setup_debug_category();
+
+	if (flags & GST_MAP_READ)
+		prot |= PROT_READ;
+	if (flags & GST_MAP_WRITE)
+		prot |= PROT_WRITE;
+
+	virt_addr = mmap(NULL, size, prot, MAP_SHARED, fd, 0);
+	if (virt_addr == MAP_FAILED)
+	{
+		GST_ERROR("could not map DMABUF with fd %d: %s", fd, strerror(errno));
+		return NULL;
+	}
+
+	return virt_addr;
+}
+
+
+void gst_imx_dmabuf_heap_unmap(gpointer virt_addr, gsize size)
+{
+	munmap(virt_addr, size);
+}
+
+
+void gst_imx_dmabuf_heap_flush(int fd)
+{
+#ifdef HAVE_DMA_HEAP
+	gst_imx_dmabuf_heap_sync(fd, DMA_BUF_SYNC_END | DMA_BUF_SYNC_WRITE);
+#else
+	(void)fd;
+#endif
+}
+
+
+void gst_imx_dmabuf_heap_invalidate(int fd)
+{
+#ifdef HAVE_DMA_HEAP
+	gst_imx_dmabuf_heap_sync(fd, DMA_BUF_SYNC_START | DMA_BUF_SYNC_READ);
+#else
+	(void)fd;
+#endif
+}
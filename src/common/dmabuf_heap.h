@@ -0,0 +1,55 @@
+/* Physically contiguous memory from the CMA DMA heap
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+#ifndef GST_IMX_COMMON_DMABUF_HEAP_H
+#define GST_IMX_COMMON_DMABUF_HEAP_H
+
+#include <gst/gst.h>
+
+
+G_BEGIN_DECLS
+
+
+/* The VPU and IPU kernel drivers cannot export their memory blocks as DMABUF.
+ * Blocks that need to be exported are allocated from the kernel's CMA DMA heap
+ * instead, which directly returns a DMABUF; its physical address is retrieved
+ * with the ioctl of the Freescale/NXP kernels (see dmabuf_import.h). The CPU
+ * mapping of these blocks is cached, and kept coherent with DMA_BUF_IOCTL_SYNC.
+ * The physical memory allocator base class uses these functions for blocks with
+ * the GST_IMX_PHYS_MEM_FLAG_DMABUF flag. */
+
+/* Returns TRUE if the DMA heap exists, and the physical address of its blocks can
+ * be retrieved. The check is done only once. */
+gboolean gst_imx_dmabuf_heap_is_available(void);
+
+/* Allocates a block; returns its DMABUF file descriptor and sets phys_addr, or
+ * returns -1 in case of an error. The block is freed by closing the descriptor.
+ * Only valid after gst_imx_dmabuf_heap_is_available() returned TRUE. */
+int gst_imx_dmabuf_heap_alloc(gsize size, guintptr *phys_addr);
+gpointer gst_imx_dmabuf_heap_map(int fd, gsize size, GstMapFlags flags);
+void gst_imx_dmabuf_heap_unmap(gpointer virt_addr, gsize size);
+
+/* Writes back CPU writes, so hardware sees them */
+void gst_imx_dmabuf_heap_flush(int fd);
+/* Discards cached contents, so the CPU sees hardware writes */
+void gst_imx_dmabuf_heap_invalidate(int fd);
+
+
+G_END_DECLS
+
+
+#endif
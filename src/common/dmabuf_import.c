@@ -0,0 +1,140 @@
+/* Import of DMABUF memory as physically contiguous memory
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include <string.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <gst/allocators/gstdmabuf.h>
+#include "dmabuf_import.h"
+#include "phys_mem_meta.h"
+
+
+GST_DEBUG_CATEGORY_STATIC(imx_dmabuf_import_debug);
+#define GST_CAT_DEFAULT imx_dmabuf_import_debug
+
+
+/* The Freescale/NXP kernels provide this ioctl for retrieving the physical
+ * address of a physically contiguous DMABUF; mainline kernels do not have it,
+ * in which case the ioctl fails, and the import is not possible */
+#ifndef DMA_BUF_IOCTL_PHYS
+#define DMA_BUF_IOCTL_PHYS _IOW('b', 10, unsigned long)
+#endif
+
+#define DMABUF_PHYS_ADDR_QDATA "GstImxDmabufPhysAddr"
+
+/* Cached physical address for DMABUFs whose address could not be resolved;
+ * prevents repeated ioctl calls for these */
+#define UNRESOLVABLE_PHYS_ADDR ((guintptr)(-1))
+
+
+static void setup_debug_category(void)
+{
+	static gsize initialized = 0;
+
+	if (g_once_init_enter(&initialized))
+	{
+		GST_DEBUG_CATEGORY_INIT(imx_dmabuf_import_debug, "imxdmabufimport", 0, "DMABUF import functions");
+		g_once_init_leave(&initialized, 1);
+	}
+}
+
+
+static GQuark gst_imx_dmabuf_phys_addr_quark(void)
+{
+	static GQuark quark = 0;
+	if (quark == 0)
+		quark = g_quark_from_static_string(DMABUF_PHYS_ADDR_QDATA);
+	return quark;
+}
+
+
+guintptr gst_imx_dmabuf_get_phys_addr(int fd)
+{
+	unsigned long phys_addr;
+
+	setup_debug_category();
+
+	if (ioctl(fd, DMA_BUF_IOCTL_PHYS, &phys_addr) < 0)
+	{
+		GST_DEBUG("could not resolve physical address of DMABUF with fd %d: %s", fd, strerror(errno));
+		return 0;
+	}
+
+	GST_DEBUG("DMABUF with fd %d has physical address %p", fd, (gpointer)phys_addr);
+
+	return (guintptr)phys_addr;
+}
+
+
+guintptr gst_imx_dmabuf_import_memory(GstMemory *memory)
+{
+	gpointer cached;
+	guintptr phys_addr;
+
+	setup_debug_category();
+
+	if (!gst_is_dmabuf_memory(memory))
+		return 0;
+
+	/* The fd is owned by the memory block, so the memory block is
+	 * the natural place for caching the per-fd result */
+	cached = gst_mini_object_get_qdata(GST_MINI_OBJECT_CAST(memory), gst_imx_dmabuf_phys_addr_quark());
+	if (cached != NULL)
+		return ((guintptr)cached == UNRESOLVABLE_PHYS_ADDR) ? 0 : (guintptr)cached;
+
+	phys_addr = gst_imx_dmabuf_get_phys_addr(gst_dmabuf_memory_get_fd(memory));
+
+	gst_mini_object_set_qdata(GST_MINI_OBJECT_CAST(memory), gst_imx_dmabuf_phys_addr_quark(), (gpointer)((phys_addr != 0) ? phys_addr : UNRESOLVABLE_PHYS_ADDR), NULL);
+
+	return phys_addr;
+}
+
+
+GstBuffer* gst_imx_dmabuf_import_buffer(GstBuffer *buffer)
+{
+	GstMemory *memory;
+	guintptr phys_addr;
+	GstImxPhysMemMeta *phys_mem_meta;
+
+	setup_debug_category();
+
+	/* Only single-memory buffers are supported, since there is no
+	 * guarantee that multiple DMABUFs are contiguous to each other */
+	if (gst_buffer_n_memory(buffer) != 1)
+		return NULL;
+
+	memory = gst_buffer_peek_memory(buffer, 0);
+	phys_addr = gst_imx_dmabuf_import_memory(memory);
+	if (phys_addr == 0)
+		return NULL;
+
+	/* Metas can only be added to writable buffers; if the buffer is not writable,
+	 * this creates a shallow copy, which does not copy the pixels */
+	buffer = gst_buffer_make_writable(gst_buffer_ref(buffer));
+
+	phys_mem_meta = GST_IMX_PHYS_MEM_META_ADD(buffer);
+	phys_mem_meta->phys_addr = phys_addr + memory->offset;
+	phys_mem_meta->x_padding = 0;
+	phys_mem_meta->y_padding = 0;
+	phys_mem_meta->padding = 0;
+
+	GST_LOG("imported DMABUF buffer %p with phys addr %p", (gpointer)buffer, (gpointer)(phys_mem_meta->phys_addr));
+
+	return buffer;
+}
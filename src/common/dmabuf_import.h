@@ -0,0 +1,50 @@
+/* Import of DMABUF memory as physically contiguous memory
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#ifndef GST_IMX_COMMON_DMABUF_IMPORT_H
+#define GST_IMX_COMMON_DMABUF_IMPORT_H
+
+#include <gst/gst.h>
+
+
+G_BEGIN_DECLS
+
+
+/* Resolves the physical address of a DMABUF file descriptor. Returns 0 if the
+ * kernel cannot resolve it. */
+guintptr gst_imx_dmabuf_get_phys_addr(int fd);
+
+/* Resolves the physical address of a DMABUF memory block. Returns 0 if the
+ * memory is not a DMABUF, or if the kernel cannot resolve its physical address
+ * (for example because the DMABUF is not physically contiguous). The result is
+ * cached in the memory block, so subsequent calls for the same block (which is
+ * the common case with buffer pools upstream) do not need a syscall. */
+guintptr gst_imx_dmabuf_import_memory(GstMemory *memory);
+
+/* Tries to import a buffer consisting of one DMABUF memory block. If this works,
+ * a new reference to a buffer with a GstImxPhysMemMeta is returned; this is either
+ * the given buffer or a shallow copy of it, sharing the same memory. Otherwise,
+ * NULL is returned. The given buffer is not consumed. */
+GstBuffer* gst_imx_dmabuf_import_buffer(GstBuffer *buffer);
+
+
+G_END_DECLS
+
+
+#endif
@@ -18,13 +18,73 @@
 
 
 #include <string.h>
+#include <unistd.h>
 #include "phys_mem_allocator.h"
+#include "phys_mem_copy.h"
+#include "dmabuf_heap.h"
 
 
 GST_DEBUG_CATEGORY_STATIC(imx_phys_mem_allocator_debug);
 #define GST_CAT_DEFAULT imx_phys_mem_allocator_debug
 
 
+/* Size classes are page-aligned, and spaced at a quarter of the next lower
+ * power of two, limiting the amount of wasted memory per block to 25% */
+#define SIZE_CLASS_MIN_GRANULARITY 4096
+
+
+/* A freed block that is kept in the recycler; contains everything
+ * that is necessary to either reuse or actually free the block */
+typedef struct
+{
+	gsize size;
+	gpointer mapped_virt_addr;
+	guintptr phys_addr, cpu_addr;
+	GstMapFlags mapping_flags;
+	GstImxPhysMemCacheMode cache_mode;
+	gboolean device_only;
+	gint64 release_time;
+}
+GstImxPhysMemRecycledBlock;
+
+
+/* Recycler keys combine the size class, the cache mode, and the device-only
+ * flag; size classes are multiples of 4096, so the lowest bits are free for these.
+ * Device-only blocks are kept separate, since subclasses may allocate (and free)
+ * them differently. */
+#define RECYCLER_DEVICE_ONLY_BIT  0x4
+#define RECYCLER_KEY(SIZE, CACHE_MODE, DEVICE_ONLY)  GSIZE_TO_POINTER((SIZE) | (gsize)(CACHE_MODE) | ((DEVICE_ONLY) ? RECYCLER_DEVICE_ONLY_BIT : 0))
+
+
+static GstMemoryFlags cache_mode_flags[] =
+{
+	0,
+	GST_IMX_PHYS_MEM_FLAG_WRITE_COMBINE,
+	GST_IMX_PHYS_MEM_FLAG_CACHED
+};
+
+
+/* Default recycler parameters. The recycler is disabled by default, since recycled
+ * blocks are only freed during allocations and deallocations, and the allocators
+ * of the VPU elements are never finalized; enabled recyclers would therefore keep
+ * their blocks after a pipeline stops. Setting GST_IMX_PHYS_MEM_RECYCLER_MAX_BYTES
+ * to 33554432 (32 MiB) is enough to keep the buffers of a few 1080p frames around
+ * during seeks and renegotiations. */
+#define DEFAULT_RECYCLER_MAX_BYTES 0
+#define DEFAULT_RECYCLER_IDLE_TIMEOUT (5 * GST_SECOND)
+
+static gsize default_recycler_max_bytes = DEFAULT_RECYCLER_MAX_BYTES;
+static GstClockTime default_recycler_idle_timeout = DEFAULT_RECYCLER_IDLE_TIMEOUT;
+
+
+static gchar const *cache_mode_names[] =
+{
+	"uncached",
+	"write-combined",
+	"cached"
+};
+
+
 static void gst_imx_phys_mem_allocator_finalize(GObject *object);
 static GstMemory* gst_imx_phys_mem_allocator_alloc(GstAllocator *allocator, gsize size, GstAllocationParams *params);
 static void gst_imx_phys_mem_allocator_free(GstAllocator *allocator, GstMemory *memory);
@@ -33,6 +93,20 @@ static void gst_imx_phys_mem_allocator_unmap(GstMemory *mem);
 static GstMemory* gst_imx_phys_mem_allocator_copy(GstMemory *mem, gssize offset, gssize size);
 static GstMemory* gst_imx_phys_mem_allocator_share(GstMemory *mem, gssize offset, gssize size);
 static gboolean gst_imx_phys_mem_allocator_is_span(GstMemory *mem1, GstMemory *mem2, gsize *offset);
+static gpointer gst_imx_phys_mem_allocator_map_block(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem, GstMapFlags flags);
+static void gst_imx_phys_mem_allocator_unmap_block(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem);
+static void gst_imx_phys_mem_allocator_flush_block(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem);
+static gpointer gst_imx_phys_mem_allocator_map_phys_mem(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem, GstMapFlags flags);
+static void gst_imx_phys_mem_allocator_unmap_phys_mem(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem);
+static void gst_imx_phys_mem_allocator_flush_region(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem, gsize offset, gsize size);
+static void gst_imx_phys_mem_allocator_invalidate_region(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem, gsize offset, gsize size);
+static gsize gst_imx_phys_mem_allocator_get_size_class(gsize size);
+static gboolean gst_imx_phys_mem_allocator_reuse_block(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem);
+static gboolean gst_imx_phys_mem_allocator_recycle_block(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem);
+static void gst_imx_phys_mem_allocator_free_recycled_block(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemRecycledBlock *block);
+static GSList* gst_imx_phys_mem_allocator_collect_idle_blocks(GstImxPhysMemAllocator *phys_mem_alloc, GstClockTime max_idle_time);
+static void gst_imx_phys_mem_allocator_free_recycled_blocks(GstImxPhysMemAllocator *phys_mem_alloc, GSList *blocks);
+static void gst_imx_phys_mem_allocator_read_recycler_defaults(void);
 
 
 G_DEFINE_ABSTRACT_TYPE(GstImxPhysMemAllocator, gst_imx_phys_mem_allocator, GST_TYPE_ALLOCATOR)
@@ -49,6 +123,11 @@ void gst_imx_phys_mem_allocator_class_init(GstImxPhysMemAllocatorClass *klass)
 	klass->free_phys_mem   = NULL;
 	klass->map_phys_mem    = NULL;
 	klass->unmap_phys_mem  = NULL;
+	klass->export_dmabuf   = NULL;
+	klass->flush_phys_mem  = NULL;
+	klass->invalidate_phys_mem   = NULL;
+	klass->supported_cache_modes = GST_IMX_PHYS_MEM_CACHE_MODE_BIT(GST_IMX_PHYS_MEM_CACHE_MODE_UNCACHED);
+	klass->native_cache_mode     = GST_IMX_PHYS_MEM_CACHE_MODE_UNCACHED;
 	parent_class->alloc    = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_allocator_alloc);
 	parent_class->free     = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_allocator_free);
 	object_class->finalize = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_allocator_finalize);
@@ -59,6 +138,19 @@ void gst_imx_phys_mem_allocator_init(GstImxPhysMemAllocator *allocator)
 {
 	GstAllocator *parent = GST_ALLOCATOR(allocator);
 
+	g_mutex_init(&(allocator->mutex));
+
+	allocator->recycled_blocks = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)g_queue_free);
+	allocator->recycler_max_bytes = 0;
+	allocator->recycled_bytes = 0;
+	allocator->num_recycled_blocks = 0;
+	allocator->recycler_idle_timeout = GST_CLOCK_TIME_NONE;
+	allocator->recycler_hits = 0;
+	allocator->recycler_misses = 0;
+
+	/* The instance's class is already the final one at this point,
+	 * so this picks the counters of the actual allocator type */
+	allocator->type_stats = gst_imx_phys_mem_stats_get_for_type(G_TYPE_FROM_INSTANCE(allocator));
 
 	parent->mem_type    = NULL;
 	parent->mem_map     = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_allocator_map);
@@ -71,7 +163,16 @@ void gst_imx_phys_mem_allocator_init(GstImxPhysMemAllocator *allocator)
 
 static void gst_imx_phys_mem_allocator_finalize(GObject *object)
 {
+	GstImxPhysMemAllocator *phys_mem_alloc = GST_IMX_PHYS_MEM_ALLOCATOR(object);
+
 	GST_INFO_OBJECT(object, "shutting down physical memory allocator");
+
+	gst_imx_phys_mem_allocator_log_recycler_stats(phys_mem_alloc, GST_OBJECT(object));
+
+	gst_imx_phys_mem_allocator_trim_recycler(phys_mem_alloc, 0);
+	g_hash_table_destroy(phys_mem_alloc->recycled_blocks);
+
+	g_mutex_clear(&(phys_mem_alloc->mutex));
 	G_OBJECT_CLASS (gst_imx_phys_mem_allocator_parent_class)->finalize(object);
 }
 
@@ -83,6 +184,12 @@ static GstImxPhysMemory* gst_imx_phys_mem_new_internal(GstImxPhysMemAllocator *p
 	phys_mem->mapped_virt_addr = NULL;
 	phys_mem->phys_addr = 0;
 	phys_mem->cpu_addr = 0;
+	phys_mem->mapping_flags = 0;
+	phys_mem->mapping_refcount = 0;
+	phys_mem->cpu_dirty = FALSE;
+	phys_mem->dmabuf_fd = -1;
+	phys_mem->dmabuf_heap_fd = -1;
+	phys_mem->owner_stats = NULL;
 
 	gst_memory_init(GST_MEMORY_CAST(phys_mem), flags, GST_ALLOCATOR_CAST(phys_mem_alloc), parent, maxsize, align, offset, size);
 
@@ -95,6 +202,7 @@ static GstImxPhysMemory* gst_imx_phys_mem_allocator_alloc_internal(GstAllocator
 	GstImxPhysMemAllocator *phys_mem_alloc;
 	GstImxPhysMemAllocatorClass *klass;
 	GstImxPhysMemory *phys_mem;
+	gboolean use_heap = FALSE;
 
 	phys_mem_alloc = GST_IMX_PHYS_MEM_ALLOCATOR(allocator);
 	klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(allocator));
@@ -108,18 +216,99 @@ static GstImxPhysMemory* gst_imx_phys_mem_allocator_alloc_internal(GstAllocator
 		size
 	);
 
+	/* With the recycler enabled, blocks are allocated with size class granularity,
+	 * to make it possible to reuse them for slightly different sizes later. Blocks
+	 * larger than the recycler budget can never be recycled, so they keep their size. */
+	if (phys_mem_alloc->recycler_max_bytes > 0)
+	{
+		gsize size_class = gst_imx_phys_mem_allocator_get_size_class(maxsize);
+		if (size_class <= phys_mem_alloc->recycler_max_bytes)
+			maxsize = size_class;
+	}
+
+	/* Replace the requested cache mode with the native one if it is not supported */
+	if (parent == NULL)
+	{
+		GstImxPhysMemCacheMode cache_mode = GST_IMX_PHYS_MEM_CACHE_MODE_UNCACHED;
+
+		if (flags & GST_IMX_PHYS_MEM_FLAG_CACHED)
+			cache_mode = GST_IMX_PHYS_MEM_CACHE_MODE_CACHED;
+		else if (flags & GST_IMX_PHYS_MEM_FLAG_WRITE_COMBINE)
+			cache_mode = GST_IMX_PHYS_MEM_CACHE_MODE_WRITE_COMBINE;
+
+		if (!(klass->supported_cache_modes & GST_IMX_PHYS_MEM_CACHE_MODE_BIT(cache_mode)))
+		{
+			GST_DEBUG_OBJECT(allocator, "%s mappings not supported - using %s mapping instead", cache_mode_names[cache_mode], cache_mode_names[klass->native_cache_mode]);
+			cache_mode = klass->native_cache_mode;
+		}
+
+		flags = (flags & ~GST_IMX_PHYS_MEM_CACHE_FLAGS) | cache_mode_flags[cache_mode];
+
+		/* Blocks which the subclass cannot export come from the DMA heap */
+		if ((flags & GST_IMX_PHYS_MEM_FLAG_DMABUF) && (klass->export_dmabuf == NULL))
+		{
+			if (!gst_imx_dmabuf_heap_is_available())
+			{
+				GST_ERROR_OBJECT(allocator, "exportable block requested, but the DMA heap is not available");
+				return NULL;
+			}
+
+			use_heap = TRUE;
+			flags = (flags & ~GST_IMX_PHYS_MEM_CACHE_FLAGS) | GST_IMX_PHYS_MEM_FLAG_CACHED;
+		}
+	}
+
 	phys_mem = gst_imx_phys_mem_new_internal(phys_mem_alloc, parent, maxsize, flags, align, offset, size);
-	if (!klass->alloc_phys_mem(phys_mem_alloc, phys_mem, maxsize))
+	if (use_heap || !gst_imx_phys_mem_allocator_reuse_block(phys_mem_alloc, phys_mem))
 	{
-		g_slice_free1(sizeof(GstImxPhysMemory), phys_mem);
-		return NULL;
+		gboolean allocated;
+
+		if (use_heap)
+		{
+			phys_mem->dmabuf_heap_fd = gst_imx_dmabuf_heap_alloc(maxsize, &(phys_mem->phys_addr));
+			allocated = (phys_mem->dmabuf_heap_fd >= 0);
+		}
+		else
+			allocated = klass->alloc_phys_mem(phys_mem_alloc, phys_mem, maxsize);
+
+		if (!allocated)
+		{
+			gst_imx_phys_mem_stats_allocation_failed(phys_mem_alloc->type_stats, maxsize);
+			g_slice_free1(sizeof(GstImxPhysMemory), phys_mem);
+			return NULL;
+		}
+
+		/* Recycled blocks are still accounted for as allocated, so
+		 * only newly allocated ones are added here */
+		gst_imx_phys_mem_stats_block_allocated(phys_mem_alloc->type_stats, maxsize);
+	}
+
+	phys_mem->owner_stats = gst_imx_phys_mem_stats_owner_acquire(maxsize);
+
+	/* Some allocators (like the VPU ones) map the block into the process
+	 * already during allocation */
+	if (phys_mem->mapped_virt_addr != NULL)
+	{
+		phys_mem->mapping_flags = GST_MAP_READWRITE;
+
+		/* If the subclass could not allocate the block without mapping it,
+		 * it cannot be treated as device-only; clear the flag, so the
+		 * mapping is kept alive until the block is freed */
+		if (GST_MEMORY_FLAG_IS_SET(phys_mem, GST_IMX_PHYS_MEM_FLAG_DEVICE_ONLY))
+		{
+			GST_DEBUG_OBJECT(allocator, "block %p was mapped during allocation - cannot be device-only", (gpointer)phys_mem);
+			GST_MEMORY_FLAG_UNSET(phys_mem, GST_IMX_PHYS_MEM_FLAG_DEVICE_ONLY);
+		}
 	}
 
 	if ((offset > 0) && (flags & GST_MEMORY_FLAG_ZERO_PREFIXED))
 	{
-		gpointer ptr = klass->map_phys_mem(phys_mem_alloc, phys_mem, maxsize, GST_MAP_WRITE);
-		memset(ptr, 0, offset);
-		klass->unmap_phys_mem(phys_mem_alloc, phys_mem);
+		gpointer ptr = gst_imx_phys_mem_allocator_map_block(phys_mem_alloc, phys_mem, GST_MAP_WRITE);
+		if (ptr != NULL)
+		{
+			memset(ptr, 0, offset);
+			gst_imx_phys_mem_allocator_unmap_block(phys_mem_alloc, phys_mem);
+		}
 	}
 
 	return phys_mem;
@@ -149,9 +338,397 @@ static void gst_imx_phys_mem_allocator_free(GstAllocator *allocator, GstMemory *
 	GstImxPhysMemAllocator *phys_mem_alloc = GST_IMX_PHYS_MEM_ALLOCATOR(allocator);
 	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(allocator));
 
-	klass->free_phys_mem(phys_mem_alloc, phys_mem);
+	/* Sub-blocks created by share() do not own the physical memory;
+	 * the parent block is unref'd by GstMemory itself */
+	if (memory->parent == NULL)
+	{
+		if (phys_mem->mapping_refcount > 0)
+			GST_WARNING_OBJECT(allocator, "block %p is freed while still being mapped %d time(s)", (gpointer)memory, phys_mem->mapping_refcount);
+
+		if (phys_mem->dmabuf_fd >= 0)
+		{
+			close(phys_mem->dmabuf_fd);
+			phys_mem->dmabuf_fd = -1;
+		}
+
+		gst_imx_phys_mem_stats_owner_release(phys_mem->owner_stats, memory->maxsize);
+
+		/* Recycled blocks keep their CPU mapping; DMA heap blocks are never recycled */
+		if ((phys_mem->dmabuf_heap_fd >= 0) || !gst_imx_phys_mem_allocator_recycle_block(phys_mem_alloc, phys_mem))
+		{
+			/* Tear down the CPU mapping; it has been kept alive for the
+			 * entire lifetime of the block */
+			if (phys_mem->mapped_virt_addr != NULL)
+				gst_imx_phys_mem_allocator_unmap_phys_mem(phys_mem_alloc, phys_mem);
+
+			if (phys_mem->dmabuf_heap_fd >= 0)
+			{
+				close(phys_mem->dmabuf_heap_fd);
+				phys_mem->dmabuf_heap_fd = -1;
+			}
+			else
+				klass->free_phys_mem(phys_mem_alloc, phys_mem);
+
+			gst_imx_phys_mem_stats_block_freed(phys_mem_alloc->type_stats, memory->maxsize);
+		}
+	}
 
 	GST_INFO_OBJECT(allocator, "freed block %p at phys addr 0x%x with size: %u", (gpointer)memory, phys_mem->phys_addr, memory->size);
+
+	g_slice_free1(sizeof(GstImxPhysMemory), phys_mem);
+}
+
+
+static gpointer gst_imx_phys_mem_allocator_map_block(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem, GstMapFlags flags)
+{
+	GstMapFlags access;
+	gpointer ptr;
+
+	access = flags & GST_MAP_READWRITE;
+
+	g_mutex_lock(&(phys_mem_alloc->mutex));
+
+	/* Only call the subclass if there is no mapping yet, or if the existing
+	 * mapping does not cover the requested access (for example, when a block
+	 * that has been mapped for reading so far is now mapped for writing);
+	 * in the latter case, the mapping is upgraded to cover both */
+	if ((phys_mem->mapped_virt_addr == NULL) || ((phys_mem->mapping_flags & access) != access))
+	{
+		GstMapFlags new_flags = access;
+		if (phys_mem->mapped_virt_addr != NULL)
+			new_flags |= phys_mem->mapping_flags;
+
+		GST_DEBUG_OBJECT(phys_mem_alloc, "%s CPU mapping of block %p (phys addr %p)  access flags: 0x%x -> 0x%x", (phys_mem->mapped_virt_addr == NULL) ? "creating" : "upgrading", (gpointer)phys_mem, (gpointer)(phys_mem->phys_addr), phys_mem->mapping_flags, new_flags);
+
+		ptr = gst_imx_phys_mem_allocator_map_phys_mem(phys_mem_alloc, phys_mem, new_flags);
+		if (ptr == NULL)
+		{
+			/* If upgrading failed, the old mapping cannot be relied upon
+			 * anymore either; go back to the unmapped state */
+			if (phys_mem->mapped_virt_addr != NULL)
+			{
+				GST_WARNING_OBJECT(phys_mem_alloc, "upgrading CPU mapping of block %p failed; block is unmapped now, %d existing mapping(s) became invalid", (gpointer)phys_mem, phys_mem->mapping_refcount);
+				phys_mem->mapped_virt_addr = NULL;
+				phys_mem->mapping_flags = 0;
+				phys_mem->mapping_refcount = 0;
+			}
+
+			g_mutex_unlock(&(phys_mem_alloc->mutex));
+			return NULL;
+		}
+
+		phys_mem->mapped_virt_addr = ptr;
+		phys_mem->mapping_flags = new_flags;
+	}
+
+	/* Cached contents may be stale if hardware wrote to the block; discard them
+	 * before the CPU reads. Not done if there are unflushed CPU writes, since
+	 * these would be lost. */
+	if ((phys_mem->mapping_refcount == 0) && (access & GST_MAP_READ) && !(phys_mem->cpu_dirty))
+		gst_imx_phys_mem_allocator_invalidate_region(phys_mem_alloc, phys_mem, 0, phys_mem->mem.maxsize);
+
+	if (access & GST_MAP_WRITE)
+		phys_mem->cpu_dirty = TRUE;
+
+	phys_mem->mapping_refcount++;
+	ptr = phys_mem->mapped_virt_addr;
+
+	g_mutex_unlock(&(phys_mem_alloc->mutex));
+
+	return ptr;
+}
+
+
+static void gst_imx_phys_mem_allocator_unmap_block(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem)
+{
+	g_mutex_lock(&(phys_mem_alloc->mutex));
+
+	/* The mapping itself stays alive; it is torn down in free()
+	 * (except for device-only blocks, see below) */
+	if (phys_mem->mapping_refcount > 0)
+		phys_mem->mapping_refcount--;
+	else
+		GST_WARNING_OBJECT(phys_mem_alloc, "unmapping block %p which is not mapped", (gpointer)phys_mem);
+
+	/* Write back CPU writes once nobody has the block mapped anymore,
+	 * so hardware sees the data */
+	if (phys_mem->mapping_refcount == 0)
+	{
+		gst_imx_phys_mem_allocator_flush_block(phys_mem_alloc, phys_mem);
+
+		/* Device-only blocks do not keep their CPU mapping around, to
+		 * free up the virtual address space again */
+		if (GST_MEMORY_FLAG_IS_SET(phys_mem, GST_IMX_PHYS_MEM_FLAG_DEVICE_ONLY) && (phys_mem->mapped_virt_addr != NULL))
+		{
+			GST_DEBUG_OBJECT(phys_mem_alloc, "tearing down CPU mapping of device-only block %p (phys addr %p)", (gpointer)phys_mem, (gpointer)(phys_mem->phys_addr));
+			gst_imx_phys_mem_allocator_unmap_phys_mem(phys_mem_alloc, phys_mem);
+			phys_mem->mapped_virt_addr = NULL;
+			phys_mem->mapping_flags = 0;
+		}
+	}
+
+	g_mutex_unlock(&(phys_mem_alloc->mutex));
+}
+
+
+/* Must be called with the mutex locked */
+static void gst_imx_phys_mem_allocator_flush_block(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem)
+{
+	if (!(phys_mem->cpu_dirty))
+		return;
+
+	gst_imx_phys_mem_allocator_flush_region(phys_mem_alloc, phys_mem, 0, phys_mem->mem.maxsize);
+
+	phys_mem->cpu_dirty = FALSE;
+}
+
+
+/* The functions below forward to the subclass, except for DMA heap blocks,
+ * which are handled by the base class */
+
+static gpointer gst_imx_phys_mem_allocator_map_phys_mem(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem, GstMapFlags flags)
+{
+	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(phys_mem_alloc));
+
+	if (phys_mem->dmabuf_heap_fd < 0)
+		return klass->map_phys_mem(phys_mem_alloc, phys_mem, phys_mem->mem.maxsize, flags);
+
+	/* DMA heap blocks are always mapped for reading and writing,
+	 * so upgrades can keep the existing mapping */
+	if (phys_mem->mapped_virt_addr != NULL)
+		return phys_mem->mapped_virt_addr;
+	else
+		return gst_imx_dmabuf_heap_map(phys_mem->dmabuf_heap_fd, phys_mem->mem.maxsize, GST_MAP_READWRITE);
+}
+
+
+static void gst_imx_phys_mem_allocator_unmap_phys_mem(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem)
+{
+	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(phys_mem_alloc));
+
+	if (phys_mem->dmabuf_heap_fd < 0)
+		klass->unmap_phys_mem(phys_mem_alloc, phys_mem);
+	else
+		gst_imx_dmabuf_heap_unmap(phys_mem->mapped_virt_addr, phys_mem->mem.maxsize);
+}
+
+
+static void gst_imx_phys_mem_allocator_flush_region(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem, gsize offset, gsize size)
+{
+	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(phys_mem_alloc));
+
+	if (gst_imx_phys_memory_get_cache_mode((GstMemory *)phys_mem) != GST_IMX_PHYS_MEM_CACHE_MODE_CACHED)
+		return;
+
+	/* DMABUF syncs always cover the entire block */
+	if (phys_mem->dmabuf_heap_fd >= 0)
+		gst_imx_dmabuf_heap_flush(phys_mem->dmabuf_heap_fd);
+	else if (klass->flush_phys_mem != NULL)
+		klass->flush_phys_mem(phys_mem_alloc, phys_mem, offset, size);
+}
+
+
+static void gst_imx_phys_mem_allocator_invalidate_region(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem, gsize offset, gsize size)
+{
+	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(phys_mem_alloc));
+
+	if (gst_imx_phys_memory_get_cache_mode((GstMemory *)phys_mem) != GST_IMX_PHYS_MEM_CACHE_MODE_CACHED)
+		return;
+
+	if (phys_mem->dmabuf_heap_fd >= 0)
+		gst_imx_dmabuf_heap_invalidate(phys_mem->dmabuf_heap_fd);
+	else if (klass->invalidate_phys_mem != NULL)
+		klass->invalidate_phys_mem(phys_mem_alloc, phys_mem, offset, size);
+}
+
+
+static gsize gst_imx_phys_mem_allocator_get_size_class(gsize size)
+{
+	gsize pow2 = 1, granularity;
+
+	while ((pow2 << 1) <= size)
+		pow2 <<= 1;
+
+	granularity = MAX(SIZE_CLASS_MIN_GRANULARITY, pow2 / 4);
+
+	return ((size + granularity - 1) / granularity) * granularity;
+}
+
+
+static gboolean gst_imx_phys_mem_allocator_reuse_block(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem)
+{
+	GQueue *queue;
+	GstImxPhysMemRecycledBlock *block;
+	GSList *idle_blocks;
+
+	if (phys_mem_alloc->recycler_max_bytes == 0)
+		return FALSE;
+
+	g_mutex_lock(&(phys_mem_alloc->mutex));
+
+	/* Take the most recently recycled block of this size class; its
+	 * pages are the most likely ones to still be in the caches/TLB */
+	queue = g_hash_table_lookup(phys_mem_alloc->recycled_blocks, RECYCLER_KEY(phys_mem->mem.maxsize, gst_imx_phys_memory_get_cache_mode((GstMemory *)phys_mem), GST_MEMORY_FLAG_IS_SET(phys_mem, GST_IMX_PHYS_MEM_FLAG_DEVICE_ONLY)));
+	block = (queue != NULL) ? g_queue_pop_tail(queue) : NULL;
+
+	if (block != NULL)
+	{
+		phys_mem->mapped_virt_addr = block->mapped_virt_addr;
+		phys_mem->phys_addr = block->phys_addr;
+		phys_mem->cpu_addr = block->cpu_addr;
+		phys_mem->mapping_flags = block->mapping_flags;
+		phys_mem->mapping_refcount = 0;
+
+		phys_mem_alloc->recycled_bytes -= block->size;
+		phys_mem_alloc->num_recycled_blocks--;
+		phys_mem_alloc->recycler_hits++;
+
+		GST_DEBUG_OBJECT(phys_mem_alloc, "reusing recycled block with %" G_GSIZE_FORMAT " bytes at phys addr %p", block->size, (gpointer)(block->phys_addr));
+
+		g_slice_free1(sizeof(GstImxPhysMemRecycledBlock), block);
+	}
+	else
+		phys_mem_alloc->recycler_misses++;
+
+	/* Use this opportunity to get rid of blocks which have been idle for too long */
+	idle_blocks = gst_imx_phys_mem_allocator_collect_idle_blocks(phys_mem_alloc, phys_mem_alloc->recycler_idle_timeout);
+
+	g_mutex_unlock(&(phys_mem_alloc->mutex));
+
+	gst_imx_phys_mem_allocator_free_recycled_blocks(phys_mem_alloc, idle_blocks);
+
+	return (block != NULL);
+}
+
+
+static gboolean gst_imx_phys_mem_allocator_recycle_block(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemory *phys_mem)
+{
+	GQueue *queue;
+	GstImxPhysMemRecycledBlock *block;
+	GSList *idle_blocks;
+	gsize size = phys_mem->mem.maxsize;
+
+	if (phys_mem_alloc->recycler_max_bytes == 0)
+		return FALSE;
+
+	g_mutex_lock(&(phys_mem_alloc->mutex));
+
+	/* Blocks which do not fit in the budget, or which have been allocated
+	 * before the recycler was enabled (and therefore do not have a size class
+	 * size) are freed as usual */
+	if (((phys_mem_alloc->recycled_bytes + size) > phys_mem_alloc->recycler_max_bytes) || (size != gst_imx_phys_mem_allocator_get_size_class(size)))
+	{
+		g_mutex_unlock(&(phys_mem_alloc->mutex));
+		return FALSE;
+	}
+
+	block = g_slice_alloc(sizeof(GstImxPhysMemRecycledBlock));
+	block->size = size;
+	block->mapped_virt_addr = phys_mem->mapped_virt_addr;
+	block->phys_addr = phys_mem->phys_addr;
+	block->cpu_addr = phys_mem->cpu_addr;
+	block->mapping_flags = phys_mem->mapping_flags;
+	block->cache_mode = gst_imx_phys_memory_get_cache_mode((GstMemory *)phys_mem);
+	block->device_only = GST_MEMORY_FLAG_IS_SET(phys_mem, GST_IMX_PHYS_MEM_FLAG_DEVICE_ONLY);
+	block->release_time = g_get_monotonic_time();
+
+	queue = g_hash_table_lookup(phys_mem_alloc->recycled_blocks, RECYCLER_KEY(size, block->cache_mode, block->device_only));
+	if (queue == NULL)
+	{
+		queue = g_queue_new();
+		g_hash_table_insert(phys_mem_alloc->recycled_blocks, RECYCLER_KEY(size, block->cache_mode, block->device_only), queue);
+	}
+	g_queue_push_tail(queue, block);
+
+	phys_mem_alloc->recycled_bytes += size;
+	phys_mem_alloc->num_recycled_blocks++;
+
+	GST_DEBUG_OBJECT(phys_mem_alloc, "recycled block with %" G_GSIZE_FORMAT " bytes at phys addr %p; recycler now contains %u blocks with %" G_GSIZE_FORMAT " bytes", size, (gpointer)(block->phys_addr), phys_mem_alloc->num_recycled_blocks, phys_mem_alloc->recycled_bytes);
+
+	idle_blocks = gst_imx_phys_mem_allocator_collect_idle_blocks(phys_mem_alloc, phys_mem_alloc->recycler_idle_timeout);
+
+	g_mutex_unlock(&(phys_mem_alloc->mutex));
+
+	gst_imx_phys_mem_allocator_free_recycled_blocks(phys_mem_alloc, idle_blocks);
+
+	return TRUE;
+}
+
+
+static void gst_imx_phys_mem_allocator_free_recycled_block(GstImxPhysMemAllocator *phys_mem_alloc, GstImxPhysMemRecycledBlock *block)
+{
+	GstImxPhysMemory phys_mem;
+	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(phys_mem_alloc));
+
+	/* The free_phys_mem and unmap_phys_mem vfuncs expect a memory block;
+	 * set up a temporary one that describes the recycled block */
+	memset(&phys_mem, 0, sizeof(GstImxPhysMemory));
+	phys_mem.mem.allocator = GST_ALLOCATOR_CAST(phys_mem_alloc);
+	phys_mem.mem.maxsize = block->size;
+	phys_mem.mem.size = block->size;
+	phys_mem.mapped_virt_addr = block->mapped_virt_addr;
+	phys_mem.phys_addr = block->phys_addr;
+	phys_mem.cpu_addr = block->cpu_addr;
+	phys_mem.mapping_flags = block->mapping_flags;
+	GST_MINI_OBJECT_FLAGS(&(phys_mem.mem)) = cache_mode_flags[block->cache_mode] | (block->device_only ? GST_IMX_PHYS_MEM_FLAG_DEVICE_ONLY : 0);
+
+	if (phys_mem.mapped_virt_addr != NULL)
+		klass->unmap_phys_mem(phys_mem_alloc, &phys_mem);
+	klass->free_phys_mem(phys_mem_alloc, &phys_mem);
+	gst_imx_phys_mem_stats_block_freed(phys_mem_alloc->type_stats, block->size);
+
+	GST_DEBUG_OBJECT(phys_mem_alloc, "freed recycled block with %" G_GSIZE_FORMAT " bytes at phys addr %p", block->size, (gpointer)(block->phys_addr));
+
+	g_slice_free1(sizeof(GstImxPhysMemRecycledBlock), block);
+}
+
+
+/* Must be called with the mutex locked; the returned blocks are removed from the
+ * recycler, and must be freed with gst_imx_phys_mem_allocator_free_recycled_blocks()
+ * after the mutex is unlocked */
+static GSList* gst_imx_phys_mem_allocator_collect_idle_blocks(GstImxPhysMemAllocator *phys_mem_alloc, GstClockTime max_idle_time)
+{
+	GHashTableIter iter;
+	gpointer value;
+	gint64 now;
+	GSList *idle_blocks = NULL;
+
+	if (!GST_CLOCK_TIME_IS_VALID(max_idle_time) || (phys_mem_alloc->num_recycled_blocks == 0))
+		return NULL;
+
+	now = g_get_monotonic_time();
+
+	g_hash_table_iter_init(&iter, phys_mem_alloc->recycled_blocks);
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+	{
+		GQueue *queue = (GQueue *)value;
+
+		/* The queues are ordered by release time, oldest blocks first */
+		while (!g_queue_is_empty(queue))
+		{
+			GstImxPhysMemRecycledBlock *block = g_queue_peek_head(queue);
+			if ((GstClockTime)(now - block->release_time) * GST_USECOND < max_idle_time)
+				break;
+
+			g_queue_pop_head(queue);
+			phys_mem_alloc->recycled_bytes -= block->size;
+			phys_mem_alloc->num_recycled_blocks--;
+			idle_blocks = g_slist_prepend(idle_blocks, block);
+		}
+	}
+
+	return idle_blocks;
+}
+
+
+static void gst_imx_phys_mem_allocator_free_recycled_blocks(GstImxPhysMemAllocator *phys_mem_alloc, GSList *blocks)
+{
+	GSList *node;
+
+	for (node = blocks; node != NULL; node = node->next)
+		gst_imx_phys_mem_allocator_free_recycled_block(phys_mem_alloc, (GstImxPhysMemRecycledBlock *)(node->data));
+
+	g_slist_free(blocks);
 }
 
 
@@ -159,11 +736,16 @@ static gpointer gst_imx_phys_mem_allocator_map(GstMemory *mem, gsize maxsize, Gs
 {
 	GstImxPhysMemory *phys_mem = (GstImxPhysMemory *)mem;
 	GstImxPhysMemAllocator *phys_mem_alloc = GST_IMX_PHYS_MEM_ALLOCATOR(mem->allocator);
-	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(mem->allocator));
 
 	GST_TRACE_OBJECT(phys_mem_alloc, "mapping %u bytes from memory block %p (phys addr %p)", maxsize, (gpointer)mem, (gpointer)(phys_mem->phys_addr));
 
-	return klass->map_phys_mem(phys_mem_alloc, phys_mem, maxsize, flags);
+	/* Sub-blocks use the mapping of the block they were shared from;
+	 * mem->offset is relative to the start of that block, which is what
+	 * GstMemory expects */
+	if (mem->parent != NULL)
+		phys_mem = (GstImxPhysMemory *)(mem->parent);
+
+	return gst_imx_phys_mem_allocator_map_block(phys_mem_alloc, phys_mem, flags);
 }
 
 
@@ -171,11 +753,13 @@ static void gst_imx_phys_mem_allocator_unmap(GstMemory *mem)
 {
 	GstImxPhysMemory *phys_mem = (GstImxPhysMemory *)mem;
 	GstImxPhysMemAllocator *phys_mem_alloc = GST_IMX_PHYS_MEM_ALLOCATOR(mem->allocator);
-	GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(mem->allocator));
 
 	GST_TRACE_OBJECT(phys_mem_alloc, "unmapping memory block %p (phys addr %p)", (gpointer)mem, (gpointer)(phys_mem->phys_addr));
 
-	klass->unmap_phys_mem(phys_mem_alloc, phys_mem);
+	if (mem->parent != NULL)
+		phys_mem = (GstImxPhysMemory *)(mem->parent);
+
+	gst_imx_phys_mem_allocator_unmap_block(phys_mem_alloc, phys_mem);
 }
 
 
@@ -186,20 +770,56 @@ static GstMemory* gst_imx_phys_mem_allocator_copy(GstMemory *mem, gssize offset,
 	if (size == -1)
 		size = ((gssize)(mem->size) > offset) ? (mem->size - offset) : 0;
 
-	copy = gst_imx_phys_mem_allocator_alloc_internal(mem->allocator, NULL, mem->maxsize, 0, mem->align, mem->offset + offset, size);
+	/* Only the requested region is copied, into a new block that
+	 * contains just this region */
+	copy = gst_imx_phys_mem_allocator_alloc_internal(mem->allocator, NULL, size, GST_MINI_OBJECT_FLAGS(mem) & GST_IMX_PHYS_MEM_CACHE_FLAGS, mem->align, 0, size);
+
+	if (copy == NULL)
+	{
+		GST_ERROR_OBJECT(mem->allocator, "could not allocate memory block for copy");
+		return NULL;
+	}
 
 	{
 		gpointer srcptr, destptr;
 		GstImxPhysMemAllocator *phys_mem_alloc = (GstImxPhysMemAllocator*)(mem->allocator);
-		GstImxPhysMemAllocatorClass *klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(mem->allocator));
-
-		srcptr = klass->map_phys_mem(phys_mem_alloc, (GstImxPhysMemory *)mem, mem->maxsize, GST_MAP_READ);
-		destptr = klass->map_phys_mem(phys_mem_alloc, copy, mem->maxsize, GST_MAP_WRITE);
-
-		memcpy(destptr, srcptr, mem->maxsize);
-
-		klass->unmap_phys_mem(phys_mem_alloc, copy);
-		klass->unmap_phys_mem(phys_mem_alloc, (GstImxPhysMemory *)mem);
+		GstImxPhysMemory *src_phys_mem = (GstImxPhysMemory *)((mem->parent != NULL) ? mem->parent : mem);
+
+		/* The copy may be done by hardware, which needs to see pending CPU writes */
+		g_mutex_lock(&(phys_mem_alloc->mutex));
+		gst_imx_phys_mem_allocator_flush_block(phys_mem_alloc, src_phys_mem);
+		g_mutex_unlock(&(phys_mem_alloc->mutex));
+
+		srcptr = gst_imx_phys_mem_allocator_map_block(phys_mem_alloc, src_phys_mem, GST_MAP_READ);
+		destptr = gst_imx_phys_mem_allocator_map_block(phys_mem_alloc, copy, GST_MAP_WRITE);
+
+		/* The mapped pointers refer to the beginning of the blocks, while
+		 * gst_imx_phys_memory_get_phys_addr() takes the offset into account */
+		if ((srcptr != NULL) && (destptr != NULL))
+		{
+			guint8 const *src_data = (guint8 const *)srcptr + mem->offset + offset;
+			gsize num_hw_copied;
+
+			num_hw_copied = gst_imx_phys_mem_copy_hw_prefix(
+				gst_imx_phys_memory_get_phys_addr((GstMemory *)copy),
+				gst_imx_phys_memory_get_phys_addr(mem) + offset,
+				size
+			);
+
+			/* The hardware wrote past the CPU cache; discard the cached contents
+			 * of the copy before the CPU writes the rest, so neither stale lines
+			 * are read later nor the CPU writes are lost */
+			if (num_hw_copied > 0)
+				gst_imx_phys_memory_invalidate((GstMemory *)copy);
+
+			if (num_hw_copied < (gsize)size)
+				memcpy((guint8 *)destptr + num_hw_copied, src_data + num_hw_copied, size - num_hw_copied);
+		}
+
+		if (destptr != NULL)
+			gst_imx_phys_mem_allocator_unmap_block(phys_mem_alloc, copy);
+		if (srcptr != NULL)
+			gst_imx_phys_mem_allocator_unmap_block(phys_mem_alloc, src_phys_mem);
 	}
 
 	GST_INFO_OBJECT(
@@ -241,8 +861,16 @@ static GstMemory* gst_imx_phys_mem_allocator_share(GstMemory *mem, gssize offset
 		phys_mem->mem.offset + offset,
 		size
 	);
+	/* The addresses refer to the beginning of the block; the share
+	 * offset is accounted for by the sub-block's mem.offset */
 	sub->phys_addr = phys_mem->phys_addr;
 	sub->cpu_addr = phys_mem->cpu_addr;
+	/* The mapping of device-only blocks can go away at any time,
+	 * so sub-blocks of these must not hold on to it */
+	if (GST_MEMORY_FLAG_IS_SET(parent, GST_IMX_PHYS_MEM_FLAG_DEVICE_ONLY))
+		sub->mapped_virt_addr = NULL;
+	else
+		sub->mapped_virt_addr = ((GstImxPhysMemory *)parent)->mapped_virt_addr;
 
 	GST_INFO_OBJECT(
 		mem->allocator,
@@ -260,21 +888,246 @@ static GstMemory* gst_imx_phys_mem_allocator_share(GstMemory *mem, gssize offset
 }
 
 
-static gboolean gst_imx_phys_mem_allocator_is_span(G_GNUC_UNUSED GstMemory *mem1, G_GNUC_UNUSED GstMemory *mem2, G_GNUC_UNUSED gsize *offset)
+static gboolean gst_imx_phys_mem_allocator_is_span(GstMemory *mem1, GstMemory *mem2, gsize *offset)
+{
+	/* GstMemory only calls this if both blocks have the same parent,
+	 * so the offset is relative to that parent */
+	if (offset != NULL)
+		*offset = mem1->offset - mem1->parent->offset;
+
+	/* The blocks are contiguous if the second one starts
+	 * right where the first one ends */
+	return (gst_imx_phys_memory_get_phys_addr(mem1) + mem1->size) == gst_imx_phys_memory_get_phys_addr(mem2);
+}
+
+
+void gst_imx_phys_mem_allocator_set_recycler_params(GstImxPhysMemAllocator *allocator, gsize max_bytes, GstClockTime idle_timeout)
+{
+	GSList *excess_blocks;
+
+	g_mutex_lock(&(allocator->mutex));
+
+	allocator->recycler_max_bytes = max_bytes;
+	allocator->recycler_idle_timeout = idle_timeout;
+
+	GST_INFO_OBJECT(allocator, "recycler %s  max bytes: %" G_GSIZE_FORMAT "  idle timeout: %" GST_TIME_FORMAT, (max_bytes > 0) ? "enabled" : "disabled", max_bytes, GST_TIME_ARGS(idle_timeout));
+
+	/* If the recycled blocks exceed the new budget, flush the recycler entirely */
+	if (allocator->recycled_bytes > max_bytes)
+		excess_blocks = gst_imx_phys_mem_allocator_collect_idle_blocks(allocator, 0);
+	else
+		excess_blocks = gst_imx_phys_mem_allocator_collect_idle_blocks(allocator, idle_timeout);
+
+	g_mutex_unlock(&(allocator->mutex));
+
+	gst_imx_phys_mem_allocator_free_recycled_blocks(allocator, excess_blocks);
+}
+
+
+void gst_imx_phys_mem_allocator_trim_recycler(GstImxPhysMemAllocator *allocator, GstClockTime max_idle_time)
+{
+	GSList *idle_blocks;
+
+	g_mutex_lock(&(allocator->mutex));
+	idle_blocks = gst_imx_phys_mem_allocator_collect_idle_blocks(allocator, max_idle_time);
+	g_mutex_unlock(&(allocator->mutex));
+
+	gst_imx_phys_mem_allocator_free_recycled_blocks(allocator, idle_blocks);
+}
+
+
+void gst_imx_phys_mem_allocator_get_recycler_stats(GstImxPhysMemAllocator *allocator, guint64 *hits, guint64 *misses, guint *num_blocks, gsize *num_bytes)
+{
+	g_mutex_lock(&(allocator->mutex));
+
+	if (hits != NULL)
+		*hits = allocator->recycler_hits;
+	if (misses != NULL)
+		*misses = allocator->recycler_misses;
+	if (num_blocks != NULL)
+		*num_blocks = allocator->num_recycled_blocks;
+	if (num_bytes != NULL)
+		*num_bytes = allocator->recycled_bytes;
+
+	g_mutex_unlock(&(allocator->mutex));
+}
+
+
+static void gst_imx_phys_mem_allocator_read_recycler_defaults(void)
+{
+	static gsize initialized = 0;
+
+	if (g_once_init_enter(&initialized))
+	{
+		gchar const *str;
+
+		str = g_getenv("GST_IMX_PHYS_MEM_RECYCLER_MAX_BYTES");
+		if (str != NULL)
+		{
+			default_recycler_max_bytes = (gsize)g_ascii_strtoull(str, NULL, 10);
+			GST_INFO("using recycler max bytes %" G_GSIZE_FORMAT " from environment", default_recycler_max_bytes);
+		}
+
+		str = g_getenv("GST_IMX_PHYS_MEM_RECYCLER_IDLE_TIMEOUT");
+		if (str != NULL)
+		{
+			default_recycler_idle_timeout = (GstClockTime)g_ascii_strtoull(str, NULL, 10) * GST_MSECOND;
+			GST_INFO("using recycler idle timeout %" GST_TIME_FORMAT " from environment", GST_TIME_ARGS(default_recycler_idle_timeout));
+		}
+
+		g_once_init_leave(&initialized, 1);
+	}
+}
+
+
+void gst_imx_phys_mem_allocator_enable_default_recycler(GstImxPhysMemAllocator *allocator)
+{
+	gst_imx_phys_mem_allocator_read_recycler_defaults();
+	gst_imx_phys_mem_allocator_set_recycler_params(allocator, default_recycler_max_bytes, default_recycler_idle_timeout);
+}
+
+
+void gst_imx_phys_mem_allocator_log_recycler_stats(GstImxPhysMemAllocator *allocator, GstObject *context)
+{
+	guint64 hits, misses;
+	guint num_blocks;
+	gsize num_bytes;
+
+	gst_imx_phys_mem_allocator_get_recycler_stats(allocator, &hits, &misses, &num_blocks, &num_bytes);
+	GST_INFO_OBJECT(context, "recycler statistics of %" GST_PTR_FORMAT ":  hits: %" G_GUINT64_FORMAT "  misses: %" G_GUINT64_FORMAT "  recycled blocks: %u  recycled bytes: %" G_GSIZE_FORMAT, (gpointer)allocator, hits, misses, num_blocks, num_bytes);
+}
+
+
+gboolean gst_imx_phys_mem_allocator_supports_dmabuf_export(GstAllocator *allocator)
+{
+	if (!GST_IS_IMX_PHYS_MEM_ALLOCATOR(allocator))
+		return FALSE;
+
+	return (GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(allocator))->export_dmabuf != NULL) || gst_imx_dmabuf_heap_is_available();
+}
+
+
+int gst_imx_phys_memory_get_dmabuf_fd(GstMemory *mem)
+{
+	GstImxPhysMemory *phys_mem;
+	GstImxPhysMemAllocator *phys_mem_alloc;
+	GstImxPhysMemAllocatorClass *klass;
+	GstMemory *sub_block = NULL;
+	int fd;
+
+	if (!gst_imx_is_phys_memory(mem))
+		return -1;
+
+	/* sub-blocks do not own the physical memory; export the parent instead */
+	if (mem->parent != NULL)
+	{
+		sub_block = mem;
+		mem = mem->parent;
+	}
+
+	phys_mem = (GstImxPhysMemory *)mem;
+	phys_mem_alloc = GST_IMX_PHYS_MEM_ALLOCATOR(mem->allocator);
+	klass = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(phys_mem_alloc));
+
+	if ((klass->export_dmabuf == NULL) && (phys_mem->dmabuf_heap_fd < 0))
+	{
+		GST_ERROR_OBJECT(phys_mem_alloc, "block %p cannot be exported; it was not allocated with the DMABUF flag", (gpointer)mem);
+		return -1;
+	}
+
+	g_mutex_lock(&(phys_mem_alloc->mutex));
+
+	if (phys_mem->dmabuf_fd < 0)
+	{
+		if (phys_mem->dmabuf_heap_fd >= 0)
+			phys_mem->dmabuf_fd = dup(phys_mem->dmabuf_heap_fd);
+		else
+			phys_mem->dmabuf_fd = klass->export_dmabuf(phys_mem_alloc, phys_mem);
+		if (phys_mem->dmabuf_fd >= 0)
+		{
+			gst_mini_object_set_qdata(GST_MINI_OBJECT_CAST(mem), g_quark_from_static_string(GST_IMX_PHYS_MEMORY_DMABUF_FD_QDATA), GINT_TO_POINTER(phys_mem->dmabuf_fd), NULL);
+			GST_DEBUG_OBJECT(phys_mem_alloc, "exported block %p at phys addr %p as DMABUF with fd %d", (gpointer)mem, (gpointer)(phys_mem->phys_addr), phys_mem->dmabuf_fd);
+		}
+		else
+			GST_ERROR_OBJECT(phys_mem_alloc, "could not export block %p at phys addr %p as DMABUF", (gpointer)mem, (gpointer)(phys_mem->phys_addr));
+	}
+
+	fd = phys_mem->dmabuf_fd;
+
+	g_mutex_unlock(&(phys_mem_alloc->mutex));
+
+	/* Attach the descriptor to the sub-block as well, since downstream only
+	 * gets to see the sub-block; the parent still owns the descriptor */
+	if ((sub_block != NULL) && (fd >= 0))
+		gst_mini_object_set_qdata(GST_MINI_OBJECT_CAST(sub_block), g_quark_from_static_string(GST_IMX_PHYS_MEMORY_DMABUF_FD_QDATA), GINT_TO_POINTER(fd), NULL);
+
+	return fd;
+}
+
+
+gboolean gst_imx_phys_mem_allocator_supports_cache_mode(GstAllocator *allocator, GstImxPhysMemCacheMode cache_mode)
 {
-	return FALSE;
+	return GST_IS_IMX_PHYS_MEM_ALLOCATOR(allocator) && (GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(G_OBJECT_GET_CLASS(allocator))->supported_cache_modes & GST_IMX_PHYS_MEM_CACHE_MODE_BIT(cache_mode));
+}
+
+
+GstImxPhysMemCacheMode gst_imx_phys_memory_get_cache_mode(GstMemory *mem)
+{
+	if (GST_MEMORY_FLAG_IS_SET(mem, GST_IMX_PHYS_MEM_FLAG_CACHED))
+		return GST_IMX_PHYS_MEM_CACHE_MODE_CACHED;
+	else if (GST_MEMORY_FLAG_IS_SET(mem, GST_IMX_PHYS_MEM_FLAG_WRITE_COMBINE))
+		return GST_IMX_PHYS_MEM_CACHE_MODE_WRITE_COMBINE;
+	else
+		return GST_IMX_PHYS_MEM_CACHE_MODE_UNCACHED;
+}
+
+
+void gst_imx_phys_memory_flush(GstMemory *mem)
+{
+	GstImxPhysMemAllocator *phys_mem_alloc = GST_IMX_PHYS_MEM_ALLOCATOR(mem->allocator);
+
+	if (mem->parent != NULL)
+		mem = mem->parent;
+
+	g_mutex_lock(&(phys_mem_alloc->mutex));
+	gst_imx_phys_mem_allocator_flush_block(phys_mem_alloc, (GstImxPhysMemory *)mem);
+	g_mutex_unlock(&(phys_mem_alloc->mutex));
+}
+
+
+void gst_imx_phys_memory_invalidate(GstMemory *mem)
+{
+	GstImxPhysMemAllocator *phys_mem_alloc = GST_IMX_PHYS_MEM_ALLOCATOR(mem->allocator);
+
+	/* Invalidate only the region of this memory; for sub-blocks,
+	 * the offset is relative to the parent's mapping */
+	gst_imx_phys_mem_allocator_invalidate_region(phys_mem_alloc, (GstImxPhysMemory *)((mem->parent != NULL) ? mem->parent : mem), mem->offset, mem->size);
+}
+
+
+void gst_imx_phys_mem_buffer_flush(GstBuffer *buffer)
+{
+	guint i, num_memory = gst_buffer_n_memory(buffer);
+
+	for (i = 0; i < num_memory; ++i)
+	{
+		GstMemory *mem = gst_buffer_peek_memory(buffer, i);
+		if (gst_imx_is_phys_memory(mem))
+			gst_imx_phys_memory_flush(mem);
+	}
 }
 
 
 guintptr gst_imx_phys_memory_get_phys_addr(GstMemory *mem)
 {
-	return ((GstImxPhysMemory *)mem)->phys_addr;
+	return ((GstImxPhysMemory *)mem)->phys_addr + mem->offset;
 }
 
 
 guintptr gst_imx_phys_memory_get_cpu_addr(GstMemory *mem)
 {
-	return ((GstImxPhysMemory *)mem)->cpu_addr;
+	GstImxPhysMemory *phys_mem = (GstImxPhysMemory *)mem;
+	return (phys_mem->cpu_addr != 0) ? (phys_mem->cpu_addr + mem->offset) : 0;
 }
 
 
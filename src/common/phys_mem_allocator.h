@@ -22,6 +22,7 @@
 
 #include <gst/gst.h>
 #include <gst/gstallocator.h>
+#include "phys_mem_stats.h"
 
 
 G_BEGIN_DECLS
@@ -38,10 +39,72 @@ typedef struct _GstImxPhysMemory GstImxPhysMemory;
 #define GST_IS_IMX_PHYS_MEM_ALLOCATOR(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_IMX_PHYS_MEM_ALLOCATOR))
 #define GST_IS_IMX_PHYS_MEM_ALLOCATOR_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_IMX_PHYS_MEM_ALLOCATOR))
 
+/* Caps feature for buffers whose memory blocks can be exported as DMABUF file descriptors;
+ * identical to GST_CAPS_FEATURE_MEMORY_DMABUF from newer gst-plugins-base versions */
+#define GST_IMX_CAPS_FEATURE_MEMORY_DMABUF "memory:DMABuf"
+/* Name of the qdata which is attached to exported memory blocks; contains the DMABUF
+ * file descriptor (use GPOINTER_TO_INT() to get it). This allows elements outside
+ * of this plugin set to access the file descriptor without having to use the
+ * functions below. The file descriptor is owned by the memory block. */
+#define GST_IMX_PHYS_MEMORY_DMABUF_FD_QDATA "GstImxPhysMemoryDmabufFd"
+
+/* Memory flags for selecting the cache mode of the CPU mapping; if neither is set
+ * in the GstAllocationParams flags, the block is mapped uncached. If the allocator
+ * does not support the requested mode, its native mode is used instead. */
+#define GST_IMX_PHYS_MEM_FLAG_WRITE_COMBINE  (GST_MEMORY_FLAG_LAST << 0)
+#define GST_IMX_PHYS_MEM_FLAG_CACHED         (GST_MEMORY_FLAG_LAST << 1)
+#define GST_IMX_PHYS_MEM_CACHE_FLAGS         (GST_IMX_PHYS_MEM_FLAG_WRITE_COMBINE | GST_IMX_PHYS_MEM_FLAG_CACHED)
+
+/* Memory flag for blocks which are normally only accessed by hardware (VPU, IPU, GPU).
+ * Subclasses should not map such blocks into the process during allocation; instead,
+ * a CPU mapping is created on the first map() call, and torn down again once the
+ * last mapping is released. This saves virtual address space, which is scarce on
+ * 32-bit systems with many large framebuffers. If the subclass maps the block
+ * during allocation anyway, the flag is cleared. */
+#define GST_IMX_PHYS_MEM_FLAG_DEVICE_ONLY    (GST_MEMORY_FLAG_LAST << 2)
+
+/* Memory flag for blocks which will be exported as DMABUF. If the subclass cannot
+ * export its blocks (export_dmabuf is NULL), the base class allocates such blocks
+ * from the CMA DMA heap instead (see dmabuf_heap.h); these are always cached, and
+ * are not recycled. */
+#define GST_IMX_PHYS_MEM_FLAG_DMABUF         (GST_MEMORY_FLAG_LAST << 3)
+
+
+typedef enum
+{
+	/* CPU reads and writes go straight to memory; slow, especially for reads */
+	GST_IMX_PHYS_MEM_CACHE_MODE_UNCACHED = 0,
+	/* writes are combined in a buffer, reads are uncached; fast for
+	 * sequential writes, slow for reads and random access */
+	GST_IMX_PHYS_MEM_CACHE_MODE_WRITE_COMBINE,
+	/* fully cached; fast CPU access, but requires cache maintenance
+	 * (flush before hardware reads, invalidate before CPU reads) */
+	GST_IMX_PHYS_MEM_CACHE_MODE_CACHED
+}
+GstImxPhysMemCacheMode;
+
+#define GST_IMX_PHYS_MEM_CACHE_MODE_BIT(MODE)  (1 << (MODE))
+
 
 struct _GstImxPhysMemAllocator
 {
 	GstAllocator parent;
+
+	/* protects the CPU mapping state of the memory blocks
+	 * and the recycler */
+	GMutex mutex;
+
+	/* Recycler for freed blocks; instead of returning freed blocks to the
+	 * kernel, they are kept in per-size-class lists and handed out again
+	 * by subsequent allocations. Disabled if recycler_max_bytes is 0. */
+	GHashTable *recycled_blocks;
+	gsize recycler_max_bytes, recycled_bytes;
+	guint num_recycled_blocks;
+	GstClockTime recycler_idle_timeout;
+	guint64 recycler_hits, recycler_misses;
+
+	/* accounting counters of this allocator's type (see phys_mem_stats.h) */
+	GstImxPhysMemStats *type_stats;
 };
 
 
@@ -51,8 +114,35 @@ struct _GstImxPhysMemAllocatorClass
 
 	gboolean (*alloc_phys_mem)(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, gssize size);
 	gboolean (*free_phys_mem)(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory);
+	/* CPU mappings are created lazily. map_phys_mem is called by the first
+	 * gst_memory_map() call, and again whenever the existing mapping does not
+	 * cover the requested access flags. When upgrading, mapped_virt_addr is
+	 * non-NULL, and the returned address should stay the same if possible, since
+	 * the old mapping may still be in use. If upgrading fails, the old mapping
+	 * must be removed, and mapped_virt_addr set to NULL.
+	 * unmap_phys_mem is only called for blocks which are mapped: for device-only
+	 * blocks once their last mapping is released, and for all other blocks right
+	 * before they are freed. Recycled blocks keep their mapping. A block can
+	 * therefore be mapped and unmapped several times during its lifetime. */
 	gpointer (*map_phys_mem)(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, gssize size, GstMapFlags flags);
 	void (*unmap_phys_mem)(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory);
+	/* export_dmabuf is optional; it returns a new DMABUF file descriptor for the
+	 * block, or -1 in case of an error. The caller takes ownership over the
+	 * descriptor. If it is NULL, the allocator does not support exporting. */
+	int (*export_dmabuf)(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory);
+
+	/* Cache modes the allocator can create mappings with (bitmask of
+	 * GST_IMX_PHYS_MEM_CACHE_MODE_BIT values), and the mode it uses if the requested
+	 * one is not supported. The requested mode can be retrieved in the vfuncs with
+	 * gst_imx_phys_memory_get_cache_mode(). */
+	guint supported_cache_modes;
+	GstImxPhysMemCacheMode native_cache_mode;
+	/* Cache maintenance for cached mappings; flush_phys_mem writes back dirty cache
+	 * lines of the given region to memory, invalidate_phys_mem discards cached
+	 * contents of the region. Both are optional; if they are NULL, cached mappings
+	 * are assumed to be coherent. */
+	void (*flush_phys_mem)(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, gsize offset, gsize size);
+	void (*invalidate_phys_mem)(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, gsize offset, gsize size);
 };
 
 
@@ -60,16 +150,84 @@ struct _GstImxPhysMemory
 {
 	GstMemory mem;
 
+	/* These addresses always refer to the beginning of the entire physical memory
+	 * block, even in sub-blocks created by gst_memory_share(); the data of the
+	 * GstMemory starts at the address plus mem.offset. Use
+	 * gst_imx_phys_memory_get_phys_addr() to get the address of the data. */
 	gpointer mapped_virt_addr;
 	guintptr phys_addr;
 	guintptr cpu_addr;
+
+	/* the CPU mapping is created on the first map call and kept alive
+	 * until the block is freed; mapping_flags contains the access flags
+	 * the mapping was created with, mapping_refcount the number of
+	 * currently active map calls */
+	GstMapFlags mapping_flags;
+	gint mapping_refcount;
+	/* TRUE if the block has been mapped for writing since the last cache flush */
+	gboolean cpu_dirty;
+
+	/* DMABUF file descriptor; -1 until the block is exported
+	 * for the first time, closed when the block is freed */
+	int dmabuf_fd;
+	/* DMABUF the block was allocated from if it is a DMA heap block, otherwise -1;
+	 * such blocks are handled by the base class instead of the subclass */
+	int dmabuf_heap_fd;
+
+	/* accounting counters of the owner the block was allocated for;
+	 * NULL in sub-blocks */
+	GstImxPhysMemStats *owner_stats;
 };
 
 
 GType gst_imx_phys_mem_allocator_get_type(void);
 
+/* Enables the recycler if max_bytes is nonzero, otherwise disables it and frees
+ * all recycled blocks. Recycled blocks which have not been reused for longer than
+ * idle_timeout are freed (GST_CLOCK_TIME_NONE = keep them until the budget is
+ * exceeded or the allocator is shut down). */
+void gst_imx_phys_mem_allocator_set_recycler_params(GstImxPhysMemAllocator *allocator, gsize max_bytes, GstClockTime idle_timeout);
+/* Frees recycled blocks which have been unused for at least max_idle_time
+ * (0 frees all of them) */
+void gst_imx_phys_mem_allocator_trim_recycler(GstImxPhysMemAllocator *allocator, GstClockTime max_idle_time);
+void gst_imx_phys_mem_allocator_get_recycler_stats(GstImxPhysMemAllocator *allocator, guint64 *hits, guint64 *misses, guint *num_blocks, gsize *num_bytes);
+/* Applies the default recycler parameters. The recycler is disabled by default; it is
+ * enabled by setting the GST_IMX_PHYS_MEM_RECYCLER_MAX_BYTES environment variable to a
+ * nonzero value. The idle timeout can be set with GST_IMX_PHYS_MEM_RECYCLER_IDLE_TIMEOUT
+ * (in milliseconds). */
+void gst_imx_phys_mem_allocator_enable_default_recycler(GstImxPhysMemAllocator *allocator);
+/* Logs the recycler statistics, using context as the logging object */
+void gst_imx_phys_mem_allocator_log_recycler_stats(GstImxPhysMemAllocator *allocator, GstObject *context);
+
+/* Returns TRUE if the allocator can export its blocks itself, or if blocks with
+ * the GST_IMX_PHYS_MEM_FLAG_DMABUF flag can be allocated from the DMA heap */
+gboolean gst_imx_phys_mem_allocator_supports_dmabuf_export(GstAllocator *allocator);
+gboolean gst_imx_phys_mem_allocator_supports_cache_mode(GstAllocator *allocator, GstImxPhysMemCacheMode cache_mode);
+
+GstImxPhysMemCacheMode gst_imx_phys_memory_get_cache_mode(GstMemory *mem);
+/* Cache maintenance entry points. Flushing is done automatically when a cached
+ * block that was mapped for writing is unmapped, and invalidation when a cached
+ * block is mapped for reading. Elements must flush explicitly before submitting
+ * a block to hardware if it may still be mapped elsewhere. For non-cached
+ * blocks, these functions do nothing. */
+void gst_imx_phys_memory_flush(GstMemory *mem);
+void gst_imx_phys_memory_invalidate(GstMemory *mem);
+/* Flushes all physical memory blocks of the buffer; to be called right before
+ * the buffer is submitted to hardware */
+void gst_imx_phys_mem_buffer_flush(GstBuffer *buffer);
+
+/* These return the addresses of the first byte of the memory's data, that is,
+ * they take the memory's offset into account */
 guintptr gst_imx_phys_memory_get_phys_addr(GstMemory *mem);
 guintptr gst_imx_phys_memory_get_cpu_addr(GstMemory *mem);
+
+/* Exports the block as DMABUF, if this has not been done already, and returns the
+ * file descriptor, or -1 if exporting is not possible. The descriptor stays owned
+ * by the memory block and is closed when the block is freed; callers must not
+ * close it, and must dup() it if they need it for longer than the block exists.
+ * Sub-blocks return the descriptor of their parent block. */
+int gst_imx_phys_memory_get_dmabuf_fd(GstMemory *mem);
+
 gboolean gst_imx_is_phys_memory(GstMemory *mem);
 
 
@@ -27,9 +27,24 @@ GST_DEBUG_CATEGORY (imx_phys_mem_bufferpool_debug);
 #define GST_CAT_DEFAULT imx_phys_mem_bufferpool_debug
 
 
+/* Buffers acquired by the idle check are not counted as buffers in use */
+#define ACQUIRE_FLAG_IDLE_CHECK (GST_BUFFER_POOL_ACQUIRE_FLAG_LAST << 0)
+
+
 static const gchar ** gst_imx_phys_mem_buffer_pool_get_options(GstBufferPool *pool);
 static gboolean gst_imx_phys_mem_buffer_pool_set_config(GstBufferPool *pool, GstStructure *config);
 static GstFlowReturn gst_imx_phys_mem_buffer_pool_alloc_buffer(GstBufferPool *pool, GstBuffer **buffer, GstBufferPoolAcquireParams *params);
+static GstFlowReturn gst_imx_phys_mem_buffer_pool_fill_buffer(GstImxPhysMemBufferPool *imx_phys_mem_pool, GstBuffer *buffer);
+static gboolean gst_imx_phys_mem_buffer_pool_start(GstBufferPool *pool);
+static gboolean gst_imx_phys_mem_buffer_pool_stop(GstBufferPool *pool);
+static GstFlowReturn gst_imx_phys_mem_buffer_pool_acquire_buffer(GstBufferPool *pool, GstBuffer **buffer, GstBufferPoolAcquireParams *params);
+static void gst_imx_phys_mem_buffer_pool_release_buffer(GstBufferPool *pool, GstBuffer *buffer);
+static void gst_imx_phys_mem_buffer_pool_free_buffer(GstBufferPool *pool, GstBuffer *buffer);
+static gpointer gst_imx_phys_mem_buffer_pool_prewarm_thread(gpointer data);
+static void gst_imx_phys_mem_buffer_pool_start_idle_check(GstImxPhysMemBufferPool *imx_phys_mem_pool);
+static gboolean gst_imx_phys_mem_buffer_pool_idle_check(GstClock *clock, GstClockTime time, GstClockID id, gpointer user_data);
+static void gst_imx_phys_mem_buffer_pool_free_weak_ref(gpointer data);
+static void gst_imx_phys_mem_buffer_pool_remove_memory(GstImxPhysMemBufferPool *imx_phys_mem_pool, GstBuffer *buffer);
 static void gst_imx_phys_mem_buffer_pool_finalize(GObject *object);
 
 
@@ -44,6 +59,10 @@ static const gchar ** gst_imx_phys_mem_buffer_pool_get_options(G_GNUC_UNUSED Gst
 	{
 		GST_BUFFER_POOL_OPTION_VIDEO_META,
 		GST_BUFFER_POOL_OPTION_IMX_PHYS_MEM,
+		GST_BUFFER_POOL_OPTION_IMX_DMABUF,
+		GST_BUFFER_POOL_OPTION_VIDEO_ALIGNMENT,
+		GST_BUFFER_POOL_OPTION_IMX_PREWARM,
+		GST_BUFFER_POOL_OPTION_IMX_IDLE_SHRINK,
 		NULL
 	};
 
@@ -57,7 +76,7 @@ static gboolean gst_imx_phys_mem_buffer_pool_set_config(GstBufferPool *pool, Gst
 	GstVideoInfo info;
 	GstVideoAlignment align;
 	GstCaps *caps;
-	gsize size;
+	guint size, min_buffers, max_buffers;
 	GstAllocator *allocator;
 
 	{
@@ -80,7 +99,7 @@ static gboolean gst_imx_phys_mem_buffer_pool_set_config(GstBufferPool *pool, Gst
 
 	imx_phys_mem_pool = GST_IMX_PHYS_MEM_BUFFER_POOL(pool);
 
-	if (!gst_buffer_pool_config_get_params(config, &caps, &size, NULL, NULL))
+	if (!gst_buffer_pool_config_get_params(config, &caps, &size, &min_buffers, &max_buffers))
 	{
 		GST_ERROR_OBJECT(pool, "pool configuration invalid");
 		return FALSE;
@@ -99,17 +118,94 @@ static gboolean gst_imx_phys_mem_buffer_pool_set_config(GstBufferPool *pool, Gst
 	}
 
 	imx_phys_mem_pool->video_info = info;
-	GST_VIDEO_INFO_SIZE(&(imx_phys_mem_pool->video_info)) = size;
 
-	gst_video_alignment_reset(&align);
-	align.padding_right = (8 - (GST_VIDEO_INFO_WIDTH(&(imx_phys_mem_pool->video_info)) & 7)) & 7;
-	align.padding_bottom = (8 - (GST_VIDEO_INFO_HEIGHT(&(imx_phys_mem_pool->video_info)) & 7)) & 7;
+	if (gst_buffer_pool_config_has_option(config, GST_BUFFER_POOL_OPTION_VIDEO_ALIGNMENT))
+	{
+		gst_buffer_pool_config_get_video_alignment(config, &align);
+		GST_DEBUG_OBJECT(
+			pool,
+			"using alignment from configuration: padding left/top/right/bottom: %u/%u/%u/%u  stride align: %u/%u/%u/%u",
+			align.padding_left, align.padding_top, align.padding_right, align.padding_bottom,
+			align.stride_align[0], align.stride_align[1], align.stride_align[2], align.stride_align[3]
+		);
+	}
+	else
+	{
+		/* Default alignment: pad width and height to the next multiple of 8 pixels */
+		gst_imx_phys_mem_buffer_pool_video_alignment_init(&align, &info, 8, 8, 0);
+	}
+
 	gst_video_info_align(&(imx_phys_mem_pool->video_info), &align);
+	imx_phys_mem_pool->video_align = align;
+
+	/* The aligned frames may be larger than the configured size */
+	if (GST_VIDEO_INFO_SIZE(&(imx_phys_mem_pool->video_info)) > size)
+	{
+		GST_DEBUG_OBJECT(pool, "aligned frame size %u is larger than configured size %u - updating configuration", GST_VIDEO_INFO_SIZE(&(imx_phys_mem_pool->video_info)), size);
+		gst_buffer_pool_config_set_params(config, caps, GST_VIDEO_INFO_SIZE(&(imx_phys_mem_pool->video_info)), min_buffers, max_buffers);
+	}
+	else
+		GST_VIDEO_INFO_SIZE(&(imx_phys_mem_pool->video_info)) = size;
+	size = GST_VIDEO_INFO_SIZE(&(imx_phys_mem_pool->video_info));
 
 	imx_phys_mem_pool->add_video_meta = gst_buffer_pool_config_has_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
 
 	imx_phys_mem_pool->allocator = allocator;
 
+	imx_phys_mem_pool->export_dmabuf = gst_buffer_pool_config_has_option(config, GST_BUFFER_POOL_OPTION_IMX_DMABUF);
+	{
+		guint i;
+		for (i = 0; i < gst_caps_get_size(caps); ++i)
+		{
+			GstCapsFeatures *features = gst_caps_get_features(caps, i);
+			if ((features != NULL) && gst_caps_features_contains(features, GST_IMX_CAPS_FEATURE_MEMORY_DMABUF))
+				imx_phys_mem_pool->export_dmabuf = TRUE;
+		}
+	}
+
+	if (imx_phys_mem_pool->export_dmabuf && !gst_imx_phys_mem_allocator_supports_dmabuf_export(allocator))
+	{
+		GST_ERROR_OBJECT(pool, "DMABUF export requested, but allocator %" GST_PTR_FORMAT " does not support it", (gpointer)allocator);
+		return FALSE;
+	}
+
+	imx_phys_mem_pool->prewarm = gst_buffer_pool_config_has_option(config, GST_BUFFER_POOL_OPTION_IMX_PREWARM);
+	if (imx_phys_mem_pool->prewarm)
+	{
+		guint num_buffers = 0;
+		gboolean async = FALSE;
+
+		gst_structure_get(config, "imx-prewarm-buffers", G_TYPE_UINT, &num_buffers, "imx-prewarm-async", G_TYPE_BOOLEAN, &async, NULL);
+
+		imx_phys_mem_pool->prewarm_count = MAX(num_buffers, min_buffers);
+		if (max_buffers != 0)
+			imx_phys_mem_pool->prewarm_count = MIN(imx_phys_mem_pool->prewarm_count, max_buffers);
+		imx_phys_mem_pool->prewarm_async = async;
+
+		GST_DEBUG_OBJECT(pool, "pre-warming enabled: %u buffer(s), %s", imx_phys_mem_pool->prewarm_count, async ? "asynchronous" : "synchronous");
+	}
+
+	imx_phys_mem_pool->idle_shrink = gst_buffer_pool_config_has_option(config, GST_BUFFER_POOL_OPTION_IMX_IDLE_SHRINK);
+	if (imx_phys_mem_pool->idle_shrink)
+	{
+		guint low_water_mark = 0;
+		guint64 idle_timeout = GST_CLOCK_TIME_NONE;
+
+		gst_structure_get(config, "imx-low-water-mark", G_TYPE_UINT, &low_water_mark, "imx-idle-timeout", G_TYPE_UINT64, &idle_timeout, NULL);
+
+		imx_phys_mem_pool->low_water_mark = MAX(low_water_mark, min_buffers);
+		imx_phys_mem_pool->idle_timeout = idle_timeout;
+		if (!GST_CLOCK_TIME_IS_VALID(idle_timeout))
+			imx_phys_mem_pool->idle_shrink = FALSE;
+
+		GST_DEBUG_OBJECT(pool, "idle shrinking enabled: low-water mark: %u buffer(s)  idle timeout: %" GST_TIME_FORMAT, imx_phys_mem_pool->low_water_mark, GST_TIME_ARGS(idle_timeout));
+	}
+
+	/* The base class allocates the minimum number of buffers when the pool is
+	 * started; synchronous pre-warming just raises that number */
+	if (imx_phys_mem_pool->prewarm && !(imx_phys_mem_pool->prewarm_async) && (imx_phys_mem_pool->prewarm_count > min_buffers))
+		gst_buffer_pool_config_set_params(config, caps, size, imx_phys_mem_pool->prewarm_count, max_buffers);
+
 	return GST_BUFFER_POOL_CLASS(gst_imx_phys_mem_buffer_pool_parent_class)->set_config(pool, config);
 }
 
@@ -118,16 +214,11 @@ static GstFlowReturn gst_imx_phys_mem_buffer_pool_alloc_buffer(GstBufferPool *po
 {
 	GstImxPhysMemBufferPool *imx_phys_mem_pool;
 	GstBuffer *buf;
-	GstMemory *mem;
 	GstVideoInfo *info;
-	GstAllocationParams alloc_params;
+	GstFlowReturn flow_ret;
 
 	imx_phys_mem_pool = GST_IMX_PHYS_MEM_BUFFER_POOL(pool);
 
-	memset(&alloc_params, 0, sizeof(GstAllocationParams));
-	alloc_params.flags = imx_phys_mem_pool->read_only ? GST_MEMORY_FLAG_READONLY : 0;
-	alloc_params.align = 0;
-
 	info = &imx_phys_mem_pool->video_info;
 
 	buf = gst_buffer_new();
@@ -137,15 +228,15 @@ static GstFlowReturn gst_imx_phys_mem_buffer_pool_alloc_buffer(GstBufferPool *po
 		return GST_FLOW_ERROR;
 	}
 
-	mem = gst_allocator_alloc(imx_phys_mem_pool->allocator, info->size, &alloc_params);
-	if (mem == NULL)
+	if ((flow_ret = gst_imx_phys_mem_buffer_pool_fill_buffer(imx_phys_mem_pool, buf)) != GST_FLOW_OK)
 	{
 		gst_buffer_unref(buf);
-		GST_ERROR_OBJECT(pool, "could not allocate %u byte for new buffer", info->size);
-		return GST_FLOW_ERROR;
+		return flow_ret;
 	}
 
-	gst_buffer_append_memory(buf, mem);
+	g_mutex_lock(&(imx_phys_mem_pool->shrink_mutex));
+	imx_phys_mem_pool->num_allocated++;
+	g_mutex_unlock(&(imx_phys_mem_pool->shrink_mutex));
 
 	if (imx_phys_mem_pool->add_video_meta)
 	{
@@ -167,35 +258,370 @@ static GstFlowReturn gst_imx_phys_mem_buffer_pool_alloc_buffer(GstBufferPool *po
 		video_crop_meta->height = GST_VIDEO_INFO_HEIGHT(info);
 	}
 
+	*buffer = buf;
+
+	return GST_FLOW_OK;
+}
+
+
+/* Allocates the memory block of the buffer and adds the physical memory metadata.
+ * Used for new buffers and for buffers whose memory was released by idle shrinking. */
+static GstFlowReturn gst_imx_phys_mem_buffer_pool_fill_buffer(GstImxPhysMemBufferPool *imx_phys_mem_pool, GstBuffer *buffer)
+{
+	GstMemory *mem;
+	GstVideoInfo *info;
+	GstAllocationParams alloc_params;
+	GstElement *owner, *previous_owner;
+
+	memset(&alloc_params, 0, sizeof(GstAllocationParams));
+	alloc_params.flags = imx_phys_mem_pool->read_only ? GST_MEMORY_FLAG_READONLY : 0;
+	alloc_params.align = 0;
+	if (imx_phys_mem_pool->export_dmabuf)
+		alloc_params.flags |= GST_IMX_PHYS_MEM_FLAG_DMABUF;
+
+	info = &imx_phys_mem_pool->video_info;
+
+	/* Pools without an owner keep the owner of the calling thread */
+	owner = g_weak_ref_get(&(imx_phys_mem_pool->owner));
+	if (owner != NULL)
+	{
+		previous_owner = gst_imx_phys_mem_stats_set_thread_owner(owner);
+		mem = gst_allocator_alloc(imx_phys_mem_pool->allocator, info->size, &alloc_params);
+		gst_imx_phys_mem_stats_set_thread_owner(previous_owner);
+		gst_object_unref(GST_OBJECT(owner));
+	}
+	else
+		mem = gst_allocator_alloc(imx_phys_mem_pool->allocator, info->size, &alloc_params);
+
+	if (mem == NULL)
+	{
+		GST_ERROR_OBJECT(imx_phys_mem_pool, "could not allocate %u byte for new buffer", info->size);
+		return GST_FLOW_ERROR;
+	}
+
+	if (imx_phys_mem_pool->export_dmabuf && (gst_imx_phys_memory_get_dmabuf_fd(mem) < 0))
+	{
+		gst_memory_unref(mem);
+		GST_ERROR_OBJECT(imx_phys_mem_pool, "could not export memory block of new buffer as DMABUF");
+		return GST_FLOW_ERROR;
+	}
+
+	gst_buffer_append_memory(buffer, mem);
+
 	{
 		GstImxPhysMemory *imx_phys_mem_mem = (GstImxPhysMemory *)mem;
-		GstImxPhysMemMeta *phys_mem_meta = (GstImxPhysMemMeta *)GST_IMX_PHYS_MEM_META_ADD(buf);
+		GstImxPhysMemMeta *phys_mem_meta = (GstImxPhysMemMeta *)GST_IMX_PHYS_MEM_META_ADD(buffer);
+		GstImxPhysMemPlanesMeta *planes_meta;
 
-		phys_mem_meta->phys_addr = imx_phys_mem_mem->phys_addr;
+		phys_mem_meta->phys_addr = gst_imx_phys_memory_get_phys_addr((GstMemory *)imx_phys_mem_mem);
 
-		phys_mem_meta->x_padding = (8 - (GST_VIDEO_INFO_WIDTH(&(imx_phys_mem_pool->video_info)) & 7)) & 7;
-		phys_mem_meta->y_padding = (8 - (GST_VIDEO_INFO_HEIGHT(&(imx_phys_mem_pool->video_info)) & 7)) & 7;
+		phys_mem_meta->x_padding = imx_phys_mem_pool->video_align.padding_right;
+		phys_mem_meta->y_padding = imx_phys_mem_pool->video_align.padding_bottom;
 
 		phys_mem_meta->padding = imx_phys_mem_pool->video_info.stride[0] * phys_mem_meta->y_padding;
+
+		/* video_info already contains the alignment, so its plane offsets
+		 * point to the first pixel of each plane */
+		planes_meta = GST_IMX_PHYS_MEM_PLANES_META_ADD(buffer);
+		gst_imx_phys_mem_planes_meta_set_from_video_info(
+			planes_meta,
+			phys_mem_meta->phys_addr,
+			info,
+			GST_VIDEO_INFO_HEIGHT(info) + imx_phys_mem_pool->video_align.padding_bottom
+		);
+
+		/* The base class marks the metas of new buffers as pooled; for refilled
+		 * buffers, this must be done here, otherwise the metas are removed when
+		 * the buffer is reset */
+		GST_META_FLAG_SET((GstMeta *)phys_mem_meta, GST_META_FLAG_POOLED);
+		GST_META_FLAG_SET((GstMeta *)planes_meta, GST_META_FLAG_POOLED);
 	}
 
-	*buffer = buf;
+	g_mutex_lock(&(imx_phys_mem_pool->shrink_mutex));
+	imx_phys_mem_pool->num_populated++;
+	g_mutex_unlock(&(imx_phys_mem_pool->shrink_mutex));
+
+	return GST_FLOW_OK;
+}
+
+
+static gboolean gst_imx_phys_mem_buffer_pool_start(GstBufferPool *pool)
+{
+	GstImxPhysMemBufferPool *imx_phys_mem_pool = GST_IMX_PHYS_MEM_BUFFER_POOL(pool);
+
+	imx_phys_mem_pool->last_busy_time = g_get_monotonic_time();
+
+	if (imx_phys_mem_pool->idle_shrink)
+		gst_imx_phys_mem_buffer_pool_start_idle_check(imx_phys_mem_pool);
+
+	/* Without asynchronous pre-warming, let the base class allocate the
+	 * minimum number of buffers (see set_config) */
+	if (!(imx_phys_mem_pool->prewarm) || !(imx_phys_mem_pool->prewarm_async))
+		return GST_BUFFER_POOL_CLASS(gst_imx_phys_mem_buffer_pool_parent_class)->start(pool);
+
+	/* Asynchronous pre-warming; the thread holds a reference to the pool, and
+	 * only one such thread runs at a time */
+	if (g_atomic_int_compare_and_exchange(&(imx_phys_mem_pool->prewarm_thread_running), 0, 1))
+	{
+		GThread *thread = g_thread_new("imxpoolprewarm", gst_imx_phys_mem_buffer_pool_prewarm_thread, gst_object_ref(pool));
+		g_thread_unref(thread);
+	}
+
+	return TRUE;
+}
+
+
+static gboolean gst_imx_phys_mem_buffer_pool_stop(GstBufferPool *pool)
+{
+	GstImxPhysMemBufferPool *imx_phys_mem_pool = GST_IMX_PHYS_MEM_BUFFER_POOL(pool);
+
+	if (imx_phys_mem_pool->idle_check_id != NULL)
+	{
+		gst_clock_id_unschedule(imx_phys_mem_pool->idle_check_id);
+		gst_clock_id_unref(imx_phys_mem_pool->idle_check_id);
+		imx_phys_mem_pool->idle_check_id = NULL;
+	}
+
+	return GST_BUFFER_POOL_CLASS(gst_imx_phys_mem_buffer_pool_parent_class)->stop(pool);
+}
+
+
+static GstFlowReturn gst_imx_phys_mem_buffer_pool_acquire_buffer(GstBufferPool *pool, GstBuffer **buffer, GstBufferPoolAcquireParams *params)
+{
+	GstImxPhysMemBufferPool *imx_phys_mem_pool = GST_IMX_PHYS_MEM_BUFFER_POOL(pool);
+	GstFlowReturn flow_ret;
+
+	flow_ret = GST_BUFFER_POOL_CLASS(gst_imx_phys_mem_buffer_pool_parent_class)->acquire_buffer(pool, buffer, params);
+	if (flow_ret != GST_FLOW_OK)
+		return flow_ret;
+
+	if ((params != NULL) && (params->flags & ACQUIRE_FLAG_IDLE_CHECK))
+		return GST_FLOW_OK;
+
+	g_mutex_lock(&(imx_phys_mem_pool->shrink_mutex));
+	imx_phys_mem_pool->num_outstanding++;
+	if (imx_phys_mem_pool->num_outstanding > imx_phys_mem_pool->low_water_mark)
+		imx_phys_mem_pool->last_busy_time = g_get_monotonic_time();
+	g_mutex_unlock(&(imx_phys_mem_pool->shrink_mutex));
+
+	/* Before GStreamer 1.6, the pool keeps buffers whose memory was freed by
+	 * idle shrinking (later versions free them, since removing the memory
+	 * tags them); get new memory for them */
+	if (gst_buffer_n_memory(*buffer) == 0)
+	{
+		GST_LOG_OBJECT(pool, "buffer %p has no memory - allocating new memory block", (gpointer)(*buffer));
+
+		if ((flow_ret = gst_imx_phys_mem_buffer_pool_fill_buffer(imx_phys_mem_pool, *buffer)) != GST_FLOW_OK)
+		{
+			g_mutex_lock(&(imx_phys_mem_pool->shrink_mutex));
+			imx_phys_mem_pool->num_outstanding--;
+			g_mutex_unlock(&(imx_phys_mem_pool->shrink_mutex));
+
+			GST_BUFFER_POOL_CLASS(gst_imx_phys_mem_buffer_pool_parent_class)->release_buffer(pool, *buffer);
+			*buffer = NULL;
+			return flow_ret;
+		}
+	}
 
 	return GST_FLOW_OK;
 }
 
 
+static void gst_imx_phys_mem_buffer_pool_release_buffer(GstBufferPool *pool, GstBuffer *buffer)
+{
+	GstImxPhysMemBufferPool *imx_phys_mem_pool = GST_IMX_PHYS_MEM_BUFFER_POOL(pool);
+
+	/* Buffers without memory come from the idle check, and were not counted */
+	if (gst_buffer_n_memory(buffer) > 0)
+	{
+		g_mutex_lock(&(imx_phys_mem_pool->shrink_mutex));
+		if (imx_phys_mem_pool->num_outstanding > 0)
+			imx_phys_mem_pool->num_outstanding--;
+		g_mutex_unlock(&(imx_phys_mem_pool->shrink_mutex));
+	}
+
+	GST_BUFFER_POOL_CLASS(gst_imx_phys_mem_buffer_pool_parent_class)->release_buffer(pool, buffer);
+}
+
+
+static void gst_imx_phys_mem_buffer_pool_free_buffer(GstBufferPool *pool, GstBuffer *buffer)
+{
+	GstImxPhysMemBufferPool *imx_phys_mem_pool = GST_IMX_PHYS_MEM_BUFFER_POOL(pool);
+
+	g_mutex_lock(&(imx_phys_mem_pool->shrink_mutex));
+	if (gst_buffer_n_memory(buffer) > 0)
+		imx_phys_mem_pool->num_populated--;
+	imx_phys_mem_pool->num_allocated--;
+	g_mutex_unlock(&(imx_phys_mem_pool->shrink_mutex));
+
+	GST_BUFFER_POOL_CLASS(gst_imx_phys_mem_buffer_pool_parent_class)->free_buffer(pool, buffer);
+}
+
+
+static gpointer gst_imx_phys_mem_buffer_pool_prewarm_thread(gpointer data)
+{
+	GstBufferPool *pool = GST_BUFFER_POOL(data);
+	GstImxPhysMemBufferPool *imx_phys_mem_pool = GST_IMX_PHYS_MEM_BUFFER_POOL(pool);
+	GstBufferPoolAcquireParams params;
+	GstBuffer **buffers;
+	guint i, num_buffers = 0, num_attempts;
+
+	memset(&params, 0, sizeof(params));
+	params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+
+	buffers = g_new0(GstBuffer*, imx_phys_mem_pool->prewarm_count);
+
+	/* start() is called before the pool is activated, so acquiring fails with
+	 * GST_FLOW_FLUSHING at first; retry for up to one second */
+	for (num_attempts = 0; (num_attempts < 1000) && (num_buffers < imx_phys_mem_pool->prewarm_count); ++num_attempts)
+	{
+		GstFlowReturn flow_ret = gst_buffer_pool_acquire_buffer(pool, &(buffers[num_buffers]), &params);
+
+		if (flow_ret == GST_FLOW_OK)
+			num_buffers++;
+		else if ((flow_ret == GST_FLOW_FLUSHING) && !gst_buffer_pool_is_active(pool))
+			g_usleep(1000);
+		else
+			break;
+	}
+
+	GST_DEBUG_OBJECT(pool, "pre-warmed %u buffer(s) asynchronously", num_buffers);
+
+	for (i = 0; i < num_buffers; ++i)
+		gst_buffer_pool_release_buffer(pool, buffers[i]);
+	g_free(buffers);
+
+	g_atomic_int_set(&(imx_phys_mem_pool->prewarm_thread_running), 0);
+	gst_object_unref(pool);
+
+	return NULL;
+}
+
+
+static void gst_imx_phys_mem_buffer_pool_start_idle_check(GstImxPhysMemBufferPool *imx_phys_mem_pool)
+{
+	GstClock *clock;
+	GstClockTime interval;
+	GWeakRef *pool_ref;
+
+	if (imx_phys_mem_pool->idle_check_id != NULL)
+		return;
+
+	/* Checking twice per timeout frees idle buffers at most 1.5 timeouts after
+	 * the pool became idle; the callback only holds a weak reference, so the
+	 * check does not keep the pool alive */
+	interval = MAX(imx_phys_mem_pool->idle_timeout / 2, GST_MSECOND);
+	pool_ref = g_new(GWeakRef, 1);
+	g_weak_ref_init(pool_ref, imx_phys_mem_pool);
+
+	clock = gst_system_clock_obtain();
+	imx_phys_mem_pool->idle_check_id = gst_clock_new_periodic_id(clock, gst_clock_get_time(clock) + interval, interval);
+	gst_clock_id_wait_async(imx_phys_mem_pool->idle_check_id, gst_imx_phys_mem_buffer_pool_idle_check, pool_ref, gst_imx_phys_mem_buffer_pool_free_weak_ref);
+	gst_object_unref(GST_OBJECT(clock));
+}
+
+
+static gboolean gst_imx_phys_mem_buffer_pool_idle_check(G_GNUC_UNUSED GstClock *clock, G_GNUC_UNUSED GstClockTime time, G_GNUC_UNUSED GstClockID id, gpointer user_data)
+{
+	GstImxPhysMemBufferPool *imx_phys_mem_pool;
+	GstBufferPool *pool;
+	GstBufferPoolAcquireParams params;
+	GSList *buffers = NULL, *node;
+	guint num_excess = 0, num_free = 0, num_shrunk = 0;
+	gint64 idle_time;
+
+	pool = g_weak_ref_get((GWeakRef *)user_data);
+	if (pool == NULL)
+		return TRUE;
+
+	imx_phys_mem_pool = GST_IMX_PHYS_MEM_BUFFER_POOL(pool);
+
+	g_mutex_lock(&(imx_phys_mem_pool->shrink_mutex));
+	idle_time = g_get_monotonic_time() - imx_phys_mem_pool->last_busy_time;
+	if ((imx_phys_mem_pool->num_outstanding <= imx_phys_mem_pool->low_water_mark) && (imx_phys_mem_pool->num_populated > imx_phys_mem_pool->low_water_mark) && ((GstClockTime)idle_time * GST_USECOND >= imx_phys_mem_pool->idle_timeout))
+	{
+		num_excess = imx_phys_mem_pool->num_populated - imx_phys_mem_pool->low_water_mark;
+		num_free = imx_phys_mem_pool->num_allocated - imx_phys_mem_pool->num_outstanding;
+	}
+	g_mutex_unlock(&(imx_phys_mem_pool->shrink_mutex));
+
+	memset(&params, 0, sizeof(params));
+	params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT | ACQUIRE_FLAG_IDLE_CHECK;
+
+	/* Take the excess buffers out of the pool and remove their memory. Acquiring
+	 * at most num_free buffers prevents the pool from allocating new ones. */
+	while ((num_shrunk < num_excess) && (num_free > 0))
+	{
+		GstBuffer *buffer;
+
+		if (gst_buffer_pool_acquire_buffer(pool, &buffer, &params) != GST_FLOW_OK)
+			break;
+
+		num_free--;
+		if (gst_buffer_n_memory(buffer) > 0)
+		{
+			gst_imx_phys_mem_buffer_pool_remove_memory(imx_phys_mem_pool, buffer);
+			num_shrunk++;
+		}
+
+		buffers = g_slist_prepend(buffers, buffer);
+	}
+
+	if (num_shrunk > 0)
+		GST_DEBUG_OBJECT(pool, "pool idle - freed memory of %u buffer(s)", num_shrunk);
+
+	/* Since GStreamer 1.6, the pool frees released buffers whose memory was removed
+	 * (removing the memory tags the buffer); older versions keep them */
+	for (node = buffers; node != NULL; node = node->next)
+		gst_buffer_pool_release_buffer(pool, (GstBuffer *)(node->data));
+	g_slist_free(buffers);
+
+	gst_object_unref(GST_OBJECT(pool));
+
+	return TRUE;
+}
+
+
+static void gst_imx_phys_mem_buffer_pool_free_weak_ref(gpointer data)
+{
+	g_weak_ref_clear((GWeakRef *)data);
+	g_free(data);
+}
+
+
+static void gst_imx_phys_mem_buffer_pool_remove_memory(GstImxPhysMemBufferPool *imx_phys_mem_pool, GstBuffer *buffer)
+{
+	gst_buffer_remove_all_memory(buffer);
+	GST_IMX_PHYS_MEM_META_DEL(buffer);
+	GST_IMX_PHYS_MEM_PLANES_META_DEL(buffer);
+
+	g_mutex_lock(&(imx_phys_mem_pool->shrink_mutex));
+	imx_phys_mem_pool->num_populated--;
+	g_mutex_unlock(&(imx_phys_mem_pool->shrink_mutex));
+}
+
+
 static void gst_imx_phys_mem_buffer_pool_finalize(GObject *object)
 {
 	GstImxPhysMemBufferPool *imx_phys_mem_pool = GST_IMX_PHYS_MEM_BUFFER_POOL(object);
 
 	GST_INFO_OBJECT(object, "shutting down physical memory buffer pool");
+
+	if (imx_phys_mem_pool->idle_check_id != NULL)
+	{
+		gst_clock_id_unschedule(imx_phys_mem_pool->idle_check_id);
+		gst_clock_id_unref(imx_phys_mem_pool->idle_check_id);
+	}
+
 	G_OBJECT_CLASS (gst_imx_phys_mem_buffer_pool_parent_class)->finalize(object);
 
 	/* unref'ing AFTER calling the parent class' finalize function, since the parent
 	 * class will shut down the allocated memory blocks, for which the allocator must
 	 * exist */
 	gst_object_unref(imx_phys_mem_pool->allocator);
+
+	g_mutex_clear(&(imx_phys_mem_pool->shrink_mutex));
+	g_weak_ref_clear(&(imx_phys_mem_pool->owner));
 }
 
 
@@ -210,12 +636,32 @@ static void gst_imx_phys_mem_buffer_pool_class_init(GstImxPhysMemBufferPoolClass
 	parent_class->get_options  = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_buffer_pool_get_options);
 	parent_class->set_config   = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_buffer_pool_set_config);
 	parent_class->alloc_buffer = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_buffer_pool_alloc_buffer);
+	parent_class->start          = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_buffer_pool_start);
+	parent_class->stop           = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_buffer_pool_stop);
+	parent_class->acquire_buffer = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_buffer_pool_acquire_buffer);
+	parent_class->release_buffer = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_buffer_pool_release_buffer);
+	parent_class->free_buffer    = GST_DEBUG_FUNCPTR(gst_imx_phys_mem_buffer_pool_free_buffer);
 }
 
 
 static void gst_imx_phys_mem_buffer_pool_init(GstImxPhysMemBufferPool *pool)
 {
 	pool->add_video_meta = FALSE;
+	pool->export_dmabuf = FALSE;
+	pool->prewarm = FALSE;
+	pool->prewarm_async = FALSE;
+	pool->prewarm_count = 0;
+	pool->prewarm_thread_running = 0;
+	pool->idle_shrink = FALSE;
+	pool->low_water_mark = 0;
+	pool->idle_timeout = GST_CLOCK_TIME_NONE;
+	pool->num_outstanding = 0;
+	pool->num_populated = 0;
+	pool->num_allocated = 0;
+	pool->last_busy_time = 0;
+	pool->idle_check_id = NULL;
+	g_mutex_init(&(pool->shrink_mutex));
+	g_weak_ref_init(&(pool->owner), NULL);
 	GST_INFO_OBJECT(pool, "initializing physical memory buffer pool");
 }
 
@@ -231,6 +677,140 @@ GstBufferPool *gst_imx_phys_mem_buffer_pool_new(gboolean read_only)
 }
 
 
+void gst_imx_phys_mem_buffer_pool_set_owner(GstBufferPool *pool, GstElement *owner)
+{
+	g_weak_ref_set(&(GST_IMX_PHYS_MEM_BUFFER_POOL(pool)->owner), owner);
+}
+
+
+GstCaps *gst_imx_phys_mem_buffer_pool_add_dmabuf_caps_feature(GstCaps *caps, GstAllocator *allocator)
+{
+	guint i;
+
+	if (!gst_imx_phys_mem_allocator_supports_dmabuf_export(allocator))
+		return gst_caps_ref(caps);
+
+	caps = gst_caps_copy(caps);
+	for (i = 0; i < gst_caps_get_size(caps); ++i)
+	{
+		GstCapsFeatures *features = gst_caps_get_features(caps, i);
+		if ((features == NULL) || gst_caps_features_is_any(features))
+			gst_caps_set_features(caps, i, gst_caps_features_new(GST_IMX_CAPS_FEATURE_MEMORY_DMABUF, NULL));
+		else if (!gst_caps_features_contains(features, GST_IMX_CAPS_FEATURE_MEMORY_DMABUF))
+			gst_caps_features_add(features, GST_IMX_CAPS_FEATURE_MEMORY_DMABUF);
+	}
+
+	return caps;
+}
+
+
+void gst_imx_phys_mem_buffer_pool_video_alignment_init(GstVideoAlignment *align, GstVideoInfo const *info, guint width_multiple, guint height_multiple, guint stride_align_mask)
+{
+	guint i;
+	guint width = GST_VIDEO_INFO_WIDTH(info);
+	guint height = GST_VIDEO_INFO_HEIGHT(info);
+
+	gst_video_alignment_reset(align);
+
+	if (width_multiple > 1)
+		align->padding_right = (width_multiple - (width % width_multiple)) % width_multiple;
+	if (height_multiple > 1)
+		align->padding_bottom = (height_multiple - (height % height_multiple)) % height_multiple;
+
+	for (i = 0; i < GST_VIDEO_MAX_PLANES; ++i)
+		align->stride_align[i] = stride_align_mask;
+}
+
+
+void gst_imx_phys_mem_buffer_pool_merge_video_alignment(GstVideoAlignment *dest, GstVideoAlignment const *src)
+{
+	guint i;
+
+	dest->padding_left = MAX(dest->padding_left, src->padding_left);
+	dest->padding_top = MAX(dest->padding_top, src->padding_top);
+	dest->padding_right = MAX(dest->padding_right, src->padding_right);
+	dest->padding_bottom = MAX(dest->padding_bottom, src->padding_bottom);
+
+	/* stride alignments are 2^n-1 masks, so OR'ing them yields the larger one */
+	for (i = 0; i < GST_VIDEO_MAX_PLANES; ++i)
+		dest->stride_align[i] |= src->stride_align[i];
+}
+
+
+void gst_imx_phys_mem_buffer_pool_query_add_video_alignment(GstQuery *query, GstVideoAlignment const *align)
+{
+	GstStructure *params = gst_structure_new(
+		GST_IMX_VIDEO_ALIGNMENT_PARAMS_NAME,
+		"padding-left", G_TYPE_UINT, align->padding_left,
+		"padding-top", G_TYPE_UINT, align->padding_top,
+		"padding-right", G_TYPE_UINT, align->padding_right,
+		"padding-bottom", G_TYPE_UINT, align->padding_bottom,
+		"stride-align0", G_TYPE_UINT, align->stride_align[0],
+		"stride-align1", G_TYPE_UINT, align->stride_align[1],
+		"stride-align2", G_TYPE_UINT, align->stride_align[2],
+		"stride-align3", G_TYPE_UINT, align->stride_align[3],
+		NULL
+	);
+
+	gst_query_add_allocation_meta(query, gst_imx_phys_mem_meta_api_get_type(), params);
+	gst_structure_free(params);
+}
+
+
+gboolean gst_imx_phys_mem_buffer_pool_query_get_video_alignment(GstQuery *query, GstVideoAlignment *align)
+{
+	guint i, num_metas;
+	gboolean found = FALSE;
+
+	num_metas = gst_query_get_n_allocation_metas(query);
+	for (i = 0; i < num_metas; ++i)
+	{
+		GstVideoAlignment requested;
+		GstStructure const *params;
+
+		if (gst_query_parse_nth_allocation_meta(query, i, &params) != gst_imx_phys_mem_meta_api_get_type())
+			continue;
+		if ((params == NULL) || !gst_structure_has_name(params, GST_IMX_VIDEO_ALIGNMENT_PARAMS_NAME))
+			continue;
+
+		gst_video_alignment_reset(&requested);
+		gst_structure_get(
+			params,
+			"padding-left", G_TYPE_UINT, &(requested.padding_left),
+			"padding-top", G_TYPE_UINT, &(requested.padding_top),
+			"padding-right", G_TYPE_UINT, &(requested.padding_right),
+			"padding-bottom", G_TYPE_UINT, &(requested.padding_bottom),
+			"stride-align0", G_TYPE_UINT, &(requested.stride_align[0]),
+			"stride-align1", G_TYPE_UINT, &(requested.stride_align[1]),
+			"stride-align2", G_TYPE_UINT, &(requested.stride_align[2]),
+			"stride-align3", G_TYPE_UINT, &(requested.stride_align[3]),
+			NULL
+		);
+
+		gst_imx_phys_mem_buffer_pool_merge_video_alignment(align, &requested);
+		found = TRUE;
+	}
+
+	return found;
+}
+
+
+void gst_imx_phys_mem_buffer_pool_config_set_video_alignment(GstStructure *config, GstVideoAlignment *align)
+{
+	gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_ALIGNMENT);
+	gst_buffer_pool_config_set_video_alignment(config, align);
+}
 
 
+void gst_imx_phys_mem_buffer_pool_config_set_prewarm(GstStructure *config, guint num_buffers, gboolean async)
+{
+	gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_IMX_PREWARM);
+	gst_structure_set(config, "imx-prewarm-buffers", G_TYPE_UINT, num_buffers, "imx-prewarm-async", G_TYPE_BOOLEAN, async, NULL);
+}
 
+
+void gst_imx_phys_mem_buffer_pool_config_set_idle_shrink(GstStructure *config, guint low_water_mark, GstClockTime idle_timeout)
+{
+	gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_IMX_IDLE_SHRINK);
+	gst_structure_set(config, "imx-low-water-mark", G_TYPE_UINT, low_water_mark, "imx-idle-timeout", G_TYPE_UINT64, idle_timeout, NULL);
+}
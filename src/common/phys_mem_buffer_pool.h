@@ -38,6 +38,27 @@ typedef struct _GstImxPhysMemBufferPoolClass GstImxPhysMemBufferPoolClass;
 #define GST_IMX_PHYS_MEM_BUFFER_POOL(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_IMX_PHYS_MEM_BUFFER_POOL, GstImxPhysMemBufferPool))
 #define GST_IMX_PHYS_MEM_BUFFER_POOL_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_IMX_PHYS_MEM_BUFFER_POOL, GstImxPhysMemBufferPoolClass))
 
+/* If this option is set, or if the configured caps contain the DMABUF caps feature,
+ * the pool exports each memory block as DMABUF right when the buffer is allocated */
+#define GST_BUFFER_POOL_OPTION_IMX_DMABUF "GstBufferPoolOptionImxDmabuf"
+
+/* Name of the parameter structure elements attach to the physical memory meta
+ * API in allocation queries to request a frame layout alignment */
+#define GST_IMX_VIDEO_ALIGNMENT_PARAMS_NAME "GstImxVideoAlignmentParams"
+
+/* If this option is set, the pool allocates buffers right when it is activated,
+ * so that the first frames do not have to wait for physical memory allocations.
+ * Use gst_imx_phys_mem_buffer_pool_config_set_prewarm() to set it. */
+#define GST_BUFFER_POOL_OPTION_IMX_PREWARM "GstBufferPoolOptionImxPrewarm"
+/* If this option is set, the pool frees the buffers which exceed a low-water mark
+ * once the number of buffers in use has stayed at or below that mark for an idle
+ * period. This is checked periodically, so pools which are not used at all shrink
+ * as well. If more buffers are needed later, they are allocated again. (Before
+ * GStreamer 1.6, only the memory of the buffers is freed, and the buffers get new
+ * memory when they are acquired again.)
+ * Use gst_imx_phys_mem_buffer_pool_config_set_idle_shrink() to set it. */
+#define GST_BUFFER_POOL_OPTION_IMX_IDLE_SHRINK "GstBufferPoolOptionImxIdleShrink"
+
 
 struct _GstImxPhysMemBufferPool
 {
@@ -45,8 +66,27 @@ struct _GstImxPhysMemBufferPool
 
 	GstAllocator *allocator;
 	GstVideoInfo video_info;
+	GstVideoAlignment video_align;
 	gboolean add_video_meta;
 	gboolean read_only;
+	gboolean export_dmabuf;
+
+	gboolean prewarm, prewarm_async;
+	guint prewarm_count;
+	gint prewarm_thread_running;
+
+	gboolean idle_shrink;
+	guint low_water_mark;
+	GstClockTime idle_timeout;
+	/* The counters below and the last busy time are protected by the mutex */
+	GMutex shrink_mutex;
+	guint num_outstanding, num_populated, num_allocated;
+	gint64 last_busy_time;
+	/* periodic idle check while the pool is active; runs in the system clock's thread */
+	GstClockID idle_check_id;
+
+	/* element the allocated memory is attributed to (see phys_mem_stats.h) */
+	GWeakRef owner;
 };
 
 
@@ -58,6 +98,52 @@ struct _GstImxPhysMemBufferPoolClass
 
 GType gst_imx_phys_mem_buffer_pool_get_type(void);
 GstBufferPool *gst_imx_phys_mem_buffer_pool_new(gboolean read_only);
+/* Attributes the memory allocated by the pool to the given element in the physical
+ * memory accounting; it also posts the warning if the threshold is reached. This
+ * is necessary because pools often allocate from threads of other elements.
+ * Without an owner, allocations are attributed to the owner of the calling thread
+ * (see gst_imx_phys_mem_stats_set_thread_owner() ). */
+void gst_imx_phys_mem_buffer_pool_set_owner(GstBufferPool *pool, GstElement *owner);
+
+/* Returns a copy of the caps with the DMABUF caps feature added to all structures,
+ * or a new reference to the caps if the allocator cannot export DMABUF */
+GstCaps *gst_imx_phys_mem_buffer_pool_add_dmabuf_caps_feature(GstCaps *caps, GstAllocator *allocator);
+
+/* Alignment handling
+ *
+ * If GST_BUFFER_POOL_OPTION_VIDEO_ALIGNMENT is set in the pool configuration, the
+ * pool lays out frames according to the GstVideoAlignment in the configuration.
+ * Otherwise, width and height are padded to the next multiple of 8 pixels.
+ *
+ * Elements which need a certain alignment add their requirements to the allocation
+ * query with gst_imx_phys_mem_buffer_pool_query_add_video_alignment(). The element
+ * that configures the pool then merges all requested alignments with
+ * gst_imx_phys_mem_buffer_pool_query_get_video_alignment() and puts the result in
+ * the pool configuration with gst_imx_phys_mem_buffer_pool_config_set_video_alignment().
+ * This way, a single frame layout satisfies all elements in the chain, and no
+ * element has to copy frames just to change their layout.
+ */
+
+/* Sets up an alignment which pads width and height of the frames described by info
+ * to multiples of width_multiple and height_multiple pixels, and aligns the strides
+ * of all planes to stride_align_mask+1 bytes (stride_align_mask must be 2^n-1). */
+void gst_imx_phys_mem_buffer_pool_video_alignment_init(GstVideoAlignment *align, GstVideoInfo const *info, guint width_multiple, guint height_multiple, guint stride_align_mask);
+/* Merges src into dest; the result satisfies both alignments, provided the padded
+ * sizes are multiples of powers of two (which is the case with the init function above) */
+void gst_imx_phys_mem_buffer_pool_merge_video_alignment(GstVideoAlignment *dest, GstVideoAlignment const *src);
+
+void gst_imx_phys_mem_buffer_pool_query_add_video_alignment(GstQuery *query, GstVideoAlignment const *align);
+/* Merges all alignments found in the query into align, which must be initialized.
+ * Returns TRUE if the query contained at least one alignment request. */
+gboolean gst_imx_phys_mem_buffer_pool_query_get_video_alignment(GstQuery *query, GstVideoAlignment *align);
+void gst_imx_phys_mem_buffer_pool_config_set_video_alignment(GstStructure *config, GstVideoAlignment *align);
+
+/* Enables pre-warming. num_buffers buffers are allocated at activation; if num_buffers
+ * is 0, the configured minimum number of buffers is used. If async is TRUE, the
+ * buffers are allocated in a background thread, and the activation does not block. */
+void gst_imx_phys_mem_buffer_pool_config_set_prewarm(GstStructure *config, guint num_buffers, gboolean async);
+/* Enables idle shrinking; see GST_BUFFER_POOL_OPTION_IMX_IDLE_SHRINK */
+void gst_imx_phys_mem_buffer_pool_config_set_idle_shrink(GstStructure *config, guint low_water_mark, GstClockTime idle_timeout);
 
 
 G_END_DECLS
@@ -0,0 +1,174 @@
+/* Copy engine for physically contiguous memory
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include <string.h>
+#include <stdlib.h>
+#include <gst/gst.h>
+#include "phys_mem_copy.h"
+
+
+GST_DEBUG_CATEGORY_STATIC(imx_phys_mem_copy_debug);
+#define GST_CAT_DEFAULT imx_phys_mem_copy_debug
+
+
+static GMutex backend_mutex;
+static GstImxPhysMemHwCopyFunc hw_copy_func = NULL;
+static gpointer hw_copy_user_data = NULL;
+static gsize copy_threshold = GST_IMX_PHYS_MEM_COPY_DEFAULT_THRESHOLD;
+
+
+/* Number of runs per size when searching the crossover; the fastest one is used */
+#define CROSSOVER_REPETITIONS 3
+
+
+static void setup_debug_category(void)
+{
+	static gsize initialized = 0;
+
+	if (g_once_init_enter(&initialized))
+	{
+		gchar const *threshold_str;
+
+		GST_DEBUG_CATEGORY_INIT(imx_phys_mem_copy_debug, "imxphysmemcopy", 0, "Copy engine for physically contiguous memory");
+
+		threshold_str = g_getenv("GST_IMX_PHYS_MEM_COPY_THRESHOLD");
+		if (threshold_str != NULL)
+		{
+			copy_threshold = (gsize)g_ascii_strtoull(threshold_str, NULL, 10);
+			GST_INFO("using copy threshold %" G_GSIZE_FORMAT " from environment", copy_threshold);
+		}
+
+		g_once_init_leave(&initialized, 1);
+	}
+}
+
+
+void gst_imx_phys_mem_copy_set_hw_backend(GstImxPhysMemHwCopyFunc func, gpointer user_data)
+{
+	setup_debug_category();
+
+	g_mutex_lock(&backend_mutex);
+	hw_copy_func = func;
+	hw_copy_user_data = user_data;
+	g_mutex_unlock(&backend_mutex);
+
+	GST_INFO("%s hardware copy backend", (func != NULL) ? "registered" : "unregistered");
+}
+
+
+void gst_imx_phys_mem_copy_set_threshold(gsize threshold)
+{
+	setup_debug_category();
+
+	g_mutex_lock(&backend_mutex);
+	copy_threshold = threshold;
+	g_mutex_unlock(&backend_mutex);
+}
+
+
+gsize gst_imx_phys_mem_copy_hw_prefix(guintptr dest_phys_addr, guintptr src_phys_addr, gsize size)
+{
+	GstImxPhysMemHwCopyFunc func;
+	gpointer user_data;
+	gsize threshold, num_hw_copied = 0;
+
+	setup_debug_category();
+
+	g_mutex_lock(&backend_mutex);
+	func = hw_copy_func;
+	user_data = hw_copy_user_data;
+	threshold = copy_threshold;
+	g_mutex_unlock(&backend_mutex);
+
+	if ((func != NULL) && (size >= threshold) && (dest_phys_addr != 0) && (src_phys_addr != 0))
+	{
+		num_hw_copied = func(user_data, dest_phys_addr, src_phys_addr, size);
+		GST_LOG("hardware copied %" G_GSIZE_FORMAT " of %" G_GSIZE_FORMAT " bytes", num_hw_copied, size);
+	}
+
+	return num_hw_copied;
+}
+
+
+gboolean gst_imx_phys_mem_copy_measure(guintptr dest_phys_addr, gpointer dest_virt_addr, guintptr src_phys_addr, gconstpointer src_virt_addr, gsize size, guint num_repetitions, gint64 *cpu_time, gint64 *hw_time)
+{
+	GstImxPhysMemHwCopyFunc func;
+	gpointer user_data;
+	guint i;
+
+	setup_debug_category();
+
+	g_mutex_lock(&backend_mutex);
+	func = hw_copy_func;
+	user_data = hw_copy_user_data;
+	g_mutex_unlock(&backend_mutex);
+
+	if (func == NULL)
+		return FALSE;
+
+	*cpu_time = *hw_time = G_MAXINT64;
+
+	for (i = 0; i < num_repetitions; ++i)
+	{
+		gint64 start_time;
+		gsize num_hw_copied;
+
+		start_time = g_get_monotonic_time();
+		memcpy(dest_virt_addr, src_virt_addr, size);
+		*cpu_time = MIN(*cpu_time, g_get_monotonic_time() - start_time);
+
+		/* The threshold is bypassed here, since it is what is being measured */
+		start_time = g_get_monotonic_time();
+		num_hw_copied = func(user_data, dest_phys_addr, src_phys_addr, size);
+		if (num_hw_copied < size)
+			memcpy((guint8 *)dest_virt_addr + num_hw_copied, (guint8 const *)src_virt_addr + num_hw_copied, size - num_hw_copied);
+		*hw_time = MIN(*hw_time, g_get_monotonic_time() - start_time);
+	}
+
+	return TRUE;
+}
+
+
+gsize gst_imx_phys_mem_copy_find_crossover(guintptr dest_phys_addr, gpointer dest_virt_addr, guintptr src_phys_addr, gconstpointer src_virt_addr)
+{
+	gsize size, crossover = 0;
+
+	/* The crossover is the smallest size from which on the hardware stays faster;
+	 * a single faster size below a slower one is considered measurement noise */
+	for (size = GST_IMX_PHYS_MEM_COPY_CALIBRATION_MIN_SIZE; size <= GST_IMX_PHYS_MEM_COPY_CALIBRATION_MAX_SIZE; size *= 2)
+	{
+		gint64 cpu_time, hw_time;
+
+		if (!gst_imx_phys_mem_copy_measure(dest_phys_addr, dest_virt_addr, src_phys_addr, src_virt_addr, size, CROSSOVER_REPETITIONS, &cpu_time, &hw_time))
+			return 0;
+
+		GST_DEBUG("copying %" G_GSIZE_FORMAT " bytes: CPU %" G_GINT64_FORMAT " us, hardware %" G_GINT64_FORMAT " us", size, cpu_time, hw_time);
+
+		if (hw_time < cpu_time)
+		{
+			if (crossover == 0)
+				crossover = size;
+		}
+		else
+			crossover = 0;
+	}
+
+	return crossover;
+}
+
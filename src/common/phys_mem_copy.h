@@ -0,0 +1,77 @@
+/* Copy engine for physically contiguous memory
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#ifndef GST_IMX_COMMON_PHYS_MEM_COPY_H
+#define GST_IMX_COMMON_PHYS_MEM_COPY_H
+
+#include <glib.h>
+
+
+G_BEGIN_DECLS
+
+
+/* Copies of at least this many bytes are done by the hardware backend (if one
+ * is registered); smaller copies are done by the CPU, since for these, the
+ * setup overhead of the hardware outweighs the gains. Can be overridden with the
+ * GST_IMX_PHYS_MEM_COPY_THRESHOLD environment variable, for example with the
+ * crossover point that gst_imx_phys_mem_copy_find_crossover() measures on the
+ * target (the IPU copy_crossover benchmark prints it). */
+#define GST_IMX_PHYS_MEM_COPY_DEFAULT_THRESHOLD (256 * 1024)
+
+/* Range of copy sizes gst_imx_phys_mem_copy_find_crossover() measures; the sizes are powers of two */
+#define GST_IMX_PHYS_MEM_COPY_CALIBRATION_MIN_SIZE (16 * 1024)
+#define GST_IMX_PHYS_MEM_COPY_CALIBRATION_MAX_SIZE (1024 * 1024)
+
+
+/* Hardware copy function; copies a prefix of the given size from src_phys_addr to
+ * dest_phys_addr, and returns the number of bytes copied. The remaining bytes
+ * are copied by the CPU. Returning 0 means the hardware cannot perform the copy
+ * (for example because of alignment restrictions). */
+typedef gsize (*GstImxPhysMemHwCopyFunc)(gpointer user_data, guintptr dest_phys_addr, guintptr src_phys_addr, gsize size);
+
+
+/* Registers a hardware copy backend, replacing any previously registered one.
+ * Passing NULL as func unregisters the backend. */
+void gst_imx_phys_mem_copy_set_hw_backend(GstImxPhysMemHwCopyFunc func, gpointer user_data);
+void gst_imx_phys_mem_copy_set_threshold(gsize threshold);
+
+/* Copies a prefix of size bytes from the source to the destination with the hardware
+ * backend, and returns the number of bytes copied. Returns 0 if no backend is registered,
+ * if size is below the threshold, or if the hardware cannot copy the blocks. The caller
+ * must copy the remaining bytes with the CPU. Since the hardware bypasses the CPU cache,
+ * the caller must also invalidate the destination's cache before the CPU accesses it;
+ * this has to happen before the remaining bytes are copied, otherwise these are lost. */
+gsize gst_imx_phys_mem_copy_hw_prefix(guintptr dest_phys_addr, guintptr src_phys_addr, gsize size);
+
+/* Measures how long the CPU and the hardware backend take to copy size bytes
+ * (the best of num_repetitions runs, in microseconds). The hardware time includes
+ * the CPU copy of the remainder the hardware cannot copy. The blocks must be at
+ * least size bytes large. Returns FALSE if no backend is registered. */
+gboolean gst_imx_phys_mem_copy_measure(guintptr dest_phys_addr, gpointer dest_virt_addr, guintptr src_phys_addr, gconstpointer src_virt_addr, gsize size, guint num_repetitions, gint64 *cpu_time, gint64 *hw_time);
+/* Measures the sizes in the calibration range, and returns the smallest size from
+ * which on the hardware is faster than the CPU, or 0 if the hardware is slower for
+ * all sizes. The blocks must be at least GST_IMX_PHYS_MEM_COPY_CALIBRATION_MAX_SIZE
+ * bytes large. */
+gsize gst_imx_phys_mem_copy_find_crossover(guintptr dest_phys_addr, gpointer dest_virt_addr, guintptr src_phys_addr, gconstpointer src_virt_addr);
+
+
+G_END_DECLS
+
+
+#endif
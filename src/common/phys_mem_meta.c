@@ -18,17 +18,163 @@
 
 
 #include "phys_mem_meta.h"
+#include "phys_mem_allocator.h"
 
 
 static gboolean gst_imx_phys_mem_meta_init(GstMeta *meta, G_GNUC_UNUSED gpointer params, G_GNUC_UNUSED GstBuffer *buffer)
 {
 	GstImxPhysMemMeta *imx_phys_mem_meta = (GstImxPhysMemMeta *)meta;
 	imx_phys_mem_meta->phys_addr = 0;
+	imx_phys_mem_meta->x_padding = 0;
+	imx_phys_mem_meta->y_padding = 0;
 	imx_phys_mem_meta->padding = 0;
 	return TRUE;
 }
 
 
+static gboolean gst_imx_phys_mem_meta_transform(GstBuffer *dest, GstMeta *meta, GstBuffer *buffer, GQuark type, gpointer data)
+{
+	GstImxPhysMemMeta *dest_meta, *src_meta;
+	GstMemory *dest_mem, *src_mem;
+	GstMetaTransformCopy *copy;
+	guintptr phys_addr;
+
+	if (!GST_META_TRANSFORM_IS_COPY(type))
+		return FALSE;
+
+	copy = (GstMetaTransformCopy *)data;
+	src_meta = (GstImxPhysMemMeta *)meta;
+
+	if ((gst_buffer_n_memory(dest) == 0) || (gst_buffer_n_memory(buffer) == 0))
+		return TRUE;
+
+	dest_mem = gst_buffer_peek_memory(dest, 0);
+	src_mem = gst_buffer_peek_memory(buffer, 0);
+
+	if (gst_imx_is_phys_memory(dest_mem))
+	{
+		/* The destination memory knows its own physical address; this covers
+		 * shared sub-blocks as well as deep copies into new blocks */
+		phys_addr = gst_imx_phys_memory_get_phys_addr(dest_mem);
+	}
+	else if ((dest_mem == src_mem) || ((dest_mem->parent != NULL) && ((dest_mem->parent == src_mem) || (dest_mem->parent == src_mem->parent))))
+	{
+		/* The destination shares the source's memory (for example, a wrapped
+		 * VPU framebuffer); the physical address moves along with the offset */
+		phys_addr = src_meta->phys_addr + (dest_mem->offset - src_mem->offset);
+	}
+	else
+	{
+		/* The memory was copied to a non-physical block; the meta does not apply */
+		return TRUE;
+	}
+
+	dest_meta = GST_IMX_PHYS_MEM_META_ADD(dest);
+	dest_meta->phys_addr = phys_addr;
+
+	/* The paddings describe the entire frame, and do not apply to regions of it */
+	if (!(copy->region))
+	{
+		dest_meta->x_padding = src_meta->x_padding;
+		dest_meta->y_padding = src_meta->y_padding;
+		dest_meta->padding = src_meta->padding;
+	}
+
+	return TRUE;
+}
+
+
+static gboolean gst_imx_phys_mem_planes_meta_init(GstMeta *meta, G_GNUC_UNUSED gpointer params, G_GNUC_UNUSED GstBuffer *buffer)
+{
+	GstImxPhysMemPlanesMeta *planes_meta = (GstImxPhysMemPlanesMeta *)meta;
+	guint i;
+
+	planes_meta->version = GST_IMX_PHYS_MEM_PLANES_META_VERSION;
+	planes_meta->n_planes = 0;
+	for (i = 0; i < GST_VIDEO_MAX_PLANES; ++i)
+	{
+		planes_meta->phys_addr[i] = 0;
+		planes_meta->stride[i] = 0;
+		planes_meta->plane_height[i] = 0;
+	}
+
+	return TRUE;
+}
+
+
+/* Finds the physical address the given physical address of a plane in src
+ * corresponds to in dest. The plane can be in any of the memory blocks of src;
+ * the block at the same index in dest is used. Memory blocks which are not
+ * physical memory blocks are only handled if dest shares them with src. */
+static gboolean gst_imx_phys_mem_planes_meta_translate_addr(GstBuffer *dest, GstBuffer *src, guintptr src_phys_addr, guintptr *dest_phys_addr)
+{
+	guint i, num_memory = MIN(gst_buffer_n_memory(src), gst_buffer_n_memory(dest));
+
+	for (i = 0; i < num_memory; ++i)
+	{
+		GstMemory *src_mem = gst_buffer_peek_memory(src, i);
+		GstMemory *dest_mem = gst_buffer_peek_memory(dest, i);
+		guintptr base;
+
+		if (!gst_imx_is_phys_memory(src_mem))
+		{
+			if (dest_mem != src_mem)
+				continue;
+
+			/* Same block, so the address stays the same */
+			*dest_phys_addr = src_phys_addr;
+			return TRUE;
+		}
+
+		base = gst_imx_phys_memory_get_phys_addr(src_mem);
+		if ((src_phys_addr < base) || (src_phys_addr >= (base + src_mem->size)))
+			continue;
+
+		if (!gst_imx_is_phys_memory(dest_mem))
+			return FALSE;
+
+		*dest_phys_addr = gst_imx_phys_memory_get_phys_addr(dest_mem) + (src_phys_addr - base);
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+
+static gboolean gst_imx_phys_mem_planes_meta_transform(GstBuffer *dest, GstMeta *meta, GstBuffer *buffer, GQuark type, gpointer data)
+{
+	GstImxPhysMemPlanesMeta *dest_meta, *src_meta;
+	guintptr phys_addr[GST_VIDEO_MAX_PLANES];
+	guint i;
+
+	if (!GST_META_TRANSFORM_IS_COPY(type))
+		return FALSE;
+
+	/* The layout describes the entire frame, and does not apply to regions of it */
+	if (((GstMetaTransformCopy *)data)->region)
+		return TRUE;
+
+	src_meta = (GstImxPhysMemPlanesMeta *)meta;
+
+	for (i = 0; i < src_meta->n_planes; ++i)
+	{
+		if (!gst_imx_phys_mem_planes_meta_translate_addr(dest, buffer, src_meta->phys_addr[i], &(phys_addr[i])))
+			return TRUE;
+	}
+
+	dest_meta = GST_IMX_PHYS_MEM_PLANES_META_ADD(dest);
+	dest_meta->n_planes = src_meta->n_planes;
+	for (i = 0; i < src_meta->n_planes; ++i)
+	{
+		dest_meta->phys_addr[i] = phys_addr[i];
+		dest_meta->stride[i] = src_meta->stride[i];
+		dest_meta->plane_height[i] = src_meta->plane_height[i];
+	}
+
+	return TRUE;
+}
+
+
 GType gst_imx_phys_mem_meta_api_get_type(void)
 {
 	static volatile GType type;
@@ -56,7 +202,7 @@ GstMetaInfo const * gst_imx_phys_mem_meta_get_info(void)
 			sizeof(GstImxPhysMemMeta),
 			GST_DEBUG_FUNCPTR(gst_imx_phys_mem_meta_init),
 			(GstMetaFreeFunction)NULL,
-			(GstMetaTransformFunction)NULL
+			GST_DEBUG_FUNCPTR(gst_imx_phys_mem_meta_transform)
 		);
 		g_once_init_leave(&gst_imx_phys_mem_meta_info, meta);
 	}
@@ -64,3 +210,111 @@ GstMetaInfo const * gst_imx_phys_mem_meta_get_info(void)
 	return gst_imx_phys_mem_meta_info;
 }
 
+
+GType gst_imx_phys_mem_planes_meta_api_get_type(void)
+{
+	static volatile GType type;
+	static gchar const *tags[] = { "memory", "phys_mem", "video", NULL };
+
+	if (g_once_init_enter(&type))
+	{
+		GType _type = gst_meta_api_type_register("GstImxPhysMemPlanesMetaAPI", tags);
+		g_once_init_leave(&type, _type);
+	}
+
+	return type;
+}
+
+
+GstMetaInfo const * gst_imx_phys_mem_planes_meta_get_info(void)
+{
+	static GstMetaInfo const *gst_imx_phys_mem_planes_meta_info = NULL;
+
+	if (g_once_init_enter(&gst_imx_phys_mem_planes_meta_info))
+	{
+		GstMetaInfo const *meta = gst_meta_register(
+			gst_imx_phys_mem_planes_meta_api_get_type(),
+			"GstImxPhysMemPlanesMeta",
+			sizeof(GstImxPhysMemPlanesMeta),
+			GST_DEBUG_FUNCPTR(gst_imx_phys_mem_planes_meta_init),
+			(GstMetaFreeFunction)NULL,
+			GST_DEBUG_FUNCPTR(gst_imx_phys_mem_planes_meta_transform)
+		);
+		g_once_init_leave(&gst_imx_phys_mem_planes_meta_info, meta);
+	}
+
+	return gst_imx_phys_mem_planes_meta_info;
+}
+
+
+void gst_imx_phys_mem_planes_meta_set_from_video_info(GstImxPhysMemPlanesMeta *meta, guintptr phys_addr, GstVideoInfo const *info, guint padded_height)
+{
+	guint i, comp;
+	GstVideoFormatInfo const *finfo = info->finfo;
+
+	meta->n_planes = GST_VIDEO_INFO_N_PLANES(info);
+
+	for (i = 0; i < meta->n_planes; ++i)
+	{
+		meta->phys_addr[i] = phys_addr + GST_VIDEO_INFO_PLANE_OFFSET(info, i);
+		meta->stride[i] = GST_VIDEO_INFO_PLANE_STRIDE(info, i);
+
+		/* Use the subsampling of the first component stored in this plane */
+		meta->plane_height[i] = padded_height;
+		for (comp = 0; comp < GST_VIDEO_FORMAT_INFO_N_COMPONENTS(finfo); ++comp)
+		{
+			if (GST_VIDEO_FORMAT_INFO_PLANE(finfo, comp) == i)
+			{
+				meta->plane_height[i] = GST_VIDEO_FORMAT_INFO_SCALE_HEIGHT(finfo, comp, padded_height);
+				break;
+			}
+		}
+	}
+}
+
+
+gboolean gst_imx_phys_mem_meta_get_plane_layout(GstBuffer *buffer, GstVideoInfo const *info, guintptr phys_addr[GST_VIDEO_MAX_PLANES], gint stride[GST_VIDEO_MAX_PLANES], guint *padded_height)
+{
+	guint i;
+	GstImxPhysMemPlanesMeta *planes_meta;
+	GstImxPhysMemMeta *phys_mem_meta;
+	GstVideoMeta *video_meta;
+
+	planes_meta = GST_IMX_PHYS_MEM_PLANES_META_GET(buffer);
+	if ((planes_meta != NULL) && (planes_meta->version >= 1) && (planes_meta->n_planes > 0) && (planes_meta->phys_addr[0] != 0))
+	{
+		for (i = 0; i < GST_VIDEO_MAX_PLANES; ++i)
+		{
+			phys_addr[i] = (i < planes_meta->n_planes) ? planes_meta->phys_addr[i] : 0;
+			stride[i] = (i < planes_meta->n_planes) ? planes_meta->stride[i] : 0;
+		}
+		*padded_height = planes_meta->plane_height[0];
+		return TRUE;
+	}
+
+	/* No planes meta; derive the layout the way it was done before the planes
+	 * meta existed: the planes are in one block, at the offsets given by the
+	 * video meta, and the padding field contains the size of the padding rows */
+	phys_mem_meta = GST_IMX_PHYS_MEM_META_GET(buffer);
+	if ((phys_mem_meta == NULL) || (phys_mem_meta->phys_addr == 0))
+		return FALSE;
+
+	video_meta = gst_buffer_get_video_meta(buffer);
+	for (i = 0; i < GST_VIDEO_MAX_PLANES; ++i)
+	{
+		if (video_meta != NULL)
+		{
+			phys_addr[i] = (i < video_meta->n_planes) ? (phys_mem_meta->phys_addr + video_meta->offset[i]) : 0;
+			stride[i] = (i < video_meta->n_planes) ? video_meta->stride[i] : 0;
+		}
+		else
+		{
+			phys_addr[i] = (i < GST_VIDEO_INFO_N_PLANES(info)) ? (phys_mem_meta->phys_addr + GST_VIDEO_INFO_PLANE_OFFSET(info, i)) : 0;
+			stride[i] = (i < GST_VIDEO_INFO_N_PLANES(info)) ? GST_VIDEO_INFO_PLANE_STRIDE(info, i) : 0;
+		}
+	}
+
+	*padded_height = ((video_meta != NULL) ? video_meta->height : GST_VIDEO_INFO_HEIGHT(info)) + ((stride[0] != 0) ? (phys_mem_meta->padding / stride[0]) : 0);
+
+	return TRUE;
+}
@@ -29,6 +29,7 @@ G_BEGIN_DECLS
 
 
 typedef struct _GstImxPhysMemMeta GstImxPhysMemMeta;
+typedef struct _GstImxPhysMemPlanesMeta GstImxPhysMemPlanesMeta;
 
 
 #define GST_IMX_PHYS_MEM_META_GET(buffer)      ((GstImxPhysMemMeta *)gst_buffer_get_meta((buffer), gst_imx_phys_mem_meta_api_get_type()))
@@ -36,8 +37,18 @@ typedef struct _GstImxPhysMemMeta GstImxPhysMemMeta;
 #define GST_IMX_PHYS_MEM_META_DEL(buffer)      (gst_buffer_remove_meta((buffer), gst_buffer_get_meta((buffer), gst_imx_phys_mem_meta_api_get_type())))
 
 
+#define GST_IMX_PHYS_MEM_PLANES_META_GET(buffer)      ((GstImxPhysMemPlanesMeta *)gst_buffer_get_meta((buffer), gst_imx_phys_mem_planes_meta_api_get_type()))
+#define GST_IMX_PHYS_MEM_PLANES_META_ADD(buffer)      ((GstImxPhysMemPlanesMeta *)gst_buffer_add_meta((buffer), gst_imx_phys_mem_planes_meta_get_info(), NULL))
+#define GST_IMX_PHYS_MEM_PLANES_META_DEL(buffer)      (gst_buffer_remove_meta((buffer), gst_buffer_get_meta((buffer), gst_imx_phys_mem_planes_meta_api_get_type())))
+
+
 #define GST_BUFFER_POOL_OPTION_IMX_PHYS_MEM "GstBufferPoolOptionImxPhysMem"
 
+/* Version of the planes meta layout. If fields are added to the meta in the future,
+ * they are appended, and the version is increased; consumers must check the
+ * version before accessing fields which were added after version 1. */
+#define GST_IMX_PHYS_MEM_PLANES_META_VERSION 1
+
 
 struct _GstImxPhysMemMeta
 {
@@ -48,9 +59,44 @@ struct _GstImxPhysMemMeta
 };
 
 
+/* Physical layout of the planes of a video frame. Unlike GstImxPhysMemMeta, this
+ * does not assume that the planes are stored contiguously in one memory block,
+ * so frames with planes in separate allocations can be described as well. */
+struct _GstImxPhysMemPlanesMeta
+{
+	GstMeta meta;
+
+	/* Version 1 */
+	guint version;
+	guint n_planes;
+	/* Physical address of the first pixel of each plane */
+	guintptr phys_addr[GST_VIDEO_MAX_PLANES];
+	/* Stride of each plane, in bytes */
+	gint stride[GST_VIDEO_MAX_PLANES];
+	/* Number of lines allocated for each plane from phys_addr on, including padding lines */
+	guint plane_height[GST_VIDEO_MAX_PLANES];
+};
+
+
 GType gst_imx_phys_mem_meta_api_get_type(void);
 GstMetaInfo const * gst_imx_phys_mem_meta_get_info(void);
 
+GType gst_imx_phys_mem_planes_meta_api_get_type(void);
+GstMetaInfo const * gst_imx_phys_mem_planes_meta_get_info(void);
+
+/* Fills the planes meta with the layout of a frame stored contiguously at phys_addr,
+ * with planes laid out as described by info; padded_height is the number of lines
+ * allocated for the frame (the height of the planes is scaled for subsampled planes) */
+void gst_imx_phys_mem_planes_meta_set_from_video_info(GstImxPhysMemPlanesMeta *meta, guintptr phys_addr, GstVideoInfo const *info, guint padded_height);
+
+/* Retrieves the physical addresses and strides of all planes of the frame in the
+ * buffer, and the number of lines allocated for the first plane. If the buffer has
+ * a planes meta, it is used. Otherwise, the layout is derived from the physical
+ * memory meta and the video meta (or, if there is no video meta, from info).
+ * info may be NULL if the buffer is known to have a video meta.
+ * Returns FALSE if the buffer has no physical address. */
+gboolean gst_imx_phys_mem_meta_get_plane_layout(GstBuffer *buffer, GstVideoInfo const *info, guintptr phys_addr[GST_VIDEO_MAX_PLANES], gint stride[GST_VIDEO_MAX_PLANES], guint *padded_height);
+
 
 G_END_DECLS
 
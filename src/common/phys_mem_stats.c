@@ -0,0 +1,377 @@
+/* Physical memory accounting
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include <string.h>
+#include "phys_mem_stats.h"
+
+
+GST_DEBUG_CATEGORY_STATIC(imx_phys_mem_stats_debug);
+#define GST_CAT_DEFAULT imx_phys_mem_stats_debug
+
+
+/* The warning is re-armed once the allocated amount drops below
+ * this fraction of the threshold, to avoid flooding the bus */
+#define REARM_THRESHOLD(THRESHOLD)  ((THRESHOLD) - (THRESHOLD) / 8)
+
+#define UNKNOWN_OWNER_NAME "unknown"
+
+
+static GstImxPhysMemStats global_stats;
+/* The tables are only accessed when a block is attributed to an owner or when
+ * an allocator is created; the counters themselves are updated without locking */
+static GMutex tables_mutex;
+static GHashTable *type_stats_table = NULL, *owner_stats_table = NULL;
+static volatile gsize warning_threshold = 0;
+static volatile gint warning_posted = 0;
+static GPrivate thread_owner;
+
+
+static void setup_debug_category(void);
+static gsize get_cma_size(void);
+static GstImxPhysMemStats* get_stats_from_table(GHashTable *table, gchar const *name);
+static void stats_add(GstImxPhysMemStats *stats, gsize size);
+static void stats_sub(GstImxPhysMemStats *stats, gsize size);
+static GstStructure* stats_to_structure(GstImxPhysMemStats *stats, gchar const *name);
+static void add_table_to_structure(GstStructure *structure, gchar const *field_name, GHashTable *table);
+
+
+
+
+static void setup_debug_category(void)
+{
+	static gsize initialized = 0;
+
+	if (g_once_init_enter(&initialized))
+	{
+		gchar const *threshold_str;
+
+		GST_DEBUG_CATEGORY_INIT(imx_phys_mem_stats_debug, "imxphysmemstats", 0, "Physical memory accounting");
+
+		memset(&global_stats, 0, sizeof(GstImxPhysMemStats));
+		type_stats_table = g_hash_table_new(g_str_hash, g_str_equal);
+		owner_stats_table = g_hash_table_new(g_str_hash, g_str_equal);
+
+		threshold_str = g_getenv("GST_IMX_PHYS_MEM_WARNING_THRESHOLD");
+		if (threshold_str != NULL)
+		{
+			warning_threshold = (gsize)g_ascii_strtoull(threshold_str, NULL, 10);
+			GST_INFO("using warning threshold %" G_GSIZE_FORMAT " from environment", warning_threshold);
+		}
+		else
+		{
+			gsize cma_size = get_cma_size();
+			warning_threshold = cma_size / 10 * 9;
+			GST_INFO("CMA size: %" G_GSIZE_FORMAT " bytes; using warning threshold %" G_GSIZE_FORMAT, cma_size, warning_threshold);
+		}
+
+		g_once_init_leave(&initialized, 1);
+	}
+}
+
+
+static gsize get_cma_size(void)
+{
+	gchar *contents, *line;
+	gsize cma_size = 0;
+
+	if (!g_file_get_contents("/proc/meminfo", &contents, NULL, NULL))
+		return 0;
+
+	line = strstr(contents, "CmaTotal:");
+	if (line != NULL)
+		cma_size = (gsize)g_ascii_strtoull(line + strlen("CmaTotal:"), NULL, 10) * 1024;
+
+	g_free(contents);
+
+	return cma_size;
+}
+
+
+/* Must be called with the tables mutex locked */
+static GstImxPhysMemStats* get_stats_from_table(GHashTable *table, gchar const *name)
+{
+	GstImxPhysMemStats *stats = g_hash_table_lookup(table, name);
+
+	if (stats == NULL)
+	{
+		stats = g_slice_alloc0(sizeof(GstImxPhysMemStats));
+		stats->name = g_strdup(name);
+		g_hash_table_insert(table, stats->name, stats);
+	}
+
+	return stats;
+}
+
+
+static void stats_add(GstImxPhysMemStats *stats, gsize size)
+{
+	gsize cur_bytes, peak_bytes;
+	gint cur_blocks, peak_blocks;
+
+	cur_bytes = (gsize)g_atomic_pointer_add(&(stats->cur_bytes), (gssize)size) + size;
+	cur_blocks = g_atomic_int_add(&(stats->cur_blocks), 1) + 1;
+
+	/* Raise the peaks if necessary; another thread may do the same
+	 * concurrently, so retry until the peak is at least the current value */
+	do
+	{
+		peak_bytes = (gsize)g_atomic_pointer_get(&(stats->peak_bytes));
+	}
+	while ((cur_bytes > peak_bytes) && !g_atomic_pointer_compare_and_exchange(&(stats->peak_bytes), peak_bytes, cur_bytes));
+
+	do
+	{
+		peak_blocks = g_atomic_int_get(&(stats->peak_blocks));
+	}
+	while ((cur_blocks > peak_blocks) && !g_atomic_int_compare_and_exchange(&(stats->peak_blocks), peak_blocks, cur_blocks));
+}
+
+
+static void stats_sub(GstImxPhysMemStats *stats, gsize size)
+{
+	g_atomic_pointer_add(&(stats->cur_bytes), -(gssize)size);
+	g_atomic_int_add(&(stats->cur_blocks), -1);
+}
+
+
+GstImxPhysMemStats* gst_imx_phys_mem_stats_get_for_type(GType type)
+{
+	GstImxPhysMemStats *stats;
+
+	setup_debug_category();
+
+	g_mutex_lock(&tables_mutex);
+	stats = get_stats_from_table(type_stats_table, g_type_name(type));
+	g_mutex_unlock(&tables_mutex);
+
+	return stats;
+}
+
+
+void gst_imx_phys_mem_stats_block_allocated(GstImxPhysMemStats *type_stats, gsize size)
+{
+	gsize cur_bytes, threshold;
+
+	setup_debug_category();
+
+	stats_add(type_stats, size);
+	stats_add(&global_stats, size);
+
+	cur_bytes = (gsize)g_atomic_pointer_get(&(global_stats.cur_bytes));
+	threshold = (gsize)g_atomic_pointer_get(&warning_threshold);
+
+	if ((threshold == 0) || (cur_bytes < threshold) || !g_atomic_int_compare_and_exchange(&warning_posted, 0, 1))
+		return;
+
+	{
+		GstElement *owner = g_private_get(&thread_owner);
+
+		GST_WARNING("%" G_GSIZE_FORMAT " bytes of physical memory allocated in %d blocks, which exceeds the warning threshold of %" G_GSIZE_FORMAT " bytes; allocation of %" G_GSIZE_FORMAT " bytes by %s (%s) reached the threshold", cur_bytes, g_atomic_int_get(&(global_stats.cur_blocks)), threshold, size, (owner != NULL) ? GST_OBJECT_NAME(owner) : UNKNOWN_OWNER_NAME, type_stats->name);
+
+		if (owner != NULL)
+		{
+			GST_ELEMENT_WARNING(
+				owner,
+				RESOURCE, NO_SPACE_LEFT,
+				("running low on physical memory"),
+				("%" G_GSIZE_FORMAT " bytes allocated, warning threshold is %" G_GSIZE_FORMAT " bytes", cur_bytes, threshold)
+			);
+		}
+	}
+}
+
+
+void gst_imx_phys_mem_stats_block_freed(GstImxPhysMemStats *type_stats, gsize size)
+{
+	gsize threshold;
+
+	setup_debug_category();
+
+	stats_sub(type_stats, size);
+	stats_sub(&global_stats, size);
+
+	threshold = (gsize)g_atomic_pointer_get(&warning_threshold);
+	if (g_atomic_int_get(&warning_posted) && ((gsize)g_atomic_pointer_get(&(global_stats.cur_bytes)) < REARM_THRESHOLD(threshold)))
+		g_atomic_int_set(&warning_posted, 0);
+}
+
+
+void gst_imx_phys_mem_stats_allocation_failed(GstImxPhysMemStats *type_stats, gsize size)
+{
+	GstElement *owner;
+
+	setup_debug_category();
+
+	g_atomic_int_inc(&(type_stats->num_failures));
+	g_atomic_int_inc(&(global_stats.num_failures));
+
+	owner = g_private_get(&thread_owner);
+
+	GST_WARNING(
+		"allocation of %" G_GSIZE_FORMAT " bytes by %s (%s) failed; currently allocated: %" G_GSIZE_FORMAT " bytes in %d blocks, peak: %" G_GSIZE_FORMAT " bytes",
+		size,
+		(owner != NULL) ? GST_OBJECT_NAME(owner) : UNKNOWN_OWNER_NAME,
+		type_stats->name,
+		(gsize)g_atomic_pointer_get(&(global_stats.cur_bytes)),
+		g_atomic_int_get(&(global_stats.cur_blocks)),
+		(gsize)g_atomic_pointer_get(&(global_stats.peak_bytes))
+	);
+
+	if (owner != NULL)
+	{
+		GstImxPhysMemStats *owner_stats;
+
+		g_mutex_lock(&tables_mutex);
+		owner_stats = get_stats_from_table(owner_stats_table, GST_OBJECT_NAME(owner));
+		g_mutex_unlock(&tables_mutex);
+
+		g_atomic_int_inc(&(owner_stats->num_failures));
+	}
+}
+
+
+GstImxPhysMemStats* gst_imx_phys_mem_stats_owner_acquire(gsize size)
+{
+	GstElement *owner;
+	GstImxPhysMemStats *owner_stats;
+
+	setup_debug_category();
+
+	owner = g_private_get(&thread_owner);
+
+	g_mutex_lock(&tables_mutex);
+	owner_stats = get_stats_from_table(owner_stats_table, (owner != NULL) ? GST_OBJECT_NAME(owner) : UNKNOWN_OWNER_NAME);
+	g_mutex_unlock(&tables_mutex);
+
+	stats_add(owner_stats, size);
+
+	return owner_stats;
+}
+
+
+void gst_imx_phys_mem_stats_owner_release(GstImxPhysMemStats *owner_stats, gsize size)
+{
+	if (owner_stats != NULL)
+		stats_sub(owner_stats, size);
+}
+
+
+GstElement* gst_imx_phys_mem_stats_set_thread_owner(GstElement *owner)
+{
+	GstElement *previous_owner = g_private_get(&thread_owner);
+	g_private_set(&thread_owner, owner);
+	return previous_owner;
+}
+
+
+void gst_imx_phys_mem_stats_set_warning_threshold(gsize threshold)
+{
+	setup_debug_category();
+
+	g_atomic_pointer_set(&warning_threshold, threshold);
+	g_atomic_int_set(&warning_posted, 0);
+}
+
+
+gsize gst_imx_phys_mem_stats_get_warning_threshold(void)
+{
+	setup_debug_category();
+
+	return (gsize)g_atomic_pointer_get(&warning_threshold);
+}
+
+
+static GstStructure* stats_to_structure(GstImxPhysMemStats *stats, gchar const *name)
+{
+	return gst_structure_new(
+		name,
+		"current-bytes", G_TYPE_UINT64, (guint64)((gsize)g_atomic_pointer_get(&(stats->cur_bytes))),
+		"peak-bytes", G_TYPE_UINT64, (guint64)((gsize)g_atomic_pointer_get(&(stats->peak_bytes))),
+		"current-blocks", G_TYPE_INT, g_atomic_int_get(&(stats->cur_blocks)),
+		"peak-blocks", G_TYPE_INT, g_atomic_int_get(&(stats->peak_blocks)),
+		"failures", G_TYPE_INT, g_atomic_int_get(&(stats->num_failures)),
+		NULL
+	);
+}
+
+
+/* Must be called with the tables mutex locked */
+static void add_table_to_structure(GstStructure *structure, gchar const *field_name, GHashTable *table)
+{
+	GHashTableIter iter;
+	gpointer value;
+	GValue table_value = G_VALUE_INIT;
+	GstStructure *table_structure;
+
+	table_structure = gst_structure_new_empty(field_name);
+
+	g_hash_table_iter_init(&iter, table);
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+	{
+		GstImxPhysMemStats *stats = (GstImxPhysMemStats *)value;
+		GValue stats_value = G_VALUE_INIT;
+
+		g_value_init(&stats_value, GST_TYPE_STRUCTURE);
+		g_value_take_boxed(&stats_value, stats_to_structure(stats, stats->name));
+		gst_structure_take_value(table_structure, stats->name, &stats_value);
+	}
+
+	g_value_init(&table_value, GST_TYPE_STRUCTURE);
+	g_value_take_boxed(&table_value, table_structure);
+	gst_structure_take_value(structure, field_name, &table_value);
+}
+
+
+GstStructure* gst_imx_phys_mem_stats_get_structure(void)
+{
+	GstStructure *structure;
+
+	setup_debug_category();
+
+	structure = stats_to_structure(&global_stats, "imx-phys-mem-stats");
+
+	g_mutex_lock(&tables_mutex);
+	add_table_to_structure(structure, "allocators", type_stats_table);
+	add_table_to_structure(structure, "owners", owner_stats_table);
+	g_mutex_unlock(&tables_mutex);
+
+	return structure;
+}
+
+
+void gst_imx_phys_mem_stats_install_property(GObjectClass *object_class, guint prop_id)
+{
+	g_object_class_install_property(
+		object_class,
+		prop_id,
+		g_param_spec_boxed(
+			"phys-mem-stats",
+			"Physical memory statistics",
+			"Snapshot of the physical memory accounting counters of all allocators and owners",
+			GST_TYPE_STRUCTURE,
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		)
+	);
+}
+
+
+void gst_imx_phys_mem_stats_get_property(GValue *value)
+{
+	g_value_take_boxed(value, gst_imx_phys_mem_stats_get_structure());
+}
@@ -0,0 +1,98 @@
+/* Physical memory accounting
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#ifndef GST_IMX_COMMON_PHYS_MEM_STATS_H
+#define GST_IMX_COMMON_PHYS_MEM_STATS_H
+
+#include <gst/gst.h>
+
+
+G_BEGIN_DECLS
+
+
+/* Physical memory accounting across all physical memory allocators. Three scopes
+ * are tracked: all allocators combined, each allocator type, and each owner (the
+ * element the memory was allocated for). The global and per-type counters cover
+ * the physical memory which is actually allocated (including blocks kept in a
+ * recycler), the per-owner counters cover the blocks currently handed out.
+ *
+ * Once the global amount of allocated memory reaches the warning threshold, a
+ * warning message is posted on the bus by the owner of the allocation. The
+ * default threshold is 90% of the CMA size reported by /proc/meminfo; it can be
+ * overridden with the GST_IMX_PHYS_MEM_WARNING_THRESHOLD environment variable
+ * (in bytes; 0 disables the warning). */
+
+
+/* Counters of one accounting scope. All fields are updated atomically;
+ * use g_atomic_int_get() and g_atomic_pointer_get() for reading them. */
+typedef struct
+{
+	gchar *name;
+	volatile gsize cur_bytes, peak_bytes;
+	volatile gint cur_blocks, peak_blocks;
+	volatile gint num_failures;
+}
+GstImxPhysMemStats;
+
+
+/* Returns the counters for the given allocator type. These are created on first use
+ * and never freed, so the returned pointer can be stored for later use. */
+GstImxPhysMemStats* gst_imx_phys_mem_stats_get_for_type(GType type);
+
+/* Called by the allocator for each physical memory block that is allocated or freed,
+ * and for each failed allocation; these update the global counters as well as the
+ * ones of the allocator type */
+void gst_imx_phys_mem_stats_block_allocated(GstImxPhysMemStats *type_stats, gsize size);
+void gst_imx_phys_mem_stats_block_freed(GstImxPhysMemStats *type_stats, gsize size);
+void gst_imx_phys_mem_stats_allocation_failed(GstImxPhysMemStats *type_stats, gsize size);
+
+/* Called by the allocator when a block is handed out and when it is returned.
+ * The block is attributed to the owner of the calling thread; the returned counters
+ * must be passed to gst_imx_phys_mem_stats_owner_release() once the block is returned. */
+GstImxPhysMemStats* gst_imx_phys_mem_stats_owner_acquire(gsize size);
+void gst_imx_phys_mem_stats_owner_release(GstImxPhysMemStats *owner_stats, gsize size);
+
+/* Attributes physical memory allocations made by the calling thread to the given
+ * element (NULL = no owner). Returns the previous owner, which must be restored once
+ * the allocations are done. The element is not ref'd, so it must stay alive until
+ * the previous owner is restored. */
+GstElement* gst_imx_phys_mem_stats_set_thread_owner(GstElement *owner);
+
+void gst_imx_phys_mem_stats_set_warning_threshold(gsize threshold);
+gsize gst_imx_phys_mem_stats_get_warning_threshold(void);
+
+/* Returns a snapshot of all counters. The structure contains the global counters
+ * (current-bytes, peak-bytes, current-blocks, peak-blocks, failures) and two
+ * sub-structures, "allocators" and "owners", which contain one structure with
+ * the same fields per allocator type and per owner, respectively.
+ * The caller takes ownership over the structure. */
+GstStructure* gst_imx_phys_mem_stats_get_structure(void);
+
+/* Installs the read-only "phys-mem-stats" property, which contains the structure
+ * returned by gst_imx_phys_mem_stats_get_structure(). Elements which allocate
+ * physical memory install it; their get_property function then calls
+ * gst_imx_phys_mem_stats_get_property() for the given property ID. */
+void gst_imx_phys_mem_stats_install_property(GObjectClass *object_class, guint prop_id);
+void gst_imx_phys_mem_stats_get_property(GValue *value);
+
+
+G_END_DECLS
+
+
+#endif
@@ -28,6 +28,7 @@
 #include <gst/video/videooverlay.h>
 
 #include "eglvivsink.h"
+#include "../common/phys_mem_buffer_pool.h"
 
 
 
@@ -723,6 +724,14 @@ static gboolean gst_imx_egl_viv_propose_allocation(GstBaseSink *sink, GstQuery *
 		gst_query_add_allocation_meta(query, GST_VIDEO_META_API_TYPE, NULL);
 	}
 
+	/* Direct textures need widths which are multiples of 16 pixels; with
+	 * such frames, the renderer can map them without copying the pixels */
+	{
+		GstVideoAlignment align;
+		gst_imx_phys_mem_buffer_pool_video_alignment_init(&align, &info, 16, 1, 0);
+		gst_imx_phys_mem_buffer_pool_query_add_video_alignment(query, &align);
+	}
+
 	return TRUE;
 }
 
@@ -689,20 +689,20 @@ static gboolean gst_imx_egl_viv_sink_gles2_renderer_fill_texture(GstImxEglVivSin
 	GstVideoMeta *video_meta;
 	GstMapInfo map_info;
 	guint num_extra_lines, stride[3], offset[3], is_phys_buf;
-	GstImxPhysMemMeta *phys_mem_meta;
+	guintptr plane_addrs[GST_VIDEO_MAX_PLANES];
+	gint plane_strides[GST_VIDEO_MAX_PLANES];
+	guint padded_height;
 	GstVideoFormat fmt;
 	GLenum gl_format;
 	GLuint w, h, total_w, total_h;
 	
-	phys_mem_meta = NULL;
 	fmt = renderer->video_info.finfo->format;
 
 	gl_format = gst_imx_egl_viv_sink_gles2_renderer_get_viv_format(fmt);
 	w = renderer->video_info.width;
 	h = renderer->video_info.height;
 
-	phys_mem_meta = GST_IMX_PHYS_MEM_META_GET(buffer);
-	is_phys_buf = (phys_mem_meta != NULL) && (phys_mem_meta->phys_addr != 0);
+	is_phys_buf = gst_imx_phys_mem_meta_get_plane_layout(buffer, &(renderer->video_info), plane_addrs, plane_strides, &padded_height);
 
 	/* Get the stride and number of extra lines */
 	video_meta = gst_buffer_get_video_meta(buffer);
@@ -723,7 +723,27 @@ static gboolean gst_imx_egl_viv_sink_gles2_renderer_fill_texture(GstImxEglVivSin
 		}
 	}
 
-	num_extra_lines = is_phys_buf ? (phys_mem_meta->padding / stride[0]) : 0;
+	/* Direct textures get only the address of the first plane, and expect the
+	 * other planes right after it; frames with other layouts are copied */
+	if (is_phys_buf)
+	{
+		GstVideoInfo layout_info;
+
+		gst_video_info_init(&layout_info);
+		gst_video_info_set_format(&layout_info, fmt, plane_strides[0] / gst_imx_egl_viv_sink_gles2_renderer_bpp(fmt), padded_height);
+
+		for (guint i = 1; i < GST_VIDEO_INFO_N_PLANES(&layout_info); ++i)
+		{
+			if ((plane_addrs[i] - plane_addrs[0]) != GST_VIDEO_INFO_PLANE_OFFSET(&layout_info, i))
+			{
+				GST_LOG("plane %u of buffer %p is not where the direct texture expects it - copying frame", i, (gpointer)buffer);
+				is_phys_buf = FALSE;
+				break;
+			}
+		}
+	}
+
+	num_extra_lines = is_phys_buf ? (padded_height - h) : 0;
 
 	/* stride is in bytes, we need pixels */
 	total_w = stride[0] / gst_imx_egl_viv_sink_gles2_renderer_bpp(fmt);
@@ -738,12 +758,12 @@ static gboolean gst_imx_egl_viv_sink_gles2_renderer_fill_texture(GstImxEglVivSin
 		GLvoid *virt_addr;
 		GLuint phys_addr;
 
-		phys_addr = (GLuint)(phys_mem_meta->phys_addr);
+		phys_addr = (GLuint)(plane_addrs[0]);
 
 		GST_LOG("mapping physical address 0x%x of video frame in buffer %p into VIV texture", phys_addr, (gpointer)buffer);
 
 		gst_buffer_map(buffer, &map_info, GST_MAP_READ);
-		virt_addr = map_info.data;
+		virt_addr = map_info.data + offset[0];
 
 		renderer->viv_planes[0] = NULL;
 
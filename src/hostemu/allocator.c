@@ -0,0 +1,378 @@
+/* Host emulation allocator, for running without i.MX hardware
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "allocator.h"
+
+
+GST_DEBUG_CATEGORY_STATIC(imx_host_emu_allocator_debug);
+#define GST_CAT_DEFAULT imx_host_emu_allocator_debug
+
+
+/* The emulated physical address space; the range is chosen to resemble
+ * the DRAM range of i.MX6 SoCs, and to fit in 32 bit, since several parts
+ * of the code (and the VPU/IPU APIs) assume 32-bit physical addresses */
+#define EMU_PHYS_ADDR_START 0x10000000
+#define EMU_PHYS_ADDR_END   0xF0000000
+#define EMU_PAGE_SIZE       4096
+
+#define ALIGN_VAL_TO(LENGTH, ALIGN_SIZE)  ( ((guintptr)((LENGTH) + (ALIGN_SIZE) - 1) / (ALIGN_SIZE)) * (ALIGN_SIZE) )
+
+
+typedef struct
+{
+	guintptr phys_addr;
+	gsize size;
+	int fd;
+	gpointer virt_addr;
+}
+GstImxHostEmuBlock;
+
+
+typedef struct
+{
+	guintptr start, end;
+}
+GstImxHostEmuAddrRange;
+
+
+static void gst_imx_host_emu_allocator_finalize(GObject *object);
+
+static gboolean gst_imx_host_emu_alloc_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, gssize size);
+static gboolean gst_imx_host_emu_free_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory);
+static gpointer gst_imx_host_emu_map_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, gssize size, GstMapFlags flags);
+static void gst_imx_host_emu_unmap_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory);
+static int gst_imx_host_emu_export_dmabuf(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory);
+
+static gint gst_imx_host_emu_compare_blocks(gconstpointer a, gconstpointer b);
+static gint gst_imx_host_emu_search_range(gconstpointer key, gconstpointer user_data);
+static GstImxHostEmuBlock* gst_imx_host_emu_find_block(GstImxHostEmuAllocator *emu_allocator, guintptr start, guintptr end);
+static gboolean gst_imx_host_emu_reserve_phys_addr(GstImxHostEmuAllocator *emu_allocator, gsize size, guintptr *phys_addr);
+
+
+G_DEFINE_TYPE(GstImxHostEmuAllocator, gst_imx_host_emu_allocator, GST_TYPE_IMX_PHYS_MEM_ALLOCATOR)
+
+
+
+
+static void gst_imx_host_emu_mem_init(void)
+{
+	GstAllocator *allocator = g_object_new(gst_imx_host_emu_allocator_get_type(), NULL);
+	gst_allocator_register(GST_IMX_HOST_EMU_ALLOCATOR_MEM_TYPE, allocator);
+}
+
+
+GstAllocator* gst_imx_host_emu_allocator_obtain(void)
+{
+	static GOnce host_emu_allocator_once = G_ONCE_INIT;
+	GstAllocator *allocator;
+
+	g_once(&host_emu_allocator_once, (GThreadFunc)gst_imx_host_emu_mem_init, NULL);
+
+	allocator = gst_allocator_find(GST_IMX_HOST_EMU_ALLOCATOR_MEM_TYPE);
+	if (allocator == NULL)
+		GST_WARNING("No allocator named %s found", GST_IMX_HOST_EMU_ALLOCATOR_MEM_TYPE);
+
+	return allocator;
+}
+
+
+gpointer gst_imx_host_emu_allocator_lookup_virt_addr(GstImxHostEmuAllocator *allocator, guintptr phys_addr)
+{
+	GstImxHostEmuBlock *block;
+	gpointer virt_addr = NULL;
+
+	g_mutex_lock(&(allocator->mutex));
+
+	block = gst_imx_host_emu_find_block(allocator, phys_addr, phys_addr + 1);
+	if (block != NULL)
+		virt_addr = (guint8 *)(block->virt_addr) + (phys_addr - block->phys_addr);
+
+	g_mutex_unlock(&(allocator->mutex));
+
+	return virt_addr;
+}
+
+
+static gboolean gst_imx_host_emu_alloc_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, gssize size)
+{
+	GstImxHostEmuAllocator *emu_allocator = GST_IMX_HOST_EMU_ALLOCATOR(allocator);
+	GstImxHostEmuBlock *block;
+	guintptr phys_addr;
+	gpointer virt_addr;
+	int fd;
+
+	fd = memfd_create("gstimx-host-emu", MFD_CLOEXEC);
+	if (fd < 0)
+	{
+		GST_ERROR_OBJECT(allocator, "could not create memfd: %s", strerror(errno));
+		return FALSE;
+	}
+
+	if (ftruncate(fd, size) < 0)
+	{
+		GST_ERROR_OBJECT(allocator, "could not resize memfd to %" G_GSSIZE_FORMAT " bytes: %s", size, strerror(errno));
+		close(fd);
+		return FALSE;
+	}
+
+	/* Map the block right away, just like the VPU allocators do; this way,
+	 * the reverse lookup can always return a valid CPU address */
+	virt_addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (virt_addr == MAP_FAILED)
+	{
+		GST_ERROR_OBJECT(allocator, "could not map memfd: %s", strerror(errno));
+		close(fd);
+		return FALSE;
+	}
+
+	g_mutex_lock(&(emu_allocator->mutex));
+
+	if (!gst_imx_host_emu_reserve_phys_addr(emu_allocator, size, &phys_addr))
+	{
+		g_mutex_unlock(&(emu_allocator->mutex));
+		GST_ERROR_OBJECT(allocator, "emulated physical address space exhausted; could not allocate %" G_GSSIZE_FORMAT " bytes", size);
+		munmap(virt_addr, size);
+		close(fd);
+		return FALSE;
+	}
+
+	block = g_slice_alloc(sizeof(GstImxHostEmuBlock));
+	block->phys_addr = phys_addr;
+	block->size = size;
+	block->fd = fd;
+	block->virt_addr = virt_addr;
+	g_tree_insert(emu_allocator->blocks, block, block);
+
+	g_mutex_unlock(&(emu_allocator->mutex));
+
+	memory->mapped_virt_addr = virt_addr;
+	memory->phys_addr = phys_addr;
+	memory->cpu_addr = (guintptr)virt_addr;
+
+	GST_DEBUG_OBJECT(allocator, "allocated %" G_GSSIZE_FORMAT " bytes of emulated physical memory at phys addr %p virt addr %p", size, (gpointer)phys_addr, virt_addr);
+
+	return TRUE;
+}
+
+
+static gboolean gst_imx_host_emu_free_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory)
+{
+	GstImxHostEmuAllocator *emu_allocator = GST_IMX_HOST_EMU_ALLOCATOR(allocator);
+	GstImxHostEmuBlock *block;
+
+	g_mutex_lock(&(emu_allocator->mutex));
+
+	block = gst_imx_host_emu_find_block(emu_allocator, memory->phys_addr, memory->phys_addr + 1);
+	if ((block == NULL) || (block->phys_addr != memory->phys_addr))
+	{
+		g_mutex_unlock(&(emu_allocator->mutex));
+		GST_ERROR_OBJECT(allocator, "phys addr %p does not refer to an allocated block", (gpointer)(memory->phys_addr));
+		return FALSE;
+	}
+
+	g_tree_remove(emu_allocator->blocks, block);
+
+	g_mutex_unlock(&(emu_allocator->mutex));
+
+	close(block->fd);
+
+	GST_DEBUG_OBJECT(allocator, "freed %" G_GSIZE_FORMAT " bytes of emulated physical memory at phys addr %p", block->size, (gpointer)(block->phys_addr));
+
+	g_slice_free1(sizeof(GstImxHostEmuBlock), block);
+
+	return TRUE;
+}
+
+
+static gpointer gst_imx_host_emu_map_phys_mem(G_GNUC_UNUSED GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, G_GNUC_UNUSED gssize size, G_GNUC_UNUSED GstMapFlags flags)
+{
+	/* Blocks are mapped read/write at allocation time */
+	return memory->mapped_virt_addr;
+}
+
+
+static void gst_imx_host_emu_unmap_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory)
+{
+	if (memory->mapped_virt_addr != NULL)
+	{
+		if (munmap(memory->mapped_virt_addr, memory->mem.maxsize) == -1)
+			GST_ERROR_OBJECT(allocator, "unmapping memfd failed: %s", strerror(errno));
+		memory->mapped_virt_addr = NULL;
+	}
+}
+
+
+static int gst_imx_host_emu_export_dmabuf(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory)
+{
+	GstImxHostEmuAllocator *emu_allocator = GST_IMX_HOST_EMU_ALLOCATOR(allocator);
+	GstImxHostEmuBlock *block;
+	int fd = -1;
+
+	/* memfds are not DMABUFs, but behave the same way as far as
+	 * mmap() and fd passing are concerned, which is sufficient
+	 * for emulating zero-copy paths */
+	g_mutex_lock(&(emu_allocator->mutex));
+
+	block = gst_imx_host_emu_find_block(emu_allocator, memory->phys_addr, memory->phys_addr + 1);
+	if (block != NULL)
+	{
+		fd = dup(block->fd);
+		if (fd < 0)
+			GST_ERROR_OBJECT(allocator, "could not duplicate memfd: %s", strerror(errno));
+	}
+
+	g_mutex_unlock(&(emu_allocator->mutex));
+
+	return fd;
+}
+
+
+static gint gst_imx_host_emu_compare_blocks(gconstpointer a, gconstpointer b)
+{
+	guintptr addr_a = ((GstImxHostEmuBlock const *)a)->phys_addr;
+	guintptr addr_b = ((GstImxHostEmuBlock const *)b)->phys_addr;
+	return (addr_a < addr_b) ? -1 : ((addr_a > addr_b) ? 1 : 0);
+}
+
+
+static gint gst_imx_host_emu_search_range(gconstpointer key, gconstpointer user_data)
+{
+	GstImxHostEmuBlock const *block = (GstImxHostEmuBlock const *)key;
+	GstImxHostEmuAddrRange const *range = (GstImxHostEmuAddrRange const *)user_data;
+
+	/* the blocks never overlap, so the first one that
+	 * intersects with the range is the one to return */
+	if ((block->phys_addr + block->size) <= range->start)
+		return 1;
+	else if (block->phys_addr >= range->end)
+		return -1;
+	else
+		return 0;
+}
+
+
+/* Must be called with the mutex locked */
+static GstImxHostEmuBlock* gst_imx_host_emu_find_block(GstImxHostEmuAllocator *emu_allocator, guintptr start, guintptr end)
+{
+	GstImxHostEmuAddrRange range = { start, end };
+	return g_tree_search(emu_allocator->blocks, gst_imx_host_emu_search_range, &range);
+}
+
+
+/* Must be called with the mutex locked */
+static gboolean gst_imx_host_emu_reserve_phys_addr(GstImxHostEmuAllocator *emu_allocator, gsize size, guintptr *phys_addr)
+{
+	guintptr candidate = emu_allocator->next_phys_addr;
+	/* a guard page is placed after each block, to make
+	 * out-of-bounds accesses by address easier to spot */
+	gsize reserved_size = ALIGN_VAL_TO(size, EMU_PAGE_SIZE) + EMU_PAGE_SIZE;
+	gboolean wrapped_around = FALSE;
+
+	if (reserved_size > (EMU_PHYS_ADDR_END - EMU_PHYS_ADDR_START))
+		return FALSE;
+
+	/* Addresses are handed out in increasing order, so an address is not
+	 * reused soon after its block was freed; once the end of the address
+	 * space is reached, the search wraps around and skips occupied ranges */
+	while (TRUE)
+	{
+		GstImxHostEmuBlock *block;
+
+		if ((candidate + reserved_size) > EMU_PHYS_ADDR_END)
+		{
+			if (wrapped_around)
+				return FALSE;
+			candidate = EMU_PHYS_ADDR_START;
+			wrapped_around = TRUE;
+		}
+
+		block = gst_imx_host_emu_find_block(emu_allocator, candidate, candidate + reserved_size);
+		if (block == NULL)
+			break;
+
+		candidate = ALIGN_VAL_TO(block->phys_addr + block->size, EMU_PAGE_SIZE) + EMU_PAGE_SIZE;
+	}
+
+	*phys_addr = candidate;
+	emu_allocator->next_phys_addr = candidate + reserved_size;
+
+	return TRUE;
+}
+
+
+
+
+static void gst_imx_host_emu_allocator_class_init(GstImxHostEmuAllocatorClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS(klass);
+	GstImxPhysMemAllocatorClass *parent_class = GST_IMX_PHYS_MEM_ALLOCATOR_CLASS(klass);
+
+	object_class->finalize       = GST_DEBUG_FUNCPTR(gst_imx_host_emu_allocator_finalize);
+	parent_class->alloc_phys_mem = GST_DEBUG_FUNCPTR(gst_imx_host_emu_alloc_phys_mem);
+	parent_class->free_phys_mem  = GST_DEBUG_FUNCPTR(gst_imx_host_emu_free_phys_mem);
+	parent_class->map_phys_mem   = GST_DEBUG_FUNCPTR(gst_imx_host_emu_map_phys_mem);
+	parent_class->unmap_phys_mem = GST_DEBUG_FUNCPTR(gst_imx_host_emu_unmap_phys_mem);
+	parent_class->export_dmabuf  = GST_DEBUG_FUNCPTR(gst_imx_host_emu_export_dmabuf);
+	/* memfd mappings are ordinary cached host memory, and coherent
+	 * since there is no real hardware accessing them; all modes are
+	 * accepted so elements can exercise their cache mode code paths */
+	parent_class->supported_cache_modes =
+		GST_IMX_PHYS_MEM_CACHE_MODE_BIT(GST_IMX_PHYS_MEM_CACHE_MODE_UNCACHED) |
+		GST_IMX_PHYS_MEM_CACHE_MODE_BIT(GST_IMX_PHYS_MEM_CACHE_MODE_WRITE_COMBINE) |
+		GST_IMX_PHYS_MEM_CACHE_MODE_BIT(GST_IMX_PHYS_MEM_CACHE_MODE_CACHED);
+	parent_class->native_cache_mode     = GST_IMX_PHYS_MEM_CACHE_MODE_CACHED;
+
+	GST_DEBUG_CATEGORY_INIT(imx_host_emu_allocator_debug, "imxhostemuallocator", 0, "Host emulation allocator for physically contiguous memory");
+}
+
+
+static void gst_imx_host_emu_allocator_init(GstImxHostEmuAllocator *allocator)
+{
+	GstAllocator *base = GST_ALLOCATOR(allocator);
+	base->mem_type = GST_IMX_HOST_EMU_ALLOCATOR_MEM_TYPE;
+
+	g_mutex_init(&(allocator->mutex));
+	allocator->blocks = g_tree_new(gst_imx_host_emu_compare_blocks);
+	allocator->next_phys_addr = EMU_PHYS_ADDR_START;
+}
+
+
+static void gst_imx_host_emu_allocator_finalize(GObject *object)
+{
+	GstImxHostEmuAllocator *emu_allocator = GST_IMX_HOST_EMU_ALLOCATOR(object);
+
+	GST_DEBUG_OBJECT(object, "shutting down host emulation allocator");
+
+	/* Chain up first, since the base class frees recycled blocks
+	 * during finalization, which requires the lookup table */
+	G_OBJECT_CLASS(gst_imx_host_emu_allocator_parent_class)->finalize(object);
+
+	if (g_tree_nnodes(emu_allocator->blocks) > 0)
+		GST_WARNING("%d emulated physical memory block(s) still allocated", g_tree_nnodes(emu_allocator->blocks));
+
+	g_tree_destroy(emu_allocator->blocks);
+	g_mutex_clear(&(emu_allocator->mutex));
+}
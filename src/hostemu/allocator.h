@@ -0,0 +1,79 @@
+/* Host emulation allocator, for running without i.MX hardware
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#ifndef GST_IMX_HOST_EMU_ALLOCATOR_H
+#define GST_IMX_HOST_EMU_ALLOCATOR_H
+
+#include <glib.h>
+#include "../common/phys_mem_allocator.h"
+
+
+G_BEGIN_DECLS
+
+
+typedef struct _GstImxHostEmuAllocator GstImxHostEmuAllocator;
+typedef struct _GstImxHostEmuAllocatorClass GstImxHostEmuAllocatorClass;
+
+
+#define GST_TYPE_IMX_HOST_EMU_ALLOCATOR             (gst_imx_host_emu_allocator_get_type())
+#define GST_IMX_HOST_EMU_ALLOCATOR(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_IMX_HOST_EMU_ALLOCATOR, GstImxHostEmuAllocator))
+#define GST_IMX_HOST_EMU_ALLOCATOR_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_IMX_HOST_EMU_ALLOCATOR, GstImxHostEmuAllocatorClass))
+#define GST_IS_IMX_HOST_EMU_ALLOCATOR(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_IMX_HOST_EMU_ALLOCATOR))
+#define GST_IS_IMX_HOST_EMU_ALLOCATOR_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_IMX_HOST_EMU_ALLOCATOR))
+
+#define GST_IMX_HOST_EMU_ALLOCATOR_MEM_TYPE "ImxHostEmuMemory"
+
+
+/* This allocator emulates physically contiguous memory on plain Linux hosts.
+ * Each block is backed by a memfd, which is mapped into the process' address
+ * space. Instead of real physical addresses, the blocks get fake, but stable
+ * addresses from an emulated physical address space; a reverse lookup table
+ * maps these addresses back to the CPU mappings, which allows for emulating
+ * hardware that accesses memory by physical address. */
+struct _GstImxHostEmuAllocator
+{
+	GstImxPhysMemAllocator parent;
+
+	/* protects blocks and next_phys_addr */
+	GMutex mutex;
+	/* reverse lookup table; maps the emulated physical address ranges to blocks */
+	GTree *blocks;
+	guintptr next_phys_addr;
+};
+
+
+struct _GstImxHostEmuAllocatorClass
+{
+	GstImxPhysMemAllocatorClass parent_class;
+};
+
+
+GType gst_imx_host_emu_allocator_get_type(void);
+GstAllocator* gst_imx_host_emu_allocator_obtain(void);
+
+/* Returns the CPU address corresponding to the given emulated physical address,
+ * or NULL if the address does not lie within any allocated block. phys_addr
+ * may point anywhere inside a block. */
+gpointer gst_imx_host_emu_allocator_lookup_virt_addr(GstImxHostEmuAllocator *allocator, guintptr phys_addr);
+
+
+G_END_DECLS
+
+
+#endif
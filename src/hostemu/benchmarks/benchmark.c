@@ -0,0 +1,139 @@
+/* Common code for the host emulation benchmarks
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include <string.h>
+#include "benchmark.h"
+#include "../../common/phys_mem_buffer_pool.h"
+#include "../../common/phys_mem_meta.h"
+
+
+
+
+gboolean gst_imx_benchmark_init(int *argc, char **argv[], gchar const *description, GstImxBenchmarkSettings *settings)
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	gint width = 1920, height = 1080, num_iterations = 200;
+	gchar *format_str = NULL;
+	gboolean ret = TRUE;
+
+	GOptionEntry entries[] =
+	{
+		{ "width", 'w', 0, G_OPTION_ARG_INT, &width, "Frame width", NULL },
+		{ "height", 'h', 0, G_OPTION_ARG_INT, &height, "Frame height", NULL },
+		{ "format", 'f', 0, G_OPTION_ARG_STRING, &format_str, "Frame format (default: I420)", NULL },
+		{ "iterations", 'n', 0, G_OPTION_ARG_INT, &num_iterations, "Number of iterations per test", NULL },
+		{ NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
+	};
+
+	context = g_option_context_new(NULL);
+	g_option_context_set_summary(context, description);
+	g_option_context_add_main_entries(context, entries, NULL);
+	g_option_context_add_group(context, gst_init_get_option_group());
+
+	if (!g_option_context_parse(context, argc, argv, &error))
+	{
+		g_printerr("Invalid command line: %s\n", error->message);
+		g_error_free(error);
+		g_option_context_free(context);
+		return FALSE;
+	}
+
+	g_option_context_free(context);
+
+	settings->format = (format_str != NULL) ? gst_video_format_from_string(format_str) : GST_VIDEO_FORMAT_I420;
+	g_free(format_str);
+
+	if ((width <= 0) || (height <= 0) || (num_iterations <= 0))
+	{
+		g_printerr("Width, height, and number of iterations must be greater than zero\n");
+		ret = FALSE;
+	}
+	else if (settings->format == GST_VIDEO_FORMAT_UNKNOWN)
+	{
+		g_printerr("Unknown frame format\n");
+		ret = FALSE;
+	}
+	else
+	{
+		settings->width = width;
+		settings->height = height;
+		settings->num_iterations = num_iterations;
+		gst_video_info_set_format(&(settings->video_info), settings->format, width, height);
+
+		g_print("%s\nframe: %ux%u %s, %" G_GSIZE_FORMAT " bytes; %u iterations per test\n\n", description, width, height, gst_video_format_to_string(settings->format), settings->video_info.size, num_iterations);
+	}
+
+	return ret;
+}
+
+
+GstBufferPool* gst_imx_benchmark_create_bufferpool(GstAllocator *allocator, GstVideoInfo const *info, guint min_buffers, guint max_buffers)
+{
+	GstBufferPool *pool;
+	GstStructure *config;
+	GstCaps *caps;
+
+	caps = gst_video_info_to_caps((GstVideoInfo *)info);
+
+	pool = gst_imx_phys_mem_buffer_pool_new(FALSE);
+	config = gst_buffer_pool_get_config(pool);
+	gst_buffer_pool_config_set_params(config, caps, info->size, min_buffers, max_buffers);
+	gst_buffer_pool_config_set_allocator(config, allocator, NULL);
+	gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_IMX_PHYS_MEM);
+	gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+	gst_buffer_pool_set_config(pool, config);
+
+	gst_caps_unref(caps);
+
+	return pool;
+}
+
+
+GstBuffer* gst_imx_benchmark_create_sysmem_frame(GstVideoInfo const *info)
+{
+	GstBuffer *buffer;
+	GstMapInfo map_info;
+	gsize i;
+
+	buffer = gst_buffer_new_allocate(NULL, info->size, NULL);
+	gst_buffer_add_video_meta_full(buffer, GST_VIDEO_FRAME_FLAG_NONE, GST_VIDEO_INFO_FORMAT(info), GST_VIDEO_INFO_WIDTH(info), GST_VIDEO_INFO_HEIGHT(info), GST_VIDEO_INFO_N_PLANES(info), (gsize *)(info->offset), (gint *)(info->stride));
+
+	/* Touch all pages, so that page faults do not distort the measurements */
+	gst_buffer_map(buffer, &map_info, GST_MAP_WRITE);
+	for (i = 0; i < map_info.size; ++i)
+		map_info.data[i] = i & 0xFF;
+	gst_buffer_unmap(buffer, &map_info);
+
+	return buffer;
+}
+
+
+void gst_imx_benchmark_print_result(gchar const *name, guint num_iterations, gsize num_bytes, gint64 duration)
+{
+	gdouble usecs_per_iteration = (gdouble)duration / num_iterations;
+
+	if (num_bytes != 0)
+	{
+		gdouble mbytes_per_sec = (duration > 0) ? ((gdouble)num_bytes * num_iterations / duration) : 0.0;
+		g_print("%-48s %10.1f us/iteration  %8.1f MB/s\n", name, usecs_per_iteration, mbytes_per_sec);
+	}
+	else
+		g_print("%-48s %10.1f us/iteration\n", name, usecs_per_iteration);
+}
@@ -0,0 +1,59 @@
+/* Common code for the host emulation benchmarks
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#ifndef GST_IMX_BENCHMARK_H
+#define GST_IMX_BENCHMARK_H
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+
+G_BEGIN_DECLS
+
+
+/* Settings shared by all benchmarks; they can be changed with command line options */
+typedef struct
+{
+	guint width, height;
+	GstVideoFormat format;
+	guint num_iterations;
+	GstVideoInfo video_info;
+}
+GstImxBenchmarkSettings;
+
+
+/* Initializes GStreamer and parses the command line. Returns FALSE if the
+ * command line is invalid; in that case, an error message has been printed. */
+gboolean gst_imx_benchmark_init(int *argc, char **argv[], gchar const *description, GstImxBenchmarkSettings *settings);
+
+/* Creates a physical memory buffer pool with the given allocator, configured for
+ * the frames described by info. The pool is not activated. */
+GstBufferPool* gst_imx_benchmark_create_bufferpool(GstAllocator *allocator, GstVideoInfo const *info, guint min_buffers, guint max_buffers);
+/* Allocates a buffer in regular system memory, filled with a test pattern */
+GstBuffer* gst_imx_benchmark_create_sysmem_frame(GstVideoInfo const *info);
+
+/* Prints the duration per iteration; if num_bytes is nonzero, the throughput
+ * is printed as well. duration is given in microseconds. */
+void gst_imx_benchmark_print_result(gchar const *name, guint num_iterations, gsize num_bytes, gint64 duration);
+
+
+G_END_DECLS
+
+
+#endif
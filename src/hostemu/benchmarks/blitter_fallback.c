@@ -0,0 +1,110 @@
+/* Blitter CPU copy fallback benchmark
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include "benchmark.h"
+#include "../allocator.h"
+
+
+/* Measures the cost of the blitter's CPU copy fallback, which is used when the
+ * input frames are not in physically contiguous memory: for each frame, a buffer
+ * is acquired from the blitter's internal pool, and the pixels are copied into it.
+ * The blitter itself cannot run without i.MX hardware, so only the copy path is
+ * measured; the result is compared with input frames that are already physically
+ * contiguous, which the blitter uses directly. */
+
+
+
+
+static void bench_copy_fallback(GstAllocator *allocator, GstImxBenchmarkSettings *settings)
+{
+	GstBufferPool *pool;
+	GstBuffer *input_buffer, *temp_input_buffer;
+	GstVideoFrame input_frame, temp_input_frame;
+	gint64 start_time;
+	guint i;
+
+	/* Same pool parameters as the blitter's internal pool */
+	pool = gst_imx_benchmark_create_bufferpool(allocator, &(settings->video_info), 2, 0);
+	gst_buffer_pool_set_active(pool, TRUE);
+	input_buffer = gst_imx_benchmark_create_sysmem_frame(&(settings->video_info));
+
+	start_time = g_get_monotonic_time();
+	for (i = 0; i < settings->num_iterations; ++i)
+	{
+		gst_buffer_pool_acquire_buffer(pool, &temp_input_buffer, NULL);
+
+		gst_video_frame_map(&input_frame, &(settings->video_info), input_buffer, GST_MAP_READ);
+		gst_video_frame_map(&temp_input_frame, &(settings->video_info), temp_input_buffer, GST_MAP_WRITE);
+		gst_video_frame_copy(&temp_input_frame, &input_frame);
+		gst_video_frame_unmap(&temp_input_frame);
+		gst_video_frame_unmap(&input_frame);
+
+		gst_buffer_unref(temp_input_buffer);
+	}
+	gst_imx_benchmark_print_result("system memory input, CPU copy fallback", settings->num_iterations, settings->video_info.size, g_get_monotonic_time() - start_time);
+
+	gst_buffer_unref(input_buffer);
+	gst_buffer_pool_set_active(pool, FALSE);
+	gst_object_unref(GST_OBJECT(pool));
+}
+
+
+static void bench_phys_mem_input(GstAllocator *allocator, GstImxBenchmarkSettings *settings)
+{
+	GstBufferPool *pool;
+	GstBuffer *input_buffer;
+	gint64 start_time;
+	guint i;
+
+	/* Upstream allocates from a physical memory pool; the blitter only has to
+	 * look up the physical address */
+	pool = gst_imx_benchmark_create_bufferpool(allocator, &(settings->video_info), 2, 0);
+	gst_buffer_pool_set_active(pool, TRUE);
+
+	start_time = g_get_monotonic_time();
+	for (i = 0; i < settings->num_iterations; ++i)
+	{
+		gst_buffer_pool_acquire_buffer(pool, &input_buffer, NULL);
+		gst_imx_phys_memory_get_phys_addr(gst_buffer_peek_memory(input_buffer, 0));
+		gst_buffer_unref(input_buffer);
+	}
+	gst_imx_benchmark_print_result("physical memory input, no copy", settings->num_iterations, settings->video_info.size, g_get_monotonic_time() - start_time);
+
+	gst_buffer_pool_set_active(pool, FALSE);
+	gst_object_unref(GST_OBJECT(pool));
+}
+
+
+int main(int argc, char *argv[])
+{
+	GstImxBenchmarkSettings settings;
+	GstAllocator *allocator;
+
+	if (!gst_imx_benchmark_init(&argc, &argv, "blitter CPU copy fallback", &settings))
+		return -1;
+
+	allocator = gst_imx_host_emu_allocator_obtain();
+
+	bench_copy_fallback(allocator, &settings);
+	bench_phys_mem_input(allocator, &settings);
+
+	gst_object_unref(GST_OBJECT(allocator));
+
+	return 0;
+}
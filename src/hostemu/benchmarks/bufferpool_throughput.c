@@ -0,0 +1,130 @@
+/* Physical memory buffer pool throughput benchmark
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include "benchmark.h"
+#include "../allocator.h"
+
+
+/* Measures how fast physical memory buffers can be obtained, both through the
+ * buffer pool and directly from the allocator. The tests that allocate new
+ * memory are run with and without the allocator's block recycler. */
+
+
+/* Number of buffers held at the same time, similar to a decoder's output queue */
+#define PIPELINE_DEPTH 4
+/* Recycler budget for the runs with the recycler; the recycler is disabled by default */
+#define RECYCLER_MAX_BYTES (32 * 1024 * 1024)
+
+
+
+
+static void bench_pool_cycle(GstAllocator *allocator, GstImxBenchmarkSettings *settings)
+{
+	GstBufferPool *pool;
+	GstBuffer *buffers[PIPELINE_DEPTH];
+	gint64 start_time;
+	guint i, j;
+
+	pool = gst_imx_benchmark_create_bufferpool(allocator, &(settings->video_info), PIPELINE_DEPTH, 0);
+	gst_buffer_pool_set_active(pool, TRUE);
+
+	start_time = g_get_monotonic_time();
+	for (i = 0; i < settings->num_iterations; ++i)
+	{
+		for (j = 0; j < PIPELINE_DEPTH; ++j)
+			gst_buffer_pool_acquire_buffer(pool, &(buffers[j]), NULL);
+		for (j = 0; j < PIPELINE_DEPTH; ++j)
+			gst_buffer_unref(buffers[j]);
+	}
+	gst_imx_benchmark_print_result("pool acquire/release (" G_STRINGIFY(PIPELINE_DEPTH) " buffers)", settings->num_iterations, 0, g_get_monotonic_time() - start_time);
+
+	gst_buffer_pool_set_active(pool, FALSE);
+	gst_object_unref(GST_OBJECT(pool));
+}
+
+
+static void bench_pool_restart(GstAllocator *allocator, GstImxBenchmarkSettings *settings, gchar const *name)
+{
+	GstBufferPool *pool;
+	GstBuffer *buffer;
+	gint64 start_time;
+	guint i;
+
+	/* Emulates pipelines which are restarted or renegotiated: each iteration
+	 * creates a pool, preallocates its buffers, and shuts it down again */
+	start_time = g_get_monotonic_time();
+	for (i = 0; i < settings->num_iterations; ++i)
+	{
+		pool = gst_imx_benchmark_create_bufferpool(allocator, &(settings->video_info), PIPELINE_DEPTH, 0);
+		gst_buffer_pool_set_active(pool, TRUE);
+		gst_buffer_pool_acquire_buffer(pool, &buffer, NULL);
+		gst_buffer_unref(buffer);
+		gst_buffer_pool_set_active(pool, FALSE);
+		gst_object_unref(GST_OBJECT(pool));
+	}
+	gst_imx_benchmark_print_result(name, settings->num_iterations, 0, g_get_monotonic_time() - start_time);
+}
+
+
+static void bench_allocator(GstAllocator *allocator, GstImxBenchmarkSettings *settings, gchar const *name)
+{
+	GstMemory *memory;
+	gint64 start_time;
+	guint i;
+
+	start_time = g_get_monotonic_time();
+	for (i = 0; i < settings->num_iterations; ++i)
+	{
+		memory = gst_allocator_alloc(allocator, settings->video_info.size, NULL);
+		gst_memory_unref(memory);
+	}
+	gst_imx_benchmark_print_result(name, settings->num_iterations, 0, g_get_monotonic_time() - start_time);
+}
+
+
+int main(int argc, char *argv[])
+{
+	GstImxBenchmarkSettings settings;
+	GstAllocator *allocator;
+	GstImxPhysMemAllocator *phys_mem_allocator;
+	guint64 hits, misses;
+
+	if (!gst_imx_benchmark_init(&argc, &argv, "physical memory buffer pool throughput", &settings))
+		return -1;
+
+	allocator = gst_imx_host_emu_allocator_obtain();
+	phys_mem_allocator = GST_IMX_PHYS_MEM_ALLOCATOR(allocator);
+
+	bench_pool_cycle(allocator, &settings);
+
+	gst_imx_phys_mem_allocator_set_recycler_params(phys_mem_allocator, 0, 0);
+	bench_pool_restart(allocator, &settings, "pool restart, recycler disabled");
+	bench_allocator(allocator, &settings, "allocator alloc/free, recycler disabled");
+
+	gst_imx_phys_mem_allocator_set_recycler_params(phys_mem_allocator, RECYCLER_MAX_BYTES, GST_CLOCK_TIME_NONE);
+	bench_pool_restart(allocator, &settings, "pool restart, recycler enabled");
+	bench_allocator(allocator, &settings, "allocator alloc/free, recycler enabled");
+
+	gst_imx_phys_mem_allocator_get_recycler_stats(phys_mem_allocator, &hits, &misses, NULL, NULL);
+	g_print("\nrecycler: %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses\n", hits, misses);
+
+	gst_object_unref(GST_OBJECT(allocator));
+
+	return 0;
+}
@@ -0,0 +1,131 @@
+/* VPU encoder input frame copy benchmark
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include "benchmark.h"
+#include "../allocator.h"
+#include "../../common/phys_mem_buffer_pool.h"
+
+
+/* Measures the cost of the VPU encoder's input path. If the incoming frames are
+ * not physically contiguous, the encoder copies them into its internal input
+ * buffer, whose frame layout is aligned to the VPU's requirements. Either way,
+ * the input buffer's cache is flushed before the VPU reads it. */
+
+
+/* Same values as GST_IMX_VPU_ENC_WIDTH_ALIGNMENT and GST_IMX_VPU_ENC_HEIGHT_ALIGNMENT;
+ * the VPU headers are not available without i.MX hardware */
+#define ENC_WIDTH_ALIGNMENT 16
+#define ENC_HEIGHT_ALIGNMENT 16
+
+
+
+
+static GstBufferPool* create_internal_bufferpool(GstAllocator *allocator, GstImxBenchmarkSettings *settings)
+{
+	GstBufferPool *pool;
+	GstStructure *config;
+	GstVideoAlignment align;
+
+	pool = gst_imx_benchmark_create_bufferpool(allocator, &(settings->video_info), 2, 0);
+
+	config = gst_buffer_pool_get_config(pool);
+	gst_imx_phys_mem_buffer_pool_video_alignment_init(&align, &(settings->video_info), ENC_WIDTH_ALIGNMENT, ENC_HEIGHT_ALIGNMENT, 0);
+	gst_imx_phys_mem_buffer_pool_config_set_video_alignment(config, &align);
+	gst_buffer_pool_set_config(pool, config);
+
+	gst_buffer_pool_set_active(pool, TRUE);
+
+	return pool;
+}
+
+
+static void bench_input_copy(GstAllocator *allocator, GstImxBenchmarkSettings *settings)
+{
+	GstBufferPool *pool;
+	GstBuffer *incoming_buffer, *internal_input_buffer;
+	GstVideoFrame incoming_frame, input_frame;
+	gint64 start_time;
+	guint i;
+
+	pool = create_internal_bufferpool(allocator, settings);
+	gst_buffer_pool_acquire_buffer(pool, &internal_input_buffer, NULL);
+	incoming_buffer = gst_imx_benchmark_create_sysmem_frame(&(settings->video_info));
+
+	start_time = g_get_monotonic_time();
+	for (i = 0; i < settings->num_iterations; ++i)
+	{
+		gst_video_frame_map(&incoming_frame, &(settings->video_info), incoming_buffer, GST_MAP_READ);
+		gst_video_frame_map(&input_frame, &(settings->video_info), internal_input_buffer, GST_MAP_WRITE);
+		gst_video_frame_copy(&input_frame, &incoming_frame);
+		gst_video_frame_unmap(&incoming_frame);
+		gst_video_frame_unmap(&input_frame);
+
+		gst_imx_phys_mem_buffer_flush(internal_input_buffer);
+	}
+	gst_imx_benchmark_print_result("system memory input, copy to internal buffer", settings->num_iterations, settings->video_info.size, g_get_monotonic_time() - start_time);
+
+	gst_buffer_unref(incoming_buffer);
+	gst_buffer_unref(internal_input_buffer);
+	gst_buffer_pool_set_active(pool, FALSE);
+	gst_object_unref(GST_OBJECT(pool));
+}
+
+
+static void bench_phys_mem_input(GstAllocator *allocator, GstImxBenchmarkSettings *settings)
+{
+	GstBufferPool *pool;
+	GstBuffer *incoming_buffer;
+	gint64 start_time;
+	guint i;
+
+	/* Upstream allocates from a pool with the encoder's alignment, so the
+	 * frames can be passed to the VPU directly */
+	pool = create_internal_bufferpool(allocator, settings);
+
+	start_time = g_get_monotonic_time();
+	for (i = 0; i < settings->num_iterations; ++i)
+	{
+		gst_buffer_pool_acquire_buffer(pool, &incoming_buffer, NULL);
+		gst_imx_phys_mem_buffer_flush(incoming_buffer);
+		gst_buffer_unref(incoming_buffer);
+	}
+	gst_imx_benchmark_print_result("physical memory input, no copy", settings->num_iterations, settings->video_info.size, g_get_monotonic_time() - start_time);
+
+	gst_buffer_pool_set_active(pool, FALSE);
+	gst_object_unref(GST_OBJECT(pool));
+}
+
+
+int main(int argc, char *argv[])
+{
+	GstImxBenchmarkSettings settings;
+	GstAllocator *allocator;
+
+	if (!gst_imx_benchmark_init(&argc, &argv, "VPU encoder input frame copy", &settings))
+		return -1;
+
+	allocator = gst_imx_host_emu_allocator_obtain();
+
+	bench_input_copy(allocator, &settings);
+	bench_phys_mem_input(allocator, &settings);
+
+	gst_object_unref(GST_OBJECT(allocator));
+
+	return 0;
+}
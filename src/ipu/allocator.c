@@ -49,6 +49,7 @@ GstAllocator* gst_imx_ipu_allocator_new(int ipu_fd)
 	allocator = g_object_new(gst_imx_ipu_allocator_get_type(), NULL);
 
 	GST_IMX_IPU_ALLOCATOR(allocator)->fd = ipu_fd;
+	gst_imx_phys_mem_allocator_enable_default_recycler(GST_IMX_PHYS_MEM_ALLOCATOR(allocator));
 
 	return allocator;
 }
@@ -102,26 +103,43 @@ static gboolean gst_imx_ipu_free_phys_mem(GstImxPhysMemAllocator *allocator, Gst
 static gpointer gst_imx_ipu_map_phys_mem(GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, gssize size, GstMapFlags flags)
 {
 	int prot = 0;
+	int mmap_flags = MAP_SHARED;
+	gpointer virt_addr;
 	GstImxPhysMemory *phys_mem = (GstImxPhysMemory *)memory;
 	GstImxIpuAllocator *ipu_allocator = GST_IMX_IPU_ALLOCATOR(allocator);
 
-	// TODO: refcount for mapping
-	if (phys_mem->mapped_virt_addr != NULL)
-		return phys_mem->mapped_virt_addr;
+	/* The base class keeps the mapping alive and refcounts it; this function
+	 * is only called if no mapping exists yet or if the access flags of the
+	 * existing mapping have to be extended */
 
 	if (flags & GST_MAP_READ)
 		prot |= PROT_READ;
 	if (flags & GST_MAP_WRITE)
 		prot |= PROT_WRITE;
 
-	phys_mem->mapped_virt_addr = mmap(0, size, prot, MAP_SHARED, ipu_allocator->fd, (dma_addr_t)(phys_mem->phys_addr));
-	if (phys_mem->mapped_virt_addr == MAP_FAILED)
+	/* When upgrading, replace the existing mapping in-place, since
+	 * its address may still be in use */
+	if (phys_mem->mapped_virt_addr != NULL)
+		mmap_flags |= MAP_FIXED;
+
+	virt_addr = mmap(phys_mem->mapped_virt_addr, size, prot, mmap_flags, ipu_allocator->fd, (dma_addr_t)(phys_mem->phys_addr));
+	if (virt_addr == MAP_FAILED)
 	{
-		phys_mem->mapped_virt_addr = NULL;
 		GST_ERROR_OBJECT(ipu_allocator, "memory-mapping the IPU framebuffer failed: %s", strerror(errno));
+
+		/* A failed MAP_FIXED mmap() may already have removed the old mapping;
+		 * remove whatever is left of it, so it is not considered valid anymore */
+		if (phys_mem->mapped_virt_addr != NULL)
+		{
+			munmap(phys_mem->mapped_virt_addr, size);
+			phys_mem->mapped_virt_addr = NULL;
+		}
+
 		return NULL;
 	}
 
+	phys_mem->mapped_virt_addr = virt_addr;
+
 	return phys_mem->mapped_virt_addr;
 }
 
@@ -149,6 +167,9 @@ static void gst_imx_ipu_allocator_class_init(GstImxIpuAllocatorClass *klass)
 	parent_class->free_phys_mem  = GST_DEBUG_FUNCPTR(gst_imx_ipu_free_phys_mem);
 	parent_class->map_phys_mem   = GST_DEBUG_FUNCPTR(gst_imx_ipu_map_phys_mem);
 	parent_class->unmap_phys_mem = GST_DEBUG_FUNCPTR(gst_imx_ipu_unmap_phys_mem);
+	/* the IPU driver always maps its DMA buffers write-combined */
+	parent_class->supported_cache_modes = GST_IMX_PHYS_MEM_CACHE_MODE_BIT(GST_IMX_PHYS_MEM_CACHE_MODE_WRITE_COMBINE);
+	parent_class->native_cache_mode     = GST_IMX_PHYS_MEM_CACHE_MODE_WRITE_COMBINE;
 
 	GST_DEBUG_CATEGORY_INIT(imx_ipu_allocator_debug, "imxipuallocator", 0, "Freescale i.MX IPU physical memory/allocator");
 }
@@ -0,0 +1,104 @@
+/* IPU copy crossover benchmark
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <gst/gst.h>
+#include "../../common/phys_mem_copy.h"
+#include "../allocator.h"
+#include "../copy.h"
+
+
+/* Measures how long the CPU and the IPU take to copy blocks of various sizes
+ * between IPU-allocated physical memory, and prints the crossover point. The
+ * plugins use a fixed default copy threshold; the crossover point can be passed
+ * to them in the GST_IMX_PHYS_MEM_COPY_THRESHOLD environment variable. */
+
+
+#define MIN_SIZE (4 * 1024)
+#define MAX_SIZE (4 * 1024 * 1024)
+#define NUM_REPETITIONS 10
+
+
+
+
+int main(int argc, char *argv[])
+{
+	int ipu_fd;
+	GstAllocator *allocator;
+	GstMemory *src_mem, *dest_mem;
+	GstMapInfo src_map_info, dest_map_info;
+	guintptr src_phys_addr, dest_phys_addr;
+	gsize size, crossover;
+
+	gst_init(&argc, &argv);
+
+	gst_imx_ipu_copy_register_backend();
+
+	ipu_fd = open("/dev/mxc_ipu", O_RDWR, 0);
+	if (ipu_fd < 0)
+	{
+		g_printerr("could not open /dev/mxc_ipu: %s\n", strerror(errno));
+		return -1;
+	}
+
+	allocator = gst_imx_ipu_allocator_new(ipu_fd);
+	src_mem = gst_allocator_alloc(allocator, MAX_SIZE, NULL);
+	dest_mem = gst_allocator_alloc(allocator, MAX_SIZE, NULL);
+	if ((src_mem == NULL) || (dest_mem == NULL))
+	{
+		g_printerr("could not allocate physical memory\n");
+		return -1;
+	}
+
+	gst_memory_map(src_mem, &src_map_info, GST_MAP_READWRITE);
+	gst_memory_map(dest_mem, &dest_map_info, GST_MAP_READWRITE);
+	src_phys_addr = gst_imx_phys_memory_get_phys_addr(src_mem);
+	dest_phys_addr = gst_imx_phys_memory_get_phys_addr(dest_mem);
+	memset(src_map_info.data, 0x55, MAX_SIZE);
+
+	g_print("%10s %12s %12s\n", "size", "CPU (us)", "IPU (us)");
+	for (size = MIN_SIZE; size <= MAX_SIZE; size *= 2)
+	{
+		gint64 cpu_time, hw_time;
+
+		gst_imx_phys_mem_copy_measure(dest_phys_addr, dest_map_info.data, src_phys_addr, src_map_info.data, size, NUM_REPETITIONS, &cpu_time, &hw_time);
+		g_print("%10" G_GSIZE_FORMAT " %12" G_GINT64_FORMAT " %12" G_GINT64_FORMAT "%s\n", size, cpu_time, hw_time, (hw_time < cpu_time) ? "  *" : "");
+	}
+
+	crossover = gst_imx_phys_mem_copy_find_crossover(dest_phys_addr, dest_map_info.data, src_phys_addr, src_map_info.data);
+	if (crossover == 0)
+		g_print("\nthe IPU is slower than the CPU for all sizes up to %d bytes\n", GST_IMX_PHYS_MEM_COPY_CALIBRATION_MAX_SIZE);
+	else
+	{
+		g_print("\ncrossover point: %" G_GSIZE_FORMAT " bytes (default threshold: %d bytes)\n", crossover, GST_IMX_PHYS_MEM_COPY_DEFAULT_THRESHOLD);
+		g_print("to use it, set GST_IMX_PHYS_MEM_COPY_THRESHOLD=%" G_GSIZE_FORMAT "\n", crossover);
+	}
+
+	gst_memory_unmap(dest_mem, &dest_map_info);
+	gst_memory_unmap(src_mem, &src_map_info);
+	gst_memory_unref(dest_mem);
+	gst_memory_unref(src_mem);
+	gst_object_unref(GST_OBJECT(allocator));
+	close(ipu_fd);
+
+	return 0;
+}
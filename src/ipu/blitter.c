@@ -31,6 +31,7 @@
 #include <gst/video/gstvideometa.h>
 #include "../common/phys_mem_meta.h"
 #include "../common/phys_mem_buffer_pool.h"
+#include "../common/dmabuf_import.h"
 #include "allocator.h"
 
 
@@ -87,6 +88,8 @@ G_DEFINE_TYPE(GstImxIpuBlitter, gst_imx_ipu_blitter, GST_TYPE_OBJECT)
 struct _GstImxIpuBlitterPrivate
 {
 	int ipu_fd;
+	/* allocator for the blitter's buffer pools; NULL if the IPU could not be opened */
+	GstAllocator *allocator;
 	struct ipu_task task;
 };
 
@@ -105,6 +108,9 @@ static void gst_imx_ipu_blitter_finalize(GObject *object);
 static guint32 gst_imx_ipu_blitter_get_v4l_format(GstVideoFormat format);
 static GstVideoFormat gst_imx_ipu_blitter_get_format_from_fb(GstImxIpuBlitter *ipu_blitter, struct fb_var_screeninfo *fb_var, struct fb_fix_screeninfo *fb_fix);
 static int gst_imx_ipu_video_bpp(GstVideoFormat fmt);
+static gboolean gst_imx_ipu_blitter_fill_task_io(GstImxIpuBlitter *ipu_blitter, GstBuffer *buffer, unsigned int *width, unsigned int *height, struct ipu_crop *crop, dma_addr_t *paddr, unsigned int *format);
+static gboolean gst_imx_ipu_blitter_is_layout_supported(GstBuffer *buffer);
+static GstBuffer* gst_imx_ipu_blitter_import_dmabuf_buffer(GstImxIpuBlitter *ipu_blitter, GstBuffer *input_buffer);
 gboolean gst_imx_ipu_blitter_set_actual_input_buffer(GstImxIpuBlitter *ipu_blitter, GstBuffer *actual_input_buffer);
 
 
@@ -181,6 +187,7 @@ void gst_imx_ipu_blitter_class_init(GstImxIpuBlitterClass *klass)
 void gst_imx_ipu_blitter_init(GstImxIpuBlitter *ipu_blitter)
 {
 	ipu_blitter->priv = g_slice_alloc(sizeof(GstImxIpuBlitterPrivate));
+	ipu_blitter->priv->allocator = NULL;
 
 	/* This FD is necessary for using the IPU ioctls */
 	ipu_blitter->priv->ipu_fd = open("/dev/mxc_ipu", O_RDWR, 0);
@@ -190,6 +197,8 @@ void gst_imx_ipu_blitter_init(GstImxIpuBlitter *ipu_blitter)
 		return;
 	}
 
+	ipu_blitter->priv->allocator = gst_imx_ipu_allocator_new(ipu_blitter->priv->ipu_fd);
+
 	ipu_blitter->internal_bufferpool = NULL;
 	ipu_blitter->actual_input_buffer = NULL;
 	ipu_blitter->previous_input_buffer = NULL;
@@ -213,6 +222,14 @@ static void gst_imx_ipu_blitter_finalize(GObject *object)
 
 	if (ipu_blitter->priv != NULL)
 	{
+		if (ipu_blitter->priv->allocator != NULL)
+		{
+			/* The allocator can outlive the blitter if buffers still reference it.
+			 * Free its recycled blocks and disable its recycler while the IPU
+			 * device is still open, since freeing them requires the device. */
+			gst_imx_phys_mem_allocator_set_recycler_params(GST_IMX_PHYS_MEM_ALLOCATOR(ipu_blitter->priv->allocator), 0, GST_CLOCK_TIME_NONE);
+			gst_object_unref(GST_OBJECT(ipu_blitter->priv->allocator));
+		}
 		if (ipu_blitter->priv->ipu_fd >= 0)
 			close(ipu_blitter->priv->ipu_fd);
 		g_slice_free1(sizeof(GstImxIpuBlitterPrivate), ipu_blitter->priv);
@@ -418,7 +435,7 @@ static GstVideoFormat gst_imx_ipu_blitter_get_format_from_fb(GstImxIpuBlitter *i
 
 
 /* Determines the number of bytes per pixel used by the IPU for the given formats;
- * necessary for calculations in the GST_IMX_FILL_IPU_TASK macro */
+ * necessary for calculations in gst_imx_ipu_blitter_fill_task_io() */
 static int gst_imx_ipu_video_bpp(GstVideoFormat fmt)
 {
 	switch (fmt)
@@ -444,10 +461,8 @@ static int gst_imx_ipu_video_bpp(GstVideoFormat fmt)
 }
 
 
-/* Since the steps for setting input and output buffers are the same,
- * their code is put in a macro, to be able to use one generic version.
- * In C++, templates would allow for cleaner generic programming, but
- * we are using C here.
+/* Since the steps for setting input and output buffers are the same, one
+ * function fills in the fields shared by struct ipu_input and struct ipu_output.
  */
 /* Of special note is the IPU task width & height values. The IPU does not
  * allow for setting stride and padding values directly. In fact, it assumes
@@ -460,58 +475,146 @@ static int gst_imx_ipu_video_bpp(GstVideoFormat fmt)
  * metadata's coordinates.)
  * One limitation of this trick is that it assumes a specific video frame
  * layout. In particular, planes with nonstandard positions inside the buffer
- * are not supported. But this is circumvented by copying frames that do not
- * contain DMA buffers (frames that do are very unlikely to use such nonstandard
- * layouts).
+ * are not supported. Input frames with such layouts are copied like frames
+ * that do not contain DMA buffers (see gst_imx_ipu_blitter_is_layout_supported()).
  * Since the stride is given in bytes, not pixels, it needs to be divided by
  * whatever gst_imx_ipu_video_bpp() returns.
  */
-#define GST_IMX_FILL_IPU_TASK(ipu_blitter, buffer, taskio) \
-do { \
- \
-	guint num_extra_lines; \
-	GstVideoMeta *video_meta; \
-	GstVideoCropMeta *video_crop_meta; \
-	GstImxPhysMemMeta *phys_mem_meta; \
- \
-	video_meta = gst_buffer_get_video_meta(buffer); \
-	video_crop_meta = gst_buffer_get_video_crop_meta(buffer); \
-	phys_mem_meta = GST_IMX_PHYS_MEM_META_GET(buffer); \
- \
-	g_assert((video_meta != NULL) && (phys_mem_meta != NULL) && (phys_mem_meta->phys_addr != 0)); \
- \
-	num_extra_lines = phys_mem_meta->padding / video_meta->stride[0]; \
-	(taskio).width = video_meta->stride[0] / gst_imx_ipu_video_bpp(video_meta->format); \
-	(taskio).height = video_meta->height + num_extra_lines; \
- \
-	if (ipu_blitter->apply_crop_metadata && (video_crop_meta != NULL)) \
-	{ \
-		if ((video_crop_meta->x >= (guint)(video_meta->width)) || (video_crop_meta->y >= (guint)(video_meta->height))) \
-			return FALSE; \
- \
-		(taskio).crop.pos.x = video_crop_meta->x; \
-		(taskio).crop.pos.y = video_crop_meta->y; \
-		(taskio).crop.w = MIN(video_crop_meta->width, (taskio).width - video_crop_meta->x); \
-		(taskio).crop.h = MIN(video_crop_meta->height, (taskio).height - video_crop_meta->y); \
-	} \
-	else \
-	{ \
-		(taskio).crop.pos.x = 0; \
-		(taskio).crop.pos.y = 0; \
-		(taskio).crop.w = (taskio).width; \
-		(taskio).crop.h = (taskio).height; \
-	} \
- \
-	(taskio).paddr = (dma_addr_t)(phys_mem_meta->phys_addr); \
-	(taskio).format = gst_imx_ipu_blitter_get_v4l_format(video_meta->format); \
-} while (0)
+static gboolean gst_imx_ipu_blitter_fill_task_io(GstImxIpuBlitter *ipu_blitter, GstBuffer *buffer, unsigned int *width, unsigned int *height, struct ipu_crop *crop, dma_addr_t *paddr, unsigned int *format)
+{
+	guintptr plane_addrs[GST_VIDEO_MAX_PLANES];
+	gint plane_strides[GST_VIDEO_MAX_PLANES];
+	guint padded_height;
+	GstVideoMeta *video_meta;
+	GstVideoCropMeta *video_crop_meta;
+
+	video_meta = gst_buffer_get_video_meta(buffer);
+	video_crop_meta = gst_buffer_get_video_crop_meta(buffer);
+
+	g_assert(video_meta != NULL);
+	if (!gst_imx_phys_mem_meta_get_plane_layout(buffer, NULL, plane_addrs, plane_strides, &padded_height))
+	{
+		GST_ERROR_OBJECT(ipu_blitter, "could not get the plane layout of buffer %p", (gpointer)buffer);
+		return FALSE;
+	}
+
+	*width = plane_strides[0] / gst_imx_ipu_video_bpp(video_meta->format);
+	*height = padded_height;
+
+	if (ipu_blitter->apply_crop_metadata && (video_crop_meta != NULL))
+	{
+		if ((video_crop_meta->x >= (guint)(video_meta->width)) || (video_crop_meta->y >= (guint)(video_meta->height)))
+		{
+			GST_ERROR_OBJECT(ipu_blitter, "crop rectangle of buffer %p starts at %u,%u, outside of the %dx%d frame", (gpointer)buffer, video_crop_meta->x, video_crop_meta->y, video_meta->width, video_meta->height);
+			return FALSE;
+		}
+
+		crop->pos.x = video_crop_meta->x;
+		crop->pos.y = video_crop_meta->y;
+		crop->w = MIN(video_crop_meta->width, *width - video_crop_meta->x);
+		crop->h = MIN(video_crop_meta->height, *height - video_crop_meta->y);
+	}
+	else
+	{
+		crop->pos.x = 0;
+		crop->pos.y = 0;
+		crop->w = *width;
+		crop->h = *height;
+	}
+
+	*paddr = (dma_addr_t)(plane_addrs[0]);
+	*format = gst_imx_ipu_blitter_get_v4l_format(video_meta->format);
+
+	return TRUE;
+}
+
+
+/* Checks if the planes of the frame are where the IPU expects them: the IPU
+ * only gets the address of the first plane, and computes the position of the
+ * other planes out of the width and height of the task (see above) */
+static gboolean gst_imx_ipu_blitter_is_layout_supported(GstBuffer *buffer)
+{
+	guintptr plane_addrs[GST_VIDEO_MAX_PLANES];
+	gint plane_strides[GST_VIDEO_MAX_PLANES];
+	guint i, padded_height;
+	GstVideoMeta *video_meta;
+	GstVideoInfo info;
+
+	video_meta = gst_buffer_get_video_meta(buffer);
+	if (video_meta == NULL)
+		return FALSE;
+
+	if (!gst_imx_phys_mem_meta_get_plane_layout(buffer, NULL, plane_addrs, plane_strides, &padded_height))
+		return FALSE;
+
+	gst_video_info_init(&info);
+	gst_video_info_set_format(&info, video_meta->format, plane_strides[0] / gst_imx_ipu_video_bpp(video_meta->format), padded_height);
+
+	for (i = 1; i < video_meta->n_planes; ++i)
+	{
+		if (((plane_addrs[i] - plane_addrs[0]) != GST_VIDEO_INFO_PLANE_OFFSET(&info, i)) || (plane_strides[i] != GST_VIDEO_INFO_PLANE_STRIDE(&info, i)))
+		{
+			GST_LOG("plane %u of buffer %p is not where the IPU expects it", i, (gpointer)buffer);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+
+/* Imports a physically contiguous DMABUF input buffer. Returns NULL if the buffer
+ * cannot be imported, or if its layout is not usable by the IPU. */
+static GstBuffer* gst_imx_ipu_blitter_import_dmabuf_buffer(GstImxIpuBlitter *ipu_blitter, GstBuffer *input_buffer)
+{
+	GstBuffer *imported_buffer;
+
+	imported_buffer = gst_imx_dmabuf_import_buffer(input_buffer);
+	if (imported_buffer == NULL)
+		return NULL;
+
+	/* Buffers without video meta use the default layout described by the
+	 * input video info; the imported buffer is writable, so the meta can be
+	 * added to it */
+	if (gst_buffer_get_video_meta(imported_buffer) == NULL)
+	{
+		GstVideoInfo *info = &(ipu_blitter->input_video_info);
+		gst_buffer_add_video_meta_full(
+			imported_buffer,
+			GST_VIDEO_FRAME_FLAG_NONE,
+			GST_VIDEO_INFO_FORMAT(info),
+			GST_VIDEO_INFO_WIDTH(info),
+			GST_VIDEO_INFO_HEIGHT(info),
+			GST_VIDEO_INFO_N_PLANES(info),
+			&(GST_VIDEO_INFO_PLANE_OFFSET(info, 0)),
+			&(GST_VIDEO_INFO_PLANE_STRIDE(info, 0))
+		);
+	}
+
+	if (!gst_imx_ipu_blitter_is_layout_supported(imported_buffer))
+	{
+		GST_TRACE_OBJECT(ipu_blitter, "imported DMABUF buffer has a layout the IPU cannot handle");
+		gst_buffer_unref(imported_buffer);
+		return NULL;
+	}
+
+	return imported_buffer;
+}
 
 
 gboolean gst_imx_ipu_blitter_set_actual_input_buffer(GstImxIpuBlitter *ipu_blitter, GstBuffer *actual_input_buffer)
 {
+	struct ipu_input *input = &(ipu_blitter->priv->task.input);
+
 	g_assert(actual_input_buffer != NULL);
 
-	GST_IMX_FILL_IPU_TASK(ipu_blitter, actual_input_buffer, ipu_blitter->priv->task.input);
+	/* The blitter takes ownership over the buffer, even if it cannot be used */
+	if (!gst_imx_ipu_blitter_fill_task_io(ipu_blitter, actual_input_buffer, &(input->width), &(input->height), &(input->crop), &(input->paddr), &(input->format)))
+	{
+		gst_buffer_unref(actual_input_buffer);
+		return FALSE;
+	}
+
 	ipu_blitter->actual_input_buffer = actual_input_buffer;
 
 	return TRUE;
@@ -520,30 +623,45 @@ gboolean gst_imx_ipu_blitter_set_actual_input_buffer(GstImxIpuBlitter *ipu_blitt
 
 gboolean gst_imx_ipu_blitter_set_output_buffer(GstImxIpuBlitter *ipu_blitter, GstBuffer *output_buffer)
 {
+	struct ipu_output *output = &(ipu_blitter->priv->task.output);
+
 	g_assert(output_buffer != NULL);
 
-	GST_IMX_FILL_IPU_TASK(ipu_blitter, output_buffer, ipu_blitter->priv->task.output);
+	/* Write back pending CPU writes now, so that they cannot be evicted
+	 * from the cache later and overwrite the blit results */
+	gst_imx_phys_mem_buffer_flush(output_buffer);
 
-	return TRUE;
+	return gst_imx_ipu_blitter_fill_task_io(ipu_blitter, output_buffer, &(output->width), &(output->height), &(output->crop), &(output->paddr), &(output->format));
 }
 
 
 gboolean gst_imx_ipu_blitter_set_input_buffer(GstImxIpuBlitter *ipu_blitter, GstBuffer *input_buffer)
 {
 	GstImxPhysMemMeta *phys_mem_meta;
+	GstBuffer *imported_buffer = NULL;
 
 	g_assert(input_buffer != NULL);
 
 	phys_mem_meta = GST_IMX_PHYS_MEM_META_GET(input_buffer);
 
-	/* Test if the input buffer uses DMA memory */
-	if ((phys_mem_meta != NULL) && (phys_mem_meta->phys_addr != 0))
+	/* Test if the input buffer uses DMA memory, with a layout the IPU can handle */
+	if ((phys_mem_meta != NULL) && (phys_mem_meta->phys_addr != 0) && gst_imx_ipu_blitter_is_layout_supported(input_buffer))
 	{
 		/* DMA memory present - the input buffer can be used as an actual input buffer */
-		gst_imx_ipu_blitter_set_actual_input_buffer(ipu_blitter, gst_buffer_ref(input_buffer));
+		if (!gst_imx_ipu_blitter_set_actual_input_buffer(ipu_blitter, gst_buffer_ref(input_buffer)))
+			return FALSE;
 
 		GST_TRACE_OBJECT(ipu_blitter, "input buffer uses DMA memory - setting it as actual input buffer");
 	}
+	else if ((imported_buffer = gst_imx_ipu_blitter_import_dmabuf_buffer(ipu_blitter, input_buffer)) != NULL)
+	{
+		/* Physically contiguous DMABUF - the buffer with the added physical memory
+		 * metadata can be used as an actual input buffer */
+		if (!gst_imx_ipu_blitter_set_actual_input_buffer(ipu_blitter, imported_buffer))
+			return FALSE;
+
+		GST_TRACE_OBJECT(ipu_blitter, "input buffer uses physically contiguous DMABUF memory - setting it as actual input buffer");
+	}
 	else
 	{
 		/* No DMA memory present; the input buffer needs to be copied to an internal
@@ -614,7 +732,8 @@ gboolean gst_imx_ipu_blitter_set_input_buffer(GstImxIpuBlitter *ipu_blitter, Gst
 		}
 
 		/* Finally, set the temp input buffer as the actual input buffer */
-		gst_imx_ipu_blitter_set_actual_input_buffer(ipu_blitter, temp_input_buffer);
+		if (!gst_imx_ipu_blitter_set_actual_input_buffer(ipu_blitter, temp_input_buffer))
+			return FALSE;
 	}
 
 	/* Configure interlacing */
@@ -644,8 +763,13 @@ gboolean gst_imx_ipu_blitter_set_input_buffer(GstImxIpuBlitter *ipu_blitter, Gst
 					else
 						GST_TRACE_OBJECT(ipu_blitter, "frame has video metadata but no deinterlacing flag");
 				}
+				else if (GST_BUFFER_FLAG_IS_SET(input_buffer, GST_VIDEO_BUFFER_FLAG_INTERLACED))
+				{
+					GST_TRACE_OBJECT(ipu_blitter, "frame has no video metadata, but interlaced buffer flag");
+					ipu_blitter->priv->task.input.deinterlace.enable = 1;
+				}
 				else
-					GST_TRACE_OBJECT(ipu_blitter, "frame has no video metadata -> no deinterlacing done");
+					GST_TRACE_OBJECT(ipu_blitter, "frame has no video metadata and no interlaced buffer flag -> no deinterlacing done");
 
 				break;
 			}
@@ -747,6 +871,9 @@ gboolean gst_imx_ipu_blitter_blit(GstImxIpuBlitter *ipu_blitter)
 		ipu_blitter->priv->task.output.rotate
 	);
 
+	/* Make sure the IPU sees all CPU writes to the input frame */
+	gst_imx_phys_mem_buffer_flush(ipu_blitter->actual_input_buffer);
+
 	/* The actual blit operation
 	 * Input and output frame are assumed to be set up properly at this point
 	 */
@@ -784,12 +911,9 @@ GstBufferPool* gst_imx_ipu_blitter_create_bufferpool(GstImxIpuBlitter *ipu_blitt
 
 	config = gst_buffer_pool_get_config(pool);
 	gst_buffer_pool_config_set_params(config, caps, size, min_buffers, max_buffers);
-	/* If the allocator value is NULL, create an allocator */
+	/* If the allocator value is NULL, use the blitter's allocator */
 	if (allocator == NULL)
-	{
-		allocator = gst_imx_ipu_allocator_new(ipu_blitter->priv->ipu_fd);
-		gst_buffer_pool_config_set_allocator(config, allocator, alloc_params);
-	}
+		gst_buffer_pool_config_set_allocator(config, ipu_blitter->priv->allocator, alloc_params);
 	gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_IMX_PHYS_MEM);
 	gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
 	gst_buffer_pool_set_config(pool, config);
@@ -804,6 +928,15 @@ GstBufferPool* gst_imx_ipu_blitter_get_internal_bufferpool(GstImxIpuBlitter *ipu
 }
 
 
+GstCaps* gst_imx_ipu_blitter_add_dmabuf_caps_feature(GstImxIpuBlitter *ipu_blitter, GstCaps *caps)
+{
+	if (ipu_blitter->priv->allocator == NULL)
+		return gst_caps_ref(caps);
+
+	return gst_imx_phys_mem_buffer_pool_add_dmabuf_caps_feature(caps, ipu_blitter->priv->allocator);
+}
+
+
 /* The produced buffer contains only metadata, no memory blocks - the IPU sink does not need anything more
  * TODO: add some logic to wrap the framebuffer memory block, including map/unmap code etc. */
 GstBuffer* gst_imx_ipu_blitter_wrap_framebuffer(GstImxIpuBlitter *ipu_blitter, int framebuffer_fd, guint x, guint y, guint width, guint height)
@@ -22,6 +22,7 @@
 
 #include <gst/gst.h>
 #include <gst/video/video.h>
+#include "../common/phys_mem_allocator.h"
 
 
 G_BEGIN_DECLS
@@ -68,6 +69,21 @@ typedef struct _GstImxIpuBlitterPrivate GstImxIpuBlitterPrivate;
 		"framerate = (fraction) [ 0, MAX ]; " \
 	)
 
+/* Caps for blitter output; the output frames can also be exported as DMABUF */
+#define GST_IMX_IPU_BLITTER_SRC_CAPS \
+	GST_STATIC_CAPS( \
+		"video/x-raw, " \
+		"format = (string) " GST_IMX_IPU_VIDEO_FORMATS ", " \
+		"width = (int) [ 64, MAX ], " \
+		"height = (int) [ 64, MAX ], " \
+		"framerate = (fraction) [ 0, MAX ]; " \
+		"video/x-raw(" GST_IMX_CAPS_FEATURE_MEMORY_DMABUF "), " \
+		"format = (string) " GST_IMX_IPU_VIDEO_FORMATS ", " \
+		"width = (int) [ 64, MAX ], " \
+		"height = (int) [ 64, MAX ], " \
+		"framerate = (fraction) [ 0, MAX ]; " \
+	)
+
 
 typedef enum
 {
@@ -96,6 +112,11 @@ GstImxIpuBlitterDeinterlaceMode;
 #define GST_IMX_IPU_BLITTER_CROP_DEFAULT  FALSE
 #define GST_IMX_IPU_BLITTER_DEINTERLACE_DEFAULT  GST_IMX_IPU_BLITTER_DEINTERLACE_NONE
 
+/* Frame width and height must be multiples of these values for the IPU
+ * to be able to use the frame directly */
+#define GST_IMX_IPU_BLITTER_WIDTH_ALIGNMENT   8
+#define GST_IMX_IPU_BLITTER_HEIGHT_ALIGNMENT  8
+
 
 struct _GstImxIpuBlitter
 {
@@ -142,6 +163,9 @@ gboolean gst_imx_ipu_blitter_blit(GstImxIpuBlitter *ipu_blitter);
 
 GstBufferPool* gst_imx_ipu_blitter_create_bufferpool(GstImxIpuBlitter *ipu_blitter, GstCaps *caps, guint size, guint min_buffers, guint max_buffers, GstAllocator *allocator, GstAllocationParams *alloc_params);
 GstBufferPool* gst_imx_ipu_blitter_get_internal_bufferpool(GstImxIpuBlitter *ipu_blitter);
+/* Returns a copy of the caps with the DMABuf caps feature added if the blocks of the
+ * blitter's buffer pools can be exported, or a new reference to the caps otherwise */
+GstCaps* gst_imx_ipu_blitter_add_dmabuf_caps_feature(GstImxIpuBlitter *ipu_blitter, GstCaps *caps);
 
 GstBuffer* gst_imx_ipu_blitter_wrap_framebuffer(GstImxIpuBlitter *ipu_blitter, int framebuffer_fd, guint x, guint y, guint width, guint height);
 
@@ -0,0 +1,123 @@
+/* IPU based hardware copy backend
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/types.h>
+#include <linux/ipu.h>
+#include <gst/gst.h>
+#include "../common/phys_mem_copy.h"
+#include "copy.h"
+
+
+GST_DEBUG_CATEGORY_STATIC(imx_ipu_copy_debug);
+#define GST_CAT_DEFAULT imx_ipu_copy_debug
+
+
+/* The IPU does not have a linear copy mode; instead, the memory is treated as
+ * an RGB565 image with lines of COPY_LINE_WIDTH pixels. RGB565 is used because
+ * the conversion to the IPU's internal format and back is lossless for it.
+ * Images are limited to COPY_MAX_LINES lines per task; larger copies are split
+ * into several tasks. The remainder that does not fill a complete line is
+ * copied by the CPU. */
+#define COPY_BYTES_PER_PIXEL 2
+#define COPY_LINE_WIDTH      1024
+#define COPY_LINE_SIZE       (COPY_LINE_WIDTH * COPY_BYTES_PER_PIXEL)
+#define COPY_MAX_LINES       1024
+#define COPY_ADDR_ALIGNMENT  8
+
+
+/* The IPU device is opened on the first hardware copy instead of when the backend
+ * is registered, since registration happens when the plugin is loaded, and plugin
+ * loading must not access the hardware. Returns -1 if the device cannot be opened. */
+static int gst_imx_ipu_copy_get_fd(void)
+{
+	static gsize initialized = 0;
+	static int ipu_fd = -1;
+
+	if (g_once_init_enter(&initialized))
+	{
+		ipu_fd = open("/dev/mxc_ipu", O_RDWR, 0);
+		if (ipu_fd < 0)
+			GST_WARNING("could not open /dev/mxc_ipu: %s - copying with the CPU instead", strerror(errno));
+
+		g_once_init_leave(&initialized, 1);
+	}
+
+	return ipu_fd;
+}
+
+
+static gsize gst_imx_ipu_copy(G_GNUC_UNUSED gpointer user_data, guintptr dest_phys_addr, guintptr src_phys_addr, gsize size)
+{
+	int ipu_fd;
+	gsize num_copied = 0;
+
+	if (((dest_phys_addr % COPY_ADDR_ALIGNMENT) != 0) || ((src_phys_addr % COPY_ADDR_ALIGNMENT) != 0))
+	{
+		GST_LOG("addresses are not aligned - cannot use the IPU for copying");
+		return 0;
+	}
+
+	ipu_fd = gst_imx_ipu_copy_get_fd();
+	if (ipu_fd < 0)
+		return 0;
+
+	while ((size - num_copied) >= COPY_LINE_SIZE)
+	{
+		struct ipu_task task;
+		guint num_lines = MIN((size - num_copied) / COPY_LINE_SIZE, COPY_MAX_LINES);
+
+		memset(&task, 0, sizeof(struct ipu_task));
+
+		task.input.width = task.output.width = COPY_LINE_WIDTH;
+		task.input.height = task.output.height = num_lines;
+		task.input.crop.w = task.output.crop.w = COPY_LINE_WIDTH;
+		task.input.crop.h = task.output.crop.h = num_lines;
+		task.input.format = task.output.format = IPU_PIX_FMT_RGB565;
+		task.input.paddr = (dma_addr_t)(src_phys_addr + num_copied);
+		task.output.paddr = (dma_addr_t)(dest_phys_addr + num_copied);
+
+		if (ioctl(ipu_fd, IPU_QUEUE_TASK, &task) == -1)
+		{
+			GST_WARNING("queuing IPU copy task failed: %s", strerror(errno));
+			break;
+		}
+
+		num_copied += num_lines * COPY_LINE_SIZE;
+	}
+
+	return num_copied;
+}
+
+
+void gst_imx_ipu_copy_register_backend(void)
+{
+	static gsize registered = 0;
+
+	if (g_once_init_enter(&registered))
+	{
+		GST_DEBUG_CATEGORY_INIT(imx_ipu_copy_debug, "imxipucopy", 0, "Freescale i.MX IPU hardware copy backend");
+		gst_imx_phys_mem_copy_set_hw_backend(gst_imx_ipu_copy, NULL);
+		g_once_init_leave(&registered, 1);
+	}
+}
@@ -0,0 +1,39 @@
+/* IPU based hardware copy backend
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#ifndef GST_IMX_IPU_COPY_H
+#define GST_IMX_IPU_COPY_H
+
+#include <glib.h>
+
+
+G_BEGIN_DECLS
+
+
+/* Registers the IPU as the hardware backend of the physical memory copy engine
+ * (see common/phys_mem_copy.h). This does not access the hardware; the IPU device
+ * is opened by the first hardware copy, and then stays open for the lifetime of
+ * the process. If it cannot be opened, copies are done by the CPU. */
+void gst_imx_ipu_copy_register_backend(void);
+
+
+G_END_DECLS
+
+
+#endif
@@ -21,12 +21,17 @@
 #include <gst/gst.h>
 #include "sink/sink.h"
 #include "videotransform/videotransform.h"
+#include "copy.h"
 
 
 
 static gboolean plugin_init(GstPlugin *plugin)
 {
 	gboolean ret = TRUE;
+
+	/* Does not touch the hardware; if the IPU cannot be used for copies later, the CPU is used */
+	gst_imx_ipu_copy_register_backend();
+
 	ret = ret && gst_element_register(plugin, "imxipuvideotransform", GST_RANK_NONE, gst_imx_ipu_video_transform_get_type());
 	ret = ret && gst_element_register(plugin, "imxipusink", GST_RANK_PRIMARY + 1, gst_imx_ipu_sink_get_type());
 	return ret;
@@ -28,6 +28,7 @@
 
 #include "sink.h"
 #include "../blitter.h"
+#include "../../common/phys_mem_buffer_pool.h"
 
 
 
@@ -41,7 +42,8 @@ enum
 	PROP_0,
 	PROP_OUTPUT_ROTATION,
 	PROP_INPUT_CROP,
-	PROP_DEINTERLACE_MODE
+	PROP_DEINTERLACE_MODE,
+	PROP_PHYS_MEM_STATS
 };
 
 
@@ -155,6 +157,7 @@ void gst_imx_ipu_sink_class_init(GstImxIpuSinkClass *klass)
 			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
 		)
 	);
+	gst_imx_phys_mem_stats_install_property(object_class, PROP_PHYS_MEM_STATS);
 }
 
 
@@ -242,7 +245,11 @@ static gboolean gst_imx_ipu_sink_init_device(GstImxIpuSink *ipu_sink)
 		return FALSE;
 	}
 
-	gst_imx_ipu_blitter_set_output_buffer(ipu_sink->priv->blitter, ipu_sink->priv->fb_buffer);
+	if (!gst_imx_ipu_blitter_set_output_buffer(ipu_sink->priv->blitter, ipu_sink->priv->fb_buffer))
+	{
+		GST_ELEMENT_ERROR(ipu_sink, RESOURCE, OPEN_READ_WRITE, ("setting framebuffer as blitter output failed"), (NULL));
+		return FALSE;
+	}
 
 	return TRUE;
 }
@@ -344,6 +351,10 @@ static void gst_imx_ipu_sink_get_property(GObject *object, guint prop_id, GValue
 			UNLOCK_BLITTER_MUTEX(ipu_sink);
 			break;
 
+		case PROP_PHYS_MEM_STATS:
+			gst_imx_phys_mem_stats_get_property(value);
+			break;
+
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 			break;
@@ -424,6 +435,13 @@ static gboolean gst_imx_ipu_propose_allocation(GstBaseSink *sink, GstQuery *quer
 		gst_query_add_allocation_meta(query, GST_VIDEO_META_API_TYPE, NULL);
 	}
 
+	/* Request the frame layout the IPU can read without copying the frame */
+	{
+		GstVideoAlignment align;
+		gst_imx_phys_mem_buffer_pool_video_alignment_init(&align, &info, GST_IMX_IPU_BLITTER_WIDTH_ALIGNMENT, GST_IMX_IPU_BLITTER_HEIGHT_ALIGNMENT, 0);
+		gst_imx_phys_mem_buffer_pool_query_add_video_alignment(query, &align);
+	}
+
 	return TRUE;
 }
 
@@ -432,6 +450,7 @@ static GstFlowReturn gst_imx_ipu_sink_show_frame(GstVideoSink *video_sink, GstBu
 {
 	gboolean ret;
 	GstImxIpuSink *ipu_sink;
+	GstElement *previous_owner;
 
 	ipu_sink = GST_IMX_IPU_SINK(video_sink);
 
@@ -443,11 +462,16 @@ static GstFlowReturn gst_imx_ipu_sink_show_frame(GstVideoSink *video_sink, GstBu
 
 	LOCK_BLITTER_MUTEX(ipu_sink);
 
+	/* the blitter's internal input buffers are attributed to this element */
+	previous_owner = gst_imx_phys_mem_stats_set_thread_owner(GST_ELEMENT(ipu_sink));
+
 	/* using early exit optimization here to avoid calls if necessary */
 	ret = TRUE;
 	ret = ret && gst_imx_ipu_blitter_set_input_buffer(ipu_sink->priv->blitter, buf);
 	ret = ret && gst_imx_ipu_blitter_blit(ipu_sink->priv->blitter);
 
+	gst_imx_phys_mem_stats_set_thread_owner(previous_owner);
+
 	UNLOCK_BLITTER_MUTEX(ipu_sink);
 
 	return ret ? GST_FLOW_OK : GST_FLOW_ERROR;
@@ -28,6 +28,7 @@
 
 #include "videotransform.h"
 #include "../common/phys_mem_meta.h"
+#include "../common/phys_mem_buffer_pool.h"
 #include "../blitter.h"
 #include "../allocator.h"
 
@@ -38,12 +39,17 @@ GST_DEBUG_CATEGORY_STATIC(imx_ipu_video_transform_debug);
 #define GST_CAT_DEFAULT imx_ipu_video_transform_debug
 
 
+/* How long the output buffer pool must be idle before it frees buffers above its minimum */
+#define OUTPUT_POOL_IDLE_TIMEOUT (5 * GST_SECOND)
+
+
 enum
 {
 	PROP_0,
 	PROP_OUTPUT_ROTATION,
 	PROP_INPUT_CROP,
-	PROP_DEINTERLACE_MODE
+	PROP_DEINTERLACE_MODE,
+	PROP_PHYS_MEM_STATS
 };
 
 
@@ -59,7 +65,7 @@ static GstStaticPadTemplate static_src_template = GST_STATIC_PAD_TEMPLATE(
 	"src",
 	GST_PAD_SRC,
 	GST_PAD_ALWAYS,
-	GST_IMX_IPU_BLITTER_CAPS
+	GST_IMX_IPU_BLITTER_SRC_CAPS
 );
 
 
@@ -178,6 +184,7 @@ void gst_imx_ipu_video_transform_class_init(GstImxIpuVideoTransformClass *klass)
 			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
 		)
 	);
+	gst_imx_phys_mem_stats_install_property(object_class, PROP_PHYS_MEM_STATS);
 }
 
 
@@ -343,6 +350,10 @@ static void gst_imx_ipu_video_transform_get_property(GObject *object, guint prop
 			UNLOCK_BLITTER_MUTEX(ipu_video_transform);
 			break;
 
+		case PROP_PHYS_MEM_STATS:
+			gst_imx_phys_mem_stats_get_property(value);
+			break;
+
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 			break;
@@ -396,7 +407,7 @@ static gboolean gst_imx_ipu_video_transform_src_event(GstBaseTransform *transfor
 }
 
 
-static GstCaps* gst_imx_ipu_video_transform_transform_caps(GstBaseTransform *transform, G_GNUC_UNUSED GstPadDirection direction, GstCaps *caps, GstCaps *filter)
+static GstCaps* gst_imx_ipu_video_transform_transform_caps(GstBaseTransform *transform, GstPadDirection direction, GstCaps *caps, GstCaps *filter)
 {
 	GstCaps *tmpcaps1, *tmpcaps2, *result;
 	GstStructure *structure;
@@ -436,6 +447,25 @@ static GstCaps* gst_imx_ipu_video_transform_transform_caps(GstBaseTransform *tra
 		gst_caps_append_structure(tmpcaps1, structure);
 	}
 
+	/* Offer output frames as DMABUF first, since downstream can then use them
+	 * without copying; the appended structures carry no caps features, so the
+	 * sink caps always use system memory */
+	if (direction == GST_PAD_SINK)
+	{
+		GstImxIpuVideoTransform *ipu_video_transform = GST_IMX_IPU_VIDEO_TRANSFORM(transform);
+
+		LOCK_BLITTER_MUTEX(ipu_video_transform);
+		if (ipu_video_transform->priv->blitter != NULL)
+		{
+			tmpcaps2 = gst_imx_ipu_blitter_add_dmabuf_caps_feature(ipu_video_transform->priv->blitter, tmpcaps1);
+			if (tmpcaps2 != tmpcaps1)
+				tmpcaps1 = gst_caps_merge(tmpcaps2, tmpcaps1);
+			else
+				gst_caps_unref(tmpcaps2);
+		}
+		UNLOCK_BLITTER_MUTEX(ipu_video_transform);
+	}
+
 	if (filter != NULL)
 	{
 		tmpcaps2 = gst_caps_intersect_full(filter, tmpcaps1, GST_CAPS_INTERSECT_FIRST);
@@ -1015,7 +1045,22 @@ static void gst_imx_ipu_video_transform_fixate_format_caps(GstBaseTransform *tra
 
 static gboolean gst_imx_ipu_video_transform_propose_allocation(GstBaseTransform *transform, G_GNUC_UNUSED GstQuery *decide_query, GstQuery *query)
 {
-	return gst_pad_peer_query(GST_BASE_TRANSFORM_SRC_PAD(transform), query);
+	GstCaps *caps;
+	GstVideoInfo vinfo;
+	GstVideoAlignment align;
+
+	if (!gst_pad_peer_query(GST_BASE_TRANSFORM_SRC_PAD(transform), query))
+		return FALSE;
+
+	/* Request the frame layout the IPU can read without copying the frame */
+	gst_query_parse_allocation(query, &caps, NULL);
+	if ((caps != NULL) && gst_video_info_from_caps(&vinfo, caps))
+	{
+		gst_imx_phys_mem_buffer_pool_video_alignment_init(&align, &vinfo, GST_IMX_IPU_BLITTER_WIDTH_ALIGNMENT, GST_IMX_IPU_BLITTER_HEIGHT_ALIGNMENT, 0);
+		gst_imx_phys_mem_buffer_pool_query_add_video_alignment(query, &align);
+	}
+
+	return TRUE;
 }
 
 
@@ -1027,7 +1072,8 @@ static gboolean gst_imx_ipu_video_transform_decide_allocation(GstBaseTransform *
 	guint size, min = 0, max = 0;
 	GstStructure *config;
 	GstVideoInfo vinfo;
-	gboolean update_pool;
+	GstVideoAlignment align;
+	gboolean update_pool, own_pool = FALSE;
 
 	gst_query_parse_allocation(query, &outcaps, NULL);
 	gst_video_info_init(&vinfo);
@@ -1035,6 +1081,11 @@ static gboolean gst_imx_ipu_video_transform_decide_allocation(GstBaseTransform *
 
 	GST_DEBUG_OBJECT(ipu_video_transform, "num allocation pools: %d", gst_query_get_n_allocation_pools(query));
 
+	/* Lay out output frames so that they satisfy both the IPU and downstream */
+	gst_imx_phys_mem_buffer_pool_video_alignment_init(&align, &vinfo, GST_IMX_IPU_BLITTER_WIDTH_ALIGNMENT, GST_IMX_IPU_BLITTER_HEIGHT_ALIGNMENT, 0);
+	if (gst_imx_phys_mem_buffer_pool_query_get_video_alignment(query, &align))
+		GST_DEBUG_OBJECT(ipu_video_transform, "downstream requested alignment; merged padding right/bottom: %u/%u", align.padding_right, align.padding_bottom);
+
 	/* Look for an allocator which can allocate physical memory buffers */
 	if (gst_query_get_n_allocation_pools(query) > 0)
 	{
@@ -1065,15 +1116,24 @@ static gboolean gst_imx_ipu_video_transform_decide_allocation(GstBaseTransform *
 		else
 			GST_DEBUG_OBJECT(ipu_video_transform, "no pool supports physical memory buffers; creating new pool");
 		pool = gst_imx_ipu_blitter_create_bufferpool(ipu_video_transform->priv->blitter, outcaps, size, min, max, NULL, NULL);
+		gst_imx_phys_mem_buffer_pool_set_owner(pool, GST_ELEMENT(ipu_video_transform));
+		own_pool = TRUE;
 	}
-	else
+
+	config = gst_buffer_pool_get_config(pool);
+	gst_buffer_pool_config_set_params(config, outcaps, size, min, max);
+	gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_IMX_PHYS_MEM);
+	gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+	gst_imx_phys_mem_buffer_pool_config_set_video_alignment(config, &align);
+	/* The own pool allocates its minimum number of buffers in the background, so
+	 * activating it does not block, and frees the buffers above that number once
+	 * downstream stops using them, for example while the pipeline is paused */
+	if (own_pool)
 	{
-		config = gst_buffer_pool_get_config(pool);
-		gst_buffer_pool_config_set_params(config, outcaps, size, min, max);
-		gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_IMX_PHYS_MEM);
-		gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
-		gst_buffer_pool_set_config(pool, config);
+		gst_imx_phys_mem_buffer_pool_config_set_prewarm(config, 0, TRUE);
+		gst_imx_phys_mem_buffer_pool_config_set_idle_shrink(config, 0, OUTPUT_POOL_IDLE_TIMEOUT);
 	}
+	gst_buffer_pool_set_config(pool, config);
 
 	GST_DEBUG_OBJECT(
 		ipu_video_transform,
@@ -1221,15 +1281,21 @@ static GstFlowReturn gst_imx_ipu_video_transform_transform_frame(GstVideoFilter
 {
 	gboolean ret;
 	GstImxIpuVideoTransform *ipu_video_transform = GST_IMX_IPU_VIDEO_TRANSFORM(filter);
+	GstElement *previous_owner;
 
 	LOCK_BLITTER_MUTEX(ipu_video_transform);
 
+	/* the blitter's internal input buffers are attributed to this element */
+	previous_owner = gst_imx_phys_mem_stats_set_thread_owner(GST_ELEMENT(ipu_video_transform));
+
 	/* using early exit optimization here to avoid calls if necessary */
 	ret = TRUE;
 	ret = ret && gst_imx_ipu_blitter_set_input_buffer(ipu_video_transform->priv->blitter, in->buffer);
 	ret = ret && gst_imx_ipu_blitter_set_output_buffer(ipu_video_transform->priv->blitter, out->buffer);
 	ret = ret && gst_imx_ipu_blitter_blit(ipu_video_transform->priv->blitter);
 
+	gst_imx_phys_mem_stats_set_thread_owner(previous_owner);
+
 	UNLOCK_BLITTER_MUTEX(ipu_video_transform);
 
 	return ret ? GST_FLOW_OK : GST_FLOW_ERROR;
@@ -0,0 +1,331 @@
+/* VPU decoder latency benchmark
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include <string.h>
+#include <gst/gst.h>
+
+
+/* Decodes a stream with imxvpudec, once with low-latency=false and once with
+ * low-latency=true, and prints how long frames spend inside the decoder. The time
+ * is captured when a frame enters the decoder's sink pad and when the decoded
+ * frame with the same timestamp leaves its source pad. By default, the input is
+ * paced to its timestamps like a live source, so the results do not include
+ * the time frames wait in the decoder's input queue. The input must therefore be
+ * timestamped, for example by passing "qtdemux ! h264parse" as the parser.
+ * The plugins must be installed, or their location must be set in GST_PLUGIN_PATH. */
+
+
+#define DEFAULT_PARSER "h264parse"
+
+
+typedef struct
+{
+	GstClockTime pts;
+	gint64 time;
+}
+InputTimestamp;
+
+
+typedef struct
+{
+	GMainLoop *loop;
+
+	/* times at which frames entered the decoder; accessed by the
+	 * input and the output streaming threads */
+	GMutex mutex;
+	GQueue input_timestamps;
+
+	gint num_input_frames, num_untimestamped_frames;
+	gint num_output_frames, num_unmatched_frames;
+	gint64 total_latency, min_latency, max_latency;
+	gint64 first_output_latency;
+
+	GstClockTime reported_latency;
+
+	gboolean error;
+}
+BenchmarkState;
+
+
+
+
+static GstPadProbeReturn input_probe(G_GNUC_UNUSED GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+	BenchmarkState *state = (BenchmarkState *)user_data;
+	GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+	InputTimestamp *input_timestamp;
+
+	state->num_input_frames++;
+
+	if (!GST_BUFFER_PTS_IS_VALID(buffer))
+	{
+		state->num_untimestamped_frames++;
+		return GST_PAD_PROBE_OK;
+	}
+
+	input_timestamp = g_slice_new(InputTimestamp);
+	input_timestamp->pts = GST_BUFFER_PTS(buffer);
+	input_timestamp->time = g_get_monotonic_time();
+
+	g_mutex_lock(&(state->mutex));
+	g_queue_push_tail(&(state->input_timestamps), input_timestamp);
+	g_mutex_unlock(&(state->mutex));
+
+	return GST_PAD_PROBE_OK;
+}
+
+
+static gint compare_pts(gconstpointer a, gconstpointer b)
+{
+	return (((InputTimestamp const *)a)->pts == *((GstClockTime const *)b)) ? 0 : 1;
+}
+
+
+static GstPadProbeReturn output_probe(G_GNUC_UNUSED GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+	BenchmarkState *state = (BenchmarkState *)user_data;
+	GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+	gint64 now = g_get_monotonic_time();
+	GstClockTime pts = GST_BUFFER_PTS(buffer);
+	GList *node;
+	InputTimestamp *input_timestamp = NULL;
+	gint64 latency;
+
+	/* Frames leave the decoder in display order; look up
+	 * the input frame with the same timestamp */
+	g_mutex_lock(&(state->mutex));
+	node = g_queue_find_custom(&(state->input_timestamps), &pts, compare_pts);
+	if (node != NULL)
+	{
+		input_timestamp = node->data;
+		g_queue_delete_link(&(state->input_timestamps), node);
+	}
+	g_mutex_unlock(&(state->mutex));
+
+	if (input_timestamp == NULL)
+	{
+		state->num_unmatched_frames++;
+		return GST_PAD_PROBE_OK;
+	}
+
+	latency = now - input_timestamp->time;
+	g_slice_free(InputTimestamp, input_timestamp);
+
+	if (state->num_output_frames == 0)
+	{
+		state->first_output_latency = latency;
+		state->min_latency = latency;
+		state->max_latency = latency;
+	}
+	else
+	{
+		state->min_latency = MIN(state->min_latency, latency);
+		state->max_latency = MAX(state->max_latency, latency);
+	}
+
+	state->total_latency += latency;
+	state->num_output_frames++;
+
+	return GST_PAD_PROBE_OK;
+}
+
+
+static void free_input_timestamp(gpointer data, G_GNUC_UNUSED gpointer user_data)
+{
+	g_slice_free(InputTimestamp, data);
+}
+
+
+static gboolean bus_watch(G_GNUC_UNUSED GstBus *bus, GstMessage *msg, gpointer user_data)
+{
+	BenchmarkState *state = (BenchmarkState *)user_data;
+
+	switch (GST_MESSAGE_TYPE(msg))
+	{
+		case GST_MESSAGE_EOS:
+			g_main_loop_quit(state->loop);
+			break;
+
+		case GST_MESSAGE_ERROR:
+		{
+			GError *error = NULL;
+			gchar *debug_info = NULL;
+
+			gst_message_parse_error(msg, &error, &debug_info);
+			g_printerr("error from %s: %s (%s)\n", GST_OBJECT_NAME(GST_MESSAGE_SRC(msg)), error->message, (debug_info != NULL) ? debug_info : "no details");
+
+			g_error_free(error);
+			g_free(debug_info);
+
+			state->error = TRUE;
+			g_main_loop_quit(state->loop);
+
+			break;
+		}
+
+		default:
+			break;
+	}
+
+	return TRUE;
+}
+
+
+static gboolean run_benchmark(gchar const *location, gchar const *parser_name, gboolean paced, gboolean low_latency, BenchmarkState *state)
+{
+	GError *error = NULL;
+	gchar *pipeline_desc;
+	GstElement *pipeline, *src, *decoder;
+	GstPad *pad;
+	GstBus *bus;
+	guint bus_watch_id;
+	GstQuery *query;
+
+	memset(state, 0, sizeof(BenchmarkState));
+	g_mutex_init(&(state->mutex));
+	g_queue_init(&(state->input_timestamps));
+	state->reported_latency = GST_CLOCK_TIME_NONE;
+
+	pipeline_desc = g_strdup_printf("filesrc name=src ! %s ! identity sync=%s ! imxvpudec name=decoder low-latency=%s ! fakesink sync=false", parser_name, paced ? "true" : "false", low_latency ? "true" : "false");
+	pipeline = gst_parse_launch(pipeline_desc, &error);
+	g_free(pipeline_desc);
+	if ((pipeline == NULL) || (error != NULL))
+	{
+		g_printerr("could not create pipeline: %s\n", error->message);
+		g_error_free(error);
+		if (pipeline != NULL)
+			gst_object_unref(GST_OBJECT(pipeline));
+		return FALSE;
+	}
+
+	src = gst_bin_get_by_name(GST_BIN(pipeline), "src");
+	g_object_set(G_OBJECT(src), "location", location, NULL);
+	gst_object_unref(GST_OBJECT(src));
+
+	decoder = gst_bin_get_by_name(GST_BIN(pipeline), "decoder");
+	pad = gst_element_get_static_pad(decoder, "sink");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, input_probe, state, NULL);
+	gst_object_unref(GST_OBJECT(pad));
+	pad = gst_element_get_static_pad(decoder, "src");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, output_probe, state, NULL);
+
+	state->loop = g_main_loop_new(NULL, FALSE);
+
+	bus = gst_element_get_bus(pipeline);
+	bus_watch_id = gst_bus_add_watch(bus, bus_watch, state);
+	gst_object_unref(GST_OBJECT(bus));
+
+	if (gst_element_set_state(pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+		state->error = TRUE;
+	else
+		g_main_loop_run(state->loop);
+
+	/* The decoder reports its latency once the VPU is initialized;
+	 * query it before the pipeline shuts down */
+	query = gst_query_new_latency();
+	if (gst_pad_query(pad, query))
+		gst_query_parse_latency(query, NULL, &(state->reported_latency), NULL);
+	gst_query_unref(query);
+
+	gst_element_set_state(pipeline, GST_STATE_NULL);
+
+	g_source_remove(bus_watch_id);
+	gst_object_unref(GST_OBJECT(pad));
+	gst_object_unref(GST_OBJECT(decoder));
+	gst_object_unref(GST_OBJECT(pipeline));
+	g_main_loop_unref(state->loop);
+
+	g_queue_foreach(&(state->input_timestamps), free_input_timestamp, NULL);
+	g_queue_clear(&(state->input_timestamps));
+	g_mutex_clear(&(state->mutex));
+
+	return !(state->error);
+}
+
+
+static void print_result(gchar const *name, BenchmarkState const *state)
+{
+	if (state->num_output_frames == 0)
+	{
+		g_print("%-16s no frames could be matched\n", name);
+		return;
+	}
+
+	g_print(
+		"%-16s %8d %12" G_GINT64_FORMAT " %12" G_GINT64_FORMAT " %12" G_GINT64_FORMAT " %12" G_GINT64_FORMAT " %12" G_GUINT64_FORMAT "\n",
+		name,
+		state->num_output_frames,
+		state->first_output_latency,
+		state->total_latency / state->num_output_frames,
+		state->min_latency,
+		state->max_latency,
+		GST_CLOCK_TIME_IS_VALID(state->reported_latency) ? (state->reported_latency / GST_USECOND) : 0
+	);
+
+	if ((state->num_untimestamped_frames > 0) || (state->num_unmatched_frames > 0))
+		g_print("%-16s %d input frame(s) had no timestamp, %d output frame(s) could not be matched\n", "", state->num_untimestamped_frames, state->num_unmatched_frames);
+}
+
+
+int main(int argc, char *argv[])
+{
+	gchar *parser_name = NULL;
+	gboolean unpaced = FALSE;
+	GOptionEntry option_entries[] =
+	{
+		{ "parser", 'p', 0, G_OPTION_ARG_STRING, &parser_name, "Parser (or demuxer and parser) for the input stream (default: " DEFAULT_PARSER ")", "PIPELINE" },
+		{ "unpaced", 'u', 0, G_OPTION_ARG_NONE, &unpaced, "Push input as fast as possible instead of pacing it to its timestamps", NULL },
+		{ NULL, 0, 0, 0, NULL, NULL, NULL }
+	};
+	GOptionContext *ctx;
+	GError *error = NULL;
+	BenchmarkState normal_state, low_latency_state;
+	gboolean success;
+
+	ctx = g_option_context_new("FILE - measure how long frames spend inside imxvpudec");
+	g_option_context_add_main_entries(ctx, option_entries, NULL);
+	g_option_context_add_group(ctx, gst_init_get_option_group());
+	if (!g_option_context_parse(ctx, &argc, &argv, &error))
+	{
+		g_printerr("could not parse options: %s\n", error->message);
+		g_error_free(error);
+		g_option_context_free(ctx);
+		return -1;
+	}
+	g_option_context_free(ctx);
+
+	if (argc < 2)
+	{
+		g_printerr("no input file specified\n");
+		return -1;
+	}
+
+	success = run_benchmark(argv[1], (parser_name != NULL) ? parser_name : DEFAULT_PARSER, !unpaced, FALSE, &normal_state);
+	success = success && run_benchmark(argv[1], (parser_name != NULL) ? parser_name : DEFAULT_PARSER, !unpaced, TRUE, &low_latency_state);
+	g_free(parser_name);
+
+	if (!success)
+		return -1;
+
+	g_print("%-16s %8s %12s %12s %12s %12s %12s\n", "mode", "frames", "first (us)", "avg (us)", "min (us)", "max (us)", "reported (us)");
+	print_result("normal", &normal_state);
+	print_result("low-latency", &low_latency_state);
+
+	return 0;
+}
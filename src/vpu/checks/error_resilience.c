@@ -0,0 +1,292 @@
+/* VPU decoder error resilience check
+ * Copyright (C) 2014  Carlos Rafael Giani
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include <string.h>
+#include <gst/gst.h>
+
+
+/* Decodes a stream with imxvpudec in error resilience mode, and corrupts some of its
+ * non-keyframes on the way. The check succeeds if the decoder does not post an error,
+ * outputs error-concealed frames flagged with GST_BUFFER_FLAG_CORRUPTED, and resumes
+ * outputting intact frames after the corruptions. The plugins must be installed, or
+ * their location must be set in GST_PLUGIN_PATH. */
+
+
+#define DEFAULT_PARSER "h264parse"
+#define DEFAULT_CORRUPTION_INTERVAL 30
+
+
+typedef struct
+{
+	GMainLoop *loop;
+	gint corruption_interval;
+	gboolean corrupt_first;
+
+	/* input side; only accessed by the parser's streaming thread,
+	 * except for num_corrupted_inputs */
+	gboolean first_input_seen;
+	gint num_delta_units;
+	volatile gint num_corrupted_inputs;
+
+	/* output side; only accessed by the sink's streaming thread */
+	gint num_frames, num_corrupted_frames, num_intact_frames_after_corruption;
+
+	gboolean error;
+}
+CheckState;
+
+
+
+
+static void corrupt_buffer(CheckState *state, GstPadProbeInfo *info)
+{
+	GstBuffer *buffer;
+	GstMapInfo map_info;
+	gsize i;
+
+	buffer = gst_buffer_make_writable(GST_PAD_PROBE_INFO_BUFFER(info));
+	GST_PAD_PROBE_INFO_DATA(info) = buffer;
+
+	if (!gst_buffer_map(buffer, &map_info, GST_MAP_READWRITE))
+		return;
+
+	/* Invert every other 16-byte chunk in the second half of the frame; the first
+	 * half stays intact, so the slice headers usually survive, and the VPU conceals
+	 * the damage instead of rejecting the frame */
+	for (i = map_info.size / 2; i < map_info.size; ++i)
+	{
+		if (((i / 16) % 2) == 0)
+			map_info.data[i] ^= 0xFF;
+	}
+
+	gst_buffer_unmap(buffer, &map_info);
+
+	g_atomic_int_inc(&(state->num_corrupted_inputs));
+}
+
+
+static GstPadProbeReturn corrupt_input_probe(G_GNUC_UNUSED GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+	CheckState *state = (CheckState *)user_data;
+	GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+
+	/* the first input is decoded before the VPU registered its framebuffers,
+	 * so corrupting it checks that recovery works in that state as well */
+	if (!state->first_input_seen)
+	{
+		state->first_input_seen = TRUE;
+		if (state->corrupt_first)
+		{
+			corrupt_buffer(state, info);
+			return GST_PAD_PROBE_OK;
+		}
+	}
+
+	/* other keyframes are left intact, since decoding resumes at those */
+	if (!GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT))
+		return GST_PAD_PROBE_OK;
+
+	state->num_delta_units++;
+	if ((state->num_delta_units % state->corruption_interval) == 0)
+		corrupt_buffer(state, info);
+
+	return GST_PAD_PROBE_OK;
+}
+
+
+static void handoff_cb(G_GNUC_UNUSED GstElement *sink, GstBuffer *buffer, G_GNUC_UNUSED GstPad *pad, gpointer user_data)
+{
+	CheckState *state = (CheckState *)user_data;
+
+	state->num_frames++;
+
+	if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_CORRUPTED))
+		state->num_corrupted_frames++;
+	else if (g_atomic_int_get(&(state->num_corrupted_inputs)) > 0)
+		state->num_intact_frames_after_corruption++;
+}
+
+
+static gboolean bus_watch(G_GNUC_UNUSED GstBus *bus, GstMessage *msg, gpointer user_data)
+{
+	CheckState *state = (CheckState *)user_data;
+
+	switch (GST_MESSAGE_TYPE(msg))
+	{
+		case GST_MESSAGE_EOS:
+			g_main_loop_quit(state->loop);
+			break;
+
+		case GST_MESSAGE_ERROR:
+		case GST_MESSAGE_WARNING:
+		{
+			GError *error = NULL;
+			gchar *debug_info = NULL;
+
+			if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR)
+				gst_message_parse_error(msg, &error, &debug_info);
+			else
+				gst_message_parse_warning(msg, &error, &debug_info);
+
+			g_printerr("%s from %s: %s (%s)\n", (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) ? "error" : "warning", GST_OBJECT_NAME(GST_MESSAGE_SRC(msg)), error->message, (debug_info != NULL) ? debug_info : "no details");
+
+			g_error_free(error);
+			g_free(debug_info);
+
+			if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR)
+			{
+				state->error = TRUE;
+				g_main_loop_quit(state->loop);
+			}
+
+			break;
+		}
+
+		default:
+			break;
+	}
+
+	return TRUE;
+}
+
+
+int main(int argc, char *argv[])
+{
+	gchar *parser_name = NULL;
+	gint corruption_interval = DEFAULT_CORRUPTION_INTERVAL;
+	gboolean corrupt_first = FALSE;
+	GOptionEntry option_entries[] =
+	{
+		{ "parser", 'p', 0, G_OPTION_ARG_STRING, &parser_name, "Parser element for the input stream (default: " DEFAULT_PARSER ")", "NAME" },
+		{ "interval", 'i', 0, G_OPTION_ARG_INT, &corruption_interval, "Corrupt every Nth non-keyframe (default: 30)", "N" },
+		{ "corrupt-first", 'f', 0, G_OPTION_ARG_NONE, &corrupt_first, "Also corrupt the first input frame", NULL },
+		{ NULL, 0, 0, 0, NULL, NULL, NULL }
+	};
+	GOptionContext *ctx;
+	GError *error = NULL;
+	gchar *pipeline_desc;
+	GstElement *pipeline, *src, *parser, *sink;
+	GstPad *parser_srcpad;
+	GstBus *bus;
+	CheckState state;
+	gboolean success;
+
+	ctx = g_option_context_new("FILE - check if imxvpudec recovers from corrupted input");
+	g_option_context_add_main_entries(ctx, option_entries, NULL);
+	g_option_context_add_group(ctx, gst_init_get_option_group());
+	if (!g_option_context_parse(ctx, &argc, &argv, &error))
+	{
+		g_printerr("could not parse options: %s\n", error->message);
+		g_error_free(error);
+		g_option_context_free(ctx);
+		return -1;
+	}
+	g_option_context_free(ctx);
+
+	if (argc < 2)
+	{
+		g_printerr("no input file specified\n");
+		return -1;
+	}
+	if (corruption_interval < 1)
+	{
+		g_printerr("invalid corruption interval %d\n", corruption_interval);
+		return -1;
+	}
+
+	memset(&state, 0, sizeof(state));
+	state.corruption_interval = corruption_interval;
+	state.corrupt_first = corrupt_first;
+
+	pipeline_desc = g_strdup_printf("filesrc name=src ! %s name=parser ! imxvpudec error-resilience=true ! fakesink name=sink signal-handoffs=true sync=false", (parser_name != NULL) ? parser_name : DEFAULT_PARSER);
+	pipeline = gst_parse_launch(pipeline_desc, &error);
+	g_free(pipeline_desc);
+	g_free(parser_name);
+	if (pipeline == NULL)
+	{
+		g_printerr("could not create pipeline: %s\n", error->message);
+		g_error_free(error);
+		return -1;
+	}
+	if (error != NULL)
+	{
+		g_printerr("could not create pipeline: %s\n", error->message);
+		g_error_free(error);
+		gst_object_unref(GST_OBJECT(pipeline));
+		return -1;
+	}
+
+	src = gst_bin_get_by_name(GST_BIN(pipeline), "src");
+	g_object_set(G_OBJECT(src), "location", argv[1], NULL);
+	gst_object_unref(GST_OBJECT(src));
+
+	parser = gst_bin_get_by_name(GST_BIN(pipeline), "parser");
+	parser_srcpad = gst_element_get_static_pad(parser, "src");
+	gst_pad_add_probe(parser_srcpad, GST_PAD_PROBE_TYPE_BUFFER, corrupt_input_probe, &state, NULL);
+	gst_object_unref(GST_OBJECT(parser_srcpad));
+	gst_object_unref(GST_OBJECT(parser));
+
+	sink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+	g_signal_connect(G_OBJECT(sink), "handoff", G_CALLBACK(handoff_cb), &state);
+	gst_object_unref(GST_OBJECT(sink));
+
+	state.loop = g_main_loop_new(NULL, FALSE);
+
+	bus = gst_element_get_bus(pipeline);
+	gst_bus_add_watch(bus, bus_watch, &state);
+	gst_object_unref(GST_OBJECT(bus));
+
+	if (gst_element_set_state(pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+		state.error = TRUE;
+	else
+		g_main_loop_run(state.loop);
+
+	gst_element_set_state(pipeline, GST_STATE_NULL);
+	gst_object_unref(GST_OBJECT(pipeline));
+	g_main_loop_unref(state.loop);
+
+	g_print("non-keyframes: %d  corrupted: %d\n", state.num_delta_units, state.num_corrupted_inputs);
+	g_print("output frames: %d  flagged as corrupted: %d  intact after first corruption: %d\n", state.num_frames, state.num_corrupted_frames, state.num_intact_frames_after_corruption);
+
+	success = TRUE;
+	if (state.error)
+	{
+		g_printerr("FAIL: the pipeline posted an error\n");
+		success = FALSE;
+	}
+	if (state.num_corrupted_inputs == 0)
+	{
+		g_printerr("FAIL: no input frames were corrupted; use a longer stream or a smaller interval\n");
+		success = FALSE;
+	}
+	if (state.num_corrupted_frames == 0)
+	{
+		g_printerr("FAIL: no output frames were flagged as corrupted\n");
+		success = FALSE;
+	}
+	if (state.num_intact_frames_after_corruption == 0)
+	{
+		g_printerr("FAIL: decoding did not resume after the corruption\n");
+		success = FALSE;
+	}
+
+	g_print("%s\n", success ? "PASS" : "FAIL");
+
+	return success ? 0 : 1;
+}
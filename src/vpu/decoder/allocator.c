@@ -19,6 +19,7 @@
 #include <string.h>
 #include <vpu_wrapper.h>
 #include "allocator.h"
+#include "../mem_blocks.h"
 
 
 GST_DEBUG_CATEGORY_STATIC(imx_vpu_dec_allocator_debug);
@@ -42,6 +43,7 @@ G_DEFINE_TYPE(GstImxVpuDecAllocator, gst_imx_vpu_dec_allocator, GST_TYPE_IMX_PHY
 static void gst_imx_vpu_dec_mem_init(void)
 {
 	GstAllocator *allocator = g_object_new(gst_imx_vpu_dec_allocator_get_type(), NULL);
+	gst_imx_phys_mem_allocator_enable_default_recycler(GST_IMX_PHYS_MEM_ALLOCATOR(allocator));
 	gst_allocator_register(GST_IMX_VPU_DEC_ALLOCATOR_MEM_TYPE, allocator);
 }
 
@@ -66,13 +68,17 @@ static gboolean gst_imx_vpu_dec_alloc_phys_mem(G_GNUC_UNUSED GstImxPhysMemAlloca
 	VpuDecRetCode ret;
 	VpuMemDesc mem_desc;
 
+	/* VPU_DecGetMem() always maps the memory; device-only blocks are
+	 * allocated without a mapping if possible */
+	if (GST_MEMORY_FLAG_IS_SET(memory, GST_IMX_PHYS_MEM_FLAG_DEVICE_ONLY) && gst_imx_vpu_alloc_device_only_phys_mem(memory, size))
+		return TRUE;
+
 	memset(&mem_desc, 0, sizeof(VpuMemDesc));
 	mem_desc.nSize = size;
 	ret = VPU_DecGetMem(&mem_desc);
 
 	if (ret == VPU_DEC_RET_SUCCESS)
 	{
-		memory->mem.size         = mem_desc.nSize;
 		memory->mapped_virt_addr = (gpointer)(mem_desc.nVirtAddr);
 		memory->phys_addr        = (guintptr)(mem_desc.nPhyAddr);
 		memory->cpu_addr         = (guintptr)(mem_desc.nCpuAddr);
@@ -88,8 +94,13 @@ static gboolean gst_imx_vpu_dec_free_phys_mem(G_GNUC_UNUSED GstImxPhysMemAllocat
         VpuDecRetCode ret;
         VpuMemDesc mem_desc;
 
+	/* The base class clears the device-only flag if the block was mapped
+	 * during allocation, so the flag tells how the block was allocated */
+	if (GST_MEMORY_FLAG_IS_SET(memory, GST_IMX_PHYS_MEM_FLAG_DEVICE_ONLY))
+		return gst_imx_vpu_free_device_only_phys_mem(memory);
+
 	memset(&mem_desc, 0, sizeof(VpuMemDesc));
-	mem_desc.nSize     = memory->mem.size;
+	mem_desc.nSize     = memory->mem.maxsize;
 	mem_desc.nVirtAddr = (unsigned long)(memory->mapped_virt_addr);
 	mem_desc.nPhyAddr  = (unsigned long)(memory->phys_addr);
 	mem_desc.nCpuAddr  = (unsigned long)(memory->cpu_addr);
@@ -102,12 +113,19 @@ static gboolean gst_imx_vpu_dec_free_phys_mem(G_GNUC_UNUSED GstImxPhysMemAllocat
 
 static gpointer gst_imx_vpu_dec_map_phys_mem(G_GNUC_UNUSED GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory, G_GNUC_UNUSED gssize size, G_GNUC_UNUSED GstMapFlags flags)
 {
+	/* Regular blocks are mapped during allocation; device-only ones are mapped here on demand */
+	if ((memory->mapped_virt_addr == NULL) && GST_MEMORY_FLAG_IS_SET(memory, GST_IMX_PHYS_MEM_FLAG_DEVICE_ONLY))
+		return gst_imx_vpu_map_device_only_phys_mem(memory);
+
 	return memory->mapped_virt_addr;
 }
 
 
-static void gst_imx_vpu_dec_unmap_phys_mem(G_GNUC_UNUSED GstImxPhysMemAllocator *allocator, G_GNUC_UNUSED GstImxPhysMemory *memory)
+static void gst_imx_vpu_dec_unmap_phys_mem(G_GNUC_UNUSED GstImxPhysMemAllocator *allocator, GstImxPhysMemory *memory)
 {
+	/* Mappings of regular blocks are released by VPU_DecFreeMem() */
+	if (GST_MEMORY_FLAG_IS_SET(memory, GST_IMX_PHYS_MEM_FLAG_DEVICE_ONLY))
+		gst_imx_vpu_unmap_device_only_phys_mem(memory);
 }
 
 
@@ -123,6 +141,9 @@ static void gst_imx_vpu_dec_allocator_class_init(GstImxVpuDecAllocatorClass *kla
 	parent_class->free_phys_mem  = GST_DEBUG_FUNCPTR(gst_imx_vpu_dec_free_phys_mem);
 	parent_class->map_phys_mem   = GST_DEBUG_FUNCPTR(gst_imx_vpu_dec_map_phys_mem);
 	parent_class->unmap_phys_mem = GST_DEBUG_FUNCPTR(gst_imx_vpu_dec_unmap_phys_mem);
+	/* the VPU wrapper always maps its DMA buffers write-combined */
+	parent_class->supported_cache_modes = GST_IMX_PHYS_MEM_CACHE_MODE_BIT(GST_IMX_PHYS_MEM_CACHE_MODE_WRITE_COMBINE);
+	parent_class->native_cache_mode     = GST_IMX_PHYS_MEM_CACHE_MODE_WRITE_COMBINE;
 
 	GST_DEBUG_CATEGORY_INIT(imx_vpu_dec_allocator_debug, "imxvpudecallocator", 0, "Freescale i.MX VPU decoder physical memory/allocator");
 }
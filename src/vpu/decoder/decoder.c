@@ -28,6 +28,7 @@
 #include "allocator.h"
 #include "../mem_blocks.h"
 #include "../common/phys_mem_meta.h"
+#include "../common/phys_mem_buffer_pool.h"
 #include "../utils.h"
 #include "../fb_buffer_pool.h"
 
@@ -60,10 +61,13 @@
  * This is necessary to notify the VPU wrapper that this frame is no longer used by anybody, and can be filled
  * with decoded frames safely.
  *
- * In case the caps change for some reason, the set_format() function is invoked. Internally, it unrefs the
+ * In case the caps change for some reason, the set_format() function is invoked. Internally, it retires the
  * framebuffers structure, closes the VPU decoder instance, and opens a new one, based on the new caps.
- * Later, VPU_DecDecodeBuf() will return VPU_DEC_INIT_OK again, and a new framebuffers instance will be created
- * etc.
+ * Later, VPU_DecDecodeBuf() will return VPU_DEC_INIT_OK again. If the retired framebuffers are large enough
+ * for the new stream and none of them is still in use downstream, they are registered again; otherwise, they
+ * are released, and a new framebuffers instance will be created etc. Reusing the framebuffers avoids
+ * reallocating tens of megabytes of physical memory on every reinitialization (for example, when switching
+ * bitrates in adaptive streaming).
  * Since the framebuffers instance is refcounted, there will be no conflicts between old buffer pools and a
  * new framebuffers structure. Old buffer pools that are kept alive for some reason (for example, because there
  * are some of its buffers still floating around) in turn keep their associated old framebuffers instance alive.
@@ -107,10 +111,21 @@
  * 12 bit is the bit depth for the I420 format, 12/8 is the number of bytes per pixel. While the decoder can also
  * output I42B and Y444 for motion JPEG, it won't use that many frames then, so 12 bit is still a good pick.)
  * Adding the typical sizes of extra decoding buffers requested by the VPU, this sums up to 72 MB.
+ * On top of that, as many framebuffers are allocated as downstream announces it needs in the allocation query,
+ * since decoded frames are passed downstream inside the framebuffers. If downstream holds more than announced,
+ * and the decoder repeatedly has to wait for framebuffers for a long time, the next set of framebuffers
+ * (allocated when the decoder is reinitialized) gets additional ones.
  * Therefore, it is recommended to make sure at least 72 MB RAM are available for a decoder instance. If multiple
  * streams need to be decoded at the same time, each one must have up to 72 MB available. This ensures the
  * decoder instance(s) can handle any kind of input stream. (In special cases the RAM usage might be
  * substantially less of course.)
+ *
+ * Waiting for framebuffers blocks the thread which calls handle_frame(), which is usually the upstream streaming
+ * thread. If the "input-queue-size" property is nonzero, handle_frame() instead puts the frame in a queue with
+ * that many entries, and a separate decode thread takes frames out of the queue and decodes them. Then, upstream
+ * only blocks if the queue is full. The decode thread releases the stream lock while it waits for framebuffers,
+ * so events can still be handled. Before flushing, the queued frames are discarded; before a format change and
+ * at EOS, the decoder waits until all queued frames were decoded.
  */
 
 
@@ -123,11 +138,45 @@ GST_DEBUG_CATEGORY_STATIC(imx_vpu_dec_debug);
 enum
 {
 	PROP_0,
-	PROP_NUM_ADDITIONAL_FRAMEBUFFERS
+	PROP_NUM_ADDITIONAL_FRAMEBUFFERS,
+	PROP_BITSTREAM_RING_BUFFER_SIZE,
+	PROP_LOW_LATENCY,
+	PROP_QOS,
+	PROP_THUMBNAIL_MODE,
+	PROP_INPUT_QUEUE_SIZE,
+	PROP_ERROR_RESILIENCE,
+	PROP_PHYS_MEM_STATS
 };
 
 
 #define DEFAULT_NUM_ADDITIONAL_FRAMEBUFFERS 0
+#define DEFAULT_BITSTREAM_RING_BUFFER_SIZE 0
+#define DEFAULT_LOW_LATENCY FALSE
+#define DEFAULT_QOS TRUE
+#define DEFAULT_THUMBNAIL_MODE FALSE
+#define DEFAULT_INPUT_QUEUE_SIZE 0
+#define DEFAULT_ERROR_RESILIENCE FALSE
+
+#define GST_IMX_VPU_DEC_MAX_INPUT_QUEUE_SIZE 64
+
+/* QoS skip mode adjustments: frames later than this skip P frames as well as B frames,
+ * and this many consecutive frames must be on time before skipping is reduced again */
+#define GST_IMX_VPU_DEC_QOS_SKIP_PB_LATENESS (100 * GST_MSECOND)
+#define GST_IMX_VPU_DEC_QOS_NUM_ON_TIME_FRAMES 8
+
+/* Limit for the number of framebuffers allocated for downstream's needs */
+#define GST_IMX_VPU_DEC_MAX_DOWNSTREAM_FRAMEBUFFERS 16
+/* If the decoder ran out of framebuffers this many times in a row, the next set of
+ * framebuffers gets GST_IMX_VPU_DEC_FRAMEBUFFER_GROWTH_STEP more of them,
+ * up to GST_IMX_VPU_DEC_MAX_GROWN_FRAMEBUFFERS */
+#define GST_IMX_VPU_DEC_STARVATIONS_UNTIL_GROWTH 3
+#define GST_IMX_VPU_DEC_FRAMEBUFFER_GROWTH_STEP 2
+#define GST_IMX_VPU_DEC_MAX_GROWN_FRAMEBUFFERS 16
+
+/* Input data the VPU reads directly (from the bitstream ring buffer or from
+ * upstream physical memory) must start at this alignment, and the VPU's bitstream
+ * reader may read up to the next multiple of it past the end of the data */
+#define BITSTREAM_RING_ALIGNMENT 512
 
 
 #define ALIGN_VAL_TO(LENGTH, ALIGN_SIZE)  ( ((guintptr)((LENGTH) + (ALIGN_SIZE) - 1) / (ALIGN_SIZE)) * (ALIGN_SIZE) )
@@ -196,7 +245,12 @@ static GstStaticPadTemplate static_src_template = GST_STATIC_PAD_TEMPLATE(
 	GST_PAD_ALWAYS,
 	GST_STATIC_CAPS(
 		"video/x-raw,"
-		"format = (string) { I420, I42B, Y444 }, "
+		"format = (string) { I420, NV12, I42B, Y444 }, "
+		"width = (int) [ 16, MAX ], "
+		"height = (int) [ 16, MAX ], "
+		"framerate = (fraction) [ 0, MAX ]; "
+		"video/x-raw(" GST_IMX_CAPS_FEATURE_MEMORY_DMABUF "),"
+		"format = (string) { I420, NV12, I42B, Y444 }, "
 		"width = (int) [ 16, MAX ], "
 		"height = (int) [ 16, MAX ], "
 		"framerate = (fraction) [ 0, MAX ]"
@@ -211,7 +265,40 @@ G_DEFINE_TYPE(GstImxVpuDec, gst_imx_vpu_dec, GST_TYPE_VIDEO_DECODER)
 static gboolean gst_imx_vpu_dec_alloc_dec_mem_blocks(GstImxVpuDec *vpu_dec);
 static gboolean gst_imx_vpu_dec_free_dec_mem_blocks(GstImxVpuDec *vpu_dec);
 static gboolean gst_imx_vpu_dec_fill_param_set(GstImxVpuDec *vpu_dec, GstVideoCodecState *state, VpuDecOpenParam *open_param, GstBuffer **codec_data);
+static gboolean gst_imx_vpu_dec_h264_has_no_bframes(GstStructure *s);
+static void gst_imx_vpu_dec_update_latency(GstImxVpuDec *vpu_dec, GstVideoCodecState *state, guint num_reorder_frames);
+static guint gst_imx_vpu_dec_get_downstream_min_buffers(GstImxVpuDec *vpu_dec, GstQuery *query);
+static gboolean gst_imx_vpu_dec_setup_pending_framebuffers(GstImxVpuDec *vpu_dec, guint num_downstream_framebuffers);
+static gboolean gst_imx_vpu_dec_must_copy_output_frames(GstImxVpuDec *vpu_dec);
+static GstBuffer* gst_imx_vpu_dec_copy_output_frame(GstImxVpuDec *vpu_dec, GstBuffer *buffer);
+static gboolean gst_imx_vpu_dec_set_skip_mode(GstImxVpuDec *vpu_dec, int skip_mode);
+static void gst_imx_vpu_dec_update_skip_mode(GstImxVpuDec *vpu_dec, GstVideoCodecFrame *frame);
+static gboolean gst_imx_vpu_dec_is_keyframes_only(GstImxVpuDec *vpu_dec);
+static gboolean gst_imx_vpu_dec_use_chroma_interleave(GstImxVpuDec *vpu_dec);
+static gboolean gst_imx_vpu_dec_use_dmabuf_output(GstImxVpuDec *vpu_dec);
+static void gst_imx_vpu_dec_set_interlace_flags(GstImxVpuDec *vpu_dec, GstBuffer *buffer, VpuFieldType field_type);
+static void gst_imx_vpu_dec_recover_from_error(GstImxVpuDec *vpu_dec);
 static void gst_imx_vpu_dec_close_decoder(GstImxVpuDec *vpu_dec);
+static void gst_imx_vpu_dec_retire_framebuffers(GstImxVpuDec *vpu_dec);
+static gboolean gst_imx_vpu_dec_setup_framebuffers(GstImxVpuDec *vpu_dec, GstImxVpuFramebufferParams *fbparams);
+static void gst_imx_vpu_dec_reset_fb_frame_numbers(GstImxVpuDec *vpu_dec);
+static gint gst_imx_vpu_dec_get_fb_index(GstImxVpuDec *vpu_dec, VpuFrameBuffer *framebuffer);
+static void gst_imx_vpu_dec_push_pts(GstImxVpuDec *vpu_dec, GstClockTime pts);
+static GstClockTime gst_imx_vpu_dec_pop_pts(GstImxVpuDec *vpu_dec);
+static void gst_imx_vpu_dec_remove_pts(GstImxVpuDec *vpu_dec, GstClockTime pts);
+static gboolean gst_imx_vpu_dec_get_input_phys_addr(GstBuffer *buffer, guintptr *phys_addr);
+static gboolean gst_imx_vpu_dec_is_input_aligned(GstBuffer *buffer, guintptr phys_addr);
+static gboolean gst_imx_vpu_dec_set_input_type(GstImxVpuDec *vpu_dec, int input_type);
+static gboolean gst_imx_vpu_dec_write_to_bitstream_ring(GstImxVpuDec *vpu_dec, guint8 const *data, gsize size, guintptr *phys_addr, guint8 **virt_addr);
+static void gst_imx_vpu_dec_free_bitstream_ring(GstImxVpuDec *vpu_dec);
+static void gst_imx_vpu_dec_prepare_input(GstImxVpuDec *vpu_dec, GstBuffer *input_buffer, VpuBufferNode *in_data);
+static gboolean gst_imx_vpu_dec_start_decode_thread(GstImxVpuDec *vpu_dec);
+static void gst_imx_vpu_dec_stop_decode_thread(GstImxVpuDec *vpu_dec);
+static gpointer gst_imx_vpu_dec_decode_thread_func(gpointer data);
+static void gst_imx_vpu_dec_wait_for_decode_thread(GstImxVpuDec *vpu_dec, gboolean discard);
+static void gst_imx_vpu_dec_release_frames(GstImxVpuDec *vpu_dec, GQueue *frames);
+static void gst_imx_vpu_dec_wait_for_framebuffers(GstImxVpuDec *vpu_dec);
+static GstFlowReturn gst_imx_vpu_dec_decode_frame(GstVideoDecoder *decoder, GstVideoCodecFrame *cur_frame);
 
 /* functions for the base class */
 static gboolean gst_imx_vpu_dec_start(GstVideoDecoder *decoder);
@@ -221,9 +308,11 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 static gboolean gst_imx_vpu_dec_flush(GstVideoDecoder *decoder);
 static GstFlowReturn gst_imx_vpu_dec_finish(GstVideoDecoder *decoder);
 static gboolean gst_imx_vpu_dec_decide_allocation(GstVideoDecoder *decoder, GstQuery *query);
+static gboolean gst_imx_vpu_dec_propose_allocation(GstVideoDecoder *decoder, GstQuery *query);
 
 static void gst_imx_vpu_dec_set_property(GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec);
 static void gst_imx_vpu_dec_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec);
+static void gst_imx_vpu_dec_finalize(GObject *object);
 
 
 
@@ -247,6 +336,7 @@ void gst_imx_vpu_dec_class_init(GstImxVpuDecClass *klass)
 
 	object_class->set_property    = GST_DEBUG_FUNCPTR(gst_imx_vpu_dec_set_property);
 	object_class->get_property    = GST_DEBUG_FUNCPTR(gst_imx_vpu_dec_get_property);
+	object_class->finalize        = GST_DEBUG_FUNCPTR(gst_imx_vpu_dec_finalize);
 
 	base_class->start             = GST_DEBUG_FUNCPTR(gst_imx_vpu_dec_start);
 	base_class->stop              = GST_DEBUG_FUNCPTR(gst_imx_vpu_dec_stop);
@@ -255,6 +345,7 @@ void gst_imx_vpu_dec_class_init(GstImxVpuDecClass *klass)
 	base_class->flush             = GST_DEBUG_FUNCPTR(gst_imx_vpu_dec_flush);
 	base_class->finish            = GST_DEBUG_FUNCPTR(gst_imx_vpu_dec_finish);
 	base_class->decide_allocation = GST_DEBUG_FUNCPTR(gst_imx_vpu_dec_decide_allocation);
+	base_class->propose_allocation = GST_DEBUG_FUNCPTR(gst_imx_vpu_dec_propose_allocation);
 
 	klass->inst_counter = 0;
 
@@ -270,6 +361,75 @@ void gst_imx_vpu_dec_class_init(GstImxVpuDecClass *klass)
 			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
 		)
 	);
+	g_object_class_install_property(
+		object_class,
+		PROP_BITSTREAM_RING_BUFFER_SIZE,
+		g_param_spec_uint(
+			"bitstream-ring-buffer-size",
+			"Bitstream ring buffer size",
+			"Size of a physically contiguous ring buffer input data is written into, in bytes, which avoids an internal copy inside the VPU wrapper; must be able to hold several frames (0 = disabled; input is then only read directly if it is in physical memory aligned to 512 bytes)",
+			0, G_MAXUINT,
+			DEFAULT_BITSTREAM_RING_BUFFER_SIZE,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
+		)
+	);
+	g_object_class_install_property(
+		object_class,
+		PROP_LOW_LATENCY,
+		g_param_spec_boolean(
+			"low-latency",
+			"Low latency",
+			"Minimize decoding latency: disable frame reordering for h.264 streams without B-frames (baseline profile) and keep fewer framebuffers free",
+			DEFAULT_LOW_LATENCY,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
+		)
+	);
+	g_object_class_install_property(
+		object_class,
+		PROP_QOS,
+		g_param_spec_boolean(
+			"qos",
+			"QoS",
+			"Let the VPU skip B frames, and if necessary P frames, if downstream reports that frames are late",
+			DEFAULT_QOS,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
+		)
+	);
+	g_object_class_install_property(
+		object_class,
+		PROP_THUMBNAIL_MODE,
+		g_param_spec_boolean(
+			"thumbnail-mode",
+			"Thumbnail mode",
+			"Decode and output only I frames, and allocate the minimum number of framebuffers",
+			DEFAULT_THUMBNAIL_MODE,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
+		)
+	);
+	g_object_class_install_property(
+		object_class,
+		PROP_INPUT_QUEUE_SIZE,
+		g_param_spec_uint(
+			"input-queue-size",
+			"Input queue size",
+			"Number of input frames to queue for a separate decode thread (0 = decode in the streaming thread)",
+			0, GST_IMX_VPU_DEC_MAX_INPUT_QUEUE_SIZE,
+			DEFAULT_INPUT_QUEUE_SIZE,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
+		)
+	);
+	g_object_class_install_property(
+		object_class,
+		PROP_ERROR_RESILIENCE,
+		g_param_spec_boolean(
+			"error-resilience",
+			"Error resilience",
+			"Continue at the next keyframe after decoding errors instead of failing, and output error-concealed frames flagged as corrupted",
+			DEFAULT_ERROR_RESILIENCE,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
+		)
+	);
+	gst_imx_phys_mem_stats_install_property(object_class, PROP_PHYS_MEM_STATS);
 
 	gst_element_class_set_static_metadata(
 		element_class,
@@ -284,9 +444,11 @@ void gst_imx_vpu_dec_class_init(GstImxVpuDecClass *klass)
 void gst_imx_vpu_dec_init(GstImxVpuDec *vpu_dec)
 {
 	vpu_dec->vpu_inst_opened = FALSE;
+	vpu_dec->chroma_interleave = FALSE;
 
 	vpu_dec->codec_data = NULL;
 	vpu_dec->current_framebuffers = NULL;
+	vpu_dec->previous_framebuffers = NULL;
 	vpu_dec->num_additional_framebuffers = DEFAULT_NUM_ADDITIONAL_FRAMEBUFFERS;
 	vpu_dec->recalculate_num_avail_framebuffers = FALSE;
 	vpu_dec->current_output_state = NULL;
@@ -294,7 +456,45 @@ void gst_imx_vpu_dec_init(GstImxVpuDec *vpu_dec)
 	vpu_dec->virt_dec_mem_blocks = NULL;
 	vpu_dec->phys_dec_mem_blocks = NULL;
 
-	vpu_dec->frame_table = NULL;
+	vpu_dec->direct_input = FALSE;
+	vpu_dec->input_mode_decided = FALSE;
+	vpu_dec->bitstream_ring_buffer_size = DEFAULT_BITSTREAM_RING_BUFFER_SIZE;
+	vpu_dec->bitstream_ring = NULL;
+	vpu_dec->bitstream_ring_offset = 0;
+
+	vpu_dec->fb_frame_numbers = NULL;
+	vpu_dec->num_fb_frame_numbers = 0;
+	vpu_dec->pts_queue_len = 0;
+
+	vpu_dec->low_latency = DEFAULT_LOW_LATENCY;
+	vpu_dec->reorder_enabled = FALSE;
+
+	vpu_dec->num_grown_framebuffers = 0;
+	vpu_dec->num_framebuffer_set_reuses = 0;
+	vpu_dec->num_reused_framebuffers = 0;
+	vpu_dec->num_allocated_framebuffers = 0;
+	vpu_dec->framebuffers_pending = FALSE;
+	vpu_dec->copy_output_frames = FALSE;
+	vpu_dec->dmabuf_output = FALSE;
+
+	vpu_dec->qos = DEFAULT_QOS;
+	vpu_dec->skip_mode = VPU_DEC_SKIPNONE;
+	vpu_dec->num_qos_on_time_frames = 0;
+
+	vpu_dec->thumbnail_mode = DEFAULT_THUMBNAIL_MODE;
+	vpu_dec->keyframes_only = FALSE;
+
+	vpu_dec->error_resilience = DEFAULT_ERROR_RESILIENCE;
+	vpu_dec->wait_for_keyframe = FALSE;
+
+	vpu_dec->input_queue_size = DEFAULT_INPUT_QUEUE_SIZE;
+	vpu_dec->decode_thread = NULL;
+	g_mutex_init(&(vpu_dec->input_queue_mutex));
+	g_cond_init(&(vpu_dec->input_queue_cond));
+	g_queue_init(&(vpu_dec->input_queue));
+	vpu_dec->decode_thread_busy = FALSE;
+	vpu_dec->decode_thread_exit = FALSE;
+	vpu_dec->async_flow_ret = GST_FLOW_OK;
 }
 
 
@@ -326,7 +526,9 @@ static gboolean gst_imx_vpu_dec_alloc_dec_mem_blocks(GstImxVpuDec *vpu_dec)
 		}
 		else if (vpu_dec->mem_info.MemSubBlock[i].MemType == VPU_MEM_PHY)
 		{
+			GstElement *previous_owner = gst_imx_phys_mem_stats_set_thread_owner(GST_ELEMENT(vpu_dec));
 			GstImxPhysMemory *memory = (GstImxPhysMemory *)gst_allocator_alloc(gst_imx_vpu_dec_allocator_obtain(), size, NULL);
+			gst_imx_phys_mem_stats_set_thread_owner(previous_owner);
 			if (memory == NULL)
 				return FALSE;
 
@@ -383,7 +585,10 @@ static gboolean gst_imx_vpu_dec_fill_param_set(GstImxVpuDec *vpu_dec, GstVideoCo
 		if (g_strcmp0(name, "video/x-h264") == 0)
 		{
 			open_param->CodecFormat = VPU_V_AVC;
-			open_param->nReorderEnable = 1;
+			if (vpu_dec->low_latency && gst_imx_vpu_dec_h264_has_no_bframes(s))
+				GST_INFO_OBJECT(vpu_dec, "low latency mode and stream has no B-frames; disabling frame reordering");
+			else
+				open_param->nReorderEnable = 1;
 			vpu_dec->use_vpuwrapper_flush_call = TRUE;
 			GST_INFO_OBJECT(vpu_dec, "setting h.264 as stream format");
 		}
@@ -531,51 +736,1105 @@ static gboolean gst_imx_vpu_dec_fill_param_set(GstImxVpuDec *vpu_dec, GstVideoCo
 				}
 			}
 
-			break;
+			break;
+		}
+	}
+
+	if (!format_set)
+		return FALSE;
+
+	open_param->nChromaInterleave = 0;
+	open_param->nMapType = 0;
+	open_param->nTiled2LinearEnable = 0;
+	open_param->nEnableFileMode = 0;
+	open_param->nPicWidth = state->info.width;
+	open_param->nPicHeight = state->info.height;
+
+	vpu_dec->codec_format = open_param->CodecFormat;
+	vpu_dec->reorder_enabled = open_param->nReorderEnable;
+
+	return TRUE;
+}
+
+
+/* Baseline profile h.264 streams cannot contain B-frames; the profile is taken from
+ * the caps, or, if it is not present there, from the avcC codec data */
+static gboolean gst_imx_vpu_dec_h264_has_no_bframes(GstStructure *s)
+{
+	gchar const *profile;
+	GValue const *value;
+
+	profile = gst_structure_get_string(s, "profile");
+	if (profile != NULL)
+		return (g_strcmp0(profile, "baseline") == 0) || (g_strcmp0(profile, "constrained-baseline") == 0);
+
+	value = gst_structure_get_value(s, "codec_data");
+	if ((value != NULL) && G_VALUE_HOLDS(value, GST_TYPE_BUFFER))
+	{
+		guint8 profile_idc;
+		/* byte 1 of the avcC codec data is the profile_idc of the SPS */
+		if (gst_buffer_extract(gst_value_get_buffer(value), 1, &profile_idc, 1) == 1)
+			return (profile_idc == 66);
+	}
+
+	return FALSE;
+}
+
+
+/* Reports the decoding latency, which is caused by frame reordering; the input
+ * queue is not included, since frames only accumulate in it if decoding
+ * blocks, and the decode thread takes them out as soon as possible */
+static void gst_imx_vpu_dec_update_latency(GstImxVpuDec *vpu_dec, GstVideoCodecState *state, guint num_reorder_frames)
+{
+	GstClockTime latency;
+
+	if ((state->info.fps_n <= 0) || (state->info.fps_d <= 0))
+	{
+		GST_DEBUG_OBJECT(vpu_dec, "frame rate unknown; not reporting latency");
+		return;
+	}
+
+	latency = gst_util_uint64_scale_int(GST_SECOND * num_reorder_frames, state->info.fps_d, state->info.fps_n);
+	GST_INFO_OBJECT(vpu_dec, "reporting latency of %" GST_TIME_FORMAT " (%u frame(s))", GST_TIME_ARGS(latency), num_reorder_frames);
+	gst_video_decoder_set_latency(GST_VIDEO_DECODER(vpu_dec), latency, latency);
+}
+
+
+/* Returns how many buffers downstream needs to hold at the same time, according to
+ * its answer to the allocation query. Decoded frames are passed downstream directly
+ * in the framebuffers, so these must be allocated in addition to the ones the VPU needs. */
+static guint gst_imx_vpu_dec_get_downstream_min_buffers(GstImxVpuDec *vpu_dec, GstQuery *query)
+{
+	guint i, min_buffers = 0;
+
+	for (i = 0; i < gst_query_get_n_allocation_pools(query); ++i)
+	{
+		guint min;
+		gst_query_parse_nth_allocation_pool(query, i, NULL, NULL, &min, NULL);
+		min_buffers = MAX(min_buffers, min);
+	}
+
+	if (min_buffers > GST_IMX_VPU_DEC_MAX_DOWNSTREAM_FRAMEBUFFERS)
+	{
+		GST_WARNING_OBJECT(vpu_dec, "downstream requires %u buffers; limiting to %d", min_buffers, GST_IMX_VPU_DEC_MAX_DOWNSTREAM_FRAMEBUFFERS);
+		min_buffers = GST_IMX_VPU_DEC_MAX_DOWNSTREAM_FRAMEBUFFERS;
+	}
+
+	GST_DEBUG_OBJECT(vpu_dec, "downstream requires %u buffers", min_buffers);
+
+	return min_buffers;
+}
+
+
+static gboolean gst_imx_vpu_dec_set_skip_mode(GstImxVpuDec *vpu_dec, int skip_mode)
+{
+	VpuDecRetCode ret;
+
+	if (skip_mode == vpu_dec->skip_mode)
+		return TRUE;
+
+	ret = VPU_DecConfig(vpu_dec->handle, VPU_DEC_CONF_SKIPMODE, &skip_mode);
+	if (ret != VPU_DEC_RET_SUCCESS)
+	{
+		GST_ERROR_OBJECT(vpu_dec, "could not configure skip mode: %s", gst_imx_vpu_strerror(ret));
+		return FALSE;
+	}
+
+	GST_DEBUG_OBJECT(vpu_dec, "skip mode changed: %d -> %d", vpu_dec->skip_mode, skip_mode);
+	vpu_dec->skip_mode = skip_mode;
+
+	return TRUE;
+}
+
+
+/* Only keyframes are decoded in thumbnail mode, and if the input segment
+ * is a key unit trick mode segment (for example, when fast forwarding);
+ * key unit trick mode segments exist since GStreamer 1.6 */
+static gboolean gst_imx_vpu_dec_is_keyframes_only(GstImxVpuDec *vpu_dec)
+{
+#if GST_CHECK_VERSION(1, 6, 0)
+	if (GST_VIDEO_DECODER(vpu_dec)->input_segment.flags & GST_SEGMENT_FLAG_TRICKMODE_KEY_UNITS)
+		return TRUE;
+#endif
+
+	return vpu_dec->thumbnail_mode;
+}
+
+
+/* Adjusts the VPU skip mode according to the time left until the frame's deadline.
+ * If frames are late, B frames are skipped first, then P frames as well (the VPU cannot
+ * skip only non-reference P frames; with VPU_DEC_SKIPPB, only I frames are decoded).
+ * Once frames are on time again, skipping is reduced step by step. Skipping of P frames
+ * only ends at a sync point, since the skipped P frames are missing as references. */
+static void gst_imx_vpu_dec_update_skip_mode(GstImxVpuDec *vpu_dec, GstVideoCodecFrame *frame)
+{
+	GstClockTimeDiff deadline;
+	int skip_mode = vpu_dec->skip_mode;
+
+	/* When only keyframes are decoded, the VPU skips everything else as well;
+	 * this also covers streams whose non-I frames are not flagged as delta units */
+	if (gst_imx_vpu_dec_is_keyframes_only(vpu_dec))
+	{
+		if (!(vpu_dec->keyframes_only))
+			GST_INFO_OBJECT(vpu_dec, "decoding keyframes only");
+		vpu_dec->keyframes_only = TRUE;
+		vpu_dec->num_qos_on_time_frames = 0;
+		gst_imx_vpu_dec_set_skip_mode(vpu_dec, VPU_DEC_SKIPPB);
+		return;
+	}
+	else if (vpu_dec->keyframes_only)
+	{
+		/* Non-I frames are missing as references until the next sync point */
+		if (!GST_VIDEO_CODEC_FRAME_IS_SYNC_POINT(frame))
+			return;
+
+		GST_INFO_OBJECT(vpu_dec, "decoding all frames again");
+		vpu_dec->keyframes_only = FALSE;
+		gst_imx_vpu_dec_set_skip_mode(vpu_dec, VPU_DEC_SKIPNONE);
+	}
+
+	if (!(vpu_dec->qos))
+		return;
+
+	deadline = gst_video_decoder_get_max_decode_time(GST_VIDEO_DECODER(vpu_dec), frame);
+	/* G_MAXINT64 means no QoS information is available */
+	if (deadline == G_MAXINT64)
+		return;
+
+	if (deadline < 0)
+	{
+		vpu_dec->num_qos_on_time_frames = 0;
+
+		if (skip_mode == VPU_DEC_SKIPNONE)
+			skip_mode = VPU_DEC_SKIPB;
+		else if ((skip_mode == VPU_DEC_SKIPB) && (-deadline > GST_IMX_VPU_DEC_QOS_SKIP_PB_LATENESS))
+			skip_mode = VPU_DEC_SKIPPB;
+	}
+	else if (skip_mode != VPU_DEC_SKIPNONE)
+	{
+		vpu_dec->num_qos_on_time_frames++;
+
+		if (vpu_dec->num_qos_on_time_frames >= GST_IMX_VPU_DEC_QOS_NUM_ON_TIME_FRAMES)
+		{
+			if (skip_mode == VPU_DEC_SKIPB)
+				skip_mode = VPU_DEC_SKIPNONE;
+			else if ((skip_mode == VPU_DEC_SKIPPB) && GST_VIDEO_CODEC_FRAME_IS_SYNC_POINT(frame))
+				skip_mode = VPU_DEC_SKIPB;
+
+			if (skip_mode != vpu_dec->skip_mode)
+				vpu_dec->num_qos_on_time_frames = 0;
+		}
+	}
+
+	if (skip_mode != vpu_dec->skip_mode)
+	{
+		GST_INFO_OBJECT(vpu_dec, "frame %u deadline: %" G_GINT64_FORMAT " ns; adjusting skip mode", frame->system_frame_number, (gint64)deadline);
+		gst_imx_vpu_dec_set_skip_mode(vpu_dec, skip_mode);
+	}
+}
+
+
+/* Decides if the VPU outputs NV12 (Cb and Cr interleaved in one plane) instead of I420.
+ * NV12 is used whenever downstream supports it, since the IPU and the GPU fetch it more
+ * efficiently. This must be decided before the decoder is opened. */
+static gboolean gst_imx_vpu_dec_use_chroma_interleave(GstImxVpuDec *vpu_dec)
+{
+	GstCaps *filter, *peer_caps;
+	gboolean nv12_supported;
+
+	/* motion JPEG can also be 4:2:2 or 4:4:4, which have no interleaved
+	 * counterpart in the src caps, so it always uses separate planes */
+	if (vpu_dec->is_mjpeg)
+		return FALSE;
+
+	filter = gst_caps_new_simple("video/x-raw", "format", G_TYPE_STRING, "NV12", NULL);
+	peer_caps = gst_pad_peer_query_caps(GST_VIDEO_DECODER_SRC_PAD(vpu_dec), filter);
+	nv12_supported = (peer_caps != NULL) && !gst_caps_is_empty(peer_caps);
+
+	if (peer_caps != NULL)
+		gst_caps_unref(peer_caps);
+	gst_caps_unref(filter);
+
+	GST_INFO_OBJECT(vpu_dec, "downstream %s NV12; using %s output", nv12_supported ? "supports" : "does not support", nv12_supported ? "NV12" : "I420");
+
+	return nv12_supported;
+}
+
+
+/* Decides if the framebuffers are exported as DMABUF, which is the case if the allocator
+ * can export them and downstream accepts the output caps with the DMABuf caps feature.
+ * If so, the feature is added to the caps of the output state. This must be decided
+ * after the output state was set, and before negotiating, since the framebuffers are
+ * set up in decide_allocation(). */
+static gboolean gst_imx_vpu_dec_use_dmabuf_output(GstImxVpuDec *vpu_dec)
+{
+	GstVideoCodecState *output_state;
+	GstCaps *caps, *dmabuf_caps;
+	GstAllocator *allocator;
+	gboolean accepted;
+
+	output_state = gst_video_decoder_get_output_state(GST_VIDEO_DECODER(vpu_dec));
+	if (output_state == NULL)
+		return FALSE;
+
+	allocator = gst_imx_vpu_dec_allocator_obtain();
+	if (!gst_imx_phys_mem_allocator_supports_dmabuf_export(allocator))
+	{
+		GST_INFO_OBJECT(vpu_dec, "DMABUF export is not supported; not using DMABuf caps");
+		gst_object_unref(GST_OBJECT(allocator));
+		gst_video_codec_state_unref(output_state);
+		return FALSE;
+	}
+
+	caps = gst_video_info_to_caps(&(output_state->info));
+	dmabuf_caps = gst_imx_phys_mem_buffer_pool_add_dmabuf_caps_feature(caps, allocator);
+	accepted = gst_pad_peer_query_accept_caps(GST_VIDEO_DECODER_SRC_PAD(vpu_dec), dmabuf_caps);
+
+	/* the decoder base class uses these caps instead of generating them from the video info */
+	if (accepted)
+		gst_caps_replace(&(output_state->caps), dmabuf_caps);
+
+	GST_INFO_OBJECT(vpu_dec, "downstream %s DMABuf caps %" GST_PTR_FORMAT, accepted ? "accepts" : "does not accept", (gpointer)dmabuf_caps);
+
+	gst_caps_unref(dmabuf_caps);
+	gst_caps_unref(caps);
+	gst_object_unref(GST_OBJECT(allocator));
+	gst_video_codec_state_unref(output_state);
+
+	return accepted;
+}
+
+
+/* Sets the interlacing flags of an output buffer (and of its video meta, which
+ * the IPU checks) according to the VPU's field type of the decoded picture.
+ * The caps of interlaced streams use the mixed interlace mode, so downstream
+ * only deinterlaces pictures which are actually interlaced. */
+static void gst_imx_vpu_dec_set_interlace_flags(GstImxVpuDec *vpu_dec, GstBuffer *buffer, VpuFieldType field_type)
+{
+	GstVideoMeta *video_meta;
+	guint flags = 0;
+
+	switch (field_type)
+	{
+		case VPU_FIELD_NONE:
+			break;
+		case VPU_FIELD_TB:
+			flags = GST_VIDEO_BUFFER_FLAG_INTERLACED | GST_VIDEO_BUFFER_FLAG_TFF;
+			break;
+		case VPU_FIELD_BT:
+			flags = GST_VIDEO_BUFFER_FLAG_INTERLACED;
+			break;
+		case VPU_FIELD_TOP:
+			flags = GST_VIDEO_BUFFER_FLAG_INTERLACED | GST_VIDEO_BUFFER_FLAG_ONEFIELD | GST_VIDEO_BUFFER_FLAG_TFF;
+			break;
+		case VPU_FIELD_BOTTOM:
+			flags = GST_VIDEO_BUFFER_FLAG_INTERLACED | GST_VIDEO_BUFFER_FLAG_ONEFIELD;
+			break;
+		default:
+			/* field order unknown; rely on the stream information */
+			if (vpu_dec->init_info.nInterlace)
+				flags = GST_VIDEO_BUFFER_FLAG_INTERLACED;
+			break;
+	}
+
+	GST_BUFFER_FLAG_UNSET(buffer, GST_VIDEO_BUFFER_FLAG_INTERLACED | GST_VIDEO_BUFFER_FLAG_TFF | GST_VIDEO_BUFFER_FLAG_RFF | GST_VIDEO_BUFFER_FLAG_ONEFIELD);
+	GST_BUFFER_FLAG_SET(buffer, flags);
+
+	/* the video meta flags have the same meaning as the buffer flags */
+	video_meta = gst_buffer_get_video_meta(buffer);
+	if (video_meta != NULL)
+	{
+		video_meta->flags = GST_VIDEO_FRAME_FLAG_NONE;
+		if (flags & GST_VIDEO_BUFFER_FLAG_INTERLACED)
+			video_meta->flags |= GST_VIDEO_FRAME_FLAG_INTERLACED;
+		if (flags & GST_VIDEO_BUFFER_FLAG_TFF)
+			video_meta->flags |= GST_VIDEO_FRAME_FLAG_TFF;
+		if (flags & GST_VIDEO_BUFFER_FLAG_ONEFIELD)
+			video_meta->flags |= GST_VIDEO_FRAME_FLAG_ONEFIELD;
+	}
+
+	GST_LOG_OBJECT(vpu_dec, "field type: %d  interlaced: %d  TFF: %d  one field: %d", (gint)field_type, !!(flags & GST_VIDEO_BUFFER_FLAG_INTERLACED), !!(flags & GST_VIDEO_BUFFER_FLAG_TFF), !!(flags & GST_VIDEO_BUFFER_FLAG_ONEFIELD));
+}
+
+
+/* Recovers from a decoding error without closing the decoder instance: the VPU
+ * is flushed, the frames it still held are dropped, and subsequent input frames
+ * are dropped until the next keyframe (see decode_frame() ). Upstream is asked
+ * for a new keyframe, which for example lets RTP payloaders request one from
+ * the sender instead of waiting for the next regular one. */
+static void gst_imx_vpu_dec_recover_from_error(GstImxVpuDec *vpu_dec)
+{
+	GstVideoDecoder *decoder = GST_VIDEO_DECODER(vpu_dec);
+	GList *frames, *frame_node;
+
+	if ((vpu_dec->current_framebuffers != NULL) && vpu_dec->use_vpuwrapper_flush_call)
+	{
+		VpuDecRetCode ret;
+
+		GST_IMX_VPU_FRAMEBUFFERS_LOCK(vpu_dec->current_framebuffers);
+
+		ret = VPU_DecFlushAll(vpu_dec->handle);
+		if (ret == VPU_DEC_RET_FAILURE_TIMEOUT)
+		{
+			GST_WARNING_OBJECT(vpu_dec, "resetting decoder after a timeout occurred");
+			ret = VPU_DecReset(vpu_dec->handle);
+		}
+		if (ret != VPU_DEC_RET_SUCCESS)
+			GST_ERROR_OBJECT(vpu_dec, "flushing VPU failed: %s", gst_imx_vpu_strerror(ret));
+
+		vpu_dec->recalculate_num_avail_framebuffers = TRUE;
+
+		GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(vpu_dec->current_framebuffers);
+	}
+
+	/* the error may occur before the VPU registered any framebuffers */
+	if (vpu_dec->current_framebuffers != NULL)
+		gst_imx_vpu_dec_reset_fb_frame_numbers(vpu_dec);
+	vpu_dec->pts_queue_len = 0;
+	vpu_dec->delay_sys_frame_numbers = FALSE;
+
+	/* All pending frames except the ones still waiting in the
+	 * input queue were passed to the VPU, and are lost now */
+	frames = gst_video_decoder_get_frames(decoder);
+	for (frame_node = frames; frame_node != NULL; frame_node = frame_node->next)
+	{
+		GstVideoCodecFrame *frame = (GstVideoCodecFrame *)(frame_node->data);
+		gboolean queued = FALSE;
+
+		if (vpu_dec->decode_thread != NULL)
+		{
+			g_mutex_lock(&(vpu_dec->input_queue_mutex));
+			queued = (g_queue_find(&(vpu_dec->input_queue), frame) != NULL);
+			g_mutex_unlock(&(vpu_dec->input_queue_mutex));
+		}
+
+		if (!queued)
+		{
+			GST_LOG_OBJECT(vpu_dec, "dropping frame with system frame number %u", frame->system_frame_number);
+			gst_video_decoder_drop_frame(decoder, frame);
+		}
+	}
+	/* unref the frames, since get_frames() refs them */
+	g_list_free_full(frames, (GDestroyNotify)gst_video_codec_frame_unref);
+
+	vpu_dec->wait_for_keyframe = TRUE;
+
+	gst_pad_push_event(GST_VIDEO_DECODER_SINK_PAD(decoder), gst_video_event_new_upstream_force_key_unit(GST_CLOCK_TIME_NONE, TRUE, 0));
+}
+
+
+static void gst_imx_vpu_dec_close_decoder(GstImxVpuDec *vpu_dec)
+{
+	VpuDecRetCode dec_ret;
+
+	if (vpu_dec->vpu_inst_opened)
+	{
+		dec_ret = VPU_DecFlushAll(vpu_dec->handle);
+		if (dec_ret == VPU_DEC_RET_FAILURE_TIMEOUT)
+		{
+			GST_WARNING_OBJECT(vpu_dec, "resetting decoder after a timeout occurred");
+			dec_ret = VPU_DecReset(vpu_dec->handle);
+			if (dec_ret != VPU_DEC_RET_SUCCESS)
+				GST_ERROR_OBJECT(vpu_dec, "resetting decoder failed: %s", gst_imx_vpu_strerror(dec_ret));
+		}
+		else if (dec_ret != VPU_DEC_RET_SUCCESS)
+			GST_ERROR_OBJECT(vpu_dec, "flushing decoder failed: %s", gst_imx_vpu_strerror(dec_ret));
+
+		dec_ret = VPU_DecClose(vpu_dec->handle);
+		if (dec_ret != VPU_DEC_RET_SUCCESS)
+			GST_ERROR_OBJECT(vpu_dec, "closing decoder failed: %s", gst_imx_vpu_strerror(dec_ret));
+
+		GST_INFO_OBJECT(vpu_dec, "VPU decoder closed");
+
+		vpu_dec->vpu_inst_opened = FALSE;
+	}
+}
+
+
+/* Detaches the current framebuffers from the decoder and keeps them as
+ * previous_framebuffers, so gst_imx_vpu_dec_setup_framebuffers() can reuse them.
+ * If some previous and still existing buffer pools depend on this framebuffers
+ * structure, they will extend its lifetime, since they ref'd it. */
+static void gst_imx_vpu_dec_retire_framebuffers(GstImxVpuDec *vpu_dec)
+{
+	if (vpu_dec->current_framebuffers == NULL)
+		return;
+
+	/* Using mutexes here to prevent race conditions when decoder_open is set to
+	 * FALSE at the same time as it is checked in the buffer pool release() function */
+	GST_IMX_VPU_FRAMEBUFFERS_LOCK(vpu_dec->current_framebuffers);
+	gst_imx_vpu_framebuffers_set_flushing(vpu_dec->current_framebuffers, TRUE);
+	vpu_dec->current_framebuffers->decenc_states.dec.decoder_open = FALSE;
+	GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(vpu_dec->current_framebuffers);
+
+	if (vpu_dec->previous_framebuffers != NULL)
+		gst_object_unref(vpu_dec->previous_framebuffers);
+
+	vpu_dec->previous_framebuffers = vpu_dec->current_framebuffers;
+	vpu_dec->current_framebuffers = NULL;
+}
+
+
+/* Registers framebuffers with the decoder, reusing the previous ones if possible.
+ * If they cannot be reused, the previous framebuffers are released; their memory
+ * is freed once all of their buffers have been returned from downstream. */
+static gboolean gst_imx_vpu_dec_setup_framebuffers(GstImxVpuDec *vpu_dec, GstImxVpuFramebufferParams *fbparams)
+{
+	GstElement *previous_owner;
+
+	g_assert(vpu_dec->current_framebuffers == NULL);
+
+	if (vpu_dec->previous_framebuffers != NULL)
+	{
+		GstImxVpuFramebuffers *framebuffers = vpu_dec->previous_framebuffers;
+		vpu_dec->previous_framebuffers = NULL;
+
+		if (gst_imx_vpu_framebuffers_can_reuse_for_decoder(framebuffers, fbparams))
+		{
+			/* Framebuffers of the previous set which are still in use downstream
+			 * stay with it; the previous set is released once they are returned */
+			previous_owner = gst_imx_phys_mem_stats_set_thread_owner(GST_ELEMENT(vpu_dec));
+			vpu_dec->current_framebuffers = gst_imx_vpu_framebuffers_new_reusing(framebuffers, fbparams);
+			gst_imx_phys_mem_stats_set_thread_owner(previous_owner);
+			gst_object_unref(framebuffers);
+
+			if (vpu_dec->current_framebuffers == NULL)
+				return FALSE;
+
+			vpu_dec->num_framebuffer_set_reuses++;
+			vpu_dec->num_reused_framebuffers += vpu_dec->current_framebuffers->num_reused_framebuffers;
+			vpu_dec->num_allocated_framebuffers += vpu_dec->current_framebuffers->num_framebuffers - vpu_dec->current_framebuffers->num_reused_framebuffers;
+
+			gst_imx_vpu_dec_reset_fb_frame_numbers(vpu_dec);
+
+			return gst_imx_vpu_framebuffers_register_with_decoder(vpu_dec->current_framebuffers, vpu_dec->handle);
+		}
+
+		GST_INFO_OBJECT(vpu_dec, "previous framebuffers cannot be reused; allocating new ones");
+		gst_object_unref(framebuffers);
+	}
+
+	previous_owner = gst_imx_phys_mem_stats_set_thread_owner(GST_ELEMENT(vpu_dec));
+	vpu_dec->current_framebuffers = gst_imx_vpu_framebuffers_new(fbparams, gst_imx_vpu_dec_allocator_obtain());
+	gst_imx_phys_mem_stats_set_thread_owner(previous_owner);
+	if (vpu_dec->current_framebuffers == NULL)
+		return FALSE;
+
+	vpu_dec->num_allocated_framebuffers += vpu_dec->current_framebuffers->num_framebuffers;
+
+	gst_imx_vpu_dec_reset_fb_frame_numbers(vpu_dec);
+
+	return gst_imx_vpu_framebuffers_register_with_decoder(vpu_dec->current_framebuffers, vpu_dec->handle);
+}
+
+
+/* Sets up the framebuffers for the parameters the VPU reported at its last (re)initialization */
+static gboolean gst_imx_vpu_dec_setup_pending_framebuffers(GstImxVpuDec *vpu_dec, guint num_downstream_framebuffers)
+{
+	GstImxVpuFramebufferParams fbparams = vpu_dec->pending_fbparams;
+	guint min_fbcount_indicated_by_vpu = (guint)(fbparams.min_framebuffer_count);
+	guint min_num_free_framebuffers = vpu_dec->pending_min_num_free_framebuffers;
+
+	vpu_dec->framebuffers_pending = FALSE;
+
+	/* In thumbnail mode, only single images are produced, so downstream
+	 * does not get to hold more than one framebuffer at a time */
+	if (vpu_dec->thumbnail_mode)
+		num_downstream_framebuffers = 0;
+
+	fbparams.min_framebuffer_count = min_fbcount_indicated_by_vpu + min_num_free_framebuffers + num_downstream_framebuffers + vpu_dec->num_grown_framebuffers + vpu_dec->num_additional_framebuffers;
+	GST_INFO_OBJECT(
+		vpu_dec,
+		"minimum number of framebuffers indicated by the VPU: %u  free: %u  held downstream: %u  grown: %u  additional: %u  chosen number: %u",
+		min_fbcount_indicated_by_vpu,
+		min_num_free_framebuffers,
+		num_downstream_framebuffers,
+		vpu_dec->num_grown_framebuffers,
+		vpu_dec->num_additional_framebuffers,
+		fbparams.min_framebuffer_count
+	);
+
+	if (!gst_imx_vpu_dec_setup_framebuffers(vpu_dec, &fbparams))
+		return FALSE;
+
+	vpu_dec->current_framebuffers->min_num_free_framebuffers = min_num_free_framebuffers;
+	vpu_dec->copy_output_frames = FALSE;
+
+	return TRUE;
+}
+
+
+/* Checks if the output frame must be copied out of its framebuffer. Once the
+ * decoder repeatedly had to wait for downstream to return framebuffers, frames
+ * are copied whenever downstream holds all spare framebuffers (the output frame's
+ * one included), until the next framebuffers are set up with more framebuffers.
+ * If downstream returns framebuffers promptly again, frames are not copied. */
+static gboolean gst_imx_vpu_dec_must_copy_output_frames(GstImxVpuDec *vpu_dec)
+{
+	gint num_starvations;
+	gboolean holds_spare;
+
+	GST_IMX_VPU_FRAMEBUFFERS_LOCK(vpu_dec->current_framebuffers);
+	num_starvations = vpu_dec->current_framebuffers->num_starvations;
+	holds_spare = gst_imx_vpu_framebuffers_downstream_holds_spare(vpu_dec->current_framebuffers);
+	GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(vpu_dec->current_framebuffers);
+
+	if (!(vpu_dec->copy_output_frames) && (num_starvations >= GST_IMX_VPU_DEC_STARVATIONS_UNTIL_GROWTH))
+	{
+		GST_INFO_OBJECT(vpu_dec, "framebuffers ran out %d times in a row; copying output frames while downstream holds all spare framebuffers", num_starvations);
+		vpu_dec->copy_output_frames = TRUE;
+	}
+
+	return vpu_dec->copy_output_frames && holds_spare;
+}
+
+
+/* Copies a decoded frame into a newly allocated buffer, which does not refer to the framebuffer */
+static GstBuffer* gst_imx_vpu_dec_copy_output_frame(GstImxVpuDec *vpu_dec, GstBuffer *buffer)
+{
+	GstVideoCodecState *output_state;
+	GstVideoFrame in_frame, out_frame;
+	GstBuffer *copy = NULL;
+
+	output_state = gst_video_decoder_get_output_state(GST_VIDEO_DECODER(vpu_dec));
+	if (output_state == NULL)
+		return NULL;
+
+	if (!gst_video_frame_map(&in_frame, &(output_state->info), buffer, GST_MAP_READ))
+	{
+		GST_ERROR_OBJECT(vpu_dec, "could not map framebuffer for copying");
+		goto done;
+	}
+
+	/* With DMABuf caps, the copy must be exportable as well */
+	if (vpu_dec->dmabuf_output)
+	{
+		GstAllocationParams alloc_params;
+		GstAllocator *allocator;
+		GstMemory *memory;
+
+		gst_allocation_params_init(&alloc_params);
+		alloc_params.flags = GST_IMX_PHYS_MEM_FLAG_DMABUF;
+
+		allocator = gst_imx_vpu_dec_allocator_obtain();
+		memory = gst_allocator_alloc(allocator, GST_VIDEO_INFO_SIZE(&(output_state->info)), &alloc_params);
+		gst_object_unref(GST_OBJECT(allocator));
+		if ((memory == NULL) || (gst_imx_phys_memory_get_dmabuf_fd(memory) < 0))
+		{
+			GST_ERROR_OBJECT(vpu_dec, "could not allocate exportable output frame copy");
+			if (memory != NULL)
+				gst_memory_unref(memory);
+			gst_video_frame_unmap(&in_frame);
+			goto done;
+		}
+
+		copy = gst_buffer_new();
+		gst_buffer_append_memory(copy, memory);
+	}
+	else
+		copy = gst_buffer_new_allocate(NULL, GST_VIDEO_INFO_SIZE(&(output_state->info)), NULL);
+
+	if (!gst_video_frame_map(&out_frame, &(output_state->info), copy, GST_MAP_WRITE))
+	{
+		GST_ERROR_OBJECT(vpu_dec, "could not map output frame copy");
+		gst_video_frame_unmap(&in_frame);
+		gst_buffer_unref(copy);
+		copy = NULL;
+		goto done;
+	}
+
+	gst_video_frame_copy(&out_frame, &in_frame);
+
+	gst_video_frame_unmap(&out_frame);
+	gst_video_frame_unmap(&in_frame);
+
+	/* interlacing and corruption flags */
+	gst_buffer_copy_into(copy, buffer, GST_BUFFER_COPY_FLAGS, 0, -1);
+
+done:
+	gst_video_codec_state_unref(output_state);
+	return copy;
+}
+
+
+/* Sizes the frame number array for the current framebuffers and clears it;
+ * entries from before a reinitialization are stale */
+static void gst_imx_vpu_dec_reset_fb_frame_numbers(GstImxVpuDec *vpu_dec)
+{
+	guint i, num = vpu_dec->current_framebuffers->num_framebuffers;
+
+	if (vpu_dec->num_fb_frame_numbers != num)
+	{
+		g_free(vpu_dec->fb_frame_numbers);
+		vpu_dec->fb_frame_numbers = g_new(gint, num);
+		vpu_dec->num_fb_frame_numbers = num;
+	}
+
+	for (i = 0; i < num; ++i)
+		vpu_dec->fb_frame_numbers[i] = -1;
+}
+
+
+/* Returns the index of the given framebuffer in the current framebuffers,
+ * or -1 if it is not part of them */
+static gint gst_imx_vpu_dec_get_fb_index(GstImxVpuDec *vpu_dec, VpuFrameBuffer *framebuffer)
+{
+	VpuFrameBuffer *first;
+
+	if ((vpu_dec->current_framebuffers == NULL) || (framebuffer == NULL))
+		return -1;
+
+	first = vpu_dec->current_framebuffers->framebuffers;
+	if ((framebuffer < first) || (framebuffer >= (first + vpu_dec->num_fb_frame_numbers)))
+		return -1;
+
+	return framebuffer - first;
+}
+
+
+static void gst_imx_vpu_dec_push_pts(GstImxVpuDec *vpu_dec, GstClockTime pts)
+{
+	guint i;
+
+	if (vpu_dec->pts_queue_len == GST_IMX_VPU_DEC_PTS_QUEUE_SIZE)
+	{
+		/* Timestamps of frames which do not produce output are removed, so
+		 * the queue can only fill up if input and output got out of sync;
+		 * start over, since the queued timestamps cannot be trusted anymore */
+		GST_WARNING_OBJECT(vpu_dec, "timestamp queue full; resetting it");
+		vpu_dec->pts_queue_len = 0;
+	}
+
+	/* Insertion sort; input timestamps are mostly ascending,
+	 * so this usually just appends */
+	for (i = vpu_dec->pts_queue_len; (i > 0) && (vpu_dec->pts_queue[i - 1] > pts); --i)
+		vpu_dec->pts_queue[i] = vpu_dec->pts_queue[i - 1];
+	vpu_dec->pts_queue[i] = pts;
+	vpu_dec->pts_queue_len++;
+}
+
+
+static GstClockTime gst_imx_vpu_dec_pop_pts(GstImxVpuDec *vpu_dec)
+{
+	GstClockTime pts;
+
+	if (vpu_dec->pts_queue_len == 0)
+		return GST_CLOCK_TIME_NONE;
+
+	pts = vpu_dec->pts_queue[0];
+	vpu_dec->pts_queue_len--;
+	memmove(&(vpu_dec->pts_queue[0]), &(vpu_dec->pts_queue[1]), vpu_dec->pts_queue_len * sizeof(GstClockTime));
+
+	return pts;
+}
+
+
+/* Removes the timestamp of an input frame which will not produce output */
+static void gst_imx_vpu_dec_remove_pts(GstImxVpuDec *vpu_dec, GstClockTime pts)
+{
+	guint i;
+
+	if (!GST_CLOCK_TIME_IS_VALID(pts))
+		return;
+
+	for (i = 0; i < vpu_dec->pts_queue_len; ++i)
+	{
+		if (vpu_dec->pts_queue[i] == pts)
+		{
+			vpu_dec->pts_queue_len--;
+			memmove(&(vpu_dec->pts_queue[i]), &(vpu_dec->pts_queue[i + 1]), (vpu_dec->pts_queue_len - i) * sizeof(GstClockTime));
+			return;
+		}
+	}
+}
+
+
+static gboolean gst_imx_vpu_dec_get_input_phys_addr(GstBuffer *buffer, guintptr *phys_addr)
+{
+	GstImxPhysMemMeta *phys_mem_meta;
+
+	/* Prefer the memory block itself, since its address also
+	 * accounts for any offset of the buffer's data */
+	if (gst_buffer_n_memory(buffer) == 1)
+	{
+		GstMemory *mem = gst_buffer_peek_memory(buffer, 0);
+		if (gst_imx_is_phys_memory(mem))
+		{
+			*phys_addr = gst_imx_phys_memory_get_phys_addr(mem);
+			return TRUE;
+		}
+	}
+
+	phys_mem_meta = GST_IMX_PHYS_MEM_META_GET(buffer);
+	if ((phys_mem_meta != NULL) && (phys_mem_meta->phys_addr != 0))
+	{
+		*phys_addr = phys_mem_meta->phys_addr;
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+
+/* Checks if the VPU can read the input buffer's data directly: the data must
+ * start at a BITSTREAM_RING_ALIGNMENT boundary, and the memory must extend up
+ * to the next such boundary past the end of the data */
+static gboolean gst_imx_vpu_dec_is_input_aligned(GstBuffer *buffer, guintptr phys_addr)
+{
+	gsize size, offset, maxsize;
+
+	if ((phys_addr & (BITSTREAM_RING_ALIGNMENT - 1)) != 0)
+		return FALSE;
+
+	size = gst_buffer_get_sizes(buffer, &offset, &maxsize);
+	return (maxsize - offset) >= ALIGN_VAL_TO(size, BITSTREAM_RING_ALIGNMENT);
+}
+
+
+static gboolean gst_imx_vpu_dec_set_input_type(GstImxVpuDec *vpu_dec, int input_type)
+{
+	VpuDecRetCode ret = VPU_DecConfig(vpu_dec->handle, VPU_DEC_CONF_INPUTTYPE, &input_type);
+	if (ret != VPU_DEC_RET_SUCCESS)
+	{
+		GST_ERROR_OBJECT(vpu_dec, "could not configure input type: %s", gst_imx_vpu_strerror(ret));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+static gboolean gst_imx_vpu_dec_write_to_bitstream_ring(GstImxVpuDec *vpu_dec, guint8 const *data, gsize size, guintptr *phys_addr, guint8 **virt_addr)
+{
+	gsize offset;
+
+	if (vpu_dec->bitstream_ring == NULL)
+	{
+		GstAllocator *allocator = gst_imx_vpu_dec_allocator_obtain();
+		GstElement *previous_owner = gst_imx_phys_mem_stats_set_thread_owner(GST_ELEMENT(vpu_dec));
+
+		vpu_dec->bitstream_ring = gst_allocator_alloc(allocator, vpu_dec->bitstream_ring_buffer_size, NULL);
+
+		gst_imx_phys_mem_stats_set_thread_owner(previous_owner);
+		gst_object_unref(GST_OBJECT(allocator));
+
+		if (vpu_dec->bitstream_ring == NULL)
+		{
+			GST_ERROR_OBJECT(vpu_dec, "could not allocate bitstream ring buffer with %u bytes", vpu_dec->bitstream_ring_buffer_size);
+			return FALSE;
+		}
+
+		/* The ring stays mapped for as long as it exists */
+		if (!gst_memory_map(vpu_dec->bitstream_ring, &(vpu_dec->bitstream_ring_map_info), GST_MAP_WRITE))
+		{
+			GST_ERROR_OBJECT(vpu_dec, "could not map bitstream ring buffer");
+			gst_memory_unref(vpu_dec->bitstream_ring);
+			vpu_dec->bitstream_ring = NULL;
+			return FALSE;
+		}
+
+		vpu_dec->bitstream_ring_offset = 0;
+
+		GST_INFO_OBJECT(vpu_dec, "allocated bitstream ring buffer with %u bytes", vpu_dec->bitstream_ring_buffer_size);
+	}
+
+	if (ALIGN_VAL_TO(size, BITSTREAM_RING_ALIGNMENT) > vpu_dec->bitstream_ring_map_info.size)
+	{
+		GST_WARNING_OBJECT(vpu_dec, "input frame with %" G_GSIZE_FORMAT " bytes does not fit in bitstream ring buffer with %" G_GSIZE_FORMAT " bytes", size, vpu_dec->bitstream_ring_map_info.size);
+		return FALSE;
+	}
+
+	/* Frames are never split; if the frame does not fit in the
+	 * remaining space, it is written at the beginning of the ring */
+	offset = ALIGN_VAL_TO(vpu_dec->bitstream_ring_offset, BITSTREAM_RING_ALIGNMENT);
+	if ((offset + ALIGN_VAL_TO(size, BITSTREAM_RING_ALIGNMENT)) > vpu_dec->bitstream_ring_map_info.size)
+		offset = 0;
+
+	memcpy(vpu_dec->bitstream_ring_map_info.data + offset, data, size);
+	gst_imx_phys_memory_flush(vpu_dec->bitstream_ring);
+
+	vpu_dec->bitstream_ring_offset = offset + size;
+
+	*phys_addr = gst_imx_phys_memory_get_phys_addr(vpu_dec->bitstream_ring) + offset;
+	*virt_addr = vpu_dec->bitstream_ring_map_info.data + offset;
+
+	return TRUE;
+}
+
+
+static void gst_imx_vpu_dec_free_bitstream_ring(GstImxVpuDec *vpu_dec)
+{
+	if (vpu_dec->bitstream_ring == NULL)
+		return;
+
+	gst_memory_unmap(vpu_dec->bitstream_ring, &(vpu_dec->bitstream_ring_map_info));
+	gst_memory_unref(vpu_dec->bitstream_ring);
+	vpu_dec->bitstream_ring = NULL;
+	vpu_dec->bitstream_ring_offset = 0;
+}
+
+
+/* Sets up in_data so the VPU reads the input directly from physical memory if possible.
+ * in_data must already contain the mapped input data. In VPU_DEC_IN_KICK mode, the
+ * VPU wrapper does not copy the input into its internal bitstream buffer, but this
+ * requires complete frames in aligned, physically contiguous memory, and that the
+ * wrapper does not have to modify or prepend anything to the data. Upstream buffers
+ * which are not aligned are written into the bitstream ring buffer if it is enabled. */
+static void gst_imx_vpu_dec_prepare_input(GstImxVpuDec *vpu_dec, GstBuffer *input_buffer, VpuBufferNode *in_data)
+{
+	guintptr phys_addr;
+	gboolean is_phys_input;
+
+	is_phys_input = gst_imx_vpu_dec_get_input_phys_addr(input_buffer, &phys_addr);
+	if (is_phys_input && !gst_imx_vpu_dec_is_input_aligned(input_buffer, phys_addr))
+	{
+		GST_LOG_OBJECT(vpu_dec, "input data at phys addr %p with %" G_GSIZE_FORMAT " bytes is not aligned to %d bytes", (gpointer)phys_addr, gst_buffer_get_size(input_buffer), BITSTREAM_RING_ALIGNMENT);
+		is_phys_input = FALSE;
+	}
+
+	if (!(vpu_dec->input_mode_decided))
+	{
+		gboolean supported_format;
+
+		vpu_dec->input_mode_decided = TRUE;
+
+		/* Formats without explicit frame boundaries (H.263, motion JPEG, WMV, VP8)
+		 * and streams which need codec data are excluded, since the wrapper
+		 * rewrites or accumulates the data of these */
+		switch (vpu_dec->codec_format)
+		{
+			case VPU_V_AVC:
+			case VPU_V_MPEG2:
+			case VPU_V_MPEG4:
+				supported_format = (vpu_dec->codec_data == NULL);
+				break;
+			default:
+				supported_format = FALSE;
+		}
+
+		if (supported_format && (is_phys_input || (vpu_dec->bitstream_ring_buffer_size > 0)) && gst_imx_vpu_dec_set_input_type(vpu_dec, VPU_DEC_IN_KICK))
+		{
+			vpu_dec->direct_input = TRUE;
+			GST_INFO_OBJECT(vpu_dec, "VPU reads input directly from %s", is_phys_input ? "upstream physical memory buffers" : "the bitstream ring buffer");
+		}
+		else
+			GST_INFO_OBJECT(vpu_dec, "VPU copies input into its internal bitstream buffer");
+	}
+
+	if (!(vpu_dec->direct_input))
+		return;
+
+	if (is_phys_input)
+	{
+		/* Make sure CPU writes from upstream reached the memory */
+		gst_imx_phys_mem_buffer_flush(input_buffer);
+		in_data->pPhyAddr = (unsigned char *)phys_addr;
+		GST_LOG_OBJECT(vpu_dec, "passing input data at phys addr %p directly to the VPU", (gpointer)phys_addr);
+		return;
+	}
+
+	if (vpu_dec->bitstream_ring_buffer_size > 0)
+	{
+		guint8 *virt_addr;
+
+		if (gst_imx_vpu_dec_write_to_bitstream_ring(vpu_dec, in_data->pVirAddr, in_data->nSize, &phys_addr, &virt_addr))
+		{
+			in_data->pPhyAddr = (unsigned char *)phys_addr;
+			in_data->pVirAddr = (unsigned char *)virt_addr;
+			return;
+		}
+	}
+
+	/* The input cannot be passed directly; switch back to the normal input
+	 * mode for the rest of the stream. Previous frames were complete, so
+	 * the wrapper's bitstream buffer does not contain partial data. */
+	GST_INFO_OBJECT(vpu_dec, "input cannot be read directly by the VPU; switching to normal input mode");
+	if (gst_imx_vpu_dec_set_input_type(vpu_dec, VPU_DEC_IN_NORMAL))
+		vpu_dec->direct_input = FALSE;
+}
+
+
+static gboolean gst_imx_vpu_dec_start_decode_thread(GstImxVpuDec *vpu_dec)
+{
+	GError *error = NULL;
+
+	vpu_dec->decode_thread_busy = FALSE;
+	vpu_dec->decode_thread_exit = FALSE;
+	vpu_dec->async_flow_ret = GST_FLOW_OK;
+
+	vpu_dec->decode_thread = g_thread_try_new("imxvpudec", gst_imx_vpu_dec_decode_thread_func, vpu_dec, &error);
+	if (vpu_dec->decode_thread == NULL)
+	{
+		GST_ERROR_OBJECT(vpu_dec, "could not start decode thread: %s", error->message);
+		g_error_free(error);
+		return FALSE;
+	}
+
+	GST_INFO_OBJECT(vpu_dec, "started decode thread with an input queue size of %u", vpu_dec->input_queue_size);
+
+	return TRUE;
+}
+
+
+static void gst_imx_vpu_dec_stop_decode_thread(GstImxVpuDec *vpu_dec)
+{
+	GQueue discarded_frames;
+
+	if (vpu_dec->decode_thread == NULL)
+		return;
+
+	g_mutex_lock(&(vpu_dec->input_queue_mutex));
+	vpu_dec->decode_thread_exit = TRUE;
+	discarded_frames = vpu_dec->input_queue;
+	g_queue_init(&(vpu_dec->input_queue));
+	g_cond_broadcast(&(vpu_dec->input_queue_cond));
+	g_mutex_unlock(&(vpu_dec->input_queue_mutex));
+
+	/* the decode thread might be waiting for framebuffers */
+	if (vpu_dec->current_framebuffers != NULL)
+	{
+		GST_IMX_VPU_FRAMEBUFFERS_LOCK(vpu_dec->current_framebuffers);
+		gst_imx_vpu_framebuffers_exit_wait_loop(vpu_dec->current_framebuffers);
+		g_cond_signal(&(vpu_dec->current_framebuffers->cond));
+		GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(vpu_dec->current_framebuffers);
+	}
+
+	g_thread_join(vpu_dec->decode_thread);
+	vpu_dec->decode_thread = NULL;
+
+	gst_imx_vpu_dec_release_frames(vpu_dec, &discarded_frames);
+
+	GST_INFO_OBJECT(vpu_dec, "stopped decode thread");
+}
+
+
+static gpointer gst_imx_vpu_dec_decode_thread_func(gpointer data)
+{
+	GstImxVpuDec *vpu_dec = GST_IMX_VPU_DEC(data);
+	GstVideoDecoder *decoder = GST_VIDEO_DECODER(data);
+
+	while (TRUE)
+	{
+		GstVideoCodecFrame *frame;
+		GstFlowReturn flow_ret;
+
+		g_mutex_lock(&(vpu_dec->input_queue_mutex));
+		while (g_queue_is_empty(&(vpu_dec->input_queue)) && !(vpu_dec->decode_thread_exit))
+			g_cond_wait(&(vpu_dec->input_queue_cond), &(vpu_dec->input_queue_mutex));
+		g_mutex_unlock(&(vpu_dec->input_queue_mutex));
+
+		/* The frame is taken out of the queue only after the stream lock is
+		 * acquired, since the queue might have been cleared in the meantime */
+		GST_VIDEO_DECODER_STREAM_LOCK(decoder);
+
+		g_mutex_lock(&(vpu_dec->input_queue_mutex));
+		if (vpu_dec->decode_thread_exit)
+		{
+			g_mutex_unlock(&(vpu_dec->input_queue_mutex));
+			GST_VIDEO_DECODER_STREAM_UNLOCK(decoder);
+			break;
+		}
+		frame = g_queue_pop_head(&(vpu_dec->input_queue));
+		flow_ret = vpu_dec->async_flow_ret;
+		vpu_dec->decode_thread_busy = (frame != NULL);
+		/* handle_frame() might be waiting for space in the queue */
+		g_cond_broadcast(&(vpu_dec->input_queue_cond));
+		g_mutex_unlock(&(vpu_dec->input_queue_mutex));
+
+		/* After an error, remaining frames are not decoded */
+		if (frame != NULL)
+		{
+			if (flow_ret == GST_FLOW_OK)
+				flow_ret = gst_imx_vpu_dec_decode_frame(decoder, frame);
+			else
+				gst_video_decoder_release_frame(decoder, frame);
+		}
+
+		GST_VIDEO_DECODER_STREAM_UNLOCK(decoder);
+
+		g_mutex_lock(&(vpu_dec->input_queue_mutex));
+		if ((flow_ret != GST_FLOW_OK) && (vpu_dec->async_flow_ret == GST_FLOW_OK))
+		{
+			GST_DEBUG_OBJECT(vpu_dec, "decode thread got flow return %s", gst_flow_get_name(flow_ret));
+			vpu_dec->async_flow_ret = flow_ret;
 		}
+		vpu_dec->decode_thread_busy = FALSE;
+		g_cond_broadcast(&(vpu_dec->input_queue_cond));
+		g_mutex_unlock(&(vpu_dec->input_queue_mutex));
 	}
 
-	if (!format_set)
-		return FALSE;
+	return NULL;
+}
 
-	open_param->nChromaInterleave = 0;
-	open_param->nMapType = 0;
-	open_param->nTiled2LinearEnable = 0;
-	open_param->nEnableFileMode = 0;
-	open_param->nPicWidth = state->info.width;
-	open_param->nPicHeight = state->info.height;
 
-	vpu_dec->codec_format = open_param->CodecFormat;
+static void gst_imx_vpu_dec_wait_for_decode_thread(GstImxVpuDec *vpu_dec, gboolean discard)
+{
+	GQueue discarded_frames = G_QUEUE_INIT;
 
-	return TRUE;
+	/* Called with the stream lock held, which is released while waiting,
+	 * since the decode thread needs it for decoding the queued frames */
+
+	if (vpu_dec->decode_thread == NULL)
+		return;
+
+	GST_VIDEO_DECODER_STREAM_UNLOCK(vpu_dec);
+
+	g_mutex_lock(&(vpu_dec->input_queue_mutex));
+
+	if (discard)
+	{
+		GST_DEBUG_OBJECT(vpu_dec, "discarding %u queued input frames", g_queue_get_length(&(vpu_dec->input_queue)));
+		discarded_frames = vpu_dec->input_queue;
+		g_queue_init(&(vpu_dec->input_queue));
+		g_cond_broadcast(&(vpu_dec->input_queue_cond));
+	}
+
+	while (!g_queue_is_empty(&(vpu_dec->input_queue)) || vpu_dec->decode_thread_busy)
+		g_cond_wait(&(vpu_dec->input_queue_cond), &(vpu_dec->input_queue_mutex));
+
+	g_mutex_unlock(&(vpu_dec->input_queue_mutex));
+
+	GST_VIDEO_DECODER_STREAM_LOCK(vpu_dec);
+
+	gst_imx_vpu_dec_release_frames(vpu_dec, &discarded_frames);
 }
 
 
-static void gst_imx_vpu_dec_close_decoder(GstImxVpuDec *vpu_dec)
+/* Releases frames that were taken out of the input queue without being decoded.
+ * The queue owns the references handle_frame() received. */
+static void gst_imx_vpu_dec_release_frames(GstImxVpuDec *vpu_dec, GQueue *frames)
 {
-	VpuDecRetCode dec_ret;
+	GstVideoCodecFrame *frame;
 
-	if (vpu_dec->vpu_inst_opened)
-	{
-		dec_ret = VPU_DecFlushAll(vpu_dec->handle);
-		if (dec_ret == VPU_DEC_RET_FAILURE_TIMEOUT)
-		{
-			GST_WARNING_OBJECT(vpu_dec, "resetting decoder after a timeout occurred");
-			dec_ret = VPU_DecReset(vpu_dec->handle);
-			if (dec_ret != VPU_DEC_RET_SUCCESS)
-				GST_ERROR_OBJECT(vpu_dec, "resetting decoder failed: %s", gst_imx_vpu_strerror(dec_ret));
-		}
-		else if (dec_ret != VPU_DEC_RET_SUCCESS)
-			GST_ERROR_OBJECT(vpu_dec, "flushing decoder failed: %s", gst_imx_vpu_strerror(dec_ret));
+	while ((frame = g_queue_pop_head(frames)) != NULL)
+		gst_video_decoder_release_frame(GST_VIDEO_DECODER(vpu_dec), frame);
+}
 
-		dec_ret = VPU_DecClose(vpu_dec->handle);
-		if (dec_ret != VPU_DEC_RET_SUCCESS)
-			GST_ERROR_OBJECT(vpu_dec, "closing decoder failed: %s", gst_imx_vpu_strerror(dec_ret));
 
-		GST_INFO_OBJECT(vpu_dec, "VPU decoder closed");
+static void gst_imx_vpu_dec_wait_for_framebuffers(GstImxVpuDec *vpu_dec)
+{
+	/* Called with the framebuffers mutex locked. The decode thread releases
+	 * the stream lock while waiting, so the streaming thread can keep queuing
+	 * frames and handle events in the meantime. The framebuffers mutex is
+	 * unlocked first to keep the stream lock -> framebuffers mutex order. */
 
-		vpu_dec->vpu_inst_opened = FALSE;
+	GstImxVpuFramebuffers *framebuffers = vpu_dec->current_framebuffers;
+
+	if ((vpu_dec->decode_thread == NULL) || (g_thread_self() != vpu_dec->decode_thread))
+	{
+		gst_imx_vpu_framebuffers_wait_until_frames_available(framebuffers);
+		return;
 	}
+
+	GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(framebuffers);
+	GST_VIDEO_DECODER_STREAM_UNLOCK(vpu_dec);
+
+	GST_IMX_VPU_FRAMEBUFFERS_LOCK(framebuffers);
+	gst_imx_vpu_framebuffers_wait_until_frames_available(framebuffers);
+	GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(framebuffers);
+
+	GST_VIDEO_DECODER_STREAM_LOCK(vpu_dec);
+	GST_IMX_VPU_FRAMEBUFFERS_LOCK(framebuffers);
 }
 
 
@@ -640,8 +1899,6 @@ static gboolean gst_imx_vpu_dec_start(GstVideoDecoder *decoder)
 		return FALSE;
 	}
 
-	vpu_dec->frame_table = g_hash_table_new(NULL, NULL);
-
 	/* Allocate the work buffers
 	 * Note that these are independent of decoder instances, so they
 	 * are allocated before the VPU_DecOpen() call, and are not
@@ -651,6 +1908,9 @@ static gboolean gst_imx_vpu_dec_start(GstVideoDecoder *decoder)
 
 #undef VPUINIT_ERR
 
+	if ((vpu_dec->input_queue_size > 0) && !gst_imx_vpu_dec_start_decode_thread(vpu_dec))
+		return FALSE;
+
 	/* The decoder is initialized in set_format, not here, since only then the input bitstream
 	 * format is known (and this information is necessary for initialization). */
 
@@ -672,21 +1932,29 @@ static gboolean gst_imx_vpu_dec_stop(GstVideoDecoder *decoder)
 	vpu_dec = GST_IMX_VPU_DEC(decoder);
 	klass = GST_IMX_VPU_DEC_CLASS(G_OBJECT_GET_CLASS(vpu_dec));
 
-	if (vpu_dec->current_framebuffers != NULL)
-	{
-		/* Using mutexes here to prevent race conditions when decoder_open is set to
-		 * FALSE at the same time as it is checked in the buffer pool release() function */
-		GST_IMX_VPU_FRAMEBUFFERS_LOCK(vpu_dec->current_framebuffers);
-		gst_imx_vpu_framebuffers_set_flushing(vpu_dec->current_framebuffers, TRUE);
-		vpu_dec->current_framebuffers->decenc_states.dec.decoder_open = FALSE;
-		GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(vpu_dec->current_framebuffers);
+	gst_imx_vpu_dec_stop_decode_thread(vpu_dec);
 
-		gst_object_unref(vpu_dec->current_framebuffers);
-		vpu_dec->current_framebuffers = NULL;
+	gst_imx_vpu_dec_retire_framebuffers(vpu_dec);
+	if (vpu_dec->previous_framebuffers != NULL)
+	{
+		gst_object_unref(vpu_dec->previous_framebuffers);
+		vpu_dec->previous_framebuffers = NULL;
 	}
+	vpu_dec->num_grown_framebuffers = 0;
+	vpu_dec->framebuffers_pending = FALSE;
+	vpu_dec->copy_output_frames = FALSE;
+	vpu_dec->dmabuf_output = FALSE;
+
+	GST_INFO_OBJECT(vpu_dec, "framebuffer statistics:  sets with reused framebuffers: %u  reused framebuffers: %u  allocated framebuffers: %u", vpu_dec->num_framebuffer_set_reuses, vpu_dec->num_reused_framebuffers, vpu_dec->num_allocated_framebuffers);
+	vpu_dec->num_framebuffer_set_reuses = 0;
+	vpu_dec->num_reused_framebuffers = 0;
+	vpu_dec->num_allocated_framebuffers = 0;
 
 	gst_imx_vpu_dec_close_decoder(vpu_dec);
 	gst_imx_vpu_dec_free_dec_mem_blocks(vpu_dec);
+	gst_imx_vpu_dec_free_bitstream_ring(vpu_dec);
+	vpu_dec->direct_input = FALSE;
+	vpu_dec->input_mode_decided = FALSE;
 
 	if (vpu_dec->codec_data != NULL)
 	{
@@ -700,10 +1968,15 @@ static gboolean gst_imx_vpu_dec_stop(GstVideoDecoder *decoder)
 		vpu_dec->current_output_state = NULL;
 	}
 
-	if (vpu_dec->frame_table != NULL)
+	g_free(vpu_dec->fb_frame_numbers);
+	vpu_dec->fb_frame_numbers = NULL;
+	vpu_dec->num_fb_frame_numbers = 0;
+	vpu_dec->pts_queue_len = 0;
+
 	{
-		g_hash_table_destroy(vpu_dec->frame_table);
-		vpu_dec->frame_table = NULL;
+		GstAllocator *allocator = gst_imx_vpu_dec_allocator_obtain();
+		gst_imx_phys_mem_allocator_log_recycler_stats(GST_IMX_PHYS_MEM_ALLOCATOR(allocator), GST_OBJECT(vpu_dec));
+		gst_object_unref(GST_OBJECT(allocator));
 	}
 
 	GST_INFO_OBJECT(vpu_dec, "VPU decoder stopped");
@@ -737,23 +2010,18 @@ static gboolean gst_imx_vpu_dec_set_format(GstVideoDecoder *decoder, GstVideoCod
 	GstBuffer *codec_data = NULL;
 	GstImxVpuDec *vpu_dec = GST_IMX_VPU_DEC(decoder);
 
-	/* Clean up existing framebuffers structure;
-	 * if some previous and still existing buffer pools depend on this framebuffers
-	 * structure, they will extend its lifetime, since they ref'd it
-	 */
-	if (vpu_dec->current_framebuffers != NULL)
+	/* Frames queued for the decode thread belong to the old format */
+	if (vpu_dec->decode_thread != NULL)
 	{
-		/* Using mutexes here to prevent race conditions when decoder_open is set to
-		 * FALSE at the same time as it is checked in the buffer pool release() function */
-		GST_IMX_VPU_FRAMEBUFFERS_LOCK(vpu_dec->current_framebuffers);
-		gst_imx_vpu_framebuffers_set_flushing(vpu_dec->current_framebuffers, TRUE);
-		vpu_dec->current_framebuffers->decenc_states.dec.decoder_open = FALSE;
-		GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(vpu_dec->current_framebuffers);
-
-		gst_object_unref(vpu_dec->current_framebuffers);
-		vpu_dec->current_framebuffers = NULL;
+		gst_imx_vpu_dec_wait_for_decode_thread(vpu_dec, FALSE);
+		vpu_dec->async_flow_ret = GST_FLOW_OK;
 	}
 
+	/* Retire existing framebuffers structure; it is kept around in case
+	 * the new stream fits in it (see gst_imx_vpu_dec_retire_framebuffers() )
+	 */
+	gst_imx_vpu_dec_retire_framebuffers(vpu_dec);
+
 	/* Clean up old codec data copy */
 	if (vpu_dec->codec_data != NULL)
 	{
@@ -771,6 +2039,14 @@ static gboolean gst_imx_vpu_dec_set_format(GstVideoDecoder *decoder, GstVideoCod
 	/* Close old decoder instance */
 	gst_imx_vpu_dec_close_decoder(vpu_dec);
 
+	/* The new instance starts in normal input mode; the input mode
+	 * is decided again once the first frame comes in */
+	vpu_dec->direct_input = FALSE;
+	vpu_dec->input_mode_decided = FALSE;
+	vpu_dec->bitstream_ring_offset = 0;
+
+	vpu_dec->pts_queue_len = 0;
+
 	memset(&open_param, 0, sizeof(open_param));
 
 	/* codec_data does not need to be unref'd after use; it is owned by the caps structure */
@@ -781,6 +2057,9 @@ static gboolean gst_imx_vpu_dec_set_format(GstVideoDecoder *decoder, GstVideoCod
 	}
 	vpu_dec->is_mjpeg = (open_param.CodecFormat == VPU_V_MJPG);
 
+	vpu_dec->chroma_interleave = gst_imx_vpu_dec_use_chroma_interleave(vpu_dec);
+	open_param.nChromaInterleave = vpu_dec->chroma_interleave ? 1 : 0;
+
 	/* The actual initialization; requires bitstream information (such as the codec type), which
 	 * is determined by the fill_param_set call before */
 	ret = VPU_DecOpen(&(vpu_dec->handle), &open_param, &(vpu_dec->mem_info));
@@ -802,6 +2081,10 @@ static gboolean gst_imx_vpu_dec_set_format(GstVideoDecoder *decoder, GstVideoCod
 		GST_ERROR_OBJECT(vpu_dec, "could not configure skip mode: %s", gst_imx_vpu_strerror(ret));
 		return FALSE;
 	}
+	vpu_dec->skip_mode = VPU_DEC_SKIPNONE;
+	vpu_dec->num_qos_on_time_frames = 0;
+	vpu_dec->keyframes_only = FALSE;
+	vpu_dec->wait_for_keyframe = FALSE;
 
 	config_param = 0;
 	ret = VPU_DecConfig(vpu_dec->handle, VPU_DEC_CONF_BUFDELAY, &config_param);
@@ -831,6 +2114,41 @@ static gboolean gst_imx_vpu_dec_set_format(GstVideoDecoder *decoder, GstVideoCod
 
 
 static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstVideoCodecFrame *cur_frame)
+{
+	GstFlowReturn flow_ret;
+	GstImxVpuDec *vpu_dec = GST_IMX_VPU_DEC(decoder);
+
+	if (vpu_dec->decode_thread == NULL)
+		return gst_imx_vpu_dec_decode_frame(decoder, cur_frame);
+
+	/* Pass the frame on to the decode thread. The stream lock is released
+	 * while waiting for space in the queue, since the decode thread needs it. */
+	GST_VIDEO_DECODER_STREAM_UNLOCK(decoder);
+
+	g_mutex_lock(&(vpu_dec->input_queue_mutex));
+	while ((g_queue_get_length(&(vpu_dec->input_queue)) >= vpu_dec->input_queue_size) && (vpu_dec->async_flow_ret == GST_FLOW_OK))
+		g_cond_wait(&(vpu_dec->input_queue_cond), &(vpu_dec->input_queue_mutex));
+
+	/* Errors from the decode thread are reported here, since
+	 * they cannot be returned to upstream any other way */
+	flow_ret = vpu_dec->async_flow_ret;
+	if (flow_ret == GST_FLOW_OK)
+	{
+		g_queue_push_tail(&(vpu_dec->input_queue), cur_frame);
+		g_cond_broadcast(&(vpu_dec->input_queue_cond));
+	}
+	g_mutex_unlock(&(vpu_dec->input_queue_mutex));
+
+	GST_VIDEO_DECODER_STREAM_LOCK(decoder);
+
+	if (flow_ret != GST_FLOW_OK)
+		gst_video_decoder_release_frame(decoder, cur_frame);
+
+	return flow_ret;
+}
+
+
+static GstFlowReturn gst_imx_vpu_dec_decode_frame(GstVideoDecoder *decoder, GstVideoCodecFrame *cur_frame)
 {
 	int buffer_ret_code;
 	VpuDecRetCode dec_ret;
@@ -838,11 +2156,38 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 	GstMapInfo in_map_info;
 	GstMapInfo codecdata_map_info;
 	GstImxVpuDec *vpu_dec;
+	gint skipped_frame_number = -1;
 
 	vpu_dec = GST_IMX_VPU_DEC(decoder);
 
 	memset(&in_data, 0, sizeof(in_data));
 
+	/* After a decoding error, decoding continues at the next keyframe */
+	if ((cur_frame != NULL) && vpu_dec->wait_for_keyframe)
+	{
+		if (!GST_VIDEO_CODEC_FRAME_IS_SYNC_POINT(cur_frame))
+		{
+			GST_LOG_OBJECT(vpu_dec, "dropping frame with system frame number %u while waiting for a keyframe", cur_frame->system_frame_number);
+			return gst_video_decoder_drop_frame(decoder, cur_frame);
+		}
+
+		GST_INFO_OBJECT(vpu_dec, "got keyframe; resuming decoding");
+		vpu_dec->wait_for_keyframe = FALSE;
+	}
+
+	if ((cur_frame != NULL) && (vpu_dec->current_framebuffers != NULL))
+	{
+		/* Discard non-keyframes right away if only keyframes are decoded;
+		 * this spares the VPU from even parsing them */
+		if (gst_imx_vpu_dec_is_keyframes_only(vpu_dec) && !GST_VIDEO_CODEC_FRAME_IS_SYNC_POINT(cur_frame))
+		{
+			GST_LOG_OBJECT(vpu_dec, "dropping non-keyframe with system frame number %u", cur_frame->system_frame_number);
+			return gst_video_decoder_drop_frame(decoder, cur_frame);
+		}
+
+		gst_imx_vpu_dec_update_skip_mode(vpu_dec, cur_frame);
+	}
+
 	if (cur_frame != NULL)
 	{
 		gst_buffer_map(cur_frame->input_buffer, &in_map_info, GST_MAP_READ);
@@ -850,9 +2195,14 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 		in_data.pPhyAddr = NULL;
 		in_data.pVirAddr = (unsigned char *)(in_map_info.data);
 		in_data.nSize = in_map_info.size;
+
+		gst_imx_vpu_dec_prepare_input(vpu_dec, cur_frame->input_buffer, &in_data);
+
+		if (vpu_dec->no_explicit_frame_boundary && GST_CLOCK_TIME_IS_VALID(cur_frame->pts))
+			gst_imx_vpu_dec_push_pts(vpu_dec, cur_frame->pts);
 	}
 
-	/* cur_frame is NULL if handle_frame() is being called inside finish(); in other words,
+	/* cur_frame is NULL if decode_frame() is being called inside finish(); in other words,
 	 * when the decoder is shutting down, and output frames are being flushed.
 	 * This requires the decoder output mode to have been set to DRAIN before, which is
 	 * done in finish(). */
@@ -884,8 +2234,24 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 
 	if (dec_ret != VPU_DEC_RET_SUCCESS)
 	{
-		GST_ERROR_OBJECT(vpu_dec, "failed to decode frame: %s", gst_imx_vpu_strerror(dec_ret));
-		return GST_FLOW_ERROR;
+		if (!(vpu_dec->error_resilience))
+		{
+			GST_ERROR_OBJECT(vpu_dec, "failed to decode frame: %s", gst_imx_vpu_strerror(dec_ret));
+			return GST_FLOW_ERROR;
+		}
+
+		GST_WARNING_OBJECT(vpu_dec, "failed to decode frame: %s; dropping frames until the next keyframe", gst_imx_vpu_strerror(dec_ret));
+
+		if (cur_frame != NULL)
+			gst_buffer_unmap(cur_frame->input_buffer, &in_map_info);
+		if (vpu_dec->codec_data != NULL)
+			gst_buffer_unmap(vpu_dec->codec_data, &codecdata_map_info);
+
+		/* this also drops cur_frame */
+		gst_imx_vpu_dec_recover_from_error(vpu_dec);
+
+		/* when draining, nothing more can be output after the VPU was flushed */
+		return (cur_frame != NULL) ? GST_FLOW_OK : GST_FLOW_EOS;
 	}
 
 	GST_LOG_OBJECT(vpu_dec, "VPU_DecDecodeBuf returns: %x", buffer_ret_code);
@@ -922,41 +2288,87 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 			}
 		}
 		else
-			fmt = GST_VIDEO_FORMAT_I420;
+			fmt = vpu_dec->chroma_interleave ? GST_VIDEO_FORMAT_NV12 : GST_VIDEO_FORMAT_I420;
 
 		GST_LOG_OBJECT(vpu_dec, "using %s as video output format", gst_video_format_to_string(fmt));
 
-		/* Allocate and register a new set of framebuffers for decoding
+		/* Add information from init_info to the output state and set it to be the output state for this decoder */
+		if (vpu_dec->current_output_state != NULL)
+		{
+			GstVideoCodecState *state = vpu_dec->current_output_state;
+
+			/* Interlaced streams can also contain progressive pictures; each
+			 * output buffer is flagged accordingly (see set_interlace_flags) */
+			GST_VIDEO_INFO_INTERLACE_MODE(&(state->info)) = vpu_dec->init_info.nInterlace ? GST_VIDEO_INTERLACE_MODE_MIXED : GST_VIDEO_INTERLACE_MODE_PROGRESSIVE;
+			gst_video_decoder_set_output_state(decoder, fmt, state->info.width, state->info.height, state);
+			gst_video_codec_state_unref(vpu_dec->current_output_state);
+
+			vpu_dec->current_output_state = NULL;
+
+			vpu_dec->dmabuf_output = gst_imx_vpu_dec_use_dmabuf_output(vpu_dec);
+		}
+
+		/* Register a set of framebuffers for decoding
 		 * This point is always reached after set_format() was called,
-		 * and always before a frame is output */
+		 * and always before a frame is output; it is also reached if the
+		 * VPU reinitializes itself because of a new sequence header.
+		 * The framebuffers are set up in decide_allocation(), since the
+		 * number of buffers downstream holds is only known there. */
 		{
-			guint min_fbcount_indicated_by_vpu;
-			GstImxVpuFramebufferParams fbparams;
-			gst_imx_vpu_framebuffers_dec_init_info_to_params(&(vpu_dec->init_info), &fbparams);
+			gst_imx_vpu_framebuffers_dec_init_info_to_params(&(vpu_dec->init_info), &(vpu_dec->pending_fbparams));
+			vpu_dec->pending_fbparams.chroma_interleave = vpu_dec->chroma_interleave ? 1 : 0;
+			vpu_dec->pending_fbparams.exportable = vpu_dec->dmabuf_output ? 1 : 0;
+
+			if (vpu_dec->thumbnail_mode)
+				vpu_dec->pending_min_num_free_framebuffers = GST_IMX_VPU_THUMBNAIL_MIN_NUM_FREE_FRAMEBUFFERS;
+			else if (vpu_dec->low_latency)
+				vpu_dec->pending_min_num_free_framebuffers = GST_IMX_VPU_LOW_LATENCY_MIN_NUM_FREE_FRAMEBUFFERS;
+			else
+				vpu_dec->pending_min_num_free_framebuffers = GST_IMX_VPU_MIN_NUM_FREE_FRAMEBUFFERS;
+
+			/* Framebuffers registered before a reinitialization are candidates for reuse as well */
+			gst_imx_vpu_dec_retire_framebuffers(vpu_dec);
 
-			min_fbcount_indicated_by_vpu = (guint)(fbparams.min_framebuffer_count);
+			/* If the decoder repeatedly had to wait for downstream to return framebuffers,
+			 * downstream holds more of them than it announced; allocate more this time
+			 * (the VPU cannot register additional framebuffers later on, so until then,
+			 * frames are copied out of the framebuffers; see must_copy_output_frames()) */
+			if (vpu_dec->copy_output_frames && (vpu_dec->num_grown_framebuffers < GST_IMX_VPU_DEC_MAX_GROWN_FRAMEBUFFERS))
+			{
+				vpu_dec->num_grown_framebuffers = MIN(vpu_dec->num_grown_framebuffers + GST_IMX_VPU_DEC_FRAMEBUFFER_GROWTH_STEP, GST_IMX_VPU_DEC_MAX_GROWN_FRAMEBUFFERS);
+				GST_INFO_OBJECT(vpu_dec, "previous framebuffers ran out; growing number of extra framebuffers to %u", vpu_dec->num_grown_framebuffers);
+			}
 
-			fbparams.min_framebuffer_count = min_fbcount_indicated_by_vpu + GST_IMX_VPU_MIN_NUM_FREE_FRAMEBUFFERS + vpu_dec->num_additional_framebuffers;
-			GST_INFO_OBJECT(vpu_dec, "minimum number of framebuffers indicated by the VPU: %u  chosen number: %u", min_fbcount_indicated_by_vpu, fbparams.min_framebuffer_count);
+			vpu_dec->framebuffers_pending = TRUE;
 
-			vpu_dec->current_framebuffers = gst_imx_vpu_framebuffers_new(&fbparams, gst_imx_vpu_dec_allocator_obtain());
-			if (vpu_dec->current_framebuffers == NULL)
-				return GST_FLOW_ERROR;
+			/* Negotiate right away instead of when the first frame is output */
+			if (!gst_video_decoder_negotiate(decoder))
+				GST_WARNING_OBJECT(vpu_dec, "negotiation failed; setting up framebuffers without knowing how many buffers downstream holds");
 
-			if (!gst_imx_vpu_framebuffers_register_with_decoder(vpu_dec->current_framebuffers, vpu_dec->handle))
+			if (vpu_dec->framebuffers_pending && !gst_imx_vpu_dec_setup_pending_framebuffers(vpu_dec, 0))
 				return GST_FLOW_ERROR;
 		}
 
-		/* Add information from init_info to the output state and set it to be the output state for this decoder */
-		if (vpu_dec->current_output_state != NULL)
 		{
-			GstVideoCodecState *state = vpu_dec->current_output_state;
-
-			GST_VIDEO_INFO_INTERLACE_MODE(&(state->info)) = vpu_dec->init_info.nInterlace ? GST_VIDEO_INTERLACE_MODE_INTERLEAVED : GST_VIDEO_INTERLACE_MODE_PROGRESSIVE;
-			gst_video_decoder_set_output_state(decoder, fmt, state->info.width, state->info.height, state);
-			gst_video_codec_state_unref(vpu_dec->current_output_state);
+			GstVideoCodecState *output_state = gst_video_decoder_get_output_state(decoder);
+			guint num_reorder_frames;
+
+			/* With h.264 reordering, the VPU's minimum framebuffer count (which
+			 * includes the DPB) bounds the number of frames held back; other formats
+			 * hold back at most one frame (because of B-frames), except for the
+			 * ones which do not support B-frames at all */
+			if (vpu_dec->codec_format == VPU_V_AVC)
+				num_reorder_frames = vpu_dec->reorder_enabled ? (MAX(vpu_dec->init_info.nMinFrameBufferCount, 1) - 1) : 0;
+			else if ((vpu_dec->codec_format == VPU_V_MJPG) || (vpu_dec->codec_format == VPU_V_H263))
+				num_reorder_frames = 0;
+			else
+				num_reorder_frames = 1;
 
-			vpu_dec->current_output_state = NULL;
+			if (output_state != NULL)
+			{
+				gst_imx_vpu_dec_update_latency(vpu_dec, output_state, num_reorder_frames);
+				gst_video_codec_state_unref(output_state);
+			}
 		}
 
 		vpu_dec->delay_sys_frame_numbers = TRUE;
@@ -1040,20 +2452,29 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 			 * Unfortunately, the VPU wrapper API doesn't allow to associate extra data with the
 			 * output framebuffer structure. Therefore, a trick is used: the output framebuffer that
 			 * gets consumed after the decoder is given input data is the one where the corresponding
-			 * decoded frame will end up. Therefore, a hash table is used, which uses the framebuffer's
-			 * address as key, and the frame number as value. When the VPU wrapper reports a frame as
-			 * available for display, the associated frame number is looked up in this table. */
-			if (frame_number != -1)
-				g_hash_table_replace(vpu_dec->frame_table, (gpointer)(dec_framelen_info.pFrame), (gpointer)(frame_number + 1));
+			 * decoded frame will end up. Therefore, an array is used, which is indexed by the
+			 * framebuffer's index, and contains the frame number. When the VPU wrapper reports a frame
+			 * as available for display, the associated frame number is looked up in this array. */
+			if (buffer_ret_code & VPU_DEC_SKIP)
+			{
+				/* Skipped frames are not decoded into any framebuffer */
+				skipped_frame_number = frame_number;
+			}
+			else if (frame_number != -1)
+			{
+				gint fb_index = gst_imx_vpu_dec_get_fb_index(vpu_dec, dec_framelen_info.pFrame);
+				if (fb_index >= 0)
+					vpu_dec->fb_frame_numbers[fb_index] = frame_number;
+			}
 		}
 
-		/* If VPU_DEC_OUTPUT_DROPPED is set, then the internal counter will not be modified */
-		if ((buffer_ret_code & VPU_DEC_ONE_FRM_CONSUMED) && !(buffer_ret_code & VPU_DEC_OUTPUT_DROPPED))
+		/* If VPU_DEC_OUTPUT_DROPPED or VPU_DEC_SKIP is set, then the internal counter will not be modified */
+		if ((buffer_ret_code & VPU_DEC_ONE_FRM_CONSUMED) && !(buffer_ret_code & (VPU_DEC_OUTPUT_DROPPED | VPU_DEC_SKIP)))
 		{
 			gint old_num_available_framebuffers = vpu_dec->current_framebuffers->num_available_framebuffers;
 
 			/* wait until frames are available or until flushing occurs */
-			gst_imx_vpu_framebuffers_wait_until_frames_available(vpu_dec->current_framebuffers);
+			gst_imx_vpu_dec_wait_for_framebuffers(vpu_dec);
 
 			vpu_dec->current_framebuffers->num_available_framebuffers--;
 			vpu_dec->current_framebuffers->decremented_availbuf_counter++;
@@ -1072,6 +2493,27 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 	if (buffer_ret_code & VPU_DEC_NO_ENOUGH_BUF)
 		GST_WARNING_OBJECT(vpu_dec, "no free output frame available (ret code: 0x%X)", buffer_ret_code);
 
+	if (buffer_ret_code & VPU_DEC_SKIP)
+	{
+		/* The VPU skipped this frame because of the current skip mode; drop it,
+		 * so it is accounted for in QoS statistics and does not stay pending */
+		GstVideoCodecFrame *skipped_frame = NULL;
+
+		if (skipped_frame_number != -1)
+			skipped_frame = gst_video_decoder_get_frame(decoder, skipped_frame_number);
+		else if (vpu_dec->no_explicit_frame_boundary)
+			skipped_frame = gst_video_decoder_get_oldest_frame(decoder);
+
+		if (skipped_frame != NULL)
+		{
+			GST_LOG_OBJECT(vpu_dec, "VPU skipped frame with system frame number %u", skipped_frame->system_frame_number);
+			if (vpu_dec->no_explicit_frame_boundary)
+				gst_imx_vpu_dec_remove_pts(vpu_dec, skipped_frame->pts);
+			gst_video_codec_frame_unref(skipped_frame);
+			gst_video_decoder_drop_frame(decoder, skipped_frame);
+		}
+	}
+
 	if (buffer_ret_code & VPU_DEC_OUTPUT_NODIS)
 	{
 		if (vpu_dec->no_explicit_frame_boundary)
@@ -1079,7 +2521,7 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 			GST_IMX_VPU_FRAMEBUFFERS_LOCK(vpu_dec->current_framebuffers);
 
 			/* wait until frames are available or until flushing occurs */
-			gst_imx_vpu_framebuffers_wait_until_frames_available(vpu_dec->current_framebuffers);
+			gst_imx_vpu_dec_wait_for_framebuffers(vpu_dec);
 
 			GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(vpu_dec->current_framebuffers);
 		}
@@ -1089,6 +2531,9 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 			/* With VP8 data, NODIS is returned for alternate reference frames, which
 			 * are not supposed to be shown, only decoded */
 
+			if (vpu_dec->no_explicit_frame_boundary)
+				gst_imx_vpu_dec_remove_pts(vpu_dec, cur_frame->pts);
+
 			GST_VIDEO_CODEC_FRAME_SET_DECODE_ONLY(cur_frame);
 			gst_video_decoder_finish_frame(decoder, cur_frame);
 
@@ -1098,13 +2543,16 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 		}
 	}
 
-	if (buffer_ret_code & VPU_DEC_OUTPUT_DIS)
+	/* In error resilience mode, mosaic frames (which contain error concealment
+	 * data) are output like regular frames, but flagged as corrupted */
+	if ((buffer_ret_code & VPU_DEC_OUTPUT_DIS) || ((buffer_ret_code & VPU_DEC_OUTPUT_MOSAIC_DIS) && vpu_dec->error_resilience))
 	{
 		GstBuffer *buffer;
 		VpuDecOutFrameInfo out_frame_info;
 		GstVideoCodecFrame *out_frame;
 		guint32 out_system_frame_number;
 		gboolean sys_frame_nr_valid;
+		gboolean corrupted = !(buffer_ret_code & VPU_DEC_OUTPUT_DIS);
 
 		/* Retrieve the decoded frame */
 		dec_ret = VPU_DecGetOutputFrame(vpu_dec->handle, &out_frame_info);
@@ -1119,7 +2567,7 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 			GST_IMX_VPU_FRAMEBUFFERS_LOCK(vpu_dec->current_framebuffers);
 
 			/* wait until frames are available or until flushing occurs */
-			gst_imx_vpu_framebuffers_wait_until_frames_available(vpu_dec->current_framebuffers);
+			gst_imx_vpu_dec_wait_for_framebuffers(vpu_dec);
 
 			vpu_dec->current_framebuffers->num_available_framebuffers--;
 			vpu_dec->current_framebuffers->decremented_availbuf_counter++;
@@ -1127,7 +2575,6 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 			GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(vpu_dec->current_framebuffers);
 		}
 
-		out_system_frame_number = (guint32)(g_hash_table_lookup(vpu_dec->frame_table, (gpointer)(out_frame_info.pDisplayFrameBuf)));
 		sys_frame_nr_valid = FALSE;
 		if (vpu_dec->no_explicit_frame_boundary)
 		{
@@ -1135,11 +2582,13 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 		}
 		else
 		{
-			if (out_system_frame_number > 0)
+			gint fb_index = gst_imx_vpu_dec_get_fb_index(vpu_dec, out_frame_info.pDisplayFrameBuf);
+
+			if ((fb_index >= 0) && (vpu_dec->fb_frame_numbers[fb_index] >= 0))
 			{
-				g_hash_table_remove(vpu_dec->frame_table, (gpointer)(out_frame_info.pDisplayFrameBuf));
+				out_system_frame_number = vpu_dec->fb_frame_numbers[fb_index];
+				vpu_dec->fb_frame_numbers[fb_index] = -1;
 
-				out_system_frame_number--;
 				out_frame = gst_video_decoder_get_frame(decoder, out_system_frame_number);
 				if (out_frame != NULL)
 				{
@@ -1161,6 +2610,15 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 			gst_buffer_unref(buffer);
 			return GST_FLOW_ERROR;
 		}
+		gst_imx_vpu_dec_set_interlace_flags(vpu_dec, buffer, out_frame_info.eFieldType);
+
+		if (corrupted)
+		{
+			GST_DEBUG_OBJECT(vpu_dec, "outputting error concealment frame");
+			GST_BUFFER_FLAG_SET(buffer, GST_BUFFER_FLAG_CORRUPTED);
+		}
+		else
+			GST_BUFFER_FLAG_UNSET(buffer, GST_BUFFER_FLAG_CORRUPTED);
 
 		if (sys_frame_nr_valid)
 		{
@@ -1171,6 +2629,16 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 			GST_LOG_OBJECT(vpu_dec, "system frame number invalid or unusable - getting oldest pending frame instead");
 			out_frame = gst_video_decoder_get_oldest_frame(decoder);
 
+			/* Frames are output in display order, but the oldest pending frame is the
+			 * oldest one in decoding order; its timestamp is wrong if frames are reordered.
+			 * The lowest pending input timestamp is the correct one in display order. */
+			if ((out_frame != NULL) && vpu_dec->no_explicit_frame_boundary)
+			{
+				GstClockTime pts = gst_imx_vpu_dec_pop_pts(vpu_dec);
+				if (GST_CLOCK_TIME_IS_VALID(pts))
+					out_frame->pts = pts;
+			}
+
 			GST_LOG_OBJECT(vpu_dec, "output frame:  codecframe: %p  framebuffer phys addr: %p  system frame number: <none; oldest frame>  gstbuffer addr: %p  pic type: %d  Y stride: %d  CbCr stride: %d", (gpointer)out_frame, (gpointer)(out_frame_info.pDisplayFrameBuf->pbufY), (gpointer)buffer, out_frame_info.ePicType, out_frame_info.pDisplayFrameBuf->nStrideY, out_frame_info.pDisplayFrameBuf->nStrideC);
 		}
 
@@ -1181,6 +2649,18 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 		 * used yet, mark it now as undisplayed. */
 		gst_imx_vpu_mark_buf_as_not_displayed(buffer);
 
+		/* Copied frames do not keep the framebuffer occupied downstream;
+		 * unref'ing the original buffer returns the framebuffer to the VPU */
+		if (gst_imx_vpu_dec_must_copy_output_frames(vpu_dec))
+		{
+			GstBuffer *copy = gst_imx_vpu_dec_copy_output_frame(vpu_dec, buffer);
+			if (copy != NULL)
+			{
+				gst_buffer_unref(buffer);
+				buffer = copy;
+			}
+		}
+
 		if (out_frame != NULL)
 		{
 			/* Unref output frame, since get_frame() and get_oldest_frame() ref it */
@@ -1198,7 +2678,8 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 	}
 	else if (buffer_ret_code & VPU_DEC_OUTPUT_MOSAIC_DIS)
 	{
-		/* XXX: mosaic frames do not seem to be useful for anything, so they are just dropped here */
+		/* XXX: mosaic frames do not seem to be useful for anything, so they are just dropped here
+		 * (unless error resilience is enabled; see above) */
 
 		VpuDecOutFrameInfo out_frame_info;
 
@@ -1223,13 +2704,20 @@ static GstFlowReturn gst_imx_vpu_dec_handle_frame(GstVideoDecoder *decoder, GstV
 		vpu_dec->current_framebuffers->num_available_framebuffers++;
 		GST_DEBUG_OBJECT(vpu_dec, "number of available buffers after dropping mosaic frame: %d -> %d", vpu_dec->current_framebuffers->num_available_framebuffers - 1, vpu_dec->current_framebuffers->num_available_framebuffers);
 		GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(vpu_dec->current_framebuffers);
+
+		/* The dropped mosaic frame occupied a slot in display order */
+		if (vpu_dec->no_explicit_frame_boundary)
+			gst_imx_vpu_dec_pop_pts(vpu_dec);
 	}
-	else if (buffer_ret_code & VPU_DEC_OUTPUT_DROPPED)
+	else if ((buffer_ret_code & VPU_DEC_OUTPUT_DROPPED) && !(buffer_ret_code & VPU_DEC_SKIP))
 	{
 		GstVideoCodecFrame *out_frame = gst_video_decoder_get_oldest_frame(decoder);
 		gst_video_codec_frame_unref(out_frame);
 		gst_video_decoder_drop_frame(decoder, out_frame);
 
+		if (vpu_dec->no_explicit_frame_boundary)
+			gst_imx_vpu_dec_pop_pts(vpu_dec);
+
 		GST_DEBUG_OBJECT(vpu_dec, "VPU dropped output frame internally");
 	}
 	else
@@ -1247,7 +2735,31 @@ static gboolean gst_imx_vpu_dec_flush(GstVideoDecoder *decoder)
 	if (!vpu_dec->vpu_inst_opened)
 		return TRUE;
 
+	/* Queued frames are discarded; wake up the decode thread in case it
+	 * waits for framebuffers, and wait until it is done with the current frame */
+	if (vpu_dec->decode_thread != NULL)
+	{
+		if (vpu_dec->current_framebuffers != NULL)
+		{
+			GST_IMX_VPU_FRAMEBUFFERS_LOCK(vpu_dec->current_framebuffers);
+			gst_imx_vpu_framebuffers_exit_wait_loop(vpu_dec->current_framebuffers);
+			g_cond_signal(&(vpu_dec->current_framebuffers->cond));
+			GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(vpu_dec->current_framebuffers);
+		}
+
+		gst_imx_vpu_dec_wait_for_decode_thread(vpu_dec, TRUE);
+		vpu_dec->async_flow_ret = GST_FLOW_OK;
+	}
+
 	vpu_dec->delay_sys_frame_numbers = FALSE;
+	vpu_dec->pts_queue_len = 0;
+
+	/* QoS information from before the flush is obsolete; the skip mode
+	 * for key unit trick modes is set again with the next frame */
+	gst_imx_vpu_dec_set_skip_mode(vpu_dec, VPU_DEC_SKIPNONE);
+	vpu_dec->num_qos_on_time_frames = 0;
+	vpu_dec->keyframes_only = FALSE;
+	vpu_dec->wait_for_keyframe = FALSE;
 
 	if (vpu_dec->current_framebuffers != NULL)
 	{
@@ -1297,6 +2809,14 @@ static GstFlowReturn gst_imx_vpu_dec_finish(GstVideoDecoder *decoder)
 	if (!vpu_dec->vpu_inst_opened)
 		return TRUE;
 
+	/* decode all frames which are still queued first */
+	if (vpu_dec->decode_thread != NULL)
+	{
+		gst_imx_vpu_dec_wait_for_decode_thread(vpu_dec, FALSE);
+		if (vpu_dec->async_flow_ret != GST_FLOW_OK)
+			return vpu_dec->async_flow_ret;
+	}
+
 	/* need to flush any output framebuffers present inside the VPU */
 	if (vpu_dec->current_framebuffers != NULL)
 	{
@@ -1327,7 +2847,7 @@ static GstFlowReturn gst_imx_vpu_dec_finish(GstVideoDecoder *decoder)
 			GST_INFO_OBJECT(vpu_dec, "pushing out all remaining unfinished frames");
 			while (TRUE)
 			{
-				GstFlowReturn flow_ret = gst_imx_vpu_dec_handle_frame(decoder, NULL);
+				GstFlowReturn flow_ret = gst_imx_vpu_dec_decode_frame(decoder, NULL);
 				if (flow_ret == GST_FLOW_EOS)
 				{
 					GST_INFO_OBJECT(vpu_dec, "last remaining unfinished frame pushed");
@@ -1353,6 +2873,11 @@ static gboolean gst_imx_vpu_dec_decide_allocation(GstVideoDecoder *decoder, GstQ
 	GstVideoInfo vinfo;
 	gboolean update_pool;
 
+	/* After the VPU was (re)initialized, the framebuffers are set up here,
+	 * since only now it is known how many buffers downstream holds */
+	if (vpu_dec->framebuffers_pending && !gst_imx_vpu_dec_setup_pending_framebuffers(vpu_dec, gst_imx_vpu_dec_get_downstream_min_buffers(vpu_dec, query)))
+		return FALSE;
+
 	g_assert(vpu_dec->current_framebuffers != NULL);
 
 	gst_query_parse_allocation(query, &outcaps, NULL);
@@ -1361,6 +2886,33 @@ static gboolean gst_imx_vpu_dec_decide_allocation(GstVideoDecoder *decoder, GstQ
 
 	GST_INFO_OBJECT(decoder, "number of allocation pools in query: %d", gst_query_get_n_allocation_pools(query));
 
+	/* The framebuffer layout is dictated by the VPU (16 pixel width and 16/32 line
+	 * height alignment), so it cannot be adapted to downstream's requests; still,
+	 * check if it satisfies them, since otherwise downstream will copy frames */
+	{
+		GstVideoAlignment align;
+
+		gst_video_alignment_reset(&align);
+		if (gst_imx_phys_mem_buffer_pool_query_get_video_alignment(query, &align))
+		{
+			GstImxVpuFramebuffers *framebuffers = vpu_dec->current_framebuffers;
+
+			if (((GST_VIDEO_INFO_WIDTH(&vinfo) + align.padding_right) > framebuffers->pic_width)
+			 || ((GST_VIDEO_INFO_HEIGHT(&vinfo) + align.padding_bottom) > framebuffers->pic_height)
+			 || (((guint)(framebuffers->y_stride) & align.stride_align[0]) != 0))
+			{
+				GST_WARNING_OBJECT(
+					decoder,
+					"framebuffer layout (%ux%u, Y stride %d) does not satisfy requested alignment (padding right/bottom %u/%u, stride align %u) - downstream may have to copy frames",
+					framebuffers->pic_width, framebuffers->pic_height, framebuffers->y_stride,
+					align.padding_right, align.padding_bottom, align.stride_align[0]
+				);
+			}
+			else
+				GST_INFO_OBJECT(decoder, "framebuffer layout satisfies the requested alignment");
+		}
+	}
+
 	/* Look for an allocator which can allocate VPU DMA buffers */
 	if (gst_query_get_n_allocation_pools(query) > 0)
 	{
@@ -1426,6 +2978,51 @@ static gboolean gst_imx_vpu_dec_decide_allocation(GstVideoDecoder *decoder, GstQ
 }
 
 
+static gboolean gst_imx_vpu_dec_propose_allocation(GstVideoDecoder *decoder, GstQuery *query)
+{
+	GstCaps *caps;
+	gboolean need_pool;
+	GstAllocator *allocator;
+	GstAllocationParams params;
+
+	gst_query_parse_allocation(query, &caps, &need_pool);
+
+	/* Propose the VPU allocator, so upstream can produce its data in physically
+	 * contiguous memory, which the VPU can then read directly */
+	allocator = gst_imx_vpu_dec_allocator_obtain();
+	gst_allocation_params_init(&params);
+	gst_query_add_allocation_param(query, allocator, &params);
+
+	if (need_pool && (caps != NULL))
+	{
+		GstStructure *s = gst_caps_get_structure(caps, 0);
+		gint width, height;
+
+		/* The size of encoded frames is not known in advance; use the size of
+		 * an uncompressed 4:2:2 frame as the worst case */
+		if (gst_structure_get_int(s, "width", &width) && gst_structure_get_int(s, "height", &height))
+		{
+			GstBufferPool *pool = gst_buffer_pool_new();
+			GstStructure *config = gst_buffer_pool_get_config(pool);
+			guint size = width * height * 2;
+
+			gst_buffer_pool_config_set_params(config, caps, size, 0, 0);
+			gst_buffer_pool_config_set_allocator(config, allocator, &params);
+			gst_buffer_pool_set_config(pool, config);
+
+			gst_query_add_allocation_pool(query, pool, size, 0, 0);
+			gst_object_unref(pool);
+
+			GST_DEBUG_OBJECT(decoder, "proposing physical memory buffer pool with buffer size %u", size);
+		}
+	}
+
+	gst_object_unref(GST_OBJECT(allocator));
+
+	return GST_VIDEO_DECODER_CLASS(gst_imx_vpu_dec_parent_class)->propose_allocation(decoder, query);
+}
+
+
 static void gst_imx_vpu_dec_set_property(GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec)
 {
 	GstImxVpuDec *vpu_dec = GST_IMX_VPU_DEC(object);
@@ -1447,6 +3044,61 @@ static void gst_imx_vpu_dec_set_property(GObject *object, guint prop_id, const G
 
 			break;
 		}
+		case PROP_BITSTREAM_RING_BUFFER_SIZE:
+		{
+			if (vpu_dec->vpu_inst_opened)
+			{
+				GST_ERROR_OBJECT(vpu_dec, "cannot change bitstream ring buffer size while a VPU decoder instance is open");
+				return;
+			}
+
+			vpu_dec->bitstream_ring_buffer_size = g_value_get_uint(value);
+
+			break;
+		}
+		case PROP_LOW_LATENCY:
+		{
+			if (vpu_dec->vpu_inst_opened)
+			{
+				GST_ERROR_OBJECT(vpu_dec, "cannot change low latency mode while a VPU decoder instance is open");
+				return;
+			}
+
+			vpu_dec->low_latency = g_value_get_boolean(value);
+
+			break;
+		}
+		case PROP_THUMBNAIL_MODE:
+		{
+			if (vpu_dec->vpu_inst_opened)
+			{
+				GST_ERROR_OBJECT(vpu_dec, "cannot change thumbnail mode while a VPU decoder instance is open");
+				return;
+			}
+
+			vpu_dec->thumbnail_mode = g_value_get_boolean(value);
+
+			break;
+		}
+		case PROP_QOS:
+			vpu_dec->qos = g_value_get_boolean(value);
+			break;
+		case PROP_ERROR_RESILIENCE:
+			vpu_dec->error_resilience = g_value_get_boolean(value);
+			break;
+		case PROP_INPUT_QUEUE_SIZE:
+		{
+			/* the decode thread exists from start() until stop() */
+			if (vpu_dec->vpu_inst_opened || (vpu_dec->decode_thread != NULL))
+			{
+				GST_ERROR_OBJECT(vpu_dec, "cannot change input queue size while the decoder is running");
+				return;
+			}
+
+			vpu_dec->input_queue_size = g_value_get_uint(value);
+
+			break;
+		}
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 			break;
@@ -1463,9 +3115,42 @@ static void gst_imx_vpu_dec_get_property(GObject *object, guint prop_id, GValue
 		case PROP_NUM_ADDITIONAL_FRAMEBUFFERS:
 			g_value_set_uint(value, vpu_dec->num_additional_framebuffers);
 			break;
+		case PROP_BITSTREAM_RING_BUFFER_SIZE:
+			g_value_set_uint(value, vpu_dec->bitstream_ring_buffer_size);
+			break;
+		case PROP_LOW_LATENCY:
+			g_value_set_boolean(value, vpu_dec->low_latency);
+			break;
+		case PROP_QOS:
+			g_value_set_boolean(value, vpu_dec->qos);
+			break;
+		case PROP_THUMBNAIL_MODE:
+			g_value_set_boolean(value, vpu_dec->thumbnail_mode);
+			break;
+		case PROP_INPUT_QUEUE_SIZE:
+			g_value_set_uint(value, vpu_dec->input_queue_size);
+			break;
+		case PROP_ERROR_RESILIENCE:
+			g_value_set_boolean(value, vpu_dec->error_resilience);
+			break;
+		case PROP_PHYS_MEM_STATS:
+			gst_imx_phys_mem_stats_get_property(value);
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 			break;
 	}
 }
 
+
+static void gst_imx_vpu_dec_finalize(GObject *object)
+{
+	GstImxVpuDec *vpu_dec = GST_IMX_VPU_DEC(object);
+
+	/* the decode thread was already stopped in stop() */
+	g_mutex_clear(&(vpu_dec->input_queue_mutex));
+	g_cond_clear(&(vpu_dec->input_queue_cond));
+
+	G_OBJECT_CLASS(gst_imx_vpu_dec_parent_class)->finalize(object);
+}
+
@@ -33,6 +33,11 @@
 G_BEGIN_DECLS
 
 
+/* Maximum number of pending input timestamps kept for formats
+ * without explicit frame boundaries (see pts_queue below) */
+#define GST_IMX_VPU_DEC_PTS_QUEUE_SIZE 32
+
+
 typedef struct _GstImxVpuDec GstImxVpuDec;
 typedef struct _GstImxVpuDecClass GstImxVpuDecClass;
 
@@ -54,15 +59,40 @@ struct _GstImxVpuDec
 	VpuMemInfo mem_info;
 
 	gboolean vpu_inst_opened, is_mjpeg, use_vpuwrapper_flush_call;
+	/* if true, the VPU outputs NV12 instead of I420; decided in set_format() */
+	gboolean chroma_interleave;
 	VpuCodStd codec_format;
 
 	GstBuffer *codec_data;
 
 	/* set of framebuffers currently registered and in use by the decoder */
 	GstImxVpuFramebuffers *current_framebuffers;
+	/* set of framebuffers that was in use before the decoder was reopened or
+	 * reinitialized; reused if it fits the new stream, otherwise released */
+	GstImxVpuFramebuffers *previous_framebuffers;
 	/* number of framebuffers allocated in addition to the minimum number indicated
 	 *by the VPU and the number of framebuffers that must be free at all times */
 	guint num_additional_framebuffers;
+	/* number of framebuffers added because downstream held more
+	 * framebuffers than announced (see handle_frame() ); reset in stop() */
+	guint num_grown_framebuffers;
+	/* parameters of the framebuffers which are set up in decide_allocation(), once
+	 * the number of buffers downstream holds is known; set after the VPU was
+	 * (re)initialized, and only valid if framebuffers_pending is TRUE */
+	GstImxVpuFramebufferParams pending_fbparams;
+	guint pending_min_num_free_framebuffers;
+	gboolean framebuffers_pending;
+	/* if TRUE, downstream holds more framebuffers than it announced, and decoded
+	 * frames are copied out of the framebuffers while it holds all spare ones;
+	 * reset when new framebuffers are set up */
+	gboolean copy_output_frames;
+	/* if TRUE, downstream accepted DMABuf caps, and the framebuffers (as well as
+	 * copies of output frames) are allocated such that they can be exported */
+	gboolean dmabuf_output;
+	/* framebuffer reuse statistics, logged in stop():  number of framebuffer
+	 * sets which took over framebuffers from a previous set, number of
+	 * framebuffers taken over, and number of framebuffers allocated anew */
+	guint num_framebuffer_set_reuses, num_reused_framebuffers, num_allocated_framebuffers;
 	/* if true, the number of available framebuffers will be recalculated
 	 * after the next VPU_DecDecodeBuf() call ; this value is true after the
 	 * reset() vfunc is called (not to be confused with VPU_DecReset() ) */
@@ -72,6 +102,30 @@ struct _GstImxVpuDec
 	 * cannot be used for associating input and output frames */
 	gboolean no_explicit_frame_boundary;
 
+	/* if true, the decoder minimizes latency: frame reordering is disabled for
+	 * streams without B-frames, and fewer framebuffers are kept free */
+	gboolean low_latency;
+	/* true if the VPU reorders frames in the current stream */
+	gboolean reorder_enabled;
+
+	/* if true, the VPU skip mode is adjusted according to QoS information;
+	 * skip_mode is the currently configured VpuDecSkipMode, and
+	 * num_qos_on_time_frames counts consecutive frames that were on time */
+	gboolean qos;
+	int skip_mode;
+	guint num_qos_on_time_frames;
+
+	/* if true, only I frames are decoded, using as few framebuffers as possible */
+	gboolean thumbnail_mode;
+	/* true while only keyframes are decoded (in thumbnail mode, or because
+	 * of a key unit trick mode segment) */
+	gboolean keyframes_only;
+
+	/* if true, decoding errors do not fail the flow; instead, the VPU is flushed, and
+	 * input frames are dropped until wait_for_keyframe is cleared by the next keyframe */
+	gboolean error_resilience;
+	gboolean wait_for_keyframe;
+
 	gint last_sys_frame_number;
 	gboolean delay_sys_frame_numbers;
 
@@ -79,7 +133,43 @@ struct _GstImxVpuDec
 
 	GSList *virt_dec_mem_blocks, *phys_dec_mem_blocks;
 
-	GHashTable *frame_table;
+	/* if true, the VPU reads input data directly from physically contiguous memory
+	 * (VPU_DEC_IN_KICK input mode) instead of first copying it into its own internal
+	 * bitstream buffer; decided when the first frame after set_format() comes in */
+	gboolean direct_input, input_mode_decided;
+	/* persistent physically contiguous ring buffer input data which is not in
+	 * physical memory gets written into, so it is copied only once;
+	 * only allocated if bitstream_ring_buffer_size is nonzero */
+	guint bitstream_ring_buffer_size;
+	GstMemory *bitstream_ring;
+	GstMapInfo bitstream_ring_map_info;
+	gsize bitstream_ring_offset;
+
+	/* system frame numbers of the frames decoded into each framebuffer,
+	 * indexed by framebuffer index; -1 = no frame number known */
+	gint *fb_frame_numbers;
+	guint num_fb_frame_numbers;
+
+	/* timestamps of pending input frames, sorted in ascending order; used for formats
+	 * without explicit frame boundaries, since input and output frames cannot be
+	 * associated then. Output frames get the lowest pending timestamp. */
+	GstClockTime pts_queue[GST_IMX_VPU_DEC_PTS_QUEUE_SIZE];
+	guint pts_queue_len;
+
+	/* if input_queue_size is nonzero, handle_frame() only puts incoming frames
+	 * in input_queue, and decode_thread decodes them; handle_frame() blocks
+	 * while the queue is full. decode_thread_busy is true while the decode thread
+	 * is decoding a frame. async_flow_ret holds the first non-OK flow return of
+	 * the decode thread, which is then returned by handle_frame(). input_queue,
+	 * decode_thread_busy, decode_thread_exit, and async_flow_ret are protected
+	 * by input_queue_mutex. */
+	guint input_queue_size;
+	GThread *decode_thread;
+	GMutex input_queue_mutex;
+	GCond input_queue_cond;
+	GQueue input_queue;
+	gboolean decode_thread_busy, decode_thread_exit;
+	GstFlowReturn async_flow_ret;
 };
 
 
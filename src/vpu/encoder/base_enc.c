@@ -24,6 +24,7 @@
 #include "../utils.h"
 #include "../../common/phys_mem_buffer_pool.h"
 #include "../../common/phys_mem_meta.h"
+#include "../../common/dmabuf_import.h"
 
 
 
@@ -35,7 +36,8 @@ enum
 {
 	PROP_0,
 	PROP_GOP_SIZE,
-	PROP_BITRATE
+	PROP_BITRATE,
+	PROP_PHYS_MEM_STATS
 };
 
 
@@ -88,16 +90,14 @@ void gst_imx_vpu_base_enc_class_init(GstImxVpuBaseEncClass *klass)
 	base_class->set_format        = GST_DEBUG_FUNCPTR(gst_imx_vpu_base_enc_set_format);
 	base_class->handle_frame      = GST_DEBUG_FUNCPTR(gst_imx_vpu_base_enc_handle_frame);
 
-	/* TODO: Memory-mapped writes into physically contiguous memory blocks are quite slow. This is
-	 * probably caused by the mapping type: if for example it is not mapped with write combining
-	 * enabled, random access to the memory will cause lots of wasteful cycles, explaining the
-	 * slowdown. Until this can be verified, the buffer pool is disabled; upstream does not get a
-	 * proposal for its allocation, and buffer contents end up copied over to a local physical
-	 * memory block by using memcpy(). Currently, doing that is ~3 times faster than letting
-	 * upstream write directly into physical memory blocks allocated by the proposed buffer pool.
-	 * (This also affects the IPU elements.)
+	/* Memory-mapped writes into physically contiguous memory blocks are quite slow, since the
+	 * blocks are mapped uncached or write-combined; random access to the memory causes lots of
+	 * wasteful cycles. Copying buffer contents over to a local physical memory block by using
+	 * memcpy() is ~3 times faster than letting upstream write directly into such blocks. For this
+	 * reason, a buffer pool is only proposed if the allocator can create cached mappings (the
+	 * proposal then requests these). (This also affects the IPU elements.)
 	 */
-	/*base_class->propose_allocation = GST_DEBUG_FUNCPTR(gst_imx_vpu_base_enc_propose_allocation);*/
+	base_class->propose_allocation = GST_DEBUG_FUNCPTR(gst_imx_vpu_base_enc_propose_allocation);
 	
 	klass->inst_counter = 0;
 
@@ -130,6 +130,7 @@ void gst_imx_vpu_base_enc_class_init(GstImxVpuBaseEncClass *klass)
 			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
 		)
 	);
+	gst_imx_phys_mem_stats_install_property(object_class, PROP_PHYS_MEM_STATS);
 }
 
 
@@ -179,7 +180,9 @@ static gboolean gst_imx_vpu_base_enc_alloc_enc_mem_blocks(GstImxVpuBaseEnc *vpu_
 		}
 		else if (vpu_base_enc->mem_info.MemSubBlock[i].MemType == VPU_MEM_PHY)
 		{
+			GstElement *previous_owner = gst_imx_phys_mem_stats_set_thread_owner(GST_ELEMENT(vpu_base_enc));
 			GstImxPhysMemory *memory = (GstImxPhysMemory *)gst_allocator_alloc(gst_imx_vpu_enc_allocator_obtain(), size, NULL);
+			gst_imx_phys_mem_stats_set_thread_owner(previous_owner);
 			if (memory == NULL)
 				return FALSE;
 
@@ -271,6 +274,9 @@ static void gst_imx_vpu_base_enc_get_property(GObject *object, guint prop_id, GV
 		case PROP_BITRATE:
 			g_value_set_uint(value, vpu_base_enc->bitrate);
 			break;
+		case PROP_PHYS_MEM_STATS:
+			gst_imx_phys_mem_stats_get_property(value);
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 			break;
@@ -374,6 +380,12 @@ static gboolean gst_imx_vpu_base_enc_stop(GstVideoEncoder *encoder)
 	gst_imx_vpu_base_enc_close_encoder(vpu_base_enc);
 	gst_imx_vpu_base_enc_free_enc_mem_blocks(vpu_base_enc);
 
+	{
+		GstAllocator *allocator = gst_imx_vpu_enc_allocator_obtain();
+		gst_imx_phys_mem_allocator_log_recycler_stats(GST_IMX_PHYS_MEM_ALLOCATOR(allocator), GST_OBJECT(vpu_base_enc));
+		gst_object_unref(GST_OBJECT(allocator));
+	}
+
 	g_mutex_lock(&inst_counter_mutex);
 	if (klass->inst_counter > 0)
 	{
@@ -518,6 +530,20 @@ static GstFlowReturn gst_imx_vpu_base_enc_handle_frame(GstVideoEncoder *encoder,
 
 	phys_mem_meta = GST_IMX_PHYS_MEM_META_GET(frame->input_buffer);
 
+	/* Physically contiguous DMABUF memory does not carry physical memory metadata;
+	 * try to import it, which adds the metadata, and avoids the frame copy below */
+	if (phys_mem_meta == NULL)
+	{
+		GstBuffer *imported_buffer = gst_imx_dmabuf_import_buffer(frame->input_buffer);
+		if (imported_buffer != NULL)
+		{
+			GST_TRACE_OBJECT(vpu_base_enc, "input buffer uses physically contiguous DMABUF memory - no frame copy necessary");
+			gst_buffer_unref(frame->input_buffer);
+			frame->input_buffer = imported_buffer;
+			phys_mem_meta = GST_IMX_PHYS_MEM_META_GET(frame->input_buffer);
+		}
+	}
+
 	/* If the incoming frame's buffer is not using physically contiguous memory,
 	 * it needs to be copied to the internal input buffer, otherwise the VPU
 	 * encoder cannot read the frame */
@@ -545,11 +571,13 @@ static GstFlowReturn gst_imx_vpu_base_enc_handle_frame(GstVideoEncoder *encoder,
 				GstStructure *config;
 				GstCaps *caps;
 				GstAllocator *allocator;
+				GstVideoAlignment align;
 
 				GST_TRACE_OBJECT(vpu_base_enc, "creating internal bufferpool");
 
 				caps = gst_video_info_to_caps(&(vpu_base_enc->video_info));
 				vpu_base_enc->internal_bufferpool = gst_imx_phys_mem_buffer_pool_new(FALSE);
+				gst_imx_phys_mem_buffer_pool_set_owner(vpu_base_enc->internal_bufferpool, GST_ELEMENT(vpu_base_enc));
 				allocator = gst_imx_vpu_enc_allocator_obtain();
 
 				config = gst_buffer_pool_get_config(vpu_base_enc->internal_bufferpool);
@@ -557,6 +585,8 @@ static GstFlowReturn gst_imx_vpu_base_enc_handle_frame(GstVideoEncoder *encoder,
 				gst_buffer_pool_config_set_allocator(config, allocator, NULL);
 				gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_IMX_PHYS_MEM);
 				gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+				gst_imx_phys_mem_buffer_pool_video_alignment_init(&align, &(vpu_base_enc->video_info), GST_IMX_VPU_ENC_WIDTH_ALIGNMENT, GST_IMX_VPU_ENC_HEIGHT_ALIGNMENT, 0);
+				gst_imx_phys_mem_buffer_pool_config_set_video_alignment(config, &align);
 				gst_buffer_pool_set_config(vpu_base_enc->internal_bufferpool, config);
 
 				gst_caps_unref(caps);
@@ -596,8 +626,6 @@ static GstFlowReturn gst_imx_vpu_base_enc_handle_frame(GstVideoEncoder *encoder,
 
 		/* Set the internal input buffer as the encoder's input */
 		input_buffer = vpu_base_enc->internal_input_buffer;
-		/* And use the internal input buffer's physical memory metadata */
-		phys_mem_meta = GST_IMX_PHYS_MEM_META_GET(vpu_base_enc->internal_input_buffer);
 	}
 	else
 	{
@@ -606,33 +634,27 @@ static GstFlowReturn gst_imx_vpu_base_enc_handle_frame(GstVideoEncoder *encoder,
 		input_buffer = frame->input_buffer;
 	}
 
+	/* Make sure the VPU sees all CPU writes to the input frame */
+	gst_imx_phys_mem_buffer_flush(input_buffer);
+
 	/* Set up physical addresses for the input framebuffer */
 	{
-		gsize *plane_offsets;
-		gint *plane_strides;
-		GstVideoMeta *video_meta;
-		unsigned char *phys_ptr;
-
-		/* Try to use plane offset and stride information from the video
-		 * metadata if present, since these can be more accurate than
-		 * the information from the video info */
-		video_meta = gst_buffer_get_video_meta(input_buffer);
-		if (video_meta != NULL)
-		{
-			plane_offsets = video_meta->offset;
-			plane_strides = video_meta->stride;
-		}
-		else
+		guintptr plane_addrs[GST_VIDEO_MAX_PLANES];
+		gint plane_strides[GST_VIDEO_MAX_PLANES];
+		guint padded_height;
+
+		/* The plane layout comes from the planes metadata if present, which also
+		 * covers planes that are not stored contiguously; otherwise, it is derived
+		 * from the video metadata, or the video info if there is no video meta */
+		if (!gst_imx_phys_mem_meta_get_plane_layout(input_buffer, &(vpu_base_enc->video_info), plane_addrs, plane_strides, &padded_height))
 		{
-			plane_offsets = vpu_base_enc->video_info.offset;
-			plane_strides = vpu_base_enc->video_info.stride;
+			GST_ERROR_OBJECT(vpu_base_enc, "input buffer has no physical address");
+			return GST_FLOW_ERROR;
 		}
 
-		phys_ptr = (unsigned char*)(phys_mem_meta->phys_addr);
-
-		input_framebuf.pbufY = phys_ptr;
-		input_framebuf.pbufCb = phys_ptr + plane_offsets[1];
-		input_framebuf.pbufCr = phys_ptr + plane_offsets[2];
+		input_framebuf.pbufY = (unsigned char*)(plane_addrs[0]);
+		input_framebuf.pbufCb = (unsigned char*)(plane_addrs[1]);
+		input_framebuf.pbufCr = (unsigned char*)(plane_addrs[2]);
 		input_framebuf.pbufMvCol = NULL; /* not used by the VPU encoder */
 		input_framebuf.nStrideY = plane_strides[0];
 		input_framebuf.nStrideC = plane_strides[1];
@@ -640,18 +662,21 @@ static GstFlowReturn gst_imx_vpu_base_enc_handle_frame(GstVideoEncoder *encoder,
 		/* this is needed for framebuffers registration below */
 		src_stride = plane_strides[0];
 
-		GST_TRACE_OBJECT(vpu_base_enc, "width: %d   height: %d   stride 0: %d   stride 1: %d   offset 0: %d   offset 1: %d   offset 2: %d", GST_VIDEO_INFO_WIDTH(&(vpu_base_enc->video_info)), GST_VIDEO_INFO_HEIGHT(&(vpu_base_enc->video_info)), plane_strides[0], plane_strides[1], plane_offsets[0], plane_offsets[1], plane_offsets[2]);
+		GST_TRACE_OBJECT(vpu_base_enc, "width: %d   height: %d   stride 0: %d   stride 1: %d   plane 0: %" G_GUINTPTR_FORMAT "   plane 1: %" G_GUINTPTR_FORMAT "   plane 2: %" G_GUINTPTR_FORMAT, GST_VIDEO_INFO_WIDTH(&(vpu_base_enc->video_info)), GST_VIDEO_INFO_HEIGHT(&(vpu_base_enc->video_info)), plane_strides[0], plane_strides[1], plane_addrs[0], plane_addrs[1], plane_addrs[2]);
 	}
 
 	/* Create framebuffers structure (if not already present) */
 	if (vpu_base_enc->framebuffers == NULL)
 	{
 		GstImxVpuFramebufferParams fbparams;
+		GstElement *previous_owner;
 		gst_imx_vpu_framebuffers_enc_init_info_to_params(&(vpu_base_enc->init_info), &fbparams);
 		fbparams.pic_width = vpu_base_enc->open_param.nPicWidth;
 		fbparams.pic_height = vpu_base_enc->open_param.nPicHeight;
 
+		previous_owner = gst_imx_phys_mem_stats_set_thread_owner(GST_ELEMENT(vpu_base_enc));
 		vpu_base_enc->framebuffers = gst_imx_vpu_framebuffers_new(&fbparams, gst_imx_vpu_enc_allocator_obtain());
+		gst_imx_phys_mem_stats_set_thread_owner(previous_owner);
 		if (vpu_base_enc->framebuffers == NULL)
 		{
 			GST_ELEMENT_ERROR(vpu_base_enc, RESOURCE, NO_SPACE_LEFT, ("could not create framebuffers structure"), (NULL));
@@ -664,7 +689,9 @@ static GstFlowReturn gst_imx_vpu_base_enc_handle_frame(GstVideoEncoder *encoder,
 	/* Allocate physical buffer for output data (if not already present) */
 	if (vpu_base_enc->output_phys_buffer == NULL)
 	{
+		GstElement *previous_owner = gst_imx_phys_mem_stats_set_thread_owner(GST_ELEMENT(vpu_base_enc));
 		vpu_base_enc->output_phys_buffer = (GstImxPhysMemory *)gst_allocator_alloc(gst_imx_vpu_enc_allocator_obtain(), vpu_base_enc->framebuffers->total_size, NULL);
+		gst_imx_phys_mem_stats_set_thread_owner(previous_owner);
 
 		if (vpu_base_enc->output_phys_buffer == NULL)
 		{
@@ -813,6 +840,8 @@ static gboolean gst_imx_vpu_base_enc_propose_allocation(GstVideoEncoder *encoder
 	GstVideoInfo info;
 	GstBufferPool *pool;
 	GstAllocator *allocator;
+	GstAllocationParams alloc_params;
+	GstVideoAlignment align;
 
 	gst_query_parse_allocation (query, &caps, &need_pool);
 
@@ -827,19 +856,48 @@ static gboolean gst_imx_vpu_base_enc_propose_allocation(GstVideoEncoder *encoder
 			return FALSE;
 		}
 
-		pool = gst_imx_phys_mem_buffer_pool_new(FALSE);
 		allocator = gst_imx_vpu_enc_allocator_obtain();
+		if (allocator == NULL)
+			return FALSE;
+
+		/* Without cached mappings, upstream writes would be slower than
+		 * the memcpy() into the internal input buffer (see class_init) */
+		if (!gst_imx_phys_mem_allocator_supports_cache_mode(allocator, GST_IMX_PHYS_MEM_CACHE_MODE_CACHED))
+		{
+			GST_DEBUG_OBJECT(encoder, "allocator cannot create cached mappings - not proposing a buffer pool");
+			gst_object_unref(GST_OBJECT(allocator));
+			return TRUE;
+		}
+
+		gst_allocation_params_init(&alloc_params);
+		alloc_params.flags = GST_IMX_PHYS_MEM_FLAG_CACHED;
+
+		gst_imx_phys_mem_buffer_pool_video_alignment_init(&align, &info, GST_IMX_VPU_ENC_WIDTH_ALIGNMENT, GST_IMX_VPU_ENC_HEIGHT_ALIGNMENT, 0);
+
+		pool = gst_imx_phys_mem_buffer_pool_new(FALSE);
+		/* the pool is used by upstream, but it is allocated on behalf of the encoder */
+		gst_imx_phys_mem_buffer_pool_set_owner(pool, GST_ELEMENT(vpu_base_enc));
 
 		config = gst_buffer_pool_get_config(pool);
 		gst_buffer_pool_config_set_params(config, caps, info.size, 2, 0);
-		gst_buffer_pool_config_set_allocator(config, allocator, NULL);
+		gst_buffer_pool_config_set_allocator(config, allocator, &alloc_params);
+		gst_object_unref(GST_OBJECT(allocator));
 		gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_IMX_PHYS_MEM);
 		gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+		gst_imx_phys_mem_buffer_pool_config_set_video_alignment(config, &align);
 		gst_buffer_pool_set_config(pool, config);
 
 		gst_query_add_allocation_pool (query, pool, info.size, 2, 0);
 		gst_object_unref (pool);
 	}
 
+	/* Request the frame layout the VPU can read without copying the frame; if
+	 * upstream configures its own pool, it can use this to lay out its frames */
+	if ((caps != NULL) && gst_video_info_from_caps(&info, caps))
+	{
+		gst_imx_phys_mem_buffer_pool_video_alignment_init(&align, &info, GST_IMX_VPU_ENC_WIDTH_ALIGNMENT, GST_IMX_VPU_ENC_HEIGHT_ALIGNMENT, 0);
+		gst_imx_phys_mem_buffer_pool_query_add_video_alignment(query, &align);
+	}
+
 	return TRUE;
 }
@@ -45,6 +45,11 @@ typedef struct _GstImxVpuBaseEncClass GstImxVpuBaseEncClass;
 #define GST_IS_IMX_VPU_BASE_ENC(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_IMX_VPU_BASE_ENC))
 #define GST_IS_IMX_VPU_BASE_ENC_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_IMX_VPU_BASE_ENC))
 
+/* Input frame width and height must be multiples of these values for
+ * the VPU to be able to use the frame directly */
+#define GST_IMX_VPU_ENC_WIDTH_ALIGNMENT   16
+#define GST_IMX_VPU_ENC_HEIGHT_ALIGNMENT  16
+
 
 struct _GstImxVpuBaseEnc
 {
@@ -19,6 +19,7 @@
 
 #include <vpu_wrapper.h>
 #include <string.h>
+#include "../common/phys_mem_allocator.h"
 #include "../common/phys_mem_meta.h"
 #include "fb_buffer_pool.h"
 #include "utils.h"
@@ -130,6 +131,7 @@ static GstFlowReturn gst_imx_vpu_fb_buffer_pool_alloc_buffer(GstBufferPool *pool
 
 	GST_IMX_VPU_BUFFER_META_ADD(buf);
 	GST_IMX_PHYS_MEM_META_ADD(buf);
+	GST_IMX_PHYS_MEM_PLANES_META_ADD(buf);
 
 	if (vpu_pool->add_videometa)
 	{
@@ -198,6 +200,9 @@ static void gst_imx_vpu_fb_buffer_pool_release_buffer(GstBufferPool *pool, GstBu
 			GST_DEBUG_OBJECT(pool, "buffer %p does not contain physical memory and/or a VPU framebuffer pointer, and does not need to be cleared", (gpointer)buffer);
 		}
 
+		if (gst_buffer_n_memory(buffer) > 0)
+			gst_imx_vpu_framebuffers_set_held_downstream(vpu_pool->framebuffers, (vpu_meta != NULL) ? vpu_meta->framebuffer : NULL, FALSE);
+
 		/* Clear out old memory blocks ; the decoder always fills empty buffers with new memory
 		 * blocks when it needs to push a newly decoded frame downstream anyway
 		 * (see gst_imx_vpu_set_buffer_contents() below)
@@ -279,6 +284,7 @@ gboolean gst_imx_vpu_set_buffer_contents(GstBuffer *buffer, GstImxVpuFramebuffer
 	GstVideoMeta *video_meta;
 	GstImxVpuBufferMeta *vpu_meta;
 	GstImxPhysMemMeta *phys_mem_meta;
+	GstImxPhysMemPlanesMeta *planes_meta;
 	GstMemory *memory;
 
 	video_meta = gst_buffer_get_video_meta(buffer);
@@ -313,19 +319,63 @@ gboolean gst_imx_vpu_set_buffer_contents(GstBuffer *buffer, GstImxVpuFramebuffer
 		phys_mem_meta->phys_addr = (guintptr)(framebuffer->pbufY);
 		phys_mem_meta->padding = framebuffers->y_stride * y_padding;
 
-		memory = gst_memory_new_wrapped(
-			GST_MEMORY_FLAG_NO_SHARE,
-			framebuffer->pbufVirtY,
-			framebuffers->total_size,
-			0,
-			framebuffers->total_size,
-			NULL,
-			NULL
-		);
+		/* The VPU framebuffer planes are addressed individually; describe
+		 * them as they are instead of relying on the video meta offsets.
+		 * All output formats store Y, Cb, Cr in this order; with NV12,
+		 * the second plane contains both Cb and Cr. */
+		planes_meta = GST_IMX_PHYS_MEM_PLANES_META_GET(buffer);
+		if (planes_meta != NULL)
+		{
+			GstVideoFormatInfo const *finfo = gst_video_format_get_info(video_meta->format);
+			guintptr plane_addrs[3] = { (guintptr)(framebuffer->pbufY), (guintptr)(framebuffer->pbufCb), (guintptr)(framebuffer->pbufCr) };
+			guint i;
+
+			planes_meta->n_planes = MIN(video_meta->n_planes, 3);
+			for (i = 0; i < planes_meta->n_planes; ++i)
+			{
+				planes_meta->phys_addr[i] = plane_addrs[i];
+				planes_meta->stride[i] = (i == 0) ? framebuffer->nStrideY : framebuffer->nStrideC;
+				planes_meta->plane_height[i] = GST_VIDEO_FORMAT_INFO_SCALE_HEIGHT(finfo, i, framebuffers->pic_height);
+			}
+		}
+
+		if ((framebuffer->pbufVirtY != NULL) && !(framebuffers->exportable))
+		{
+			memory = gst_memory_new_wrapped(
+				GST_MEMORY_FLAG_NO_SHARE,
+				framebuffer->pbufVirtY,
+				framebuffers->total_size,
+				0,
+				framebuffers->total_size,
+				NULL,
+				NULL
+			);
+		}
+		else
+		{
+			/* Device-only framebuffers have no CPU mapping; share the physical
+			 * memory block instead of wrapping a virtual address, so a mapping
+			 * is created only if someone actually maps the buffer. Shared
+			 * blocks are read-only, which is fine for decoded frames.
+			 * Exportable framebuffers are always shared, since downstream
+			 * gets the DMABUF file descriptor from the physical memory block. */
+			GstMemory *fb_memory = gst_imx_vpu_framebuffers_get_memory(framebuffers, framebuffer);
+			gsize offset = (guintptr)(framebuffer->pbufY) - gst_imx_phys_memory_get_phys_addr(fb_memory);
+			memory = gst_memory_share(fb_memory, offset, framebuffers->total_size);
+
+			if (framebuffers->exportable && (gst_imx_phys_memory_get_dmabuf_fd(memory) < 0))
+			{
+				GST_ERROR("could not export framebuffer %p as DMABUF", (gpointer)framebuffer);
+				gst_memory_unref(memory);
+				return FALSE;
+			}
+		}
 	}
 
 	GST_IMX_VPU_FRAMEBUFFERS_LOCK(framebuffers);
 	framebuffers->num_framebuffers_in_buffers++;
+	if (gst_buffer_n_memory(buffer) == 0)
+		gst_imx_vpu_framebuffers_set_held_downstream(framebuffers, framebuffer, TRUE);
 	GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(framebuffers);
 
 	/* remove any existing memory blocks */
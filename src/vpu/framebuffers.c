@@ -39,6 +39,10 @@ G_DEFINE_TYPE(GstImxVpuFramebuffers, gst_imx_vpu_framebuffers, GST_TYPE_OBJECT)
 
 
 static gboolean gst_imx_vpu_framebuffers_configure(GstImxVpuFramebuffers *framebuffers, GstImxVpuFramebufferParams *params, GstAllocator *allocator);
+static gboolean gst_imx_vpu_framebuffers_alloc_arena(GstImxVpuFramebuffers *framebuffers, GstAllocator *allocator, int alignment);
+static gboolean gst_imx_vpu_framebuffers_alloc_separate_blocks(GstImxVpuFramebuffers *framebuffers, GstAllocator *allocator);
+static void gst_imx_vpu_framebuffers_init_alloc_params(GstImxVpuFramebuffers *framebuffers, GstAllocationParams *alloc_params);
+static void gst_imx_vpu_framebuffers_fill_framebuffer(GstImxVpuFramebuffers *framebuffers, VpuFrameBuffer *framebuffer, GstImxPhysMemory *memory);
 static void gst_imx_vpu_framebuffers_finalize(GObject *object);
 
 
@@ -65,12 +69,25 @@ void gst_imx_vpu_framebuffers_init(GstImxVpuFramebuffers *framebuffers)
 	framebuffers->num_available_framebuffers = 0;
 	framebuffers->decremented_availbuf_counter = 0;
 	framebuffers->num_framebuffers_in_buffers = 0;
+	framebuffers->num_framebuffers_downstream = 0;
+	framebuffers->held_downstream = NULL;
+	framebuffers->min_num_free_framebuffers = GST_IMX_VPU_MIN_NUM_FREE_FRAMEBUFFERS;
+	framebuffers->num_starvations = 0;
 	framebuffers->fb_mem_blocks = NULL;
+	framebuffers->fb_sub_blocks = NULL;
+	framebuffers->num_reused_framebuffers = 0;
 
 	framebuffers->y_stride = framebuffers->uv_stride = 0;
 	framebuffers->y_size = framebuffers->u_size = framebuffers->v_size = framebuffers->mv_size = 0;
 	framebuffers->total_size = 0;
 
+	framebuffers->pic_width = framebuffers->pic_height = 0;
+	framebuffers->mjpeg_source_format = 0;
+	framebuffers->interlace = 0;
+	framebuffers->address_alignment = 0;
+	framebuffers->chroma_interleave = 0;
+	framebuffers->exportable = 0;
+
 	framebuffers->flushing = FALSE;
 	framebuffers->exit_loop = FALSE;
 
@@ -142,6 +159,119 @@ gboolean gst_imx_vpu_framebuffers_register_with_encoder(GstImxVpuFramebuffers *f
 }
 
 
+gboolean gst_imx_vpu_framebuffers_can_reuse_for_decoder(GstImxVpuFramebuffers *framebuffers, GstImxVpuFramebufferParams *params)
+{
+	guint pic_width, pic_height;
+	gint num_downstream;
+
+	if ((framebuffers->registration_state == GST_IMX_VPU_FRAMEBUFFERS_ENCODER_REGISTERED) || (framebuffers->held_downstream == NULL))
+		return FALSE;
+
+	pic_width = ALIGN_VAL_TO(params->pic_width, FRAME_ALIGN);
+	pic_height = ALIGN_VAL_TO(params->pic_height, params->interlace ? (2 * FRAME_ALIGN) : FRAME_ALIGN);
+
+	GST_IMX_VPU_FRAMEBUFFERS_LOCK(framebuffers);
+	num_downstream = framebuffers->num_framebuffers_downstream;
+	GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(framebuffers);
+
+	if ((pic_width > framebuffers->pic_width) || (pic_height > framebuffers->pic_height))
+	{
+		GST_DEBUG_OBJECT(framebuffers, "cannot reuse framebuffers: size %ux%u is too small for %ux%u", framebuffers->pic_width, framebuffers->pic_height, pic_width, pic_height);
+		return FALSE;
+	}
+
+	if ((params->mjpeg_source_format != framebuffers->mjpeg_source_format) || (params->interlace != framebuffers->interlace) || (params->address_alignment != framebuffers->address_alignment) || (params->chroma_interleave != framebuffers->chroma_interleave) || ((params->exportable != 0) != (framebuffers->exportable != 0)))
+	{
+		GST_DEBUG_OBJECT(framebuffers, "cannot reuse framebuffers: format, interlacing, address alignment or exportability differ");
+		return FALSE;
+	}
+
+	/* Framebuffers still in use downstream cannot be taken over, since the
+	 * VPU would consider them free and overwrite them */
+	if (num_downstream >= (gint)(framebuffers->num_framebuffers))
+	{
+		GST_DEBUG_OBJECT(framebuffers, "cannot reuse framebuffers: all %d framebuffers still in use downstream", num_downstream);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+GstImxVpuFramebuffers * gst_imx_vpu_framebuffers_new_reusing(GstImxVpuFramebuffers *previous, GstImxVpuFramebufferParams *params)
+{
+	GstImxVpuFramebuffers *framebuffers;
+	GstAllocationParams alloc_params;
+	guint i;
+
+	framebuffers = g_object_new(gst_imx_vpu_framebuffers_get_type(), NULL);
+
+	framebuffers->allocator = previous->allocator;
+
+	/* The framebuffers are taken over as they are, so the new set uses the
+	 * previous set's layout, which may be larger than what params describes */
+	framebuffers->mjpeg_source_format = previous->mjpeg_source_format;
+	framebuffers->interlace = previous->interlace;
+	framebuffers->address_alignment = previous->address_alignment;
+	framebuffers->chroma_interleave = previous->chroma_interleave;
+	framebuffers->exportable = previous->exportable;
+	framebuffers->pic_width = previous->pic_width;
+	framebuffers->pic_height = previous->pic_height;
+	framebuffers->y_stride = previous->y_stride;
+	framebuffers->uv_stride = previous->uv_stride;
+	framebuffers->y_size = previous->y_size;
+	framebuffers->u_size = previous->u_size;
+	framebuffers->v_size = previous->v_size;
+	framebuffers->mv_size = previous->mv_size;
+	framebuffers->total_size = previous->total_size;
+
+	framebuffers->num_framebuffers = params->min_framebuffer_count;
+	framebuffers->num_available_framebuffers = framebuffers->num_framebuffers;
+	framebuffers->framebuffers = (VpuFrameBuffer *)g_slice_alloc(sizeof(VpuFrameBuffer) * framebuffers->num_framebuffers);
+	framebuffers->held_downstream = g_new0(guint8, framebuffers->num_framebuffers);
+
+	/* Take over the framebuffers which are not in use downstream; the descriptors
+	 * are copied, since the VPU refers to the registered array. The memory blocks
+	 * are ref'd, so they stay around even if the previous set is finalized. */
+	GST_IMX_VPU_FRAMEBUFFERS_LOCK(previous);
+	for (i = 0; (i < previous->num_framebuffers) && (framebuffers->num_reused_framebuffers < framebuffers->num_framebuffers); ++i)
+	{
+		GstMemory *memory;
+
+		if (previous->held_downstream[i])
+			continue;
+
+		memory = gst_imx_vpu_framebuffers_get_memory(previous, &(previous->framebuffers[i]));
+		framebuffers->framebuffers[framebuffers->num_reused_framebuffers] = previous->framebuffers[i];
+		framebuffers->fb_sub_blocks = g_slist_append(framebuffers->fb_sub_blocks, gst_memory_ref(memory));
+		framebuffers->num_reused_framebuffers++;
+	}
+	GST_IMX_VPU_FRAMEBUFFERS_UNLOCK(previous);
+
+	/* Allocate the remaining framebuffers */
+	gst_imx_vpu_framebuffers_init_alloc_params(framebuffers, &alloc_params);
+
+	for (i = framebuffers->num_reused_framebuffers; i < framebuffers->num_framebuffers; ++i)
+	{
+		GstImxPhysMemory *memory = (GstImxPhysMemory *)gst_allocator_alloc(framebuffers->allocator, framebuffers->total_size, &alloc_params);
+		if (memory == NULL)
+		{
+			GST_ERROR_OBJECT(framebuffers, "could not allocate memory block for framebuffer #%u", i);
+			gst_object_unref(framebuffers);
+			return NULL;
+		}
+
+		gst_imx_vpu_append_phys_mem_block(memory, &(framebuffers->fb_mem_blocks));
+		framebuffers->fb_sub_blocks = g_slist_append(framebuffers->fb_sub_blocks, gst_memory_ref((GstMemory *)memory));
+		gst_imx_vpu_framebuffers_fill_framebuffer(framebuffers, &(framebuffers->framebuffers[i]), memory);
+	}
+
+	GST_INFO_OBJECT(framebuffers, "reusing %u of %u framebuffers with size %ux%u from previous framebuffers; allocated %u new ones", framebuffers->num_reused_framebuffers, previous->num_framebuffers, framebuffers->pic_width, framebuffers->pic_height, framebuffers->num_framebuffers - framebuffers->num_reused_framebuffers);
+
+	return framebuffers;
+}
+
+
 void gst_imx_vpu_framebuffers_dec_init_info_to_params(VpuDecInitInfo *init_info, GstImxVpuFramebufferParams *params)
 {
 	params->pic_width = init_info->nPicWidth;
@@ -150,6 +280,10 @@ void gst_imx_vpu_framebuffers_dec_init_info_to_params(VpuDecInitInfo *init_info,
 	params->mjpeg_source_format = init_info->nMjpgSourceFormat;
 	params->interlace = init_info->nInterlace;
 	params->address_alignment = init_info->nAddressAlignment;
+	/* not part of the init info; set by the decoder */
+	params->chroma_interleave = 0;
+	/* not part of the init info; set by the decoder after caps negotiation */
+	params->exportable = 0;
 }
 
 
@@ -161,6 +295,8 @@ void gst_imx_vpu_framebuffers_enc_init_info_to_params(VpuEncInitInfo *init_info,
 	params->mjpeg_source_format = 0;
 	params->interlace = 0;
 	params->address_alignment = init_info->nAddressAlignment;
+	params->chroma_interleave = 0;
+	params->exportable = 0;
 }
 
 
@@ -175,9 +311,37 @@ void gst_imx_vpu_framebuffers_set_flushing(GstImxVpuFramebuffers *framebuffers,
 
 void gst_imx_vpu_framebuffers_wait_until_frames_available(GstImxVpuFramebuffers *framebuffers)
 {
+	gint64 deadline;
+	gboolean starved = FALSE;
+
 	GST_LOG_OBJECT(framebuffers, "flushing = %d  exit_loop = %d", framebuffers->flushing ? 1 : 0, framebuffers->exit_loop ? 1 : 0);
-	while ((framebuffers->num_available_framebuffers < GST_IMX_VPU_MIN_NUM_FREE_FRAMEBUFFERS) && !(framebuffers->flushing) && !(framebuffers->exit_loop))
-		g_cond_wait(&(framebuffers->cond), &(framebuffers->available_fb_mutex));
+
+	deadline = g_get_monotonic_time() + GST_IMX_VPU_FRAMEBUFFERS_STARVATION_TIME;
+	while ((framebuffers->num_available_framebuffers < framebuffers->min_num_free_framebuffers) && !(framebuffers->flushing) && !(framebuffers->exit_loop))
+	{
+		if (starved)
+			g_cond_wait(&(framebuffers->cond), &(framebuffers->available_fb_mutex));
+		else if (!g_cond_wait_until(&(framebuffers->cond), &(framebuffers->available_fb_mutex), deadline))
+		{
+			starved = TRUE;
+
+			/* A slow downstream which returns framebuffers at its own pace
+			 * is not starving the decoder; only count waits where the
+			 * framebuffers it holds are what keeps the decoder waiting */
+			if (gst_imx_vpu_framebuffers_downstream_holds_spare(framebuffers))
+			{
+				framebuffers->num_starvations++;
+				GST_DEBUG_OBJECT(framebuffers, "still waiting for free framebuffers, %d held downstream; number of starvations: %d", framebuffers->num_framebuffers_downstream, framebuffers->num_starvations);
+			}
+		}
+	}
+
+	if (!starved && (framebuffers->num_available_framebuffers >= framebuffers->min_num_free_framebuffers) && (framebuffers->num_starvations > 0))
+	{
+		GST_DEBUG_OBJECT(framebuffers, "framebuffers available again without starving; resetting number of starvations");
+		framebuffers->num_starvations = 0;
+	}
+
 	framebuffers->exit_loop = FALSE;
 }
 
@@ -188,11 +352,43 @@ void gst_imx_vpu_framebuffers_exit_wait_loop(GstImxVpuFramebuffers *framebuffers
 }
 
 
+void gst_imx_vpu_framebuffers_set_held_downstream(GstImxVpuFramebuffers *framebuffers, VpuFrameBuffer *framebuffer, gboolean held)
+{
+	if (held)
+		framebuffers->num_framebuffers_downstream++;
+	else
+		framebuffers->num_framebuffers_downstream--;
+
+	if ((framebuffers->held_downstream != NULL) && (framebuffer >= framebuffers->framebuffers) && (framebuffer < (framebuffers->framebuffers + framebuffers->num_framebuffers)))
+		framebuffers->held_downstream[framebuffer - framebuffers->framebuffers] = held ? 1 : 0;
+}
+
+
+gboolean gst_imx_vpu_framebuffers_downstream_holds_spare(GstImxVpuFramebuffers *framebuffers)
+{
+	return framebuffers->num_framebuffers_downstream > ((gint)(framebuffers->num_framebuffers) - framebuffers->min_num_free_framebuffers);
+}
+
+
+GstMemory* gst_imx_vpu_framebuffers_get_memory(GstImxVpuFramebuffers *framebuffers, VpuFrameBuffer *framebuffer)
+{
+	GSList *mem_blocks;
+	guint index;
+
+	g_assert((framebuffer >= framebuffers->framebuffers) && (framebuffer < (framebuffers->framebuffers + framebuffers->num_framebuffers)));
+
+	index = framebuffer - framebuffers->framebuffers;
+	mem_blocks = (framebuffers->fb_sub_blocks != NULL) ? framebuffers->fb_sub_blocks : framebuffers->fb_mem_blocks;
+
+	return (GstMemory *)g_slist_nth_data(mem_blocks, index);
+}
+
+
 static gboolean gst_imx_vpu_framebuffers_configure(GstImxVpuFramebuffers *framebuffers, GstImxVpuFramebufferParams *params, GstAllocator *allocator)
 {
 	int alignment;
-	unsigned char *phys_ptr, *virt_ptr;
 	guint i;
+	GSList *mem_block_node;
 
 	g_assert(GST_IS_IMX_PHYS_MEM_ALLOCATOR(allocator));
 
@@ -200,9 +396,16 @@ static gboolean gst_imx_vpu_framebuffers_configure(GstImxVpuFramebuffers *frameb
 	framebuffers->num_available_framebuffers = framebuffers->num_framebuffers;
 	framebuffers->decremented_availbuf_counter = 0;
 	framebuffers->framebuffers = (VpuFrameBuffer *)g_slice_alloc(sizeof(VpuFrameBuffer) * framebuffers->num_framebuffers);
+	framebuffers->held_downstream = g_new0(guint8, framebuffers->num_framebuffers);
 
 	framebuffers->allocator = allocator;
 
+	framebuffers->mjpeg_source_format = params->mjpeg_source_format;
+	framebuffers->interlace = params->interlace;
+	framebuffers->address_alignment = params->address_alignment;
+	framebuffers->chroma_interleave = params->chroma_interleave;
+	framebuffers->exportable = params->exportable;
+
 	framebuffers->pic_width = ALIGN_VAL_TO(params->pic_width, FRAME_ALIGN);
 	if (params->interlace)
 		framebuffers->pic_height = ALIGN_VAL_TO(params->pic_height, (2 * FRAME_ALIGN));
@@ -230,6 +433,15 @@ static gboolean gst_imx_vpu_framebuffers_configure(GstImxVpuFramebuffers *frameb
 			g_assert_not_reached();
 	}
 
+	/* With chroma interleaving (only used with 4:2:0), Cb and Cr are stored in one
+	 * plane with twice the stride; the u_size region then holds both of them */
+	if (params->chroma_interleave)
+	{
+		framebuffers->uv_stride = framebuffers->y_stride;
+		framebuffers->u_size = framebuffers->y_size / 2;
+		framebuffers->v_size = 0;
+	}
+
 	alignment = params->address_alignment;
 	if (alignment > 1)
 	{
@@ -263,52 +475,166 @@ static gboolean gst_imx_vpu_framebuffers_configure(GstImxVpuFramebuffers *frameb
 		framebuffers->total_size, framebuffers->num_framebuffers, framebuffers->total_size * framebuffers->num_framebuffers
 	);
 
-	for (i = 0; i < framebuffers->num_framebuffers; ++i)
+	/* Try to place all framebuffers in one contiguous arena first; this
+	 * reduces the number of CMA allocations from one per framebuffer to
+	 * one per framebuffer set, and therefore CMA fragmentation. If the
+	 * arena cannot be allocated, fall back to one block per framebuffer.
+	 * Exportable framebuffers always use separate blocks, since each
+	 * one is exported as its own DMABUF. */
+	if (framebuffers->exportable)
 	{
-		GstImxPhysMemory *memory;
-		VpuFrameBuffer *framebuffer;
+		if (!gst_imx_vpu_framebuffers_alloc_separate_blocks(framebuffers, allocator))
+		{
+			GST_ERROR_OBJECT(framebuffers, "could not allocate exportable framebuffers");
+			return FALSE;
+		}
+	}
+	else if (!gst_imx_vpu_framebuffers_alloc_arena(framebuffers, allocator, alignment) && !gst_imx_vpu_framebuffers_alloc_separate_blocks(framebuffers, allocator))
+		return FALSE;
 
-		framebuffer = &(framebuffers->framebuffers[i]);
+	mem_block_node = (framebuffers->fb_sub_blocks != NULL) ? framebuffers->fb_sub_blocks : framebuffers->fb_mem_blocks;
 
-		memory = (GstImxPhysMemory *)gst_allocator_alloc(allocator, framebuffers->total_size, NULL);
-		if (memory == NULL)
-			return FALSE;
-		gst_imx_vpu_append_phys_mem_block(memory, &(framebuffers->fb_mem_blocks));
+	for (i = 0; i < framebuffers->num_framebuffers; ++i, mem_block_node = mem_block_node->next)
+		gst_imx_vpu_framebuffers_fill_framebuffer(framebuffers, &(framebuffers->framebuffers[i]), (GstImxPhysMemory *)(mem_block_node->data));
 
-		phys_ptr = (unsigned char*)(memory->phys_addr);
-		virt_ptr = (unsigned char*)(memory->mapped_virt_addr); /* TODO */
+	return TRUE;
+}
 
-		if (alignment > 1)
-		{
-			phys_ptr = (unsigned char*)ALIGN_VAL_TO(phys_ptr, alignment);
+
+/* Sets up the plane addresses and strides of a framebuffer stored in the given memory block */
+static void gst_imx_vpu_framebuffers_fill_framebuffer(GstImxVpuFramebuffers *framebuffers, VpuFrameBuffer *framebuffer, GstImxPhysMemory *memory)
+{
+	int alignment = framebuffers->address_alignment;
+	unsigned char *phys_ptr, *virt_ptr;
+
+	/* sub-blocks share the parent's addresses; the memory offset
+	 * denotes where the sub-block starts inside the parent */
+	phys_ptr = (unsigned char*)gst_imx_phys_memory_get_phys_addr((GstMemory *)memory);
+	/* device-only framebuffers have no CPU mapping; only the VPU,
+	 * IPU and GPU access them, using the physical addresses */
+	virt_ptr = (memory->mapped_virt_addr != NULL) ? ((unsigned char*)(memory->mapped_virt_addr) + memory->mem.offset) : NULL;
+
+	if (alignment > 1)
+	{
+		phys_ptr = (unsigned char*)ALIGN_VAL_TO(phys_ptr, alignment);
+		if (virt_ptr != NULL)
 			virt_ptr = (unsigned char*)ALIGN_VAL_TO(virt_ptr, alignment);
-		}
+	}
 
-		framebuffer->nStrideY = framebuffers->y_stride;
-		framebuffer->nStrideC = framebuffers->uv_stride;	
+	framebuffer->nStrideY = framebuffers->y_stride;
+	framebuffer->nStrideC = framebuffers->uv_stride;	
 
-		/* fill phy addr*/
-		framebuffer->pbufY     = phys_ptr;
-		framebuffer->pbufCb    = phys_ptr + framebuffers->y_size;
-		framebuffer->pbufCr    = phys_ptr + framebuffers->y_size + framebuffers->u_size;
-		framebuffer->pbufMvCol = phys_ptr + framebuffers->y_size + framebuffers->u_size + framebuffers->v_size;
+	/* fill phy addr*/
+	framebuffer->pbufY     = phys_ptr;
+	framebuffer->pbufCb    = phys_ptr + framebuffers->y_size;
+	framebuffer->pbufCr    = phys_ptr + framebuffers->y_size + framebuffers->u_size;
+	framebuffer->pbufMvCol = phys_ptr + framebuffers->y_size + framebuffers->u_size + framebuffers->v_size;
 
-		/* fill virt addr */
+	/* fill virt addr */
+	if (virt_ptr != NULL)
+	{
 		framebuffer->pbufVirtY     = virt_ptr;
 		framebuffer->pbufVirtCb    = virt_ptr + framebuffers->y_size;
 		framebuffer->pbufVirtCr    = virt_ptr + framebuffers->y_size + framebuffers->u_size;
 		framebuffer->pbufVirtMvCol = virt_ptr + framebuffers->y_size + framebuffers->u_size + framebuffers->v_size;
+	}
+	else
+	{
+		framebuffer->pbufVirtY     = NULL;
+		framebuffer->pbufVirtCb    = NULL;
+		framebuffer->pbufVirtCr    = NULL;
+		framebuffer->pbufVirtMvCol = NULL;
+	}
 
-		framebuffer->pbufY_tilebot = 0;
-		framebuffer->pbufCb_tilebot = 0;
-		framebuffer->pbufVirtY_tilebot = 0;
-		framebuffer->pbufVirtCb_tilebot = 0;
+	framebuffer->pbufY_tilebot = 0;
+	framebuffer->pbufCb_tilebot = 0;
+	framebuffer->pbufVirtY_tilebot = 0;
+	framebuffer->pbufVirtCb_tilebot = 0;
+}
+
+
+static gboolean gst_imx_vpu_framebuffers_alloc_arena(GstImxVpuFramebuffers *framebuffers, GstAllocator *allocator, int alignment)
+{
+	GstMemory *arena;
+	GstAllocationParams alloc_params;
+	gsize slot_size, arena_size;
+	guint i;
+
+	/* All framebuffers in a set have the same size, so the arena is
+	 * simply split into equally sized slots */
+	slot_size = ALIGN_VAL_TO(framebuffers->total_size, MAX(alignment, FRAME_ALIGN));
+	arena_size = slot_size * framebuffers->num_framebuffers;
+
+	/* Framebuffers are only accessed by hardware; any CPU mapping is
+	 * created on demand (see gst_imx_vpu_set_buffer_contents()) */
+	gst_allocation_params_init(&alloc_params);
+	alloc_params.flags = GST_IMX_PHYS_MEM_FLAG_DEVICE_ONLY;
+
+	arena = gst_allocator_alloc(allocator, arena_size, &alloc_params);
+	if (arena == NULL)
+	{
+		GST_WARNING_OBJECT(framebuffers, "could not allocate framebuffer arena with %" G_GSIZE_FORMAT " bytes; falling back to separate framebuffer memory blocks", arena_size);
+		return FALSE;
+	}
+
+	/* Ensure the arena has a CPU mapping before it is shared;
+	 * the sub-blocks refer to the parent's addresses. Device-only
+	 * arenas are mapped on demand instead. */
+	if ((((GstImxPhysMemory *)arena)->mapped_virt_addr == NULL) && !GST_MEMORY_FLAG_IS_SET(arena, GST_IMX_PHYS_MEM_FLAG_DEVICE_ONLY))
+	{
+		GstMapInfo map_info;
+		if (!gst_memory_map(arena, &map_info, GST_MAP_READWRITE))
+		{
+			GST_ERROR_OBJECT(framebuffers, "could not map framebuffer arena");
+			gst_allocator_free(allocator, arena);
+			return FALSE;
+		}
+		gst_memory_unmap(arena, &map_info);
+	}
+
+	gst_imx_vpu_append_phys_mem_block((GstImxPhysMemory *)arena, &(framebuffers->fb_mem_blocks));
+
+	for (i = 0; i < framebuffers->num_framebuffers; ++i)
+	{
+		GstMemory *sub_block = gst_memory_share(arena, i * slot_size, framebuffers->total_size);
+		framebuffers->fb_sub_blocks = g_slist_append(framebuffers->fb_sub_blocks, sub_block);
+	}
+
+	GST_INFO_OBJECT(framebuffers, "allocated framebuffer arena with %" G_GSIZE_FORMAT " bytes at phys addr %p, split into %u slots with %" G_GSIZE_FORMAT " bytes each", arena_size, (gpointer)(((GstImxPhysMemory *)arena)->phys_addr), framebuffers->num_framebuffers, slot_size);
+
+	return TRUE;
+}
+
+
+static gboolean gst_imx_vpu_framebuffers_alloc_separate_blocks(GstImxVpuFramebuffers *framebuffers, GstAllocator *allocator)
+{
+	GstAllocationParams alloc_params;
+	guint i;
+
+	gst_imx_vpu_framebuffers_init_alloc_params(framebuffers, &alloc_params);
+
+	for (i = 0; i < framebuffers->num_framebuffers; ++i)
+	{
+		GstImxPhysMemory *memory = (GstImxPhysMemory *)gst_allocator_alloc(allocator, framebuffers->total_size, &alloc_params);
+		if (memory == NULL)
+			return FALSE;
+		gst_imx_vpu_append_phys_mem_block(memory, &(framebuffers->fb_mem_blocks));
 	}
 
 	return TRUE;
 }
 
 
+/* Sets up the parameters for allocating blocks which contain one framebuffer each */
+static void gst_imx_vpu_framebuffers_init_alloc_params(GstImxVpuFramebuffers *framebuffers, GstAllocationParams *alloc_params)
+{
+	gst_allocation_params_init(alloc_params);
+	alloc_params->flags = GST_IMX_PHYS_MEM_FLAG_DEVICE_ONLY;
+	if (framebuffers->exportable)
+		alloc_params->flags |= GST_IMX_PHYS_MEM_FLAG_DMABUF;
+}
+
+
 static void gst_imx_vpu_framebuffers_finalize(GObject *object)
 {
 	GstImxVpuFramebuffers *framebuffers = GST_IMX_VPU_FRAMEBUFFERS(object);
@@ -329,7 +655,16 @@ static void gst_imx_vpu_framebuffers_finalize(GObject *object)
 		framebuffers->framebuffers = NULL;
 	}
 
-	gst_imx_vpu_free_phys_mem_blocks((GstImxPhysMemAllocator *)(framebuffers->allocator), &(framebuffers->fb_mem_blocks));
+	/* The memory blocks are unref'd instead of freed directly, since framebuffers
+	 * sets which took over some of the framebuffers may still use them; the
+	 * arena sub-blocks hold references to the arena as well */
+	g_slist_free_full(framebuffers->fb_sub_blocks, (GDestroyNotify)gst_memory_unref);
+	framebuffers->fb_sub_blocks = NULL;
+	g_slist_free_full(framebuffers->fb_mem_blocks, (GDestroyNotify)gst_memory_unref);
+	framebuffers->fb_mem_blocks = NULL;
+
+	g_free(framebuffers->held_downstream);
+	framebuffers->held_downstream = NULL;
 
 	G_OBJECT_CLASS(gst_imx_vpu_framebuffers_parent_class)->finalize(object);
 }
@@ -40,6 +40,13 @@ typedef struct _GstImxVpuFramebuffersClass GstImxVpuFramebuffersClass;
 #define GST_IS_IMX_VPU_FRAMEBUFFERS_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_IMX_VPU_FRAMEBUFFERS))
 
 #define GST_IMX_VPU_MIN_NUM_FREE_FRAMEBUFFERS 6
+/* Smaller number of free framebuffers, used when decoding with minimal latency */
+#define GST_IMX_VPU_LOW_LATENCY_MIN_NUM_FREE_FRAMEBUFFERS 2
+/* Minimum number of free framebuffers when decoding only single I frames */
+#define GST_IMX_VPU_THUMBNAIL_MIN_NUM_FREE_FRAMEBUFFERS 1
+/* Waiting for free framebuffers longer than this (in microseconds) means downstream
+ * holds more framebuffers than anticipated, instead of just pacing the decoder */
+#define GST_IMX_VPU_FRAMEBUFFERS_STARVATION_TIME (500 * G_TIME_SPAN_MILLISECOND)
 
 
 typedef enum
@@ -79,7 +86,26 @@ struct _GstImxVpuFramebuffers
 	VpuFrameBuffer *framebuffers;
 	guint num_framebuffers;
 	gint num_available_framebuffers, decremented_availbuf_counter, num_framebuffers_in_buffers;
+	/* number of buffers containing a framebuffer which have not been
+	 * returned to their buffer pool yet */
+	gint num_framebuffers_downstream;
+	/* one flag per framebuffer; nonzero while the framebuffer is in such a buffer */
+	guint8 *held_downstream;
+	/* number of framebuffers that must be available before decoding can
+	 * continue; GST_IMX_VPU_MIN_NUM_FREE_FRAMEBUFFERS by default */
+	gint min_num_free_framebuffers;
+	/* number of consecutive gst_imx_vpu_framebuffers_wait_until_frames_available()
+	 * calls which were blocked for longer than GST_IMX_VPU_FRAMEBUFFERS_STARVATION_TIME
+	 * while downstream held all spare framebuffers; reset once a call returns
+	 * without starving */
+	gint num_starvations;
 	GSList *fb_mem_blocks;
+	/* per-framebuffer blocks if fb_mem_blocks does not contain exactly one block
+	 * per framebuffer: sub-blocks of the framebuffer arena, or blocks taken over
+	 * from a previous framebuffers set */
+	GSList *fb_sub_blocks;
+	/* number of framebuffers taken over from a previous framebuffers set */
+	guint num_reused_framebuffers;
 	GMutex available_fb_mutex;
 	GCond cond;
 	gboolean flushing, exit_loop;
@@ -89,6 +115,11 @@ struct _GstImxVpuFramebuffers
 	int total_size;
 
 	guint pic_width, pic_height;
+	/* parameters the framebuffers were configured with; used for
+	 * checking if the framebuffers can be reused */
+	gint mjpeg_source_format, interlace, address_alignment, chroma_interleave;
+	/* if nonzero, each framebuffer is a separate block which can be exported as DMABUF */
+	gint exportable;
 };
 
 
@@ -106,7 +137,12 @@ typedef struct
 		min_framebuffer_count,
 		mjpeg_source_format,
 		interlace,
-		address_alignment;
+		address_alignment,
+		/* if nonzero, the Cb and Cr planes are interleaved into one plane (NV12) */
+		chroma_interleave,
+		/* if nonzero, the framebuffers are allocated such that they can be exported
+		 * as DMABUF; this rules out the framebuffer arena */
+		exportable;
 }
 GstImxVpuFramebufferParams;
 
@@ -122,6 +158,19 @@ GstImxVpuFramebuffers * gst_imx_vpu_framebuffers_new(GstImxVpuFramebufferParams
 gboolean gst_imx_vpu_framebuffers_register_with_decoder(GstImxVpuFramebuffers *framebuffers, VpuDecHandle handle);
 gboolean gst_imx_vpu_framebuffers_register_with_encoder(GstImxVpuFramebuffers *framebuffers, VpuEncHandle handle, guint src_stride);
 
+/* Checks if framebuffers which were registered with a now closed or reinitialized
+ * decoder can be used for a decoder with the given parameters. This is the case if
+ * the framebuffers are large enough, have the same format, alignment and
+ * exportability, and at
+ * least one of them is not in use downstream. */
+gboolean gst_imx_vpu_framebuffers_can_reuse_for_decoder(GstImxVpuFramebuffers *framebuffers, GstImxVpuFramebufferParams *params);
+/* Creates a new, unregistered framebuffers set with the layout of the previous one.
+ * The framebuffers of the previous set which are not in use downstream are taken
+ * over; only the remaining ones are allocated. The VPU keeps pointers to the
+ * registered framebuffer array, so the previous set's array cannot be registered
+ * again while some of its framebuffers are still in use downstream. */
+GstImxVpuFramebuffers * gst_imx_vpu_framebuffers_new_reusing(GstImxVpuFramebuffers *previous, GstImxVpuFramebufferParams *params);
+
 void gst_imx_vpu_framebuffers_dec_init_info_to_params(VpuDecInitInfo *init_info, GstImxVpuFramebufferParams *params);
 void gst_imx_vpu_framebuffers_enc_init_info_to_params(VpuEncInitInfo *init_info, GstImxVpuFramebufferParams *params);
 
@@ -129,6 +178,15 @@ void gst_imx_vpu_framebuffers_enc_init_info_to_params(VpuEncInitInfo *init_info,
 void gst_imx_vpu_framebuffers_set_flushing(GstImxVpuFramebuffers *framebuffers, gboolean flushing);
 void gst_imx_vpu_framebuffers_wait_until_frames_available(GstImxVpuFramebuffers *framebuffers);
 void gst_imx_vpu_framebuffers_exit_wait_loop(GstImxVpuFramebuffers *framebuffers);
+/* Updates the downstream counter and flag of the given framebuffer; the lock must be held */
+void gst_imx_vpu_framebuffers_set_held_downstream(GstImxVpuFramebuffers *framebuffers, VpuFrameBuffer *framebuffer, gboolean held);
+/* Returns TRUE if downstream holds so many framebuffers that fewer than
+ * min_num_free_framebuffers can be available until it returns some; the lock must be held */
+gboolean gst_imx_vpu_framebuffers_downstream_holds_spare(GstImxVpuFramebuffers *framebuffers);
+
+/* Returns the physical memory block the given framebuffer is stored in. The
+ * framebuffers object retains ownership over the block. */
+GstMemory* gst_imx_vpu_framebuffers_get_memory(GstImxVpuFramebuffers *framebuffers, VpuFrameBuffer *framebuffer);
 
 
 G_END_DECLS
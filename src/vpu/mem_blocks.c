@@ -17,6 +17,12 @@
  */
 
 
+#include <config.h>
+#include <string.h>
+#ifdef HAVE_VPU_IO
+#include <vpu_lib.h>
+#include <vpu_io.h>
+#endif
 #include "mem_blocks.h"
 
 
@@ -119,3 +125,104 @@ gboolean gst_imx_vpu_free_phys_mem_blocks(GstImxPhysMemAllocator *phys_mem_alloc
 	return TRUE;
 }
 
+
+#ifdef HAVE_VPU_IO
+
+static void gst_imx_vpu_fill_mem_desc(GstImxPhysMemory *memory, vpu_mem_desc *mem_desc)
+{
+	memset(mem_desc, 0, sizeof(vpu_mem_desc));
+	mem_desc->size       = memory->mem.maxsize;
+	mem_desc->phy_addr   = (unsigned long)(memory->phys_addr);
+	mem_desc->cpu_addr   = (unsigned long)(memory->cpu_addr);
+	mem_desc->virt_uaddr = (unsigned long)(memory->mapped_virt_addr);
+}
+
+#endif
+
+
+gboolean gst_imx_vpu_alloc_device_only_phys_mem(GstImxPhysMemory *memory, gssize size)
+{
+#ifdef HAVE_VPU_IO
+	vpu_mem_desc mem_desc;
+
+	setup_debug_category();
+
+	memset(&mem_desc, 0, sizeof(vpu_mem_desc));
+	mem_desc.size = size;
+	if (IOGetPhyMem(&mem_desc) != 0)
+	{
+		GST_ERROR("could not allocate %d bytes of device-only physical memory", (int)size);
+		return FALSE;
+	}
+
+	memory->mapped_virt_addr = NULL;
+	memory->phys_addr        = (guintptr)(mem_desc.phy_addr);
+	memory->cpu_addr         = (guintptr)(mem_desc.cpu_addr);
+
+	GST_DEBUG("allocated %d bytes of device-only physical memory at phys addr %p", (int)size, (gpointer)(memory->phys_addr));
+
+	return TRUE;
+#else
+	(void)memory;
+	(void)size;
+	return FALSE;
+#endif
+}
+
+
+gboolean gst_imx_vpu_free_device_only_phys_mem(GstImxPhysMemory *memory)
+{
+#ifdef HAVE_VPU_IO
+	vpu_mem_desc mem_desc;
+
+	setup_debug_category();
+
+	gst_imx_vpu_fill_mem_desc(memory, &mem_desc);
+	return (IOFreePhyMem(&mem_desc) == 0);
+#else
+	(void)memory;
+	return FALSE;
+#endif
+}
+
+
+gpointer gst_imx_vpu_map_device_only_phys_mem(GstImxPhysMemory *memory)
+{
+#ifdef HAVE_VPU_IO
+	vpu_mem_desc mem_desc;
+
+	setup_debug_category();
+
+	gst_imx_vpu_fill_mem_desc(memory, &mem_desc);
+	if (IOGetVirtMem(&mem_desc) == -1)
+	{
+		GST_ERROR("could not map device-only physical memory at phys addr %p", (gpointer)(memory->phys_addr));
+		return NULL;
+	}
+
+	GST_DEBUG("mapped device-only physical memory at phys addr %p to virt addr %p", (gpointer)(memory->phys_addr), (gpointer)(mem_desc.virt_uaddr));
+
+	return (gpointer)(mem_desc.virt_uaddr);
+#else
+	(void)memory;
+	return NULL;
+#endif
+}
+
+
+void gst_imx_vpu_unmap_device_only_phys_mem(GstImxPhysMemory *memory)
+{
+#ifdef HAVE_VPU_IO
+	vpu_mem_desc mem_desc;
+
+	setup_debug_category();
+
+	if (memory->mapped_virt_addr == NULL)
+		return;
+
+	gst_imx_vpu_fill_mem_desc(memory, &mem_desc);
+	IOFreeVirtMem(&mem_desc);
+#else
+	(void)memory;
+#endif
+}
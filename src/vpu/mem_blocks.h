@@ -36,6 +36,15 @@ gboolean gst_imx_vpu_free_virt_mem_blocks(GSList **virt_mem_blocks);
 void gst_imx_vpu_append_phys_mem_block(GstImxPhysMemory *memory, GSList **phys_mem_blocks);
 gboolean gst_imx_vpu_free_phys_mem_blocks(GstImxPhysMemAllocator *phys_mem_allocator, GSList **phys_mem_blocks);
 
+/* Functions for device-only blocks (see GST_IMX_PHYS_MEM_FLAG_DEVICE_ONLY); these use the
+ * low-level VPU I/O library, since VPU_DecGetMem() and VPU_EncGetMem() always map the
+ * allocated memory. If the VPU I/O library is not available, the alloc function returns
+ * FALSE, and the VPU allocators use the regular, mapped allocation instead. */
+gboolean gst_imx_vpu_alloc_device_only_phys_mem(GstImxPhysMemory *memory, gssize size);
+gboolean gst_imx_vpu_free_device_only_phys_mem(GstImxPhysMemory *memory);
+gpointer gst_imx_vpu_map_device_only_phys_mem(GstImxPhysMemory *memory);
+void gst_imx_vpu_unmap_device_only_phys_mem(GstImxPhysMemory *memory);
+
 
 G_END_DECLS
 